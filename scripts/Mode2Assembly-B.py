@@ -44,6 +44,7 @@ mode2Options.maxDiscordantReadCountForBubbleRemoval = int(config['Assembly']['mo
 mode2Options.minLogPForBubbleRemoval = float(config['Assembly']['mode2.bubbleRemoval.minlogP'])
 
 mode2Options.componentSizeThresholdForBubbleRemoval = int(config['Assembly']['mode2.bubbleRemoval.componentSizeThreshold'])
+mode2Options.incrementalBubbleRemoval = ast.literal_eval(config['Assembly']['mode2.bubbleRemoval.incremental'])
 mode2Options.minConcordantReadCountForPhasing = int(config['Assembly']['mode2.phasing.minConcordantReadCount'])
 mode2Options.maxDiscordantReadCountForPhasing = int(config['Assembly']['mode2.phasing.maxDiscordantReadCount'])
 mode2Options.minLogPForPhasing = float(config['Assembly']['mode2.phasing.minlogP'])
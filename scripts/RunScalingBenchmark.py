@@ -0,0 +1,220 @@
+#!/usr/bin/python3
+
+import argparse
+import csv
+import json
+import os
+import shutil
+import subprocess
+import time
+
+helpMessage = """
+Measures how assembly time and memory scale with genome size
+and number of threads, using simulated reads.
+
+For each genome size, reads are simulated using
+"shasta --command simulateReads". Each simulated input
+is then assembled using each of the requested thread counts.
+For each assembly, elapsed time, CPU time, and peak resident memory
+of each assembly phase are taken from PhaseTimes.csv
+in the assembly directory. Assemblies are run with --resetPeakMemoryPerPhase,
+so the peak resident memory of each phase is the peak during that phase only,
+and the peak resident memory of the entire assembly is the maximum
+over all phases.
+
+The following files are written to the output directory:
+- ScalingPhases.csv: one line for each genome size, thread count, and phase.
+- ScalingSummary.csv: one line for each genome size and thread count,
+  including speedup and parallel efficiency relative to the smallest thread count.
+- Scaling.json: all of the above, plus the assembly summary for each assembly.
+
+It is assumed that the Shasta executable is in the
+same directory that contains this script
+(typically, that will be the shasta-install/bin directory),
+unless --shasta is specified.
+
+Example:
+RunScalingBenchmark.py --sizes 1000000 10000000 100000000 --threads 4 16 64
+"""
+
+parser = argparse.ArgumentParser(description = helpMessage,
+    formatter_class = argparse.RawDescriptionHelpFormatter)
+parser.add_argument('--sizes', type=int, nargs='+', default=[1000000, 10000000],
+    help='Simulated genome sizes, in bases.')
+parser.add_argument('--threads', type=int, nargs='+', default=[os.cpu_count()],
+    help='Thread counts to use for each assembly.')
+parser.add_argument('--config', default='Nanopore-Sep2020',
+    help='Assembly configuration (built-in name or configuration file).')
+parser.add_argument('--coverage', type=float, default=30.,
+    help='Coverage of the simulated reads.')
+parser.add_argument('--repeatFraction', type=float, default=0.05,
+    help='Fraction of the simulated genome consisting of repeats.')
+parser.add_argument('--heterozygosity', type=float, default=0.,
+    help='Heterozygosity of the simulated genome. If 0, the genome is haploid.')
+parser.add_argument('--readLengthMean', type=float, default=20000.,
+    help='Mean simulated read length.')
+parser.add_argument('--readLengthStandardDeviation', type=float, default=10000.,
+    help='Standard deviation of simulated read length.')
+parser.add_argument('--errorModel', default='guppy-3.6.0-a',
+    help='Bayesian consensus caller configuration used to simulate repeat count errors, or none.')
+parser.add_argument('--memoryMode', default='anonymous',
+    help='Value of --memoryMode for the assemblies.')
+parser.add_argument('--memoryBacking', default='4K',
+    help='Value of --memoryBacking for the assemblies.')
+parser.add_argument('--outputDirectory', default='ScalingBenchmark',
+    help='Directory for simulated reads, assemblies, and reports.')
+parser.add_argument('--keepAssemblies', action='store_true',
+    help='Keep the assembly directories. By default, they are removed after their results are collected.')
+parser.add_argument('--shasta', default=os.path.dirname(os.path.realpath(__file__)) + '/shasta',
+    help='The Shasta executable.')
+arguments = parser.parse_args()
+
+shastaExecutable = os.path.realpath(arguments.shasta)
+if not os.path.exists(shastaExecutable):
+    raise Exception('Shasta executable not found at %s' % shastaExecutable)
+threadCounts = sorted(set(arguments.threads))
+outputDirectory = os.path.realpath(arguments.outputDirectory)
+os.makedirs(outputDirectory, exist_ok=True)
+
+
+
+# Run a command, with output to a log file.
+# Return elapsed seconds and peak resident memory in bytes.
+def runCommand(command, logFileName):
+    print(' '.join(command), flush=True)
+    with open(logFileName, 'w') as log:
+        t0 = time.monotonic()
+        process = subprocess.Popen(command, stdout=log, stderr=subprocess.STDOUT)
+        pid, status, resourceUsage = os.wait4(process.pid, 0)
+        t1 = time.monotonic()
+    if not (os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0):
+        raise Exception('Command failed with status %i, see %s' % (status, logFileName))
+    # On Linux, ru_maxrss is in KiB.
+    return t1 - t0, 1024 * resourceUsage.ru_maxrss
+
+
+
+# Simulate the reads for each genome size, if not already done.
+def simulateReads(size):
+    prefix = '%s/Simulated-%i' % (outputDirectory, size)
+    fileName = prefix + '-Reads.fasta'
+    if os.path.exists(fileName):
+        print('Using existing %s' % fileName)
+        return fileName
+    runCommand([
+        shastaExecutable,
+        '--command', 'simulateReads',
+        '--simulateOutputPrefix', prefix,
+        '--simulateGenomeSize', str(size),
+        '--simulateCoverage', str(arguments.coverage),
+        '--simulateRepeatFraction', str(arguments.repeatFraction),
+        '--simulateHeterozygosity', str(arguments.heterozygosity),
+        '--simulateReadLengthMean', str(arguments.readLengthMean),
+        '--simulateReadLengthStandardDeviation', str(arguments.readLengthStandardDeviation),
+        '--simulateErrorModel', arguments.errorModel],
+        prefix + '-simulateReads.log')
+    return fileName
+
+
+
+# Run one assembly and gather its results.
+def assemble(size, threadCount, inputFileName):
+    assemblyName = 'Assembly-%i-%i' % (size, threadCount)
+    assemblyDirectory = '%s/%s' % (outputDirectory, assemblyName)
+    if os.path.exists(assemblyDirectory):
+        shutil.rmtree(assemblyDirectory)
+    elapsedSeconds, peakResidentMemory = runCommand([
+        shastaExecutable,
+        '--input', inputFileName,
+        '--config', arguments.config,
+        '--threads', str(threadCount),
+        '--memoryMode', arguments.memoryMode,
+        '--memoryBacking', arguments.memoryBacking,
+        '--resetPeakMemoryPerPhase',
+        '--assemblyDirectory', assemblyDirectory],
+        assemblyDirectory + '.log')
+
+    result = {
+        'Genome size': size,
+        'Threads': threadCount,
+        'Elapsed seconds': elapsedSeconds,
+        'Peak resident memory bytes': peakResidentMemory,
+        }
+
+    # Per-phase results.
+    with open(assemblyDirectory + '/PhaseTimes.csv') as phaseTimesCsv:
+        result['Phases'] = list(csv.DictReader(phaseTimesCsv))
+    result['CPU seconds'] = sum(float(phase['CPU seconds']) for phase in result['Phases'])
+
+    # Per-phase peak memory is obtained by resetting the peak resident memory
+    # at the beginning of each phase (--resetPeakMemoryPerPhase),
+    # so the operating system value can be less than the largest phase value.
+    result['Peak resident memory bytes'] = max([peakResidentMemory] +
+        [int(phase['Peak resident memory bytes']) for phase in result['Phases']])
+
+    with open(assemblyDirectory + '/AssemblySummary.json') as summaryJson:
+        result['Assembly summary'] = json.load(summaryJson)
+
+    # Clean up.
+    if arguments.memoryMode == 'filesystem':
+        subprocess.run([shastaExecutable, '--command', 'cleanupBinaryData',
+            '--assemblyDirectory', assemblyDirectory])
+    if not arguments.keepAssemblies:
+        shutil.rmtree(assemblyDirectory)
+
+    print('Genome size %i, %i threads: %.1f s, peak resident memory %.3f GiB' %
+        (size, threadCount, elapsedSeconds, result['Peak resident memory bytes'] / 2.**30), flush=True)
+    return result
+
+
+
+# Main loop over genome sizes and thread counts.
+results = []
+for size in sorted(set(arguments.sizes)):
+    inputFileName = simulateReads(size)
+    sizeResults = []
+    for threadCount in threadCounts:
+        sizeResults.append(assemble(size, threadCount, inputFileName))
+
+    # Speedup and parallel efficiency relative to the smallest thread count.
+    reference = sizeResults[0]
+    for result in sizeResults:
+        speedup = reference['Elapsed seconds'] / result['Elapsed seconds']
+        result['Speedup'] = speedup
+        result['Parallel efficiency'] = speedup * reference['Threads'] / result['Threads']
+    results += sizeResults
+
+
+
+# Write the reports.
+with open(outputDirectory + '/ScalingSummary.csv', 'w') as summaryCsv:
+    summaryCsv.write('Genome size,Threads,Elapsed seconds,CPU seconds,'
+        'Peak resident memory bytes,Speedup,Parallel efficiency,'
+        'Assembled segments N50\n')
+    for result in results:
+        assembledSegments = result['Assembly summary'].get('Assembled segments', {})
+        summaryCsv.write('%i,%i,%.3f,%.3f,%i,%.3f,%.3f,%s\n' % (
+            result['Genome size'], result['Threads'],
+            result['Elapsed seconds'], result['CPU seconds'],
+            result['Peak resident memory bytes'],
+            result['Speedup'], result['Parallel efficiency'],
+            assembledSegments.get('Assembled segments N50', '')))
+
+with open(outputDirectory + '/ScalingPhases.csv', 'w') as phasesCsv:
+    phasesCsv.write('Genome size,Threads,Phase,Elapsed seconds,CPU seconds,'
+        'Average CPU utilization,Peak resident memory bytes\n')
+    for result in results:
+        for phase in result['Phases']:
+            phasesCsv.write('%i,%i,%s,%s,%s,%s,%s\n' % (
+                result['Genome size'], result['Threads'], phase['Phase'],
+                phase['Elapsed seconds'], phase['CPU seconds'],
+                phase['Average CPU utilization'], phase['Peak resident memory bytes']))
+
+with open(outputDirectory + '/Scaling.json', 'w') as scalingJson:
+    json.dump({
+        'Shasta executable': shastaExecutable,
+        'Configuration': arguments.config,
+        'Virtual CPUs': os.cpu_count(),
+        'Results': results}, scalingJson, indent=2)
+
+print('Scaling reports written to %s' % outputDirectory)
@@ -0,0 +1,9 @@
+#!/usr/bin/python3
+
+# Write a small binary assembly graph, read it back,
+# and check that truncated or corrupted copies are rejected.
+# Run it in any writable directory.
+
+import shasta
+
+shasta.testBinaryAssemblyGraph()
@@ -0,0 +1,15 @@
+#!/usr/bin/python3
+
+# Check that the mode 2 assembly graph stored in binary data
+# is reconstructed identically, for both the final state
+# and the state stored before phasing.
+# Run it in the directory of a complete small mode 2 assembly
+# (--Assembly.mode 2) with binary data still available.
+
+import shasta
+
+a = shasta.Assembler()
+a.accessMarkers()
+a.accessMarkerGraphVertices()
+a.accessMarkerGraphEdges()
+a.testSaveAssemblyGraph2()
@@ -0,0 +1,9 @@
+#!/usr/bin/python3
+
+# Check that the read sketches used by Mode 3 segment clustering
+# discard most segment pairs with few common oriented reads
+# and never discard a pair with enough common oriented reads.
+
+import shasta
+
+shasta.testSegmentReadSketches()
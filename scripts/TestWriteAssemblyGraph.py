@@ -0,0 +1,15 @@
+#!/usr/bin/python3
+
+# Check that the parallel assembly graph output (GFA and FASTA)
+# is byte-for-byte identical to the output of the serial code it replaced.
+# Run it in the directory of a complete small assembly,
+# for example one created from shasta/tests/TinyTest.fasta.gz.
+
+import shasta
+
+a = shasta.Assembler()
+a.accessAssemblyGraphVertices()
+a.accessAssemblyGraphEdges()
+a.accessAssemblyGraphEdgeLists()
+a.accessAssemblyGraphSequences()
+a.testWriteAssemblyGraph()
@@ -0,0 +1,14 @@
+#!/usr/bin/python3
+
+# Check that the parallel mode 2 assembly output (GFA, FASTA, and csv files)
+# is byte-for-byte identical to the output of the serial code it replaced.
+# Run it in the directory of a complete small mode 2 assembly
+# (--Assembly.mode 2) with binary data still available.
+
+import shasta
+
+a = shasta.Assembler()
+a.accessMarkers()
+a.accessMarkerGraphVertices()
+a.accessMarkerGraphEdges()
+a.testWriteAssemblyGraph2()
@@ -1,7 +1,9 @@
 #include "Assembler.hpp"
 #include "buildId.hpp"
+#include "CachingConsensusCaller.hpp"
 #include "Coverage.hpp"
 #include "MedianConsensusCaller.hpp"
+#include "performanceLog.hpp"
 #include "Reads.hpp"
 #include "SimpleConsensusCaller.hpp"
 #include "SimpleBayesianConsensusCaller.hpp"
@@ -142,7 +144,10 @@ void Assembler::setupConsensusCaller(const string& s)
                 ". Bayesian:builtinName required or Bayesian::absolutePath");
         }
 
-        consensusCaller = std::make_shared<SimpleBayesianConsensusCaller>(constructorString);
+        // The Bayesian consensus caller is expensive and many positions
+        // have identical coverage, so we put a cache in front of it.
+        consensusCaller = std::make_shared<CachingConsensusCaller>(
+            std::make_shared<SimpleBayesianConsensusCaller>(constructorString));
         return;
     }
 
@@ -156,6 +161,20 @@ void Assembler::setupConsensusCaller(const string& s)
 
 
 
+// If the consensus caller is a CachingConsensusCaller,
+// write its statistics to performance.log and reset them.
+void Assembler::writeConsensusCallerStatistics()
+{
+    CachingConsensusCaller* cachingConsensusCaller =
+        dynamic_cast<CachingConsensusCaller*>(consensusCaller.get());
+    if(cachingConsensusCaller) {
+        cachingConsensusCaller->writeStatistics(performanceLog);
+        cachingConsensusCaller->clearStatistics();
+    }
+}
+
+
+
 // Store assembly time.
 void Assembler::storeAssemblyTime(
     double elapsedTimeSeconds,
@@ -16,8 +16,11 @@
 #include "shastaTypes.hpp"
 
 // Standard library.
+#include <functional>
 #include "memory.hpp"
+#include <mutex>
 #include "string.hpp"
+#include <thread>
 #include "tuple.hpp"
 #include "utility.hpp"
 
@@ -33,6 +36,7 @@ namespace shasta {
     class AssemblerOptions;
     class AssembledSegment;
     class AssemblyGraph2;
+    class Benchmark;
     class CompressedAssemblyGraph;
     class ConsensusCaller;
     class Histogram2;
@@ -47,7 +51,9 @@ namespace shasta {
     class LongBaseSequences;
     class MarkerConnectivityGraph;
     class MarkerConnectivityGraphVertexMap;
+    class MinHashOptions;
     class Mode2AssemblyOptions;
+    class OrderedFileWriter;
     class OrientedReadPair;
     class Reads;
     class ReferenceOverlapMap;
@@ -383,15 +389,26 @@ private:
     size_t largeDataPageSize;
 
     // Function to construct names for binary objects.
+    // If the prefix is in a shared read-only directory
+    // (see class SharedAssemblyData), binary objects that were not
+    // published are anonymous.
     string largeDataName(const string& name) const
     {
         if(largeDataFileNamePrefix.empty()) {
             return "";  // Anonymous;
         } else {
-            return largeDataFileNamePrefix + name;
+            return MemoryMapped::vectorPolicy.sharedDataName(largeDataFileNamePrefix + name);
         }
     }
 
+    // Create a new binary object with the name returned by largeDataName.
+    // If the object is anonymous, the name is still used to identify it
+    // in the statistics written to performance.log.
+    template<class T> void createNew(T& t, const string& name)
+    {
+        t.createNew(largeDataName(name), largeDataPageSize, name);
+    }
+
 
 
     // Various pieces of assembler information stored in shared memory.
@@ -577,6 +594,12 @@ private:
     // The markers on all oriented reads. Indexed by OrientedReadId::getValue().
     MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t> markers;
     void checkMarkersAreOpen() const;
+public:
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& getMarkerTable() const
+    {
+        return markers;
+    }
+private:
 
     // Get markers sorted by KmerId for a given OrientedReadId.
     void getMarkersSortedByKmerId(
@@ -786,6 +809,12 @@ private:
 public:
     void analyzeAlignmentMatrix(ReadId, Strand, ReadId, Strand);
 private:
+    void computeAlignmentMatrixHistogram(
+        OrientedReadId,
+        OrientedReadId,
+        int64_t dx,
+        int64_t dy,
+        vector< vector<uint64_t> >& histogram) const;
 
 
     // Alternative alignment functions with 1 suffix (SeqAn).
@@ -882,7 +911,67 @@ public:
         AlignmentInfo&
         ) const;
 
+
+
+    // Batch versions of some query functions, for use by Python scripts
+    // that process many oriented read pairs or markers.
+    // They are multithreaded and don't write any output.
+    // The Python bindings validate the input using checkBatchQueryInput,
+    // then release the GIL while these run.
+    // They use batchQueryData and the load balancing data of MultithreadedObject,
+    // so batchQueryMutex serializes them if they are called from several threads.
+    // While one of them is running, other multithreaded Assembler functions
+    // must not be called from other threads.
+
+    // Check that all oriented read ids are valid
+    // and, for markers, that all ordinals are valid.
+    // Throw an exception naming the first invalid entry.
+    void checkBatchQueryInput(const vector< array<OrientedReadId, 2> >&) const;
+    void checkBatchQueryInput(const vector< pair<OrientedReadId, uint32_t> >&) const;
+
+    // Align many pairs of oriented reads using alignment method 4.
+    // Only the AlignmentInfo is returned for each pair.
+    void alignOrientedReads4Batch(
+        const vector< array<OrientedReadId, 2> >&,
+        const Align4::Options&,
+        vector<AlignmentInfo>&,
+        size_t threadCount);
+
+    // Find the marker graph vertices for many markers,
+    // each specified as an (OrientedReadId, ordinal) pair.
+    // MarkerGraph::invalidCompressedVertexId is returned for markers
+    // that don't belong to any vertex.
+    void getGlobalMarkerGraphVertexBatch(
+        const vector< pair<OrientedReadId, uint32_t> >&,
+        vector<MarkerGraph::VertexId>&,
+        size_t threadCount);
+
+    // Compute the same alignment matrix histogram used by analyzeAlignmentMatrix
+    // for many pairs of oriented reads. For each pair, return
+    // the number of histogram cells in x and y and the number of active cells
+    // (cells containing at least 10 common markers).
+    void analyzeAlignmentMatrixBatch(
+        const vector< array<OrientedReadId, 2> >&,
+        vector< array<uint64_t, 3> >&,
+        size_t threadCount);
+
 private:
+    class BatchQueryData {
+    public:
+
+        // Not owned.
+        const vector< array<OrientedReadId, 2> >* orientedReadPairs = 0;
+        const Align4::Options* align4Options = 0;
+        vector<AlignmentInfo>* alignmentInfos = 0;
+        vector< array<uint64_t, 3> >* alignmentMatrixSummaries = 0;
+        const vector< pair<OrientedReadId, uint32_t> >* markerSpecifications = 0;
+        vector<MarkerGraph::VertexId>* vertexIds = 0;
+    };
+    BatchQueryData batchQueryData;
+    std::mutex batchQueryMutex;
+    void alignOrientedReads4BatchThreadFunction(size_t threadId);
+    void getGlobalMarkerGraphVertexBatchThreadFunction(size_t threadId);
+    void analyzeAlignmentMatrixBatchThreadFunction(size_t threadId);
 
 
     // Create a local alignment graph starting from a given oriented read
@@ -937,6 +1026,12 @@ private:
     // They are stored with readId0<readId1 and with strand0==0.
     // The order in compressedAlignments matches that in alignmentData.
     MemoryMapped::Vector<AlignmentData> alignmentData;
+public:
+    const MemoryMapped::Vector<AlignmentData>& getAlignmentData() const
+    {
+        return alignmentData;
+    }
+private:
     MemoryMapped::VectorOfVectors<char, uint64_t> compressedAlignments;
     
     void checkAlignmentDataAreOpen() const;
@@ -1010,9 +1105,14 @@ private:
     // For more information, see comments in ReadGraph.hpp.
     ReadGraph readGraph;
 public:
+    const ReadGraph& getReadGraph() const
+    {
+        return readGraph;
+    }
     void createReadGraph(
         uint32_t maxAlignmentCount,
-        uint32_t maxTrim);
+        uint32_t maxTrim,
+        size_t threadCount = 0);
 
     void createReadGraph2(
         uint32_t maxAlignmentCount,
@@ -1020,7 +1120,44 @@ public:
         double alignedFractionPercentile,
         double maxSkipPercentile,
         double maxDriftPercentile,
-        double maxTrimPercentile);
+        double maxTrimPercentile,
+        size_t threadCount = 0);
+private:
+
+    // For each read, select the best maxAlignmentCount alignments.
+    // Used by createReadGraph and createReadGraph2.
+    void selectReadGraphAlignments(
+        uint32_t maxAlignmentCount,
+        bool useReadGraph2Criteria,
+        vector<bool>& keepAlignment,
+        size_t threadCount);
+    void selectReadGraphAlignmentsThreadFunction(size_t threadId);
+    void createReadGraphUsingSelectedAlignmentsThreadFunction1(size_t threadId);
+    void createReadGraphUsingSelectedAlignmentsThreadFunction2(size_t threadId);
+    void createReadGraphUsingSelectedAlignmentsThreadFunction3(size_t threadId);
+    void createReadGraphUsingSelectedAlignmentsThreadFunction4(size_t threadId);
+    void createReadGraphUsingSelectedAlignmentsThreadFunction5(size_t threadId);
+    class CreateReadGraphData {
+    public:
+        uint32_t maxAlignmentCount;
+        bool useReadGraph2Criteria;
+
+        // Bit vector of the alignments selected by selectReadGraphAlignments,
+        // set by the threads using atomic operations.
+        vector<uint64_t> keepAlignmentBits;
+
+        // The alignments to be used by createReadGraphUsingSelectedAlignments.
+        const vector<bool>* keepAlignment = 0;
+
+        // Alignments are processed in blocks of this size
+        // when creating the read graph edges.
+        static const uint64_t blockSize = 4096;
+
+        // The index of the first read graph edge generated by each block.
+        vector<uint64_t> blockEdgeBegin;
+    };
+    CreateReadGraphData createReadGraphData;
+public:
 
     void setReadGraph2Criteria(
             double markerCountPercentile,
@@ -1035,7 +1172,29 @@ public:
     void checkReadGraphIsOpen() const;
     void removeReadGraphBridges(uint64_t maxDistance);
     void analyzeReadGraph();
-    void readGraphClustering();
+    void readGraphClustering(size_t threadCount = 0);
+private:
+    void readGraphClusteringThreadFunction1(size_t threadId);
+    void readGraphClusteringThreadFunction2(size_t threadId);
+    class ReadGraphClusteringData {
+    public:
+        uint64_t seed;
+
+        // The clustering run and sweep being processed.
+        uint64_t run;
+        uint64_t sweep;
+
+        // The cluster of each vertex before and after the current sweep.
+        // Indexed by OrientedReadId::getValue().
+        vector<ReadId> cluster;
+        vector<ReadId> newCluster;
+
+        // For each read graph edge, the number of clustering runs
+        // in which its two vertices were assigned to the same cluster.
+        vector<uint64_t> isSameClusterEdge;
+    };
+    ReadGraphClusteringData readGraphClusteringData;
+public:
     void writeReadGraphEdges(bool useReadName=false) const;
 
 
@@ -1049,7 +1208,12 @@ public:
         size_t threadCount);
 private:
     void flagInconsistentAlignmentsThreadFunction1(size_t threadId);
+    void flagInconsistentAlignmentsThreadFunction11(size_t threadId);
+    void flagInconsistentAlignmentsThreadFunction12(size_t threadId);
+    void flagInconsistentAlignmentsThreadFunction13(size_t threadId);
     void flagInconsistentAlignmentsThreadFunction2(size_t threadId);
+    bool flagInconsistentAlignmentsUsesEdge(uint32_t edgeId) const;
+    bool flagInconsistentAlignmentsRanksHigher(OrientedReadId, OrientedReadId) const;
     class FlagInconsistentAlignmentsData {
     public:
 
@@ -1063,6 +1227,23 @@ private:
         // oriented with the lowest OrientedReadId first.
         MemoryMapped::Vector<int32_t> edgeOffset;
 
+        // For each oriented read, the number of read graph edges
+        // used in triangle enumeration.
+        // Vertices are ranked by this degree, then by OrientedReadId.
+        MemoryMapped::Vector<uint32_t> degree;
+
+        // The triangle index. For each oriented read v, it contains
+        // the oriented reads that are joined to v by an edge used in
+        // triangle enumeration and rank higher than v,
+        // each with the corresponding edge id, sorted by OrientedReadId.
+        // Each triangle is found exactly once, at its lowest ranking vertex,
+        // by intersecting two of these lists.
+        MemoryMapped::VectorOfVectors<pair<OrientedReadId, uint32_t>, uint64_t> triangleIndex;
+
+        // Triangle statistics.
+        uint64_t triangleCount;
+        uint64_t inconsistentTriangleCount;
+
         // The inconsistent read graph edge ids found by each thread.
         vector< vector<uint64_t> > threadEdgeIds;
     };
@@ -1140,13 +1321,45 @@ public:
 
 
     // Strict strand separation in the read graph.
-    void flagCrossStrandReadGraphEdges2();
+    void flagCrossStrandReadGraphEdges2(size_t threadCount = 0);
+private:
+    void flagCrossStrandReadGraphEdges2ThreadFunction(size_t threadId);
+    void flagCrossStrandReadGraphEdges2ThreadFunctionComponents(size_t threadId);
+    class FlagCrossStrandReadGraphEdges2Data {
+    public:
+
+        // The first edge of each pair of read graph edges to be processed,
+        // in processing order.
+        vector<uint64_t> edgeIds;
+
+        // The batch of edgeIds currently being processed.
+        uint64_t batchBegin;
+        uint64_t batchEnd;
+
+        // The status of each pair in the current batch,
+        // as determined at the beginning of the batch.
+        static const uint8_t unknown = 0;
+        static const uint8_t sameComponent = 1;
+        static const uint8_t crossStrand = 2;
+        vector<uint8_t> status;
+
+        // The parent vector of the disjoint sets data structure.
+        const ReadId* parent = 0;
+        ReadId findRoot(ReadId) const;
+
+        // The connected component of each oriented read.
+        vector<ReadId> component;
+    };
+    FlagCrossStrandReadGraphEdges2Data flagCrossStrandReadGraphEdges2Data;
+public:
 
 
 
     // Create the ReadGraph given a bool vector that specifies which
     // alignments should be used in the read graph.
-    void createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignment);
+    void createReadGraphUsingSelectedAlignments(
+        vector<bool>& keepAlignment,
+        size_t threadCount = 0);
 
     // Add alignments to avoid coverage holes.
     void fixCoverageHoles(vector<bool>& keepAlignment) const;
@@ -1218,7 +1431,20 @@ public:
     // Compute connected components of the read graph.
     // This just writes a csv file and has no other side effects
     // (nothing is stored).
-    void computeReadGraphConnectedComponents() const;
+    void computeReadGraphConnectedComponents(size_t threadCount = 0);
+private:
+    void computeReadGraphConnectedComponentsThreadFunction1(size_t threadId);
+    void computeReadGraphConnectedComponentsThreadFunction2(size_t threadId);
+    class ComputeReadGraphConnectedComponentsData {
+    public:
+        shared_ptr<DisjointSets> disjointSetsPointer;
+
+        // The set representative of each oriented read.
+        // Indexed by OrientedReadId::getValue().
+        vector<ReadId> component;
+    };
+    ComputeReadGraphConnectedComponentsData computeReadGraphConnectedComponentsData;
+public:
 
 
 
@@ -1960,12 +2186,27 @@ public:
 
 
     // Detangle the AssemblyGraph.
-    void detangle();    // detangleMethod 1
+    // If useRounds is true, non-conflicting tangles are detangled
+    // in rounds (see AssemblyPathGraph::detangle).
+    void detangle(bool useRounds = false, size_t threadCount = 0);    // detangleMethod 1
     void detangle2(     // detangleMethod 2
         uint64_t diagonalReadCountMin,
         uint64_t offDiagonalReadCountMax,
-        double detangleOffDiagonalRatio
+        double detangleOffDiagonalRatio,
+        bool useRounds = false,
+        size_t threadCount = 0
          );
+private:
+    void detangleThreadFunction(size_t threadId);
+    class DetangleData {
+    public:
+        // For each edge of the AssemblyPathGraph or AssemblyPathGraph2,
+        // the corresponding assembly graph edge and a pointer to
+        // the oriented read ids to be filled in.
+        vector< pair<AssemblyGraphEdgeId, vector<OrientedReadId>*> > edges;
+    };
+    DetangleData detangleData;
+public:
 
 
 
@@ -2100,9 +2341,11 @@ public:
 
     // Write the assembly graph in GFA 1.0 format defined here:
     // https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
-    void writeGfa1(const string& fileName);
-    void writeGfa1BothStrands(const string& fileName);
-    void writeGfa1BothStrandsNoSequence(const string& fileName);
+    // Segments and links are formatted in parallel
+    // and written out in order using an OrderedFileWriter.
+    void writeGfa1(const string& fileName, size_t threadCount = 0);
+    void writeGfa1BothStrands(const string& fileName, size_t threadCount = 0);
+    void writeGfa1BothStrandsNoSequence(const string& fileName, size_t threadCount = 0);
 private:
     // Construct the CIGAR string given two vectors of repeat counts.
     // Used by writeGfa1.
@@ -2115,7 +2358,71 @@ private:
 public:
 
     // Write assembled sequences in FASTA format.
-    void writeFasta(const string& fileName);
+    void writeFasta(const string& fileName, size_t threadCount = 0);
+
+    // Write the assembly graph in the binary format
+    // described in BinaryAssemblyGraph.hpp.
+    void writeAssemblyGraphBinary(const string& fileName);
+private:
+
+    // Data and functions used by writeGfa1, writeGfa1BothStrands,
+    // writeGfa1BothStrandsNoSequence, and writeFasta.
+    class WriteAssemblyGraphData {
+    public:
+        enum class Format {Gfa1, Gfa1BothStrands, Gfa1BothStrandsNoSequence, Fasta};
+        enum class Pass {Segments, Links};
+        Format format;
+        Pass pass;
+        OrderedFileWriter* writer = 0;
+
+        // The sequence number for the OrderedFileWriter of
+        // the batch beginning at begin is firstSequenceNumber + begin / batchSize.
+        uint64_t firstSequenceNumber;
+        uint64_t batchSize;
+    };
+    WriteAssemblyGraphData writeAssemblyGraphData;
+    void writeAssemblyGraph(
+        const string& fileName,
+        WriteAssemblyGraphData::Format,
+        size_t threadCount);
+    void writeAssemblyGraphThreadFunction(size_t threadId);
+    void appendAssembledSequence(
+        AssemblyGraphEdgeId,
+        bool reverseComplement,
+        string&) const;
+    void appendGfa1Segment(
+        AssemblyGraphEdgeId,
+        bool bothStrands,
+        string&) const;
+    void appendGfa1Links(
+        AssemblyGraphVertexId,
+        bool bothStrands,
+        string&,
+        string& cigarString) const;
+    void appendGfa1SegmentNoSequence(
+        AssemblyGraphEdgeId,
+        string&) const;
+    void appendGfa1LinksNoSequence(
+        AssemblyGraphVertexId,
+        string&) const;
+
+    // The serial writers used before the output was parallelized.
+    // Only used by testWriteAssemblyGraph.
+    void writeGfa1Baseline(const string& fileName);
+    void writeGfa1BothStrandsBaseline(const string& fileName);
+    void writeFastaBaseline(const string& fileName);
+public:
+
+    // Check that writeGfa1, writeGfa1BothStrands, writeGfa1BothStrandsNoSequence,
+    // and writeFasta produce output that is byte-for-byte identical
+    // to the serial writers they replaced, for 1 thread and for threadCount threads.
+    // Throws an exception if a difference is found.
+    void testWriteAssemblyGraph(size_t threadCount = 0);
+private:
+    void appendFastaSequence(
+        AssemblyGraphEdgeId,
+        string&) const;
+public:
 
 
 
@@ -2337,6 +2644,86 @@ public:
 public:
     void accessAllSoft();
 
+    // Lazy access to assembly data (used by --command explore and
+    // optionally by Python scripts).
+    // accessAllLazy registers the same data as accessAllSoft
+    // without accessing them. Each registered item is identified by
+    // the name passed to largeDataName for its main binary object,
+    // for example "Markers" or "GlobalMarkerGraphEdges".
+    // It is accessed on first use by accessLazy, which is also
+    // called by the checkXxxAreOpen functions, and by the http server
+    // before processing each request.
+    // If warmup is true, a background thread asks the kernel to read ahead
+    // the binary files of the registered items, in order of expected use.
+    // Only useful when binary data are in a directory (not anonymous memory).
+    void accessAllLazy(bool warmup);
+    bool accessLazy(const string& name) const;
+    void accessAllRegisteredLazy(bool includeExpensive) const;
+private:
+    class LazyAccessData {
+    public:
+        class Item {
+        public:
+            std::function<void()> accessFunction;
+
+            // The names passed to largeDataName for the binary
+            // objects used by this item. Only used to check availability
+            // and for warmup.
+            vector<string> dataNames;
+
+            // Expensive items (which construct data structures in memory
+            // when accessed) are only accessed when specifically requested.
+            bool isExpensive = false;
+
+            bool isAvailable = false;
+            bool wasAccessed = false;
+        };
+        std::map<string, Item> items;
+
+        // The item names, in the order in which they were registered.
+        // This is also the order used for warmup.
+        vector<string> itemNames;
+
+        bool isEnabled = false;
+        std::mutex mutex;
+        std::thread warmupThread;
+
+        ~LazyAccessData();
+    };
+    mutable LazyAccessData lazyAccessData;
+    void registerLazyAccess(
+        const string& name,
+        const vector<string>& dataNames,
+        const std::function<void()>& accessFunction,
+        bool isExpensive = false);
+    static void lazyAccessWarmupThreadFunction(vector<string> fileNames);
+public:
+
+
+
+    // Micro-benchmarks of computational kernels, using the data
+    // of this assembly as input. Used by the shastaBenchmark executable.
+    // Results are added to the Benchmark object. Kernels that need
+    // data not available for this assembly are skipped.
+    // The sampleCount controls the number of alignment candidates,
+    // marker graph edges, and marker graph vertices used.
+    // MarkerFinder and LowHash0 use all threads and all reads.
+    // All other kernels are single threaded.
+    void benchmarkKernels(
+        Benchmark&,
+        const AssemblerOptions&,
+        uint64_t sampleCount,
+        size_t threadCount);
+private:
+    void benchmarkMarkerFinder(Benchmark&, size_t threadCount);
+    void benchmarkMurmurHash(Benchmark&, uint64_t m, uint64_t sampleCount);
+    void benchmarkLowHash(Benchmark&, const MinHashOptions&, size_t threadCount);
+    void benchmarkAlignments(Benchmark&, const AlignOptions&, uint64_t sampleCount);
+    void benchmarkSpoaEdgeConsensus(Benchmark&, uint64_t sampleCount);
+    void benchmarkConsensusCaller(Benchmark&, const string& consensusCallerName, uint64_t sampleCount);
+    void benchmarkLongBaseSequence(Benchmark&, uint64_t sampleCount);
+public:
+
     // Store assembly time.
     void storeAssemblyTime(
         double elapsedTimeSeconds,
@@ -2397,6 +2784,7 @@ public:
     void setupConsensusCaller(const string&);
 private:
     shared_ptr<ConsensusCaller> consensusCaller;
+    void writeConsensusCallerStatistics();
 public:
 
 
@@ -2408,6 +2796,19 @@ public:
         const Mode2AssemblyOptions&,
         size_t threadCount,
         bool debug);
+    void accessAssemblyGraph2(size_t threadCount);
+    void rephaseAssemblyGraph2(
+        uint64_t pruneLength,
+        const Mode2AssemblyOptions&,
+        size_t threadCount);
+
+    // Check that the mode 2 output is byte-for-byte identical to the output
+    // of the serial writers it replaced. See AssemblyGraph2::testWriteOutput.
+    void testWriteAssemblyGraph2(size_t threadCount);
+
+    // Check that the mode 2 assembly graph is reconstructed identically
+    // from binary data. See AssemblyGraph2::testSave.
+    void testSaveAssemblyGraph2(size_t threadCount);
 
 
     // Mode 3 assembly.
@@ -258,8 +258,8 @@ void Assembler::computeAlignments(
 
     // Store the alignments found by each thread.
     performanceLog << timestamp << "Storing the alignment found by each thread." << endl;
-    alignmentData.createNew(largeDataName("AlignmentData"), largeDataPageSize);
-    compressedAlignments.createNew(largeDataName("CompressedAlignments"), largeDataPageSize);
+    createNew(alignmentData, "AlignmentData");
+    createNew(compressedAlignments, "CompressedAlignments");
     
     for(size_t threadId=0; threadId<threadCount; threadId++) {
         const vector<AlignmentData>& threadAlignmentData = data.threadAlignmentData[threadId];
@@ -359,9 +359,7 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
         make_shared< MemoryMapped::VectorOfVectors<char, uint64_t> >();
     data.threadCompressedAlignments[threadId] = thisThreadCompressedAlignmentsPointer;
     auto& thisThreadCompressedAlignments = *thisThreadCompressedAlignmentsPointer;
-    thisThreadCompressedAlignments.createNew(
-        largeDataName("tmp-ThreadGlobalCompressedAlignments-" + to_string(threadId)),
-        largeDataPageSize);
+    createNew(thisThreadCompressedAlignments, "tmp-ThreadGlobalCompressedAlignments-" + to_string(threadId));
 
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -506,7 +504,7 @@ void Assembler::accessCompressedAlignments()
 // This could be made multithreaded if it becomes a bottleneck.
 void Assembler::computeAlignmentTable()
 {
-    alignmentTable.createNew(largeDataName("AlignmentTable"), largeDataPageSize);
+    createNew(alignmentTable, "AlignmentTable");
     alignmentTable.beginPass1(ReadId(2 * reads->readCount()));
     for(const AlignmentData& ad: alignmentData) {
         const auto& readIds = ad.readIds;
@@ -585,6 +583,9 @@ void Assembler::accessAlignmentDataReadWrite()
 
 void Assembler::checkAlignmentDataAreOpen() const
 {
+    if(!alignmentData.isOpen || !alignmentTable.isOpen()) {
+        accessLazy("AlignmentData");
+    }
     if(!alignmentData.isOpen || !alignmentTable.isOpen()) {
         throw runtime_error("Alignment data are not accessible.");
     }
@@ -769,14 +770,17 @@ void Assembler::flagPalindromicReadsThreadFunction(size_t threadId)
 
 
 
-void Assembler::analyzeAlignmentMatrix(
-    ReadId readId0, Strand strand0,
-    ReadId readId1, Strand strand1)
+// Compute the histogram of common markers in the alignment matrix
+// of two oriented reads, in cells of size (dx, dy) in coordinates
+// x = ordinal0 + ordinal1, y = ordinal0 - ordinal1.
+// The histogram is indexed by [ix][iy].
+void Assembler::computeAlignmentMatrixHistogram(
+    OrientedReadId orientedReadId0,
+    OrientedReadId orientedReadId1,
+    int64_t dx,
+    int64_t dy,
+    vector< vector<uint64_t> >& histogram) const
 {
-    // Get the oriented reads.
-    const OrientedReadId orientedReadId0(readId0, strand0);
-    const OrientedReadId orientedReadId1(readId1, strand1);
-
     // Get the markers sorted by kmerId.
     vector<MarkerWithOrdinal> markers0;
     vector<MarkerWithOrdinal> markers1;
@@ -807,13 +811,9 @@ void Assembler::analyzeAlignmentMatrix(
     const int64_t ny= yMax -yMin + 1;
 
     // Create a histogram in cells of size (dx, dy).
-    const int64_t dx = 100;
-    const int64_t dy = 20;
     const int64_t nxCells = (nx-1)/dx + 1;
     const int64_t nyCells = (ny-1)/dy + 1;
-    vector< vector<uint64_t> > histogram(nxCells, vector<uint64_t>(nyCells, 0));
-    cout << "nxCells " << nxCells << endl;
-    cout << "nyCells " << nyCells << endl;
+    histogram.assign(nxCells, vector<uint64_t>(nyCells, 0));
 
 
 
@@ -870,6 +870,27 @@ void Assembler::analyzeAlignmentMatrix(
             it1 = it1End;
         }
     }
+}
+
+
+
+void Assembler::analyzeAlignmentMatrix(
+    ReadId readId0, Strand strand0,
+    ReadId readId1, Strand strand1)
+{
+    // Get the oriented reads.
+    const OrientedReadId orientedReadId0(readId0, strand0);
+    const OrientedReadId orientedReadId1(readId1, strand1);
+
+    // Create a histogram in cells of size (dx, dy).
+    const int64_t dx = 100;
+    const int64_t dy = 20;
+    vector< vector<uint64_t> > histogram;
+    computeAlignmentMatrixHistogram(orientedReadId0, orientedReadId1, dx, dy, histogram);
+    const int64_t nxCells = int64_t(histogram.size());
+    const int64_t nyCells = nxCells == 0 ? 0 : int64_t(histogram.front().size());
+    cout << "nxCells " << nxCells << endl;
+    cout << "nyCells " << nyCells << endl;
 
     ofstream csv("Histogram.csv");
     PngImage image = PngImage(int(nxCells), int(nyCells));
@@ -1171,8 +1192,7 @@ void Assembler::suppressAlignmentCandidates(
 
     // Allocate memory for flags to keep track of which alignments
     // should be suppressed.
-    suppressAlignmentCandidatesData.suppress.createNew(
-        largeDataName("tmp-suppressAlignmentCandidates"), largeDataPageSize);
+    createNew(suppressAlignmentCandidatesData.suppress, "tmp-suppressAlignmentCandidates");
     const uint64_t candidateCount = alignmentCandidates.candidates.size();
     suppressAlignmentCandidatesData.suppress.resize(candidateCount);
 
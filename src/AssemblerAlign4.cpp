@@ -199,7 +199,7 @@ void Assembler::computeSortedMarkers(uint64_t threadCount)
     }
 
     // Do it.
-    sortedMarkers.createNew(largeDataName("SortedMarkers"), largeDataPageSize);
+    createNew(sortedMarkers, "SortedMarkers");
     sortedMarkers.beginPass1(orientedReadCount);
     const uint64_t batchSize = 10000;
     setupLoadBalancing(orientedReadCount, batchSize);
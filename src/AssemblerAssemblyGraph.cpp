@@ -2,8 +2,10 @@
 #include "Assembler.hpp"
 #include "assembleMarkerGraphPath.hpp"
 #include "AssembledSegment.hpp"
+#include "BinaryAssemblyGraph.hpp"
 #include "deduplicate.hpp"
 #include "LocalAssemblyGraph.hpp"
+#include "OrderedFileWriter.hpp"
 #include "orderPairs.hpp"
 #include "performanceLog.hpp"
 #include "Reads.hpp"
@@ -55,18 +57,13 @@ void Assembler::createAssemblyGraphEdges()
     // Vector used to keep track of marker graph edges that were already found.
     const EdgeId edgeCount = markerGraph.edges.size();
     MemoryMapped::Vector<bool> wasFound;
-    wasFound.createNew(
-        largeDataName("tmp-createAssemblyGraphVertices-wasFound"),
-        largeDataPageSize);
+    createNew(wasFound, "tmp-createAssemblyGraphVertices-wasFound");
     wasFound.resize(edgeCount);
     fill(wasFound.begin(), wasFound.end(), false);
 
     // Initialize the data structures we are going to fill in.
-    assemblyGraph.edgeLists.createNew(
-        largeDataName("AssemblyGraphEdgeLists"),
-        largeDataPageSize);
-    assemblyGraph.reverseComplementEdge.createNew(
-        largeDataName("AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+    createNew(assemblyGraph.edgeLists, "AssemblyGraphEdgeLists");
+    createNew(assemblyGraph.reverseComplementEdge, "AssemblyGraphReverseComplementEdge");
 
 
 
@@ -236,9 +233,7 @@ void Assembler::createAssemblyGraphEdges()
 
 
     // Create the markerToAssemblyTable.
-    assemblyGraph.markerToAssemblyTable.createNew(
-        largeDataName("MarkerToAssemblyTable"),
-        largeDataPageSize);
+    createNew(assemblyGraph.markerToAssemblyTable, "MarkerToAssemblyTable");
     assemblyGraph.createMarkerToAssemblyTable(edges.size());
 
 
@@ -310,9 +305,7 @@ void Assembler::createAssemblyGraphVertices()
     // Each marker graph vertex that is the first or last vertex
     // of a linear edge chain corresponding to an edge of the assembly graph.
     // generates an assembly graph vertex.
-    assemblyGraph.vertices.createNew(
-        largeDataName("AssemblyGraphVertices"),
-        largeDataPageSize);
+    createNew(assemblyGraph.vertices, "AssemblyGraphVertices");
     for(EdgeId age=0; age<assemblyGraph.edgeLists.size(); age++) {
         const auto chain = assemblyGraph.edgeLists[age];
         SHASTA_ASSERT(chain.size() > 0);
@@ -345,8 +338,7 @@ void Assembler::createAssemblyGraphVertices()
 
 
     // Find the reverse complement of each vertex.
-    assemblyGraph.reverseComplementVertex.createNew(
-        largeDataName("AssemblyGraphReverseComplementVertex"), largeDataPageSize);
+    createNew(assemblyGraph.reverseComplementVertex, "AssemblyGraphReverseComplementVertex");
     assemblyGraph.reverseComplementVertex.resize(assemblyGraph.vertices.size());
     for(AssemblyGraph::VertexId agv=0; agv<assemblyGraph.vertices.size(); agv++) {
     	const MarkerGraph::VertexId mgv = assemblyGraph.vertices[agv];
@@ -363,9 +355,7 @@ void Assembler::createAssemblyGraphVertices()
 
 
     // Create assemblyGraph edges.
-    assemblyGraph.edges.createNew(
-        largeDataName("AssemblyGraphEdges"),
-        largeDataPageSize);
+    createNew(assemblyGraph.edges, "AssemblyGraphEdges");
     assemblyGraph.edges.resize(assemblyGraph.edgeLists.size());
     for(EdgeId age=0; age<assemblyGraph.edgeLists.size(); age++) {
         const auto chain = assemblyGraph.edgeLists[age];
@@ -434,12 +424,8 @@ void Assembler::createAssemblyGraphVertices()
     // cout << timestamp << "Creating assembly graph edges by source and by target." << endl;
 
     // Create edges by source and by target.
-    assemblyGraph.edgesBySource.createNew(
-        largeDataName("AssemblyGraphEdgesBySource"),
-        largeDataPageSize);
-    assemblyGraph.edgesByTarget.createNew(
-        largeDataName("AssemblyGraphEdgesByTarget"),
-        largeDataPageSize);
+    createNew(assemblyGraph.edgesBySource, "AssemblyGraphEdgesBySource");
+    createNew(assemblyGraph.edgesByTarget, "AssemblyGraphEdgesByTarget");
     assemblyGraph.computeConnectivity();
 
 }
@@ -699,8 +685,8 @@ void Assembler::assemble(
 
 
     // Store the assembly results found by each thread.
-    assemblyGraph.sequences.createNew(largeDataName("AssembledSequences"), largeDataPageSize);
-    assemblyGraph.repeatCounts.createNew(largeDataName("AssembledRepeatCounts"), largeDataPageSize);
+    createNew(assemblyGraph.sequences, "AssembledSequences");
+    createNew(assemblyGraph.repeatCounts, "AssembledRepeatCounts");
     size_t assembledEdgeCount = 0;
     for(AssemblyGraph::EdgeId edgeId=0; edgeId<assemblyGraph.edgeLists.size(); edgeId++) {
         if(assemblyGraph.edges[edgeId].wasRemoved() ||
@@ -757,11 +743,11 @@ void Assembler::assembleThreadFunction(size_t threadId)
 
     assembleData.sequences[threadId] = make_shared<LongBaseSequences>();
     LongBaseSequences& sequences = *(assembleData.sequences[threadId]);
-    sequences.createNew(largeDataName("tmp-Sequences-" + to_string(threadId)), largeDataPageSize);
+    createNew(sequences, "tmp-Sequences-" + to_string(threadId));
 
     assembleData.repeatCounts[threadId] = make_shared<MemoryMapped::VectorOfVectors<uint8_t, uint64_t> >();
     MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& repeatCounts = *(assembleData.repeatCounts[threadId]);
-    repeatCounts.createNew(largeDataName("tmp-RepeatCounts-" + to_string(threadId)), largeDataPageSize);
+    createNew(repeatCounts, "tmp-RepeatCounts-" + to_string(threadId));
 
     AssembledSegment assembledSegment;
 
@@ -938,119 +924,316 @@ void Assembler::computeAssemblyStatistics()
 
 // Write the assembly graph in GFA 1.0 format defined here:
 // https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
-void Assembler::writeGfa1(const string& fileName)
+void Assembler::writeGfa1(const string& fileName, size_t threadCount)
 {
-    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
-    using VertexId = AssemblyGraph::VertexId;
-    using EdgeId = AssemblyGraph::EdgeId;
-
     performanceLog << timestamp << "writeGfa1 begins" << endl;
+    writeAssemblyGraph(fileName, WriteAssemblyGraphData::Format::Gfa1, threadCount);
+    performanceLog << timestamp << "writeGfa1 ends" << endl;
+}
+
+
+
+// Write the assembly graph in GFA 1.0 format defined here:
+// https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
+// This version writes a GFA file containing both strands.
+void Assembler::writeGfa1BothStrands(const string& fileName, size_t threadCount)
+{
+    performanceLog << timestamp << "writeGfa1BothStrands begins" << endl;
+    writeAssemblyGraph(fileName, WriteAssemblyGraphData::Format::Gfa1BothStrands, threadCount);
+    performanceLog << timestamp << "writeGfa1BothStrands ends" << endl;
+}
+
+
+
+// Write the assembly graph in GFA 1.0 format, both strands, without sequence.
+// The sequence length of each edge is written as the number of
+// marker graph edges. The output is the same as
+// AssemblyGraph::writeGfa1BothStrandsNoSequence, which is serial
+// and is still used for debug output before sequence assembly.
+void Assembler::writeGfa1BothStrandsNoSequence(const string& fileName, size_t threadCount)
+{
+    performanceLog << timestamp << "writeGfa1BothStrandsNoSequence begins" << endl;
+    writeAssemblyGraph(fileName, WriteAssemblyGraphData::Format::Gfa1BothStrandsNoSequence, threadCount);
+    performanceLog << timestamp << "writeGfa1BothStrandsNoSequence ends" << endl;
+}
+
+
+
+// Write assembled sequences in FASTA format.
+void Assembler::writeFasta(const string& fileName, size_t threadCount)
+{
+    performanceLog << timestamp << "writeFasta begins" << endl;
+    writeAssemblyGraph(fileName, WriteAssemblyGraphData::Format::Fasta, threadCount);
+    performanceLog << timestamp << "writeFasta ends" << endl;
+}
+
 
-    ofstream gfa(fileName);
+
+// Common code used by writeGfa1, writeGfa1BothStrands,
+// writeGfa1BothStrandsNoSequence, and writeFasta.
+// Segments and links are formatted in parallel, in batches,
+// and each batch is written out in order using an OrderedFileWriter.
+void Assembler::writeAssemblyGraph(
+    const string& fileName,
+    WriteAssemblyGraphData::Format format,
+    size_t threadCount)
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using Format = WriteAssemblyGraphData::Format;
+    using Pass = WriteAssemblyGraphData::Pass;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    OrderedFileWriter writer(fileName);
+    WriteAssemblyGraphData& data = writeAssemblyGraphData;
+    data.format = format;
+    data.writer = &writer;
+    uint64_t sequenceNumber = 0;
 
     // Write the header line.
-    gfa << "H\tVN:Z:1.0\n";
+    if(format != Format::Fasta) {
+        writer.write(sequenceNumber++, string("H\tVN:Z:1.0\n"));
+    }
 
-    // Write a segment record for each edge.
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
-        if(assemblyGraph.edges[edgeId].wasRemoved()) {
-            continue;
-        }
+    // Write a segment record (or a FASTA sequence) for each edge.
+    // Without sequence, this does not require the assembled sequences to exist.
+    const uint64_t edgeCount = (format == Format::Gfa1BothStrandsNoSequence) ?
+        assemblyGraph.edgeLists.size() : assemblyGraph.sequences.size();
+    data.pass = Pass::Segments;
+    data.firstSequenceNumber = sequenceNumber;
+    data.batchSize = 100;
+    setupLoadBalancing(edgeCount, data.batchSize);
+    runThreads(&Assembler::writeAssemblyGraphThreadFunction, threadCount);
+    sequenceNumber += (edgeCount + data.batchSize - 1) / data.batchSize;
 
-        // Only output one of each pair of reverse complemented edges.
-        if(!assemblyGraph.isAssembledEdge(edgeId)) {
-            continue;
+    // Write GFA links.
+    if(format != Format::Fasta) {
+        const uint64_t vertexCount = assemblyGraph.vertices.size();
+        data.pass = Pass::Links;
+        data.firstSequenceNumber = sequenceNumber;
+        data.batchSize = 10000;
+        setupLoadBalancing(vertexCount, data.batchSize);
+        runThreads(&Assembler::writeAssemblyGraphThreadFunction, threadCount);
+        sequenceNumber += (vertexCount + data.batchSize - 1) / data.batchSize;
+    }
+
+    SHASTA_ASSERT(writer.getChunkCount() == sequenceNumber);
+    performanceLog << "Wrote " << writer.getSize() << " bytes to " << fileName << endl;
+    data.writer = 0;
+}
+
+
+
+void Assembler::writeAssemblyGraphThreadFunction(size_t threadId)
+{
+    using Format = WriteAssemblyGraphData::Format;
+    using Pass = WriteAssemblyGraphData::Pass;
+    const WriteAssemblyGraphData& data = writeAssemblyGraphData;
+    const bool bothStrands = (data.format == Format::Gfa1BothStrands);
+
+    string buffer;
+    string cigarString;
+
+    // Loop over batches assigned to this thread.
+    // Each batch is written out even if empty,
+    // to keep the sequence numbers contiguous.
+    // If this thread fails, the writer is aborted, so other
+    // threads don't wait forever for the batch that was not written.
+    try {
+        uint64_t begin, end;
+        while(getNextBatch(begin, end)) {
+            buffer.clear();
+            for(uint64_t i=begin; i!=end; i++) {
+                if(data.pass == Pass::Segments) {
+                    if(data.format == Format::Fasta) {
+                        appendFastaSequence(i, buffer);
+                    } else if(data.format == Format::Gfa1BothStrandsNoSequence) {
+                        appendGfa1SegmentNoSequence(i, buffer);
+                    } else {
+                        appendGfa1Segment(i, bothStrands, buffer);
+                    }
+                } else {
+                    if(data.format == Format::Gfa1BothStrandsNoSequence) {
+                        appendGfa1LinksNoSequence(i, buffer);
+                    } else {
+                        appendGfa1Links(i, bothStrands, buffer, cigarString);
+                    }
+                }
+            }
+            data.writer->write(data.firstSequenceNumber + begin / data.batchSize, buffer);
         }
+    } catch(...) {
+        data.writer->abort();
+        throw;
+    }
+}
 
-        const auto sequence = assemblyGraph.sequences[edgeId];
-        const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
-        SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
-        gfa << "S\t" << edgeId << "\t";
 
-        // Write the sequence.
+
+// Append to a string the raw sequence of an assembled edge
+// of the assembly graph, optionally reverse complemented.
+void Assembler::appendAssembledSequence(
+    AssemblyGraphEdgeId edgeId,
+    bool reverseComplement,
+    string& s) const
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    const auto sequence = assemblyGraph.sequences[edgeId];
+    const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
+    SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+
+    if(reverseComplement) {
         for(size_t i=0; i<sequence.baseCount; i++) {
-            const Base b = sequence[i];
-            const uint8_t repeatCount = repeatCounts[i];
-            for(size_t k=0; k<repeatCount; k++) {
-                gfa << b;
-            }
+            const size_t j = sequence.baseCount - 1 - i;
+            s.append(repeatCounts[j], sequence[j].complement().character());
         }
+    } else {
+        for(size_t i=0; i<sequence.baseCount; i++) {
+            s.append(repeatCounts[i], sequence[i].character());
+        }
+    }
+}
+
+
+
+// Append to a string the GFA segment record for an edge of the assembly graph.
+// If bothStrands is false, only one of each pair of
+// reverse complemented edges is written.
+void Assembler::appendGfa1Segment(
+    AssemblyGraphEdgeId edgeId,
+    bool bothStrands,
+    string& s) const
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
 
-        // Write "number of reads" as average edge coverage
-        // times number of bases.
-        const uint32_t averageEdgeCoverage =
-            assemblyGraph.edges[edgeId].averageEdgeCoverage;
-        gfa << "\tRC:i:" << averageEdgeCoverage * sequence.baseCount;
+    if(assemblyGraph.edges[edgeId].wasRemoved()) {
+        return;
+    }
+    const bool isAssembled = assemblyGraph.isAssembledEdge(edgeId);
+    if(!bothStrands and !isAssembled) {
+        return;
+    }
 
-        gfa << "\n";
+    s.append("S\t");
+    s.append(to_string(edgeId));
+    s.append("\t");
+
+    // Write the sequence.
+    // If this edge was not assembled, we write out the reverse
+    // complemented sequence of the reverse complemented edge.
+    uint64_t baseCount;
+    if(isAssembled) {
+        baseCount = assemblyGraph.sequences[edgeId].baseCount;
+        appendAssembledSequence(edgeId, false, s);
+    } else {
+        const AssemblyGraph::EdgeId edgeIdRc = assemblyGraph.reverseComplementEdge[edgeId];
+        SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edgeIdRc));
+        baseCount = assemblyGraph.sequences[edgeIdRc].baseCount;
+        appendAssembledSequence(edgeIdRc, true, s);
     }
 
+    // Write "number of reads" as average edge coverage
+    // times number of bases.
+    const uint32_t averageEdgeCoverage =
+        assemblyGraph.edges[edgeId].averageEdgeCoverage;
+    s.append("\tRC:i:");
+    s.append(to_string(averageEdgeCoverage * baseCount));
+    s.append("\n");
+}
 
-    // Write GFA links.
-    // For each vertex in the assembly graph there is a link for
-    // each combination of in-edges and out-edges.
-    // Therefore each assembly graph vertex generates a number of
-    // links equal to the product of its in-degree and out-degree.
+
+
+// Append to a string the GFA link records for a vertex of the assembly graph.
+// For each vertex in the assembly graph there is a link for
+// each combination of in-edges and out-edges.
+// Therefore each assembly graph vertex generates a number of
+// links equal to the product of its in-degree and out-degree.
+// If bothStrands is false, links are expressed in terms of the
+// edges written by appendGfa1Segment, and each link is only written once.
+// Otherwise, all links are written with orientation ++.
+void Assembler::appendGfa1Links(
+    AssemblyGraphVertexId vertexId,
+    bool bothStrands,
+    string& s,
+    string& cigarString) const
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using EdgeId = AssemblyGraph::EdgeId;
     const size_t k = assemblerInfo->k;
-    string cigarString;
-    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
 
-        // In-edges.
-        const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
+    // In-edges.
+    const span<const EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
 
-        // Out-edges.
-        const span<EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
+    // Out-edges.
+    const span<const EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
 
-        // Loop over combinations of in-edges and out-edges.
-        for(const EdgeId edge0: edges0) {
-            if(assemblyGraph.edges[edge0].wasRemoved()) {
+    // Loop over combinations of in-edges and out-edges.
+    vector<uint8_t> lastRepeatCounts0(k);
+    vector<uint8_t> firstRepeatCounts1(k);
+    for(const EdgeId edge0: edges0) {
+        if(assemblyGraph.edges[edge0].wasRemoved()) {
+            continue;
+        }
+        const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
+
+        // Get the last k repeat counts of edge0.
+        if(assemblyGraph.isAssembledEdge(edge0)) {
+            const span<const uint8_t> storedRepeatCounts0 = assemblyGraph.repeatCounts[edge0];
+            const auto end0 = storedRepeatCounts0.end();
+            copy(end0-k, end0, lastRepeatCounts0.begin());
+        } else {
+            SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge0Rc));
+            const span<const uint8_t> storedRepeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
+            const auto begin0Rc = storedRepeatCounts0Rc.begin();
+            copy(begin0Rc, begin0Rc+k, lastRepeatCounts0.begin());
+            std::reverse(lastRepeatCounts0.begin(), lastRepeatCounts0.end());
+        }
+
+        for(const EdgeId edge1: edges1) {
+            if(assemblyGraph.edges[edge1].wasRemoved()) {
                 continue;
             }
-            const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
+            const EdgeId edge1Rc = assemblyGraph.reverseComplementEdge[edge1];
 
-            // Get the last k repeat counts of edge0.
-            vector<uint8_t> lastRepeatCounts0(k);
-            if(assemblyGraph.isAssembledEdge(edge0)) {
-                const span<uint8_t> storedRepeatCounts0 = assemblyGraph.repeatCounts[edge0];
-                const auto end0 = storedRepeatCounts0.end();
-                copy(end0-k, end0, lastRepeatCounts0.begin());
+            // Get the first k repeat counts of edge1.
+            if(assemblyGraph.isAssembledEdge(edge1)) {
+                const span<const uint8_t> storedRepeatCounts1 = assemblyGraph.repeatCounts[edge1];
+                const auto begin1 = storedRepeatCounts1.begin();
+                copy(begin1, begin1+k, firstRepeatCounts1.begin());
             } else {
-                SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge0Rc));
-                const span<uint8_t> storedRepeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
-                const auto begin0Rc = storedRepeatCounts0Rc.begin();
-                copy(begin0Rc, begin0Rc+k, lastRepeatCounts0.begin());
-                std::reverse(lastRepeatCounts0.begin(), lastRepeatCounts0.end());
+                SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge1Rc));
+                const span<const uint8_t> storedRepeatCounts1Rc = assemblyGraph.repeatCounts[edge1Rc];
+                const auto end1Rc = storedRepeatCounts1Rc.end();
+                copy(end1Rc-k, end1Rc, firstRepeatCounts1.begin());
+                std::reverse(firstRepeatCounts1.begin(), firstRepeatCounts1.end());
             }
 
-            for(const EdgeId edge1: edges1) {
-                if(assemblyGraph.edges[edge1].wasRemoved()) {
-                    continue;
-                }
-                const EdgeId edge1Rc = assemblyGraph.reverseComplementEdge[edge1];
-
-                // Get the first k repeat counts of edge1.
-                vector<uint8_t> firstRepeatCounts1(k);
-                if(assemblyGraph.isAssembledEdge(edge1)) {
-                    const span<uint8_t> storedRepeatCounts1 = assemblyGraph.repeatCounts[edge1];
-                    const auto begin1 = storedRepeatCounts1.begin();
-                    copy(begin1, begin1+k, firstRepeatCounts1.begin());
-                } else {
-                    SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge1Rc));
-                    const span<uint8_t> storedRepeatCounts1Rc = assemblyGraph.repeatCounts[edge1Rc];
-                    const auto end1Rc = storedRepeatCounts1Rc.end();
-                    copy(end1Rc-k, end1Rc, firstRepeatCounts1.begin());
-                    std::reverse(firstRepeatCounts1.begin(), firstRepeatCounts1.end());
-                }
+            // Construct the cigar string.
+            constructCigarString(
+                span<uint8_t>(
+                    lastRepeatCounts0.data(),
+                    lastRepeatCounts0.data() + lastRepeatCounts0.size()),
+                span<uint8_t>(
+                    firstRepeatCounts1.data(),
+                    firstRepeatCounts1.data() + firstRepeatCounts1.size()),
+                cigarString);
+
+            if(bothStrands) {
 
-                // Construct the cigar string.
-                constructCigarString(
-                    span<uint8_t>(
-                        lastRepeatCounts0.data(),
-                        lastRepeatCounts0.data() + lastRepeatCounts0.size()),
-                    span<uint8_t>(
-                        firstRepeatCounts1.data(),
-                        firstRepeatCounts1.data() + firstRepeatCounts1.size()),
-                    cigarString);
+                // Note that in the double stranded version of GFA
+                // output all links are written with orientation ++.
+                s.append("L\t");
+                s.append(to_string(edge0));
+                s.append("\t+\t");
+                s.append(to_string(edge1));
+                s.append("\t+\t");
+                s.append(cigarString);
+                s.append("\n");
+
+            } else {
 
                 // Keep track of which edges are actually assembled and output.
                 EdgeId edge0Out = edge0;
@@ -1075,233 +1258,198 @@ void Assembler::writeGfa1(const string& fileName)
                 }
 
                 // Write out the link record for this edge.
-                gfa << "L\t" <<
-                    edge0Out << "\t" <<
-                    (reverse0 ? "-" : "+") << "\t" <<
-                    edge1Out << "\t" <<
-                    (reverse1 ? "-" : "+") << "\t" <<
-                    cigarString << "\n";
+                s.append("L\t");
+                s.append(to_string(edge0Out));
+                s.append(reverse0 ? "\t-\t" : "\t+\t");
+                s.append(to_string(edge1Out));
+                s.append(reverse1 ? "\t-\t" : "\t+\t");
+                s.append(cigarString);
+                s.append("\n");
             }
         }
-
     }
-    performanceLog << timestamp << "writeGfa1 ends" << endl;
 }
 
 
 
-// Write the assembly graph in GFA 1.0 format defined here:
-// https://github.com/GFA-spec/GFA-spec/blob/master/GFA1.md
-// This version writes a GFA file containing both strands.
-void Assembler::writeGfa1BothStrands(const string& fileName)
+// Append to a string the GFA segment record for an edge of the assembly graph,
+// without sequence. The sequence length is written
+// as the number of marker graph edges.
+void Assembler::appendGfa1SegmentNoSequence(
+    AssemblyGraphEdgeId edgeId,
+    string& s) const
 {
-    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
-    using VertexId = AssemblyGraph::VertexId;
-    using EdgeId = AssemblyGraph::EdgeId;
-
-    performanceLog << timestamp << "writeGfa1BothStrands begins" << endl;
-
-    ofstream gfa(fileName);
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
 
-    // Write the header line.
-    gfa << "H\tVN:Z:1.0\n";
+    if(assemblyGraph.edges[edgeId].wasRemoved()) {
+        return;
+    }
 
-    // Write a segment record for each edge.
-    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
-        if(assemblyGraph.edges[edgeId].wasRemoved()) {
-            continue;
-        }
+    s.append("S\t");
+    s.append(to_string(edgeId));
+    s.append("\t*\tLN:i:");
+    s.append(to_string(assemblyGraph.edgeLists.size(edgeId)));
+    s.append("\n");
+}
 
-        // Get the id of the reverse complemented edge.
-        const EdgeId edgeIdRc = assemblyGraph.reverseComplementEdge[edgeId];
-
-        // Write the name to make it easy to keep track of reverse
-        // complemented edges.
-        gfa << "S\t" << edgeId << "\t";
-
-        // Write the sequence.
-        size_t sequenceLength;
-        if(assemblyGraph.isAssembledEdge(edgeId)) {
-
-            // This edge was assembled. We can just write the stored sequence.
-            const auto sequence = assemblyGraph.sequences[edgeId];
-            const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
-            SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
-            sequenceLength = sequence.baseCount;
-            for(size_t i=0; i<sequence.baseCount; i++) {
-                const Base b = sequence[i];
-                const uint8_t repeatCount = repeatCounts[i];
-                for(size_t k=0; k<repeatCount; k++) {
-                    gfa << b;
-                }
-            }
-        } else {
 
-            // This edge was not assembled. We write out the reverse
-            // complemented sequence of the reverse complemented edge.
-            SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edgeIdRc));
-            const auto sequence = assemblyGraph.sequences[edgeIdRc];
-            const auto repeatCounts = assemblyGraph.repeatCounts[edgeIdRc];
-            SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
-            sequenceLength = sequence.baseCount;
-            for(size_t i=0; i<sequence.baseCount; i++) {
-                const size_t j = sequence.baseCount - 1 - i;
-                const Base b = sequence[j].complement();
-                const uint8_t repeatCount = repeatCounts[j];
-                for(size_t k=0; k<repeatCount; k++) {
-                    gfa << b;
-                }
-            }
 
+// Append to a string the GFA link records for a vertex of the assembly graph,
+// with orientation ++ and the CIGAR string left unspecified.
+void Assembler::appendGfa1LinksNoSequence(
+    AssemblyGraphVertexId vertexId,
+    string& s) const
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using EdgeId = AssemblyGraph::EdgeId;
 
+    for(const EdgeId edge0: assemblyGraph.edgesByTarget[vertexId]) {
+        if(assemblyGraph.edges[edge0].wasRemoved()) {
+            continue;
         }
-
-        // Write "number of reads" as average edge coverage
-        // times number of bases.
-        const uint32_t averageEdgeCoverage =
-            assemblyGraph.edges[edgeId].averageEdgeCoverage;
-        gfa << "\tRC:i:" << averageEdgeCoverage * sequenceLength;
-;
-        gfa << "\n";
-    }
-
-  
-    // Write GFA links.
-    // For each vertex in the assembly graph there is a link for
-    // each combination of in-edges and out-edges.
-    // Therefore each assembly graph vertex generates a number of
-    // links equal to the product of its in-degree and out-degree.
-    const size_t k = assemblerInfo->k;
-    string cigarString;
-    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
-
-        // In-edges.
-        const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
-
-        // Out-edges.
-        const span<EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
-
-        // Loop over in-edges.
-        for(const EdgeId edge0: edges0) {
-            if(assemblyGraph.edges[edge0].wasRemoved()) {
+        for(const EdgeId edge1: assemblyGraph.edgesBySource[vertexId]) {
+            if(assemblyGraph.edges[edge1].wasRemoved()) {
                 continue;
             }
-            const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
-
-            // Get the last k repeat counts of edge0.
-            vector<uint8_t> lastRepeatCounts0(k);
-            if(assemblyGraph.isAssembledEdge(edge0)) {
-                const span<uint8_t> storedRepeatCounts0 = assemblyGraph.repeatCounts[edge0];
-                const auto end0 = storedRepeatCounts0.end();
-                copy(end0-k, end0, lastRepeatCounts0.begin());
-            } else {
-                SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge0Rc));
-                const span<uint8_t> storedRepeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
-                const auto begin0Rc = storedRepeatCounts0Rc.begin();
-                copy(begin0Rc, begin0Rc+k, lastRepeatCounts0.begin());
-                std::reverse(lastRepeatCounts0.begin(), lastRepeatCounts0.end());
-            }
-
-            // Loop over in-edges.
-            for(const EdgeId edge1: edges1) {
-                if(assemblyGraph.edges[edge1].wasRemoved()) {
-                    continue;
-                }
-                const EdgeId edge1Rc = assemblyGraph.reverseComplementEdge[edge1];
-
-                // Get the first k repeat counts of edge1.
-                vector<uint8_t> firstRepeatCounts1(k);
-                if(assemblyGraph.isAssembledEdge(edge1)) {
-                    const span<uint8_t> storedRepeatCounts1 = assemblyGraph.repeatCounts[edge1];
-                    const auto begin1 = storedRepeatCounts1.begin();
-                    copy(begin1, begin1+k, firstRepeatCounts1.begin());
-                } else {
-                    SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge1Rc));
-                    const span<uint8_t> storedRepeatCounts1Rc = assemblyGraph.repeatCounts[edge1Rc];
-                    const auto end1Rc = storedRepeatCounts1Rc.end();
-                    copy(end1Rc-k, end1Rc, firstRepeatCounts1.begin());
-                    std::reverse(firstRepeatCounts1.begin(), firstRepeatCounts1.end());
-                }
-
-
-                // Construct the cigar string.
-                constructCigarString(
-                    span<uint8_t>(
-                        lastRepeatCounts0.data(),
-                        lastRepeatCounts0.data() + lastRepeatCounts0.size()),
-                    span<uint8_t>(
-                        firstRepeatCounts1.data(),
-                        firstRepeatCounts1.data() + firstRepeatCounts1.size()),
-                    cigarString);
-
-
-                // Write out the link record for this edge.
-                // Note that in the double stranded version of GFA
-                // output all links are written with orientation ++.
-                gfa << "L\t" <<
-                    edge0 << "\t+\t" <<
-                    edge1 << "\t+\t" <<
-                    cigarString << "\n";
-            }
+            s.append("L\t");
+            s.append(to_string(edge0));
+            s.append("\t+\t");
+            s.append(to_string(edge1));
+            s.append("\t+\t*\n");
         }
     }
-
-    performanceLog << timestamp << "writeGfa1BothStrands ends" << endl;
-
 }
 
 
 
-void Assembler::writeGfa1BothStrandsNoSequence(const string& fileName)
+// Append to a string the FASTA record for an edge of the assembly graph.
+// Only one of each pair of reverse complemented edges is written.
+void Assembler::appendFastaSequence(
+    AssemblyGraphEdgeId edgeId,
+    string& s) const
 {
-    assemblyGraphPointer->writeGfa1BothStrandsNoSequence(fileName);
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+
+    if(assemblyGraph.edges[edgeId].wasRemoved()) {
+        return;
+    }
+    if(!assemblyGraph.isAssembledEdge(edgeId)) {
+        return;
+    }
+
+    // Compute the length so we can write it in the header.
+    size_t length = 0;
+    for(const uint8_t repeatCount: assemblyGraph.repeatCounts[edgeId]) {
+        length += repeatCount;
+    }
+
+    s.append(">");
+    s.append(to_string(edgeId));
+    s.append(" length ");
+    s.append(to_string(length));
+    s.append("\n");
+    appendAssembledSequence(edgeId, false, s);
+    s.append("\n");
 }
 
 
 
-// Write assembled sequences in FASTA format.
-void Assembler::writeFasta(const string& fileName)
+// Write the assembly graph in the binary format described in BinaryAssemblyGraph.hpp.
+// This contains the same segments and links as the GFA file
+// written by writeGfa1 (one strand only).
+void Assembler::writeAssemblyGraphBinary(const string& fileName)
 {
-    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using VertexId = AssemblyGraph::VertexId;
     using EdgeId = AssemblyGraph::EdgeId;
+    const size_t k = assemblerInfo->k;
 
-    performanceLog << timestamp << "writeFasta begins" << endl;
+    performanceLog << timestamp << "writeAssemblyGraphBinary begins" << endl;
 
-    ofstream fasta(fileName);
+    BinaryAssemblyGraphWriter writer;
 
-    // Write a sequence for each edge of the assembly graph.
+    // Add a segment for each assembled edge.
+    const uint64_t invalidSegmentId = std::numeric_limits<uint64_t>::max();
+    vector<uint64_t> segmentTable(assemblyGraph.sequences.size(), invalidSegmentId);
+    string sequence;
     for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
         if(assemblyGraph.edges[edgeId].wasRemoved()) {
             continue;
         }
-
-        // Only output one of each pair of reverse complemented edges.
         if(!assemblyGraph.isAssembledEdge(edgeId)) {
             continue;
         }
+        sequence.clear();
+        appendAssembledSequence(edgeId, false, sequence);
+        segmentTable[edgeId] = writer.addSegment(
+            to_string(edgeId),
+            sequence,
+            double(assemblyGraph.edges[edgeId].averageEdgeCoverage));
+    }
 
-        const auto sequence = assemblyGraph.sequences[edgeId];
-        const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
-        SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+    // Add the links, using the same conventions as writeGfa1.
+    // The overlap is the number of raw bases in the
+    // last k RLE bases of the first segment.
+    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
+        const span<const EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
+        const span<const EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
 
-        // Compute the length so we can write it in the header.
-        size_t length = 0;
-        for(const uint8_t repeatCount: repeatCounts) {
-            length += repeatCount;
-        }
+        for(const EdgeId edge0: edges0) {
+            if(assemblyGraph.edges[edge0].wasRemoved()) {
+                continue;
+            }
 
-        fasta << ">" << edgeId << " length " << length << "\n";
-        for(size_t i=0; i<sequence.baseCount; i++) {
-            const Base b = sequence[i];
-            const uint8_t repeatCount = repeatCounts[i];
-            for(size_t k=0; k<repeatCount; k++) {
-                fasta << b;
+            // Compute the overlap using the last k repeat counts of edge0.
+            uint64_t overlap = 0;
+            if(assemblyGraph.isAssembledEdge(edge0)) {
+                const span<const uint8_t> repeatCounts0 = assemblyGraph.repeatCounts[edge0];
+                for(auto it=repeatCounts0.end()-k; it!=repeatCounts0.end(); ++it) {
+                    overlap += *it;
+                }
+            } else {
+                const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
+                const span<const uint8_t> repeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
+                for(auto it=repeatCounts0Rc.begin(); it!=repeatCounts0Rc.begin()+k; ++it) {
+                    overlap += *it;
+                }
+            }
+
+            for(const EdgeId edge1: edges1) {
+                if(assemblyGraph.edges[edge1].wasRemoved()) {
+                    continue;
+                }
+
+                EdgeId edge0Out = edge0;
+                EdgeId edge1Out = edge1;
+                bool reverse0 = false;
+                bool reverse1 = false;
+                if(!assemblyGraph.isAssembledEdge(edge0Out)) {
+                    edge0Out = assemblyGraph.reverseComplementEdge[edge0Out];
+                    reverse0 = true;
+                }
+                if(!assemblyGraph.isAssembledEdge(edge1Out)) {
+                    edge1Out = assemblyGraph.reverseComplementEdge[edge1Out];
+                    reverse1 = true;
+                }
+
+                // Avoid writing links twice.
+                if(edge0Out > edge1Out) {
+                    continue;
+                }
+                if(edge0Out == edge1Out && reverse0) {
+                    continue;
+                }
+
+                writer.addLink(
+                    segmentTable[edge0Out], reverse0,
+                    segmentTable[edge1Out], reverse1,
+                    overlap);
             }
         }
-        fasta << "\n";
     }
-    performanceLog << timestamp << "writeFasta ends" << endl;
 
+    writer.write(fileName);
+    performanceLog << timestamp << "writeAssemblyGraphBinary ends" << endl;
 }
 
 
@@ -1753,7 +1901,7 @@ bool Assembler::extractLocalAssemblyGraph(
 
 // Python-callable.
 AssembledSegment Assembler::assembleAssemblyGraphEdge(
-    AssemblyGraph::EdgeId edgeId,
+    AssemblyGraphEdgeId edgeId,
     bool storeCoverageData)
 {
     AssembledSegment assembledSegment;
@@ -1767,7 +1915,7 @@ AssembledSegment Assembler::assembleAssemblyGraphEdge(
 // Optionally outputs detailed assembly information
 // in html (skipped if the html pointer is 0).
 void Assembler::assembleAssemblyGraphEdge(
-    AssemblyGraph::EdgeId edgeId,
+    AssemblyGraphEdgeId edgeId,
     bool storeCoverageData,
     AssembledSegment& assembledSegment)
 {
@@ -1811,7 +1959,7 @@ void Assembler::writeOrientedReadsByAssemblyGraphEdge()
 
 
 void Assembler::colorGfaBySimilarityToSegment(
-    AssemblyGraph::EdgeId edgeId,
+    AssemblyGraphEdgeId edgeId,
     uint64_t minVertexCount,
     uint64_t minEdgeCount)
 {
@@ -1831,8 +1979,7 @@ void Assembler::gatherOrientedReadsByAssemblyGraphEdge(size_t threadCount)
         threadCount = std::thread::hardware_concurrency();
     }
 
-    assemblyGraph.orientedReadsByEdge.createNew(
-        largeDataName("PhasingGraphOrientedReads"), largeDataPageSize);
+    createNew(assemblyGraph.orientedReadsByEdge, "PhasingGraphOrientedReads");
     assemblyGraph.orientedReadsByEdge.beginPass1(assemblyGraph.edgeLists.size());
     setupLoadBalancing(assemblyGraph.edgeLists.size(), 1);
     runThreads(&Assembler::gatherOrientedReadsByAssemblyGraphEdgePass1, threadCount);
@@ -5,6 +5,9 @@
 #include "SHASTA_ASSERT.hpp"
 using namespace shasta;
 
+// Standard library.
+#include "fstream.hpp"
+
 
 
 void Assembler::createAssemblyGraph2(
@@ -38,9 +41,103 @@ void Assembler::createAssemblyGraph2(
         pruneLength,
         mode2Options,
         assemblerInfo->assemblyGraph2Statistics,
+        largeDataFileNamePrefix,
+        largeDataPageSize,
         threadCount,
         debug
         );
 
+    // Store the final graph in binary data, so it can be reconstructed later
+    // without recomputing it. The constructor already stored
+    // the graph as it was before phasing.
+    assemblyGraph2Pointer->save(largeDataFileNamePrefix, largeDataPageSize, false, threadCount);
+
     performanceLog << timestamp << "Assembler::createAssemblyGraph2 ends." << endl;
 }
+
+
+
+// Reconstruct the final mode 2 assembly graph from binary data.
+void Assembler::accessAssemblyGraph2(size_t threadCount)
+{
+    assemblyGraph2Pointer = make_shared<AssemblyGraph2>(
+        assemblerInfo->readRepresentation,
+        assemblerInfo->k,
+        getReads().getFlags(),
+        markers,
+        markerGraph,
+        largeDataFileNamePrefix,
+        false,
+        threadCount
+        );
+}
+
+
+
+// Redo phasing of the mode 2 assembly graph with different
+// phasing parameters, starting from the graph as it was stored
+// before phasing and final pruning.
+// This writes the assembly output again, updates the
+// wasAssembled flags of marker graph edges and the mode 2 statistics,
+// stores the new final graph, and rewrites the assembly summary.
+// The marker graph edges must be accessible with write access.
+void Assembler::rephaseAssemblyGraph2(
+    uint64_t pruneLength,
+    const Mode2AssemblyOptions& mode2Options,
+    size_t threadCount)
+{
+    // Check that we have what we need.
+    checkMarkerGraphVerticesAreAvailable();
+    checkMarkerGraphEdgesIsOpen();
+    SHASTA_ASSERT(markerGraph.edges.isOpenWithWriteAccess);
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    performanceLog << timestamp << "Assembler::rephaseAssemblyGraph2 begins." << endl;
+
+    assemblyGraph2Pointer = make_shared<AssemblyGraph2>(
+        assemblerInfo->readRepresentation,
+        assemblerInfo->k,
+        getReads().getFlags(),
+        markers,
+        markerGraph,
+        largeDataFileNamePrefix,
+        true,
+        threadCount
+        );
+    AssemblyGraph2& assemblyGraph2 = *assemblyGraph2Pointer;
+    assemblyGraph2.phaseAndWriteOutput(
+        pruneLength, mode2Options, assemblerInfo->assemblyGraph2Statistics, threadCount);
+    assemblyGraph2.save(largeDataFileNamePrefix, largeDataPageSize, false, threadCount);
+
+    // Rewrite the assembly summary, which includes the mode 2 statistics.
+    ofstream html("AssemblySummary.html");
+    writeAssemblySummary(html);
+    ofstream json("AssemblySummary.json");
+    writeAssemblySummaryJson(json);
+
+    performanceLog << timestamp << "Assembler::rephaseAssemblyGraph2 ends." << endl;
+}
+
+
+
+void Assembler::testWriteAssemblyGraph2(size_t threadCount)
+{
+    if(not assemblyGraph2Pointer) {
+        accessAssemblyGraph2(threadCount);
+    }
+    assemblyGraph2Pointer->testWriteOutput(threadCount);
+}
+
+
+
+void Assembler::testSaveAssemblyGraph2(size_t threadCount)
+{
+    if(not assemblyGraph2Pointer) {
+        accessAssemblyGraph2(threadCount);
+    }
+    assemblyGraph2Pointer->testSave(threadCount);
+}
@@ -0,0 +1,223 @@
+// Batch versions of some Assembler query functions.
+// See Assembler.hpp for more information.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "Align4.hpp"
+#include "MemoryMappedAllocator.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "array.hpp"
+
+
+
+void Assembler::checkBatchQueryInput(
+    const vector< array<OrientedReadId, 2> >& orientedReadPairs) const
+{
+    checkMarkersAreOpen();
+    const uint64_t orientedReadCount = markers.size();
+    for(uint64_t i=0; i<orientedReadPairs.size(); i++) {
+        for(const OrientedReadId orientedReadId: orientedReadPairs[i]) {
+            if(orientedReadId.getValue() >= orientedReadCount) {
+                throw runtime_error("Invalid oriented read id " +
+                    to_string(orientedReadId.getValue()) + " at row " + to_string(i) +
+                    ". Valid oriented read ids are less than " + to_string(orientedReadCount) + ".");
+            }
+        }
+    }
+}
+
+
+
+void Assembler::checkBatchQueryInput(
+    const vector< pair<OrientedReadId, uint32_t> >& markerSpecifications) const
+{
+    checkMarkersAreOpen();
+    const uint64_t orientedReadCount = markers.size();
+    for(uint64_t i=0; i<markerSpecifications.size(); i++) {
+        const OrientedReadId orientedReadId = markerSpecifications[i].first;
+        const uint32_t ordinal = markerSpecifications[i].second;
+        if(orientedReadId.getValue() >= orientedReadCount) {
+            throw runtime_error("Invalid oriented read id " +
+                to_string(orientedReadId.getValue()) + " at row " + to_string(i) +
+                ". Valid oriented read ids are less than " + to_string(orientedReadCount) + ".");
+        }
+        const uint64_t markerCount = markers.size(orientedReadId.getValue());
+        if(ordinal >= markerCount) {
+            throw runtime_error("Invalid ordinal " + to_string(ordinal) + " at row " +
+                to_string(i) + ". Oriented read " + orientedReadId.getString() +
+                " has " + to_string(markerCount) + " markers.");
+        }
+    }
+}
+
+
+
+// Align many pairs of oriented reads using alignment method 4.
+void Assembler::alignOrientedReads4Batch(
+    const vector< array<OrientedReadId, 2> >& orientedReadPairs,
+    const Align4::Options& options,
+    vector<AlignmentInfo>& alignmentInfos,
+    size_t threadCount)
+{
+    std::lock_guard<std::mutex> lock(batchQueryMutex);
+    checkMarkersAreOpen();
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    alignmentInfos.clear();
+    alignmentInfos.resize(orientedReadPairs.size());
+
+    batchQueryData.orientedReadPairs = &orientedReadPairs;
+    batchQueryData.align4Options = &options;
+    batchQueryData.alignmentInfos = &alignmentInfos;
+
+    const uint64_t batchSize = 10;
+    setupLoadBalancing(orientedReadPairs.size(), batchSize);
+    runThreads(&Assembler::alignOrientedReads4BatchThreadFunction, threadCount);
+
+    batchQueryData = BatchQueryData();
+}
+
+
+
+void Assembler::alignOrientedReads4BatchThreadFunction(size_t threadId)
+{
+    const vector< array<OrientedReadId, 2> >& orientedReadPairs = *batchQueryData.orientedReadPairs;
+    const Align4::Options& options = *batchQueryData.align4Options;
+    vector<AlignmentInfo>& alignmentInfos = *batchQueryData.alignmentInfos;
+
+    // Each thread uses its own memory allocator.
+    MemoryMapped::ByteAllocator byteAllocator(
+        largeDataName("tmp-BatchByteAllocator-" + to_string(threadId)),
+        largeDataPageSize, 2ULL * 1024 * 1024 * 1024);
+
+    Alignment alignment;
+    const bool debug = false;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const array<OrientedReadId, 2>& orientedReadPair = orientedReadPairs[i];
+            alignOrientedReads4(
+                orientedReadPair[0], orientedReadPair[1],
+                options, byteAllocator, alignment, alignmentInfos[i], debug);
+        }
+    }
+}
+
+
+
+// Find the marker graph vertices for many markers.
+void Assembler::getGlobalMarkerGraphVertexBatch(
+    const vector< pair<OrientedReadId, uint32_t> >& markerSpecifications,
+    vector<MarkerGraph::VertexId>& vertexIds,
+    size_t threadCount)
+{
+    std::lock_guard<std::mutex> lock(batchQueryMutex);
+    checkMarkersAreOpen();
+    SHASTA_ASSERT(markerGraph.vertexTable.isOpen);
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    vertexIds.clear();
+    vertexIds.resize(markerSpecifications.size());
+
+    batchQueryData.markerSpecifications = &markerSpecifications;
+    batchQueryData.vertexIds = &vertexIds;
+
+    // This is just a table lookup for each marker, so use large batches.
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(markerSpecifications.size(), batchSize);
+    runThreads(&Assembler::getGlobalMarkerGraphVertexBatchThreadFunction, threadCount);
+
+    batchQueryData = BatchQueryData();
+}
+
+
+
+void Assembler::getGlobalMarkerGraphVertexBatchThreadFunction(size_t)
+{
+    const vector< pair<OrientedReadId, uint32_t> >& markerSpecifications =
+        *batchQueryData.markerSpecifications;
+    vector<MarkerGraph::VertexId>& vertexIds = *batchQueryData.vertexIds;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const pair<OrientedReadId, uint32_t>& p = markerSpecifications[i];
+            vertexIds[i] = getGlobalMarkerGraphVertex(p.first, p.second);
+        }
+    }
+}
+
+
+
+// Alignment matrix summaries for many pairs of oriented reads.
+void Assembler::analyzeAlignmentMatrixBatch(
+    const vector< array<OrientedReadId, 2> >& orientedReadPairs,
+    vector< array<uint64_t, 3> >& alignmentMatrixSummaries,
+    size_t threadCount)
+{
+    std::lock_guard<std::mutex> lock(batchQueryMutex);
+    checkMarkersAreOpen();
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    alignmentMatrixSummaries.clear();
+    alignmentMatrixSummaries.resize(orientedReadPairs.size());
+
+    batchQueryData.orientedReadPairs = &orientedReadPairs;
+    batchQueryData.alignmentMatrixSummaries = &alignmentMatrixSummaries;
+
+    const uint64_t batchSize = 10;
+    setupLoadBalancing(orientedReadPairs.size(), batchSize);
+    runThreads(&Assembler::analyzeAlignmentMatrixBatchThreadFunction, threadCount);
+
+    batchQueryData = BatchQueryData();
+}
+
+
+
+void Assembler::analyzeAlignmentMatrixBatchThreadFunction(size_t)
+{
+    const vector< array<OrientedReadId, 2> >& orientedReadPairs = *batchQueryData.orientedReadPairs;
+    vector< array<uint64_t, 3> >& alignmentMatrixSummaries = *batchQueryData.alignmentMatrixSummaries;
+
+    // Same cell size and threshold used by analyzeAlignmentMatrix.
+    const int64_t dx = 100;
+    const int64_t dy = 20;
+    const uint64_t minFrequency = 10;
+
+    vector< vector<uint64_t> > histogram;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const array<OrientedReadId, 2>& orientedReadPair = orientedReadPairs[i];
+            computeAlignmentMatrixHistogram(
+                orientedReadPair[0], orientedReadPair[1], dx, dy, histogram);
+
+            uint64_t activeCellCount = 0;
+            for(const vector<uint64_t>& column: histogram) {
+                for(const uint64_t frequency: column) {
+                    if(frequency >= minFrequency) {
+                        ++activeCellCount;
+                    }
+                }
+            }
+
+            array<uint64_t, 3>& summary = alignmentMatrixSummaries[i];
+            summary[0] = histogram.size();
+            summary[1] = histogram.empty() ? 0 : histogram.front().size();
+            summary[2] = activeCellCount;
+        }
+    }
+}
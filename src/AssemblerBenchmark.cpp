@@ -0,0 +1,478 @@
+// Micro-benchmarks of computational kernels that use assembly data.
+// They are used by the shastaBenchmark executable
+// (see shasta/srcBenchmark) and are described in Assembler.hpp.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "Align4.hpp"
+#include "Alignment.hpp"
+#include "AlignmentGraph.hpp"
+#include "AssemblerOptions.hpp"
+#include "Benchmark.hpp"
+#include "compressAlignment.hpp"
+#include "ConsensusCaller.hpp"
+#include "Coverage.hpp"
+#include "LowHash0.hpp"
+#include "MarkerFinder.hpp"
+#include "MemoryMappedAllocator.hpp"
+#include "MurmurHash2.hpp"
+#include "Reads.hpp"
+using namespace shasta;
+
+// Spoa.
+#include "spoa/spoa.hpp"
+
+// Standard library.
+#include "array.hpp"
+
+
+
+// Run all benchmarks. Benchmarks that need data
+// not available in this assembly are skipped.
+void Assembler::benchmarkKernels(
+    Benchmark& benchmark,
+    const AssemblerOptions& assemblerOptions,
+    uint64_t sampleCount,
+    size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const auto runBenchmark = [&benchmark](const string& name, const std::function<void()>& f)
+    {
+        try {
+            f();
+        } catch(const std::exception& e) {
+            benchmark.skip(name, e.what());
+        }
+    };
+
+    runBenchmark("MarkerFinder", [&]() {benchmarkMarkerFinder(benchmark, threadCount);});
+    runBenchmark("MurmurHash", [&]() {
+        benchmarkMurmurHash(benchmark, assemblerOptions.minHashOptions.m, sampleCount);});
+    runBenchmark("LowHash0", [&]() {
+        benchmarkLowHash(benchmark, assemblerOptions.minHashOptions, threadCount);});
+    runBenchmark("Alignments", [&]() {
+        benchmarkAlignments(benchmark, assemblerOptions.alignOptions, sampleCount);});
+    runBenchmark("SpoaEdgeConsensus", [&]() {benchmarkSpoaEdgeConsensus(benchmark, sampleCount);});
+    runBenchmark("ConsensusCaller", [&]() {
+        benchmarkConsensusCaller(benchmark, assemblerOptions.assemblyOptions.consensusCaller, sampleCount);});
+    runBenchmark("LongBaseSequence", [&]() {benchmarkLongBaseSequence(benchmark, sampleCount);});
+}
+
+
+
+// Find markers in all reads, using all threads.
+// The markers are stored in anonymous memory.
+void Assembler::benchmarkMarkerFinder(Benchmark& benchmark, size_t threadCount)
+{
+    reads->checkReadsAreOpen();
+    checkKmersAreOpen();
+
+    benchmark.run("MarkerFinder", "reads", reads->readCount(),
+        [&]()
+        {
+            MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t> benchmarkMarkers;
+            benchmarkMarkers.createNew("", 4096);
+            MarkerFinder markerFinder(assemblerInfo->k, kmerTable, getReads(),
+                benchmarkMarkers, threadCount);
+            const uint64_t markerCount = benchmarkMarkers.totalSize();
+            benchmarkMarkers.remove();
+            return markerCount;
+        },
+        {{"Threads", to_string(threadCount)}});
+}
+
+
+
+// Compute the MurmurHash of all features (m consecutive marker k-mer ids)
+// of the first sampleCount reads, as done by LowHash.
+void Assembler::benchmarkMurmurHash(Benchmark& benchmark, uint64_t m, uint64_t sampleCount)
+{
+    checkMarkersAreOpen();
+
+    // Gather the k-mer ids.
+    vector< vector<KmerId> > kmerIds;
+    uint64_t featureCount = 0;
+    const uint64_t orientedReadCount = min(uint64_t(markers.size()), 2 * sampleCount);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        const auto orientedReadMarkers = markers[i];
+        kmerIds.emplace_back();
+        for(const CompressedMarker& marker: orientedReadMarkers) {
+            kmerIds.back().push_back(marker.kmerId);
+        }
+        if(kmerIds.back().size() >= m) {
+            featureCount += kmerIds.back().size() + 1 - m;
+        }
+    }
+    const int featureByteCount = int(m * sizeof(KmerId));
+
+    benchmark.run("MurmurHash", "features", featureCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const vector<KmerId>& v: kmerIds) {
+                if(v.size() < m) {
+                    continue;
+                }
+                for(uint64_t j=0; j<=v.size()-m; j++) {
+                    checksum ^= MurmurHash64A(&v[j], featureByteCount, 231);
+                }
+            }
+            return checksum;
+        },
+        {{"m", to_string(m)}});
+}
+
+
+
+// Run one LowHash0 iteration, using all threads.
+// Alignment candidates are stored in anonymous memory.
+// Most of the time is spent computing low hashes and filling buckets.
+void Assembler::benchmarkLowHash(
+    Benchmark& benchmark,
+    const MinHashOptions& minHashOptions,
+    size_t threadCount)
+{
+    checkKmersAreOpen();
+    checkMarkersAreOpen();
+
+    const string anonymousPrefix;
+    benchmark.run("LowHash0", "oriented reads", markers.size(),
+        [&]()
+        {
+            MemoryMapped::Vector<OrientedReadPair> candidates;
+            MemoryMapped::Vector< array<uint64_t, 3> > statistics;
+            candidates.createNew("", 4096);
+            statistics.createNew("", 4096);
+            LowHash0 lowHash(
+                minHashOptions.m,
+                minHashOptions.hashFraction,
+                1, 0.,
+                0,
+                minHashOptions.minBucketSize,
+                minHashOptions.maxBucketSize,
+                minHashOptions.minFrequency,
+                threadCount,
+                kmerTable,
+                getReads(),
+                markers,
+                candidates,
+                statistics,
+                anonymousPrefix,
+                4096);
+            const uint64_t candidateCount = candidates.size();
+            candidates.remove();
+            statistics.remove();
+            return candidateCount;
+        },
+        {
+            {"Threads", to_string(threadCount)},
+            {"m", to_string(minHashOptions.m)},
+            {"hashFraction", to_string(minHashOptions.hashFraction)},
+            {"Iterations", "1"}
+        });
+}
+
+
+
+// Compute alignments of sampleCount alignment candidates,
+// evenly spaced among all candidates, using alignment methods 0, 1, 3, and 4.
+// The alignments computed by method 4 are then used to benchmark
+// alignment compression and decompression.
+void Assembler::benchmarkAlignments(
+    Benchmark& benchmark,
+    const AlignOptions& alignOptions,
+    uint64_t sampleCount)
+{
+    checkMarkersAreOpen();
+    checkAlignmentCandidatesAreOpen();
+    const uint64_t candidateCount = alignmentCandidates.candidates.size();
+    if(candidateCount == 0) {
+        throw runtime_error("There are no alignment candidates.");
+    }
+
+    // Pick the candidates.
+    vector< array<OrientedReadId, 2> > orientedReadPairs;
+    const uint64_t pairCount = min(sampleCount, candidateCount);
+    for(uint64_t i=0; i<pairCount; i++) {
+        const OrientedReadPair& candidate =
+            alignmentCandidates.candidates[(i * candidateCount) / pairCount];
+        orientedReadPairs.push_back({
+            OrientedReadId(candidate.readIds[0], 0),
+            OrientedReadId(candidate.readIds[1], candidate.isSameStrand ? 0 : 1)});
+    }
+    const vector< pair<string, string> > parameters = {
+        {"maxSkip", to_string(alignOptions.maxSkip)},
+        {"maxDrift", to_string(alignOptions.maxDrift)},
+        {"maxMarkerFrequency", to_string(alignOptions.maxMarkerFrequency)},
+        {"maxBand", to_string(alignOptions.maxBand)}};
+
+    Alignment alignment;
+    AlignmentInfo alignmentInfo;
+
+    // Method 0.
+    array<vector<MarkerWithOrdinal>, 2> markersSortedByKmerId;
+    AlignmentGraph graph;
+    benchmark.run("Align0", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const auto& orientedReadIds: orientedReadPairs) {
+                for(size_t j=0; j<2; j++) {
+                    getMarkersSortedByKmerId(orientedReadIds[j], markersSortedByKmerId[j]);
+                }
+                alignOrientedReads(markersSortedByKmerId,
+                    alignOptions.maxSkip, alignOptions.maxDrift, alignOptions.maxMarkerFrequency,
+                    false, graph, alignment, alignmentInfo);
+                checksum += alignment.ordinals.size();
+            }
+            return checksum;
+        },
+        parameters);
+
+    // Method 1.
+    benchmark.run("Align1", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const auto& orientedReadIds: orientedReadPairs) {
+                alignOrientedReads1(orientedReadIds[0], orientedReadIds[1],
+                    alignOptions.matchScore, alignOptions.mismatchScore, alignOptions.gapScore,
+                    alignment, alignmentInfo);
+                checksum += alignment.ordinals.size();
+            }
+            return checksum;
+        },
+        parameters);
+
+    // Method 3.
+    benchmark.run("Align3", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const auto& orientedReadIds: orientedReadPairs) {
+                alignOrientedReads3(orientedReadIds[0], orientedReadIds[1],
+                    alignOptions.matchScore, alignOptions.mismatchScore, alignOptions.gapScore,
+                    alignOptions.downsamplingFactor, alignOptions.bandExtend, alignOptions.maxBand,
+                    alignment, alignmentInfo);
+                checksum += alignment.ordinals.size();
+            }
+            return checksum;
+        },
+        parameters);
+
+    // Method 4. Keep the alignments for the compression benchmarks.
+    Align4::Options align4Options;
+    align4Options.deltaX = alignOptions.align4DeltaX;
+    align4Options.deltaY = alignOptions.align4DeltaY;
+    align4Options.minEntryCountPerCell = alignOptions.align4MinEntryCountPerCell;
+    align4Options.maxDistanceFromBoundary = alignOptions.align4MaxDistanceFromBoundary;
+    align4Options.minAlignedMarkerCount = alignOptions.minAlignedMarkerCount;
+    align4Options.minAlignedFraction = alignOptions.minAlignedFraction;
+    align4Options.maxSkip = alignOptions.maxSkip;
+    align4Options.maxDrift = alignOptions.maxDrift;
+    align4Options.maxTrim = alignOptions.maxTrim;
+    align4Options.maxBand = alignOptions.maxBand;
+    align4Options.matchScore = alignOptions.matchScore;
+    align4Options.mismatchScore = alignOptions.mismatchScore;
+    align4Options.gapScore = alignOptions.gapScore;
+    MemoryMapped::ByteAllocator byteAllocator("", 4096, 2ULL * 1024 * 1024 * 1024);
+    vector<Alignment> alignments(pairCount);
+    benchmark.run("Align4", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(uint64_t i=0; i<pairCount; i++) {
+                const auto& orientedReadIds = orientedReadPairs[i];
+                alignOrientedReads4(orientedReadIds[0], orientedReadIds[1],
+                    align4Options, byteAllocator, alignments[i], alignmentInfo, false);
+                checksum += alignments[i].ordinals.size();
+            }
+            return checksum;
+        },
+        parameters);
+
+    // Compression and decompression of the method 4 alignments.
+    vector<string> compressedAlignments(pairCount);
+    benchmark.run("CompressAlignment", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(uint64_t i=0; i<pairCount; i++) {
+                shasta::compress(alignments[i], compressedAlignments[i]);
+                checksum += compressedAlignments[i].size();
+            }
+            return checksum;
+        });
+    benchmark.run("DecompressAlignment", "alignments", pairCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const string& compressedAlignment: compressedAlignments) {
+                shasta::decompress(
+                    span<const char>(compressedAlignment.data(),
+                    compressedAlignment.data() + compressedAlignment.size()),
+                    alignment);
+                checksum += alignment.ordinals.size();
+            }
+            return checksum;
+        });
+}
+
+
+
+// Compute spoa consensus for sampleCount marker graph edges,
+// evenly spaced among all edges.
+void Assembler::benchmarkSpoaEdgeConsensus(Benchmark& benchmark, uint64_t sampleCount)
+{
+    checkMarkersAreOpen();
+    checkMarkerGraphEdgesIsOpen();
+    const uint64_t edgeCount = markerGraph.edges.size();
+    if(edgeCount == 0) {
+        throw runtime_error("The marker graph has no edges.");
+    }
+    const uint64_t sampleEdgeCount = min(sampleCount, edgeCount);
+
+    // Same settings used during assembly.
+    const uint32_t markerGraphEdgeLengthThresholdForConsensus = 1000;
+    const spoa::AlignmentType alignmentType = spoa::AlignmentType::kNW;
+    const int8_t match = 1;
+    const int8_t mismatch = -1;
+    const int8_t gap = -1;
+    auto spoaAlignmentEngine = spoa::createAlignmentEngine(alignmentType, match, mismatch, gap);
+    auto spoaAlignmentGraph = spoa::createGraph();
+
+    vector<Base> sequence;
+    vector<uint32_t> repeatCounts;
+    uint8_t overlappingBaseCount;
+    benchmark.run("SpoaEdgeConsensus", "marker graph edges", sampleEdgeCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(uint64_t i=0; i<sampleEdgeCount; i++) {
+                const MarkerGraph::EdgeId edgeId = (i * edgeCount) / sampleEdgeCount;
+                ComputeMarkerGraphEdgeConsensusSequenceUsingSpoaDetail detail;
+                computeMarkerGraphEdgeConsensusSequenceUsingSpoa(
+                    edgeId,
+                    markerGraphEdgeLengthThresholdForConsensus,
+                    spoaAlignmentEngine,
+                    spoaAlignmentGraph,
+                    sequence,
+                    repeatCounts,
+                    overlappingBaseCount,
+                    detail,
+                    0);
+                checksum += sequence.size() + overlappingBaseCount;
+            }
+            return checksum;
+        });
+}
+
+
+
+// Call consensus base and repeat count at all positions of
+// sampleCount marker graph vertices, evenly spaced among all vertices.
+// The Coverage objects are computed before the benchmark runs,
+// so only the ConsensusCaller is timed.
+void Assembler::benchmarkConsensusCaller(
+    Benchmark& benchmark,
+    const string& consensusCallerName,
+    uint64_t sampleCount)
+{
+    checkMarkersAreOpen();
+    checkMarkerGraphVerticesAreAvailable();
+    const uint64_t vertexCount = markerGraph.vertexCount();
+    if(vertexCount == 0) {
+        throw runtime_error("The marker graph has no vertices.");
+    }
+    setupConsensusCaller(consensusCallerName);
+
+    // Gather the Coverage objects.
+    vector<Coverage> coverages;
+    const uint64_t sampleVertexCount = min(sampleCount, vertexCount);
+    const size_t k = assemblerInfo->k;
+    for(uint64_t i=0; i<sampleVertexCount; i++) {
+        const MarkerGraph::VertexId vertexId = (i * vertexCount) / sampleVertexCount;
+        const span<MarkerId> markerIds = markerGraph.getVertexMarkerIds(vertexId);
+        for(uint32_t position=0; position<uint32_t(k); position++) {
+            Coverage coverage;
+            for(const MarkerId markerId: markerIds) {
+                const OrientedReadId orientedReadId = findMarkerId(markerId).first;
+                const uint32_t markerPosition = markers.begin()[markerId].position;
+                Base base;
+                uint8_t repeatCount;
+                tie(base, repeatCount) = reads->getOrientedReadBaseAndRepeatCount(
+                    orientedReadId, markerPosition + position);
+                coverage.addRead(AlignedBase(base), orientedReadId.getStrand(), size_t(repeatCount));
+            }
+            coverages.push_back(coverage);
+        }
+    }
+
+    benchmark.run("ConsensusCaller", "positions", coverages.size(),
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(const Coverage& coverage: coverages) {
+                const Consensus consensus = (*consensusCaller)(coverage);
+                checksum += consensus.base.value + consensus.repeatCount;
+            }
+            return checksum;
+        },
+        {{"ConsensusCaller", consensusCallerName}});
+}
+
+
+
+// Access bases of the reads, both sequentially and
+// in random order on both strands.
+void Assembler::benchmarkLongBaseSequence(Benchmark& benchmark, uint64_t sampleCount)
+{
+    reads->checkReadsAreOpen();
+    const ReadId readCount = reads->readCount();
+    if(readCount == 0) {
+        throw runtime_error("There are no reads.");
+    }
+
+    // Sequential access to all bases of all reads.
+    uint64_t baseCount = 0;
+    for(ReadId readId=0; readId<readCount; readId++) {
+        baseCount += reads->getRead(readId).baseCount;
+    }
+    benchmark.run("LongBaseSequenceSequential", "bases", baseCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for(ReadId readId=0; readId<readCount; readId++) {
+                const LongBaseSequenceView read = reads->getRead(readId);
+                for(uint64_t position=0; position<read.baseCount; position++) {
+                    checksum += read[position].value;
+                }
+            }
+            return checksum;
+        });
+
+    // Random access, using a simple linear congruential generator
+    // so the sequence of accesses is the same on all platforms.
+    const uint64_t accessCount = 1000 * sampleCount;
+    benchmark.run("LongBaseSequenceRandom", "bases", accessCount,
+        [&]()
+        {
+            uint64_t checksum = 0;
+            uint64_t x = 1;
+            for(uint64_t i=0; i<accessCount; i++) {
+                x = 6364136223846793005ULL * x + 1442695040888963407ULL;
+                const ReadId readId = ReadId((x >> 33) % readCount);
+                const uint64_t length = reads->getRead(readId).baseCount;
+                if(length == 0) {
+                    continue;
+                }
+                const OrientedReadId orientedReadId(readId, Strand(i & 1));
+                const uint32_t position = uint32_t((x >> 11) % length);
+                checksum += reads->getOrientedReadBase(orientedReadId, position).value;
+            }
+            return checksum;
+        });
+}
@@ -154,7 +154,7 @@ void Assembler::createReadGraphUsingPseudoPaths(
     const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
     cout << timestamp << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
     readGraph.remove();
-    createReadGraphUsingSelectedAlignments(keepAlignment);
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
 }
 
 
@@ -2,6 +2,7 @@
 #include "Assembler.hpp"
 #include "AssemblyPathGraph.hpp"
 #include "AssemblyPathGraph2.hpp"
+#include "deduplicate.hpp"
 #include "performanceLog.hpp"
 using namespace shasta;
 
@@ -9,12 +10,18 @@ using namespace shasta;
 #include <boost/graph/iteration_macros.hpp>
 
 #include <cstdlib>
+#include <thread>
 
 
 
 // Detangle method 1
-void Assembler::detangle()
+void Assembler::detangle(bool useRounds, size_t threadCount)
 {
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
 
     // Check that we have what we need.
@@ -40,45 +47,35 @@ void Assembler::detangle()
 
     // Fill in the oriented read ids of the edges.
     performanceLog << timestamp << "Filling in oriented reads." << endl;
+    // This is done in parallel over edges.
+    detangleData.edges.clear();
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
         AssemblyPathGraphEdge& edge = graph[e];
 
         // At this stage the path must be a single assembly graph edge.
         SHASTA_ASSERT(edge.path.size() == 1);
         const AssemblyGraph::EdgeId edgeId = edge.path.front();
-
-        // Get the marker graph edges corresponding to this assembly graph edge.
-        const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
-
-        // Loop over these marker graph edges.
-        std::set<OrientedReadId> orientedReadIds;
-        for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
-
-            // Loop over the marker intervals of this marker graph edge.
-            const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-            for(const MarkerInterval& markerInterval: markerIntervals) {
-                orientedReadIds.insert(markerInterval.orientedReadId);
-            }
-        }
-
-        // Copy the oriented read ids to the AssemblyPathGraphEdge.
-        copy(orientedReadIds.begin(), orientedReadIds.end(),
-            back_inserter(edge.orientedReadIds));
+        detangleData.edges.push_back(make_pair(edgeId, &edge.orientedReadIds));
 
         // Also store the path length, measured on the marker graph.
-        edge.pathLength = markerGraphEdgeIds.size();
+        edge.pathLength = assemblyGraph.edgeLists.size(edgeId);
     }
+    setupLoadBalancing(detangleData.edges.size(), 100);
+    runThreads(&Assembler::detangleThreadFunction, threadCount);
+    detangleData.edges.clear();
+    detangleData.edges.shrink_to_fit();
 
 
     // Create the tangles.
     performanceLog << timestamp << "Creating the tangles." << endl;
-    graph.createTangles();
+    graph.createTangles(threadCount);
+    performanceLog << timestamp << "Detangling." << endl;
 
     // Do the detangling.
     const double basesPerMarker =
         double(assemblerInfo->baseCount) /
         double(markers.totalSize()/2);
-    graph.detangle(basesPerMarker, assemblyGraph);
+    graph.detangle(basesPerMarker, assemblyGraph, useRounds, threadCount);
 
 
 
@@ -99,9 +96,7 @@ void Assembler::detangle()
 
     // The new vertices are sorted by marker graph vertex id.
     // The position in the newVertices vector is the vertex id in the new assembly graph.
-    newAssemblyGraph.vertices.createNew(
-        largeDataName("New-AssemblyGraphVertices"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.vertices, "New-AssemblyGraphVertices");
     newAssemblyGraph.vertices.resize(newVertices.size());
     for(AssemblyGraph::VertexId vertexId=0; vertexId<newVertices.size(); vertexId++) {
         newAssemblyGraph.vertices[vertexId] = newVertices[vertexId].first;
@@ -112,8 +107,7 @@ void Assembler::detangle()
 
 
     // Find the reverse complement of each vertex.
-    newAssemblyGraph.reverseComplementVertex.createNew(
-        largeDataName("New-AssemblyGraphReverseComplementVertex"), largeDataPageSize);
+    createNew(newAssemblyGraph.reverseComplementVertex, "New-AssemblyGraphReverseComplementVertex");
     newAssemblyGraph.reverseComplementVertex.resize(newAssemblyGraph.vertices.size());
     for(AssemblyGraph::VertexId vertexId=0; vertexId<newAssemblyGraph.vertices.size(); vertexId++) {
         const AssemblyPathGraph::vertex_descriptor v = newVertices[vertexId].second;
@@ -152,12 +146,8 @@ void Assembler::detangle()
     cout << "The detangled assembly graph has " <<
         newEdges.size() << " edges." << endl;
 
-    newAssemblyGraph.edges.createNew(
-        largeDataName("New-AssemblyGraphEdges"),
-        largeDataPageSize);
-    newAssemblyGraph.edgeLists.createNew(
-        largeDataName("New-AssemblyGraphEdgeLists"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.edges, "New-AssemblyGraphEdges");
+    createNew(newAssemblyGraph.edgeLists, "New-AssemblyGraphEdgeLists");
     // ofstream csv("DetangleMap.csv");
     // csv << "Path before detangle,Edge after detangle\n";
     for(AssemblyGraph::EdgeId newEdgeId=0; newEdgeId<newEdges.size(); newEdgeId++) {
@@ -201,18 +191,13 @@ void Assembler::detangle()
 
 
     // Compute connectivity of the new assembly graph.
-    newAssemblyGraph.edgesBySource.createNew(
-        largeDataName("New-AssemblyGraphEdgesBySource"),
-        largeDataPageSize);
-    newAssemblyGraph.edgesByTarget.createNew(
-        largeDataName("New-AssemblyGraphEdgesByTarget"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.edgesBySource, "New-AssemblyGraphEdgesBySource");
+    createNew(newAssemblyGraph.edgesByTarget, "New-AssemblyGraphEdgesByTarget");
     newAssemblyGraph.computeConnectivity();
 
 
     // Find reverse complement edges of the new assembly graph.
-    newAssemblyGraph.reverseComplementEdge.createNew(
-        largeDataName("New-AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+    createNew(newAssemblyGraph.reverseComplementEdge, "New-AssemblyGraphReverseComplementEdge");
     newAssemblyGraph.reverseComplementEdge.resize(newAssemblyGraph.edges.size());
     for(AssemblyGraph::EdgeId edgeId=0; edgeId<newAssemblyGraph.edges.size(); edgeId++) {
         const AssemblyPathGraph::edge_descriptor e = newEdges[edgeId];
@@ -272,9 +257,7 @@ void Assembler::detangle()
 
 
     // Create the marker to assembly table for the detangled marker graph.
-    newAssemblyGraph.markerToAssemblyTable.createNew(
-        largeDataName("New-MarkerToAssemblyTable"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.markerToAssemblyTable, "New-MarkerToAssemblyTable");
     newAssemblyGraph.createMarkerToAssemblyTable(markerGraph.edges.size());
 
 
@@ -309,9 +292,16 @@ void Assembler::detangle()
 void Assembler::detangle2(
     uint64_t diagonalReadCountMin,
     uint64_t offDiagonalReadCountMax,
-    double detangleOffDiagonalRatio
+    double detangleOffDiagonalRatio,
+    bool useRounds,
+    size_t threadCount
     )
 {
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
 
     // Check that we have what we need.
@@ -341,46 +331,36 @@ void Assembler::detangle2(
 
     // Fill in the oriented read ids of the edges.
     performanceLog << timestamp << "Filling in oriented reads." << endl;
+    // This is done in parallel over edges.
+    detangleData.edges.clear();
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
         AssemblyPathGraph2Edge& edge = graph[e];
 
         // At this stage the path must be a single assembly graph edge.
         SHASTA_ASSERT(edge.path.size() == 1);
         const AssemblyGraph::EdgeId edgeId = edge.path.front();
-
-        // Get the marker graph edges corresponding to this assembly graph edge.
-        const auto markerGraphEdgeIds = assemblyGraph.edgeLists[edgeId];
-
-        // Loop over these marker graph edges.
-        std::set<OrientedReadId> orientedReadIds;
-        for(const MarkerGraph::EdgeId markerGraphEdgeId: markerGraphEdgeIds) {
-
-            // Loop over the marker intervals of this marker graph edge.
-            const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
-            for(const MarkerInterval& markerInterval: markerIntervals) {
-                orientedReadIds.insert(markerInterval.orientedReadId);
-            }
-        }
-
-        // Copy the oriented read ids to the AssemblyPathGraphEdge.
-        copy(orientedReadIds.begin(), orientedReadIds.end(),
-            back_inserter(edge.orientedReadIds));
+        detangleData.edges.push_back(make_pair(edgeId, &edge.orientedReadIds));
 
         // Also store the path length, measured on the marker graph.
-        edge.pathLength = markerGraphEdgeIds.size();
+        edge.pathLength = assemblyGraph.edgeLists.size(edgeId);
     }
+    setupLoadBalancing(detangleData.edges.size(), 100);
+    runThreads(&Assembler::detangleThreadFunction, threadCount);
+    detangleData.edges.clear();
+    detangleData.edges.shrink_to_fit();
 
 
 
     // Create the tangles.
     performanceLog << timestamp << "Creating the tangles." << endl;
-    graph.createTangles();
+    graph.createTangles(threadCount);
+    performanceLog << timestamp << "Detangling." << endl;
 
     // Do the detangling.
     const double basesPerMarker =
         double(assemblerInfo->baseCount) /
         double(markers.totalSize()/2);
-    graph.detangle(basesPerMarker, assemblyGraph);
+    graph.detangle(basesPerMarker, assemblyGraph, useRounds, threadCount);
 
 
 
@@ -401,9 +381,7 @@ void Assembler::detangle2(
 
     // The new vertices are sorted by marker graph vertex id.
     // The position in the newVertices vector is the vertex id in the new assembly graph.
-    newAssemblyGraph.vertices.createNew(
-        largeDataName("New-AssemblyGraphVertices"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.vertices, "New-AssemblyGraphVertices");
     newAssemblyGraph.vertices.resize(newVertices.size());
     for(AssemblyGraph::VertexId vertexId=0; vertexId<newVertices.size(); vertexId++) {
         newAssemblyGraph.vertices[vertexId] = newVertices[vertexId].first;
@@ -414,8 +392,7 @@ void Assembler::detangle2(
 
 
     // Find the reverse complement of each vertex.
-    newAssemblyGraph.reverseComplementVertex.createNew(
-        largeDataName("New-AssemblyGraphReverseComplementVertex"), largeDataPageSize);
+    createNew(newAssemblyGraph.reverseComplementVertex, "New-AssemblyGraphReverseComplementVertex");
     newAssemblyGraph.reverseComplementVertex.resize(newAssemblyGraph.vertices.size());
     for(AssemblyGraph::VertexId vertexId=0; vertexId<newAssemblyGraph.vertices.size(); vertexId++) {
         const AssemblyPathGraph2::vertex_descriptor v = newVertices[vertexId].second;
@@ -454,12 +431,8 @@ void Assembler::detangle2(
     cout << "The detangled assembly graph has " <<
         newEdges.size() << " edges." << endl;
 
-    newAssemblyGraph.edges.createNew(
-        largeDataName("New-AssemblyGraphEdges"),
-        largeDataPageSize);
-    newAssemblyGraph.edgeLists.createNew(
-        largeDataName("New-AssemblyGraphEdgeLists"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.edges, "New-AssemblyGraphEdges");
+    createNew(newAssemblyGraph.edgeLists, "New-AssemblyGraphEdgeLists");
     // ofstream csv("DetangleMap.csv");
     // csv << "Path before detangle,Edge after detangle\n";
     for(AssemblyGraph::EdgeId newEdgeId=0; newEdgeId<newEdges.size(); newEdgeId++) {
@@ -503,18 +476,13 @@ void Assembler::detangle2(
 
 
     // Compute connectivity of the new assembly graph.
-    newAssemblyGraph.edgesBySource.createNew(
-        largeDataName("New-AssemblyGraphEdgesBySource"),
-        largeDataPageSize);
-    newAssemblyGraph.edgesByTarget.createNew(
-        largeDataName("New-AssemblyGraphEdgesByTarget"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.edgesBySource, "New-AssemblyGraphEdgesBySource");
+    createNew(newAssemblyGraph.edgesByTarget, "New-AssemblyGraphEdgesByTarget");
     newAssemblyGraph.computeConnectivity();
 
 
     // Find reverse complement edges of the new assembly graph.
-    newAssemblyGraph.reverseComplementEdge.createNew(
-        largeDataName("New-AssemblyGraphReverseComplementEdge"), largeDataPageSize);
+    createNew(newAssemblyGraph.reverseComplementEdge, "New-AssemblyGraphReverseComplementEdge");
     newAssemblyGraph.reverseComplementEdge.resize(newAssemblyGraph.edges.size());
     for(AssemblyGraph::EdgeId edgeId=0; edgeId<newAssemblyGraph.edges.size(); edgeId++) {
         const AssemblyPathGraph2::edge_descriptor e = newEdges[edgeId];
@@ -574,9 +542,7 @@ void Assembler::detangle2(
 
 
     // Create the marker to assembly table for the detangled marker graph.
-    newAssemblyGraph.markerToAssemblyTable.createNew(
-        largeDataName("New-MarkerToAssemblyTable"),
-        largeDataPageSize);
+    createNew(newAssemblyGraph.markerToAssemblyTable, "New-MarkerToAssemblyTable");
     newAssemblyGraph.createMarkerToAssemblyTable(markerGraph.edges.size());
 
 
@@ -603,3 +569,34 @@ void Assembler::detangle2(
     assemblyGraphPointer = newAssemblyGraphPointer;
 
 }
+
+
+
+// Fill in the oriented reads of the AssemblyPathGraph or AssemblyPathGraph2
+// edges for detangling. Each edge gets the sorted oriented read ids
+// that appear in the marker intervals of the marker graph edges
+// of the corresponding assembly graph edge.
+void Assembler::detangleThreadFunction(size_t threadId)
+{
+    const AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const AssemblyGraph::EdgeId edgeId = detangleData.edges[i].first;
+            vector<OrientedReadId>& orientedReadIds = *detangleData.edges[i].second;
+            orientedReadIds.clear();
+
+            // Loop over the marker graph edges corresponding to this assembly graph edge.
+            for(const MarkerGraph::EdgeId markerGraphEdgeId: assemblyGraph.edgeLists[edgeId]) {
+
+                // Loop over the marker intervals of this marker graph edge.
+                const auto markerIntervals = markerGraph.edgeMarkerIntervals[markerGraphEdgeId];
+                for(const MarkerInterval& markerInterval: markerIntervals) {
+                    orientedReadIds.push_back(markerInterval.orientedReadId);
+                }
+            }
+            deduplicate(orientedReadIds);
+        }
+    }
+}
@@ -301,6 +301,18 @@ void Assembler::processRequest(
     }
 
 
+    // If lazy access is enabled, make sure the data needed
+    // by this request are accessible. Accessing most data only
+    // requires mapping the binary files to memory, so we access all of them
+    // except for the mode 3 assembly graph, which is only needed
+    // by the mode 3 pages and is expensive to construct.
+    if(lazyAccessData.isEnabled) {
+        accessAllRegisteredLazy(false);
+        if(keyword.compare(0, 13, "/exploreMode3") == 0) {
+            accessLazy("Mode3AssemblyGraph");
+        }
+    }
+
     // We found the keyword. Call the function that processes this keyword.
     // The processing function is only responsible for writing the html body.
     writeHtmlBegin(html);
@@ -17,6 +17,9 @@ void Assembler::accessKmers()
 
 void Assembler::checkKmersAreOpen()const
 {
+    if(!kmerTable.isOpen) {
+        accessLazy("Kmers");
+    }
     if(!kmerTable.isOpen) {
         throw runtime_error("Kmers are not accessible.");
     }
@@ -142,7 +145,7 @@ void Assembler::randomlySelectKmers(
 void Assembler::initializeKmerTable()
 {
     // Create the kmer table with the necessary size.
-    kmerTable.createNew(largeDataName("Kmers"), largeDataPageSize);
+    createNew(kmerTable, "Kmers");
     const size_t k = assemblerInfo->k;
     const size_t kmerCount = 1ULL << (2ULL*k);
     kmerTable.resize(kmerCount);
@@ -414,9 +417,7 @@ void Assembler::computeKmerFrequency(size_t threadId)
 {
     // Create a frequency vector for this thread.
     MemoryMapped::Vector<uint64_t> frequency;
-    frequency.createNew(
-        largeDataName("tmp-KmerFrequency-" + to_string(threadId)),
-        largeDataPageSize);
+    createNew(frequency, "tmp-KmerFrequency-" + to_string(threadId));
     frequency.resize(kmerTable.size());
     fill(frequency.begin(), frequency.end(), 0);
 
@@ -620,10 +621,8 @@ void Assembler::selectKmers2(
     // global frequency (total number of occurrences in all
     // oriented reads) and the number of reads in
     // which the k-mer is over-enriched.
-    selectKmers2Data.globalFrequency.createNew(
-        largeDataName("tmp-SelectKmers2-GlobalFrequency"),  largeDataPageSize);
-    selectKmers2Data.overenrichedReadCount.createNew(
-        largeDataName("tmp-SelectKmers2-OverenrichedReadCount"),  largeDataPageSize);
+    createNew(selectKmers2Data.globalFrequency, "tmp-SelectKmers2-GlobalFrequency");
+    createNew(selectKmers2Data.overenrichedReadCount, "tmp-SelectKmers2-OverenrichedReadCount");
     selectKmers2Data.globalFrequency.resize(kmerTable.size());
     selectKmers2Data.overenrichedReadCount.resize(kmerTable.size());
     fill(
@@ -767,17 +766,13 @@ void Assembler::selectKmers2ThreadFunction(size_t threadId)
 {
     // Initialize globalFrequency for this thread.
     MemoryMapped::Vector<uint64_t> globalFrequency;
-    globalFrequency.createNew(
-        largeDataName("tmp-SelectKmers2-GlobalFrequency-" + to_string(threadId)),
-        largeDataPageSize);
+    createNew(globalFrequency, "tmp-SelectKmers2-GlobalFrequency-" + to_string(threadId));
     globalFrequency.resize(kmerTable.size());
     fill(globalFrequency.begin(), globalFrequency.end(), 0);
 
     // Initialize overenrichedReadCount for this thread.
     MemoryMapped::Vector<ReadId> overenrichedReadCount;
-    overenrichedReadCount.createNew(
-        largeDataName("tmp-SelectKmers2-OverenrichedReadCount-" + to_string(threadId)),
-        largeDataPageSize);
+    createNew(overenrichedReadCount, "tmp-SelectKmers2-OverenrichedReadCount-" + to_string(threadId));
     overenrichedReadCount.resize(kmerTable.size());
     fill(overenrichedReadCount.begin(), overenrichedReadCount.end(), 0);
 
@@ -935,8 +930,7 @@ void Assembler::selectKmers4(
     initializeKmerTable();
 
     // Initialize the global frequency of all k-mers.
-    selectKmers4Data.globalFrequency.createNew(
-        largeDataName("tmp-SelectKmers4-GlobalFrequency"),  largeDataPageSize);
+    createNew(selectKmers4Data.globalFrequency, "tmp-SelectKmers4-GlobalFrequency");
     selectKmers4Data.globalFrequency.resize(kmerTable.size());
     fill(
         selectKmers4Data.globalFrequency.begin(),
@@ -946,8 +940,7 @@ void Assembler::selectKmers4(
     // Initialize the minimumDistance vector, which stores
     // the minimum RLE distance between any two copies of each k-mer
     // in any oriented read.
-    selectKmers4Data.minimumDistance.createNew(
-        largeDataName("tmp-selectKmers4-minimumDistance"), largeDataPageSize);
+    createNew(selectKmers4Data.minimumDistance, "tmp-selectKmers4-minimumDistance");
     const uint64_t kmerCount = kmerTable.size();
     selectKmers4Data.minimumDistance.resize(kmerCount);
     for(uint64_t i=0; i<kmerCount; i++) {
@@ -1136,9 +1129,7 @@ void Assembler::selectKmers4ThreadFunction(size_t threadId)
     // Initialize globalFrequency for this thread.
     // Having all threads accumulate atomically on the global frequency vector is too slow.
     MemoryMapped::Vector<uint64_t> globalFrequency;
-    globalFrequency.createNew(
-        largeDataName("tmp-SelectKmers4-GlobalFrequency-" + to_string(threadId)),
-        largeDataPageSize);
+    createNew(globalFrequency, "tmp-SelectKmers4-GlobalFrequency-" + to_string(threadId));
     globalFrequency.resize(kmerTable.size());
     fill(globalFrequency.begin(), globalFrequency.end(), 0);
 
@@ -0,0 +1,258 @@
+// Lazy access to assembly data.
+// See Assembler.hpp for more information.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "AssemblyGraph.hpp"
+#include "filesystem.hpp"
+#include "performanceLog.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "iostream.hpp"
+
+// Linux.
+#include <fcntl.h>
+#include <unistd.h>
+
+
+
+// Register all the data accessed by accessAllSoft, without accessing them.
+void Assembler::accessAllLazy(bool warmup)
+{
+    // If binary data are in anonymous memory there is nothing to access.
+    if(largeDataFileNamePrefix.empty()) {
+        accessAllSoft();
+        return;
+    }
+
+    lazyAccessData.isEnabled = true;
+
+    // The registration order is also the warmup order,
+    // so register first the data used by most requests.
+    registerLazyAccess("Markers", {"Markers"}, [this]() {accessMarkers();});
+    registerLazyAccess("MarkerGraphVertices",
+        {"MarkerGraphVertices", "MarkerGraphVertexTable"},
+        [this]() {accessMarkerGraphVertices();});
+    registerLazyAccess("GlobalMarkerGraphEdges",
+        {"GlobalMarkerGraphEdges", "GlobalMarkerGraphEdgeMarkerIntervals"},
+        [this]() {accessMarkerGraphEdges(false);});
+    registerLazyAccess("MarkerGraphReverseComplementeVertex",
+        {"MarkerGraphReverseComplementeVertex"},
+        [this]() {accessMarkerGraphReverseComplementVertex();});
+    registerLazyAccess("MarkerGraphReverseComplementeEdge",
+        {"MarkerGraphReverseComplementeEdge"},
+        [this]() {accessMarkerGraphReverseComplementEdge();});
+    registerLazyAccess("MarkerGraphVertexRepeatCounts",
+        {"MarkerGraphVertexRepeatCounts", "MarkerGraphEdgesConsensus"},
+        [this]() {accessMarkerGraphConsensus();});
+    registerLazyAccess("ReadGraphEdges",
+        {"ReadGraphEdges", "ReadGraphConnectivity"},
+        [this]() {accessReadGraph();});
+    registerLazyAccess("AlignmentData",
+        {"AlignmentData", "AlignmentTable"},
+        [this]() {accessAlignmentData();});
+    registerLazyAccess("CompressedAlignments",
+        {"CompressedAlignments"},
+        [this]() {accessCompressedAlignments();});
+    registerLazyAccess("AlignmentCandidates",
+        {"AlignmentCandidates"},
+        [this]() {accessAlignmentCandidates();});
+    registerLazyAccess("CandidateTable",
+        {"CandidateTable"},
+        [this]() {accessAlignmentCandidateTable();});
+    registerLazyAccess("ReadLowHashStatistics",
+        {"ReadLowHashStatistics"},
+        [this]() {accessReadLowHashStatistics();});
+    registerLazyAccess("Kmers", {"Kmers"}, [this]() {accessKmers();});
+
+    // Data specific to assembly mode 0.
+    if(assemblerInfo->assemblyMode == 0) {
+        registerLazyAccess("AssemblyGraphVertices",
+            {"AssemblyGraphVertices", "MarkerToAssemblyTable"},
+            [this]() {accessAssemblyGraphVertices();});
+        registerLazyAccess("AssemblyGraphEdges",
+            {"AssemblyGraphEdges"},
+            [this]() {accessAssemblyGraphEdges();});
+        registerLazyAccess("AssemblyGraphEdgeLists",
+            {"AssemblyGraphEdgeLists"},
+            [this]() {accessAssemblyGraphEdgeLists();});
+        registerLazyAccess("AssembledSequences",
+            {"AssembledSequences", "AssembledRepeatCounts"},
+            [this]() {accessAssemblyGraphSequences();});
+    }
+
+    // Data specific to assembly mode 2.
+    // The http server does not use it, so it is only accessed on request.
+    if(assemblerInfo->assemblyMode == 2) {
+        registerLazyAccess("AssemblyGraph2", {"AssemblyGraph2-"},
+            [this]() {accessAssemblyGraph2(0);}, true);
+    }
+
+    // Data specific to assembly mode 3.
+    // Accessing the mode 3 assembly graph constructs it
+    // from the marker graph, so only do it when needed.
+    if(assemblerInfo->assemblyMode == 3) {
+        registerLazyAccess("Mode3AssemblyGraph",
+            {"Markers", "MarkerGraphVertices", "GlobalMarkerGraphEdges"},
+            [this]() {accessMode3AssemblyGraph();}, true);
+    }
+
+    bool allDataAreAvailable = true;
+    for(const string& name: lazyAccessData.itemNames) {
+        if(not lazyAccessData.items[name].isAvailable) {
+            cout << name << " is not available." << endl;
+            allDataAreAvailable = false;
+        }
+    }
+    if(!allDataAreAvailable) {
+        cout << "Not all assembly data are accessible." << endl;
+        cout << "Some functionality is not available." << endl;
+    }
+
+    // Start the warmup thread.
+    if(warmup) {
+
+        // Gather the binary files of the registered items, in order.
+        // The reads are always accessed by the constructor,
+        // but their pages are not yet in memory, so warm them up first.
+        const string directoryName =
+            largeDataFileNamePrefix.substr(0, largeDataFileNamePrefix.size() - 1);
+        vector<string> directoryContents = filesystem::directoryContents(directoryName);
+        sort(directoryContents.begin(), directoryContents.end());
+        vector<string> dataNames = {"Read"};
+        for(const string& name: lazyAccessData.itemNames) {
+            const LazyAccessData::Item& item = lazyAccessData.items[name];
+            copy(item.dataNames.begin(), item.dataNames.end(), back_inserter(dataNames));
+        }
+        vector<string> fileNames;
+        for(const string& dataName: dataNames) {
+            const string prefix = largeDataFileNamePrefix + dataName;
+            for(const string& fileName: directoryContents) {
+                if(fileName.compare(0, prefix.size(), prefix) == 0 and
+                    find(fileNames.begin(), fileNames.end(), fileName) == fileNames.end()) {
+                    fileNames.push_back(fileName);
+                }
+            }
+        }
+        lazyAccessData.warmupThread = std::thread(lazyAccessWarmupThreadFunction, fileNames);
+    }
+}
+
+
+
+// Register an item for lazy access.
+// It is available if at least one binary file name begins
+// with the largeDataName of its first data name.
+void Assembler::registerLazyAccess(
+    const string& name,
+    const vector<string>& dataNames,
+    const std::function<void()>& accessFunction,
+    bool isExpensive)
+{
+    SHASTA_ASSERT(not dataNames.empty());
+    SHASTA_ASSERT(lazyAccessData.items.find(name) == lazyAccessData.items.end());
+
+    LazyAccessData::Item& item = lazyAccessData.items[name];
+    item.accessFunction = accessFunction;
+    item.dataNames = dataNames;
+    item.isExpensive = isExpensive;
+
+    const string prefix = largeDataName(dataNames.front());
+    const string directoryName = prefix.substr(0, prefix.find_last_of('/'));
+    for(const string& fileName: filesystem::directoryContents(directoryName)) {
+        if(fileName.compare(0, prefix.size(), prefix) == 0) {
+            item.isAvailable = true;
+            break;
+        }
+    }
+
+    lazyAccessData.itemNames.push_back(name);
+}
+
+
+
+// Access a registered item, if it was not already accessed.
+// Return true if the item is accessible.
+// If lazy access is not enabled, this does nothing and returns false.
+bool Assembler::accessLazy(const string& name) const
+{
+    if(not lazyAccessData.isEnabled) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(lazyAccessData.mutex);
+    auto it = lazyAccessData.items.find(name);
+    if(it == lazyAccessData.items.end()) {
+        return false;
+    }
+    LazyAccessData::Item& item = it->second;
+    if(item.wasAccessed or not item.isAvailable) {
+        return item.isAvailable;
+    }
+
+    // Don't try again if this fails.
+    item.wasAccessed = true;
+    const auto t0 = steady_clock::now();
+    try {
+        item.accessFunction();
+    } catch(const exception& e) {
+        cout << name << " is not accessible." << endl;
+        item.isAvailable = false;
+        return false;
+    }
+    const auto t1 = steady_clock::now();
+    performanceLog << timestamp << "Lazy access to " << name <<
+        " took " << seconds(t1 - t0) << " s." << endl;
+    return true;
+}
+
+
+
+// Access all registered items that were not already accessed.
+void Assembler::accessAllRegisteredLazy(bool includeExpensive) const
+{
+    vector<string> names;
+    {
+        std::lock_guard<std::mutex> lock(lazyAccessData.mutex);
+        for(const string& name: lazyAccessData.itemNames) {
+            const LazyAccessData::Item& item = lazyAccessData.items[name];
+            if(item.isAvailable and not item.wasAccessed and
+                (includeExpensive or not item.isExpensive)) {
+                names.push_back(name);
+            }
+        }
+    }
+    for(const string& name: names) {
+        accessLazy(name);
+    }
+}
+
+
+
+// The warmup thread only asks the kernel to read ahead the binary files.
+// It does not use any Assembler data or write any output,
+// so it does not need synchronization.
+void Assembler::lazyAccessWarmupThreadFunction(vector<string> fileNames)
+{
+    for(const string& fileName: fileNames) {
+        const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+        if(fileDescriptor == -1) {
+            continue;
+        }
+        ::posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fileDescriptor);
+    }
+}
+
+
+
+Assembler::LazyAccessData::~LazyAccessData()
+{
+    if(warmupThread.joinable()) {
+        warmupThread.join();
+    }
+}
@@ -29,8 +29,8 @@ void Assembler::findAlignmentCandidatesLowHash0(
     SHASTA_ASSERT(readCount > 0);
 
     // Create the alignment candidates.
-    alignmentCandidates.candidates.createNew(largeDataName("AlignmentCandidates"), largeDataPageSize);
-    readLowHashStatistics.createNew(largeDataName("ReadLowHashStatistics"), largeDataPageSize);
+    createNew(alignmentCandidates.candidates, "AlignmentCandidates");
+    createNew(readLowHashStatistics, "ReadLowHashStatistics");
 
     // Run the LowHash computation to find candidate alignments.
     LowHash0 lowHash(
@@ -73,6 +73,9 @@ void Assembler::accessReadLowHashStatistics()
 
 void Assembler::checkAlignmentCandidatesAreOpen() const
 {
+    if(!alignmentCandidates.candidates.isOpen) {
+        accessLazy("AlignmentCandidates");
+    }
     if(!alignmentCandidates.candidates.isOpen) {
         throw runtime_error("Alignment candidates are not accessible.");
     }
@@ -151,10 +154,8 @@ void Assembler::findAlignmentCandidatesLowHash1(
     SHASTA_ASSERT(readCount > 0);
 
     // Prepare storage.
-    alignmentCandidates.candidates.createNew(
-        largeDataName("AlignmentCandidates"), largeDataPageSize);
-    alignmentCandidates.featureOrdinals.createNew(
-        largeDataName("AlignmentCandidatesFeatureOrdinale"), largeDataPageSize);
+    createNew(alignmentCandidates.candidates, "AlignmentCandidates");
+    createNew(alignmentCandidates.featureOrdinals, "AlignmentCandidatesFeatureOrdinale");
 
     // Do the computation.
     LowHash1 lowHash1(
@@ -312,7 +313,7 @@ void Assembler::writeAlignmentCandidates(bool useReadName, bool verbose) const
 void Assembler::markAlignmentCandidatesAllPairs()
 {
     // Create the alignment candidates.
-    alignmentCandidates.candidates.createNew(largeDataName("AlignmentCandidates"), largeDataPageSize);
+    createNew(alignmentCandidates.candidates, "AlignmentCandidates");
 
     // Add all pairs on both orientations.
     const ReadId n = reads->readCount();
@@ -96,9 +96,7 @@ void Assembler::createMarkerGraphVertices(
     // Initialize computation of the global marker graph.
     data.orientedMarkerCount = markers.totalSize();
 
-    data.disjointSetTable.createNew(
-        largeDataName("tmp-DisjointSetTable"),
-        largeDataPageSize);
+    createNew(data.disjointSetTable, "tmp-DisjointSetTable");
     // DisjointSets data structure needs an additional 64 bits per entry, in order to implement
     // a lock-free, union-find operation. You can find more information in dset64-gccatomic.hpp.
     // Once the set representatives have been found, we have no need for these extra 64 bits per entry.
@@ -184,9 +182,7 @@ void Assembler::createMarkerGraphVertices(
     // This way, we allocate data.workArea only after compacting 
     // data.disjointSetTable.
     performanceLog << timestamp << "Counting the number of markers in each disjoint set." << endl;
-    data.workArea.createNew(
-        largeDataName("tmp-WorkArea"),
-        largeDataPageSize);
+    createNew(data.workArea, "tmp-WorkArea");
     data.workArea.reserveAndResize(data.orientedMarkerCount);
     fill(data.workArea.begin(), data.workArea.end(), 0ULL);
     setupLoadBalancing(data.orientedMarkerCount, batchSize);
@@ -322,9 +318,7 @@ void Assembler::createMarkerGraphVertices(
 
 
     // Gather the markers in each disjoint set.
-    data.disjointSetMarkers.createNew(
-        largeDataName("tmp-DisjointSetMarkers"),
-        largeDataPageSize);
+    createNew(data.disjointSetMarkers, "tmp-DisjointSetMarkers");
     performanceLog << timestamp << "Gathering markers in disjoint sets, pass1." << endl;
     data.disjointSetMarkers.beginPass1(disjointSetCount);
     performanceLog << timestamp << "Processing " << data.orientedMarkerCount << " oriented markers." << endl;
@@ -374,9 +368,7 @@ void Assembler::createMarkerGraphVertices(
     // - It contains more than one marker on the same oriented read.
     // - It does not contain at least minCoveragePerStrand supporting
     //   oriented reads on each strand.
-    data.isBadDisjointSet.createNew(
-        largeDataName("tmp-IsBadDisjointSet"),
-        largeDataPageSize);
+    createNew(data.isBadDisjointSet, "tmp-IsBadDisjointSet");
     data.isBadDisjointSet.reserveAndResize(disjointSetCount);
     performanceLog << timestamp << "Flagging bad disjoint sets." << endl;
     setupLoadBalancing(disjointSetCount, batchSize);
@@ -392,9 +384,7 @@ void Assembler::createMarkerGraphVertices(
 
     // Renumber the disjoint sets again, this time without counting the ones marked as bad.
     performanceLog << timestamp << "Renumbering disjoint sets to remove the bad ones." << endl;
-    data.workArea.createNew(
-        largeDataName("tmp-WorkArea"),
-        largeDataPageSize);
+    createNew(data.workArea, "tmp-WorkArea");
     data.workArea.reserveAndResize(disjointSetCount);
     newDisjointSetId = 0ULL;
     for(MarkerGraph::VertexId oldDisjointSetId=0;
@@ -424,9 +414,7 @@ void Assembler::createMarkerGraphVertices(
     // That becomes the vertex id assigned to that marker.
     // This could be multithreaded.
     performanceLog << timestamp << "Assigning vertex ids to markers." << endl;
-    markerGraph.vertexTable.createNew(
-        largeDataName("MarkerGraphVertexTable"),
-        largeDataPageSize);
+    createNew(markerGraph.vertexTable, "MarkerGraphVertexTable");
     markerGraph.vertexTable.reserveAndResize(data.orientedMarkerCount);
     for(MarkerGraph::VertexId markerId=0;
         markerId<data.orientedMarkerCount; ++markerId) {
@@ -447,9 +435,7 @@ void Assembler::createMarkerGraphVertices(
     // This could be multithreaded.
     performanceLog << timestamp << "Gathering the markers of each vertex of the marker graph." << endl;
     markerGraph.constructVertices();
-    markerGraph.vertices().createNew(
-        largeDataName("MarkerGraphVertices"),
-        largeDataPageSize);
+    createNew(markerGraph.vertices(), "MarkerGraphVertices");
     for(MarkerGraph::VertexId oldDisjointSetId=0;
         oldDisjointSetId<disjointSetCount; ++oldDisjointSetId) {
         if(data.isBadDisjointSet[oldDisjointSetId]) {
@@ -941,6 +927,9 @@ void Assembler::accessMarkerGraphVertices(bool readWriteAccess)
 
 void Assembler::checkMarkerGraphVerticesAreAvailable() const
 {
+    if(!markerGraph.vertices().isOpen() || !markerGraph.vertexTable.isOpen) {
+        accessLazy("MarkerGraphVertices");
+    }
     if(!markerGraph.vertices().isOpen() || !markerGraph.vertexTable.isOpen) {
         throw runtime_error("Vertices of the marker graph are not accessible.");
     }
@@ -1152,9 +1141,7 @@ void Assembler::findMarkerGraphReverseComplementVertices(size_t threadCount)
     // Allocate the vector to hold the reverse complemented
     // vertex id for each vertex.
     if(not markerGraph.reverseComplementVertex.isOpen) {
-        markerGraph.reverseComplementVertex.createNew(
-            largeDataName("MarkerGraphReverseComplementeVertex"),
-            largeDataPageSize);
+        createNew(markerGraph.reverseComplementVertex, "MarkerGraphReverseComplementeVertex");
     }
     markerGraph.reverseComplementVertex.resize(vertexCount);
 
@@ -1261,8 +1248,7 @@ void Assembler::findMarkerGraphReverseComplementEdges(size_t threadCount)
 
     // Allocate the vector to hold the reverse complemented
     // edge id for each edge.
-    markerGraph.reverseComplementEdge.createNew(
-        largeDataName("MarkerGraphReverseComplementeEdge"), largeDataPageSize);
+    createNew(markerGraph.reverseComplementEdge, "MarkerGraphReverseComplementeEdge");
     markerGraph.reverseComplementEdge.resize(edgeCount);
 
     // Check all marker graph edges.
@@ -2047,12 +2033,8 @@ void Assembler::createMarkerGraphEdges(size_t threadCount)
 
     // Combine the edges found by each thread.
     performanceLog << timestamp << "Combining the edges found by each thread." << endl;
-    markerGraph.edges.createNew(
-            largeDataName("GlobalMarkerGraphEdges"),
-            largeDataPageSize);
-    markerGraph.edgeMarkerIntervals.createNew(
-            largeDataName("GlobalMarkerGraphEdgeMarkerIntervals"),
-            largeDataPageSize);
+    createNew(markerGraph.edges, "GlobalMarkerGraphEdges");
+    createNew(markerGraph.edgeMarkerIntervals, "GlobalMarkerGraphEdgeMarkerIntervals");
     for(size_t threadId=0; threadId<threadCount; threadId++) {
         auto& thisThreadEdges = *createMarkerGraphEdgesData.threadEdges[threadId];
         auto& thisThreadEdgeMarkerIntervals = *createMarkerGraphEdgesData.threadEdgeMarkerIntervals[threadId];
@@ -2088,12 +2070,12 @@ void Assembler::createMarkerGraphEdges(size_t threadCount)
 
 void Assembler::createMarkerGraphEdgesBySourceAndTarget(size_t threadCount)
 {
-    markerGraph.edgesBySource.createNew(
-        largeDataName("GlobalMarkerGraphEdgesBySource"),
-        largeDataPageSize);
-    markerGraph.edgesByTarget.createNew(
-        largeDataName("GlobalMarkerGraphEdgesByTarget"),
-        largeDataPageSize);
+    // This uses the two pass construction with atomic counts
+    // rather than VectorOfVectorsBuilder. Marker graph vertices have low degree,
+    // so there is little contention, and the builder would need
+    // temporary memory proportional to the number of edges.
+    createNew(markerGraph.edgesBySource, "GlobalMarkerGraphEdgesBySource");
+    createNew(markerGraph.edgesByTarget, "GlobalMarkerGraphEdgesByTarget");
 
     // cout << timestamp << "Create marker graph edges by source and target: pass 1 begins." << endl;
     markerGraph.edgesBySource.beginPass1(markerGraph.vertexCount());
@@ -2123,9 +2105,7 @@ void Assembler::createMarkerGraphEdgesThreadFunction0(size_t threadId)
         make_shared< MemoryMapped::Vector<MarkerGraph::Edge> >();
     createMarkerGraphEdgesData.threadEdges[threadId] = thisThreadEdgesPointer;
     MemoryMapped::Vector<MarkerGraph::Edge>& thisThreadEdges = *thisThreadEdgesPointer;
-    thisThreadEdges.createNew(
-            largeDataName("tmp-ThreadGlobalMarkerGraphEdges-" + to_string(threadId)),
-            largeDataPageSize);
+    createNew(thisThreadEdges, "tmp-ThreadGlobalMarkerGraphEdges-" + to_string(threadId));
 
     // Create the vector to contain the marker intervals for edges found by this thread.
     shared_ptr< MemoryMapped::VectorOfVectors<MarkerInterval, uint64_t> >
@@ -2134,9 +2114,7 @@ void Assembler::createMarkerGraphEdgesThreadFunction0(size_t threadId)
     createMarkerGraphEdgesData.threadEdgeMarkerIntervals[threadId] = thisThreadEdgeMarkerIntervalsPointer;
     MemoryMapped::VectorOfVectors<MarkerInterval, uint64_t>&
         thisThreadEdgeMarkerIntervals = *thisThreadEdgeMarkerIntervalsPointer;
-    thisThreadEdgeMarkerIntervals.createNew(
-            largeDataName("tmp-ThreadGlobalMarkerGraphEdgeMarkerIntervals-" + to_string(threadId)),
-            largeDataPageSize);
+    createNew(thisThreadEdgeMarkerIntervals, "tmp-ThreadGlobalMarkerGraphEdgeMarkerIntervals-" + to_string(threadId));
 
     // Some things used inside the loop but defined here for performance.
     vector< pair<MarkerGraph::VertexId, vector<MarkerInterval> > > children;
@@ -2246,6 +2224,9 @@ void Assembler::accessMarkerGraphEdges(
 
 void Assembler::checkMarkerGraphEdgesIsOpen() const
 {
+    if(!markerGraph.edges.isOpen) {
+        accessLazy("GlobalMarkerGraphEdges");
+    }
     SHASTA_ASSERT(markerGraph.edges.isOpen);
     SHASTA_ASSERT(markerGraph.edgesBySource.isOpen());
     SHASTA_ASSERT(markerGraph.edgesByTarget.isOpen());
@@ -2305,9 +2286,7 @@ void Assembler::transitiveReduction(
     // Gather edges for each coverage less than highCoverageThreshold.
     // Only add to the list those with id less than the id of their reverse complement.
     MemoryMapped::VectorOfVectors<EdgeId, EdgeId>  edgesByCoverage;
-    edgesByCoverage.createNew(
-            largeDataName("tmp-flagMarkerGraphWeakEdges-edgesByCoverage"),
-            largeDataPageSize);
+    createNew(edgesByCoverage, "tmp-flagMarkerGraphWeakEdges-edgesByCoverage");
     edgesByCoverage.beginPass1(highCoverageThreshold);
     for(EdgeId edgeId=0; edgeId!=edges.size(); edgeId++) {
         if (markerGraph.reverseComplementEdge[edgeId] < edgeId) {
@@ -2336,9 +2315,7 @@ void Assembler::transitiveReduction(
     // Vector to contain vertex distances during each BFS.
     // Is is set to -1 for vertices not reached by the BFS.
     MemoryMapped::Vector<int> vertexDistances;
-    vertexDistances.createNew(
-        largeDataName("tmp-flagMarkerGraphWeakEdges-vertexDistances"),
-        largeDataPageSize);
+    createNew(vertexDistances, "tmp-flagMarkerGraphWeakEdges-vertexDistances");
     vertexDistances.resize(markerGraph.vertexCount());
     fill(vertexDistances.begin(), vertexDistances.end(), -1);
 
@@ -2533,9 +2510,7 @@ void Assembler::reverseTransitiveReduction(
     // Gather edges for each coverage less than highCoverageThreshold.
     // Only add to the list those with id less than the id of their reverse complement.
     MemoryMapped::VectorOfVectors<EdgeId, EdgeId>  edgesByCoverage;
-    edgesByCoverage.createNew(
-            largeDataName("tmp-flagMarkerGraphWeakEdges-edgesByCoverage"),
-            largeDataPageSize);
+    createNew(edgesByCoverage, "tmp-flagMarkerGraphWeakEdges-edgesByCoverage");
     edgesByCoverage.beginPass1(highCoverageThreshold);
     for(EdgeId edgeId=0; edgeId!=edges.size(); edgeId++) {
         if (markerGraph.reverseComplementEdge[edgeId] < edgeId) {
@@ -2561,9 +2536,7 @@ void Assembler::reverseTransitiveReduction(
     // Vector to contain vertex distances during each BFS.
     // Is is set to -1 for vertices not reached by the BFS.
     MemoryMapped::Vector<int> vertexDistances;
-    vertexDistances.createNew(
-        largeDataName("tmp-flagMarkerGraphWeakEdges-vertexDistances"),
-        largeDataPageSize);
+    createNew(vertexDistances, "tmp-flagMarkerGraphWeakEdges-vertexDistances");
     vertexDistances.resize(markerGraph.vertexCount());
     fill(vertexDistances.begin(), vertexDistances.end(), -1);
 
@@ -2856,9 +2829,7 @@ void Assembler::pruneMarkerGraphStrongSubgraph(size_t iterationCount)
 
     // Flags to mark edges to prune at each iteration.
     MemoryMapped::Vector<bool> edgesToBePruned;
-    edgesToBePruned.createNew(
-        largeDataName("tmp-PruneMarkerGraphStrogngSubgraph"),
-        largeDataPageSize);
+    createNew(edgesToBePruned, "tmp-PruneMarkerGraphStrogngSubgraph");
     edgesToBePruned.resize(edgeCount);
     fill(edgesToBePruned.begin(), edgesToBePruned.end(), false);
 
@@ -4525,9 +4496,7 @@ void Assembler::assembleMarkerGraphVertices(size_t threadCount)
     }
 
     // Initialize the vector to contain assemblerInfo->k optimal repeat counts for each vertex.
-    markerGraph.vertexRepeatCounts.createNew(
-        largeDataName("MarkerGraphVertexRepeatCounts"),
-        largeDataPageSize);
+    createNew(markerGraph.vertexRepeatCounts, "MarkerGraphVertexRepeatCounts");
     markerGraph.vertexRepeatCounts.resize(assemblerInfo->k * markerGraph.vertexCount());
 
     // Do the work in parallel.
@@ -4535,6 +4504,7 @@ void Assembler::assembleMarkerGraphVertices(size_t threadCount)
     setupLoadBalancing(markerGraph.vertexCount(), batchSize);
     runThreads(&Assembler::assembleMarkerGraphVerticesThreadFunction, threadCount);
 
+    writeConsensusCallerStatistics();
     performanceLog << timestamp << "assembleMarkerGraphVertices ends." << endl;
 }
 
@@ -4618,8 +4588,7 @@ void Assembler::computeMarkerGraphVerticesCoverageData(size_t threadCount)
 
 
     // Gather the results computed by all the threads.
-    markerGraph.vertexCoverageData.createNew(
-        largeDataName("MarkerGraphVerticesCoverageData"), largeDataPageSize);
+    createNew(markerGraph.vertexCoverageData, "MarkerGraphVerticesCoverageData");
     for(MarkerGraph::VertexId vertexId=0; vertexId!=markerGraph.vertexCount(); vertexId++) {
         const auto& p = vertexTable[vertexId];
         const size_t threadId = p.first;
@@ -4656,10 +4625,8 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
         make_shared< MemoryMapped::VectorOfVectors<pair<uint32_t, CompressedCoverageData>, uint64_t> >();
     auto& threadVertexIds = *data.threadVertexIds[threadId];
     auto& threadCoverageData = *data.threadVertexCoverageData[threadId];
-    threadVertexIds.createNew(
-        largeDataName("tmp-computeMarkerGraphVertices-vertexIds" + to_string(threadId)), largeDataPageSize);
-    threadCoverageData.createNew(
-        largeDataName("tmp-markerGraphVerticesCoverageData" + to_string(threadId)), largeDataPageSize);
+    createNew(threadVertexIds, "tmp-computeMarkerGraphVertices-vertexIds" + to_string(threadId));
+    createNew(threadCoverageData, "tmp-markerGraphVerticesCoverageData" + to_string(threadId));
 
 
     // Some work areas used in the loop and defined here to reduce memory allocation
@@ -4795,14 +4762,11 @@ void Assembler::assembleMarkerGraphEdges(
     }
 
     // Gather the results.
-    markerGraph.edgeConsensus.createNew(
-        largeDataName("MarkerGraphEdgesConsensus"), largeDataPageSize);
-    markerGraph.edgeConsensusOverlappingBaseCount.createNew(
-        largeDataName("MarkerGraphEdgesConsensusOverlappingBaseCount"), largeDataPageSize);
+    createNew(markerGraph.edgeConsensus, "MarkerGraphEdgesConsensus");
+    createNew(markerGraph.edgeConsensusOverlappingBaseCount, "MarkerGraphEdgesConsensusOverlappingBaseCount");
     markerGraph.edgeConsensusOverlappingBaseCount.resize(markerGraph.edges.size());
     if(storeCoverageData) {
-        markerGraph.edgeCoverageData.createNew(
-            largeDataName("MarkerGraphEdgesCoverageData"), largeDataPageSize);
+        createNew(markerGraph.edgeCoverageData, "MarkerGraphEdgesCoverageData");
     }
     for(MarkerGraph::EdgeId edgeId=0; edgeId!=markerGraph.edges.size(); edgeId++) {
         const auto& p = edgeTable[edgeId];
@@ -4841,6 +4805,7 @@ void Assembler::assembleMarkerGraphEdges(
         assembleMarkerGraphEdgesData.threadEdgeCoverageData.clear();
     }
 
+    writeConsensusCallerStatistics();
     performanceLog << timestamp << "assembleMarkerGraphEdges ends." << endl;
 }
 
@@ -4886,12 +4851,9 @@ void Assembler::assembleMarkerGraphEdgesThreadFunction(size_t threadId)
     MemoryMapped::Vector<uint8_t>& overlappingBaseCountVector =
         *assembleMarkerGraphEdgesData.threadEdgeConsensusOverlappingBaseCount[threadId];
 
-    edgeIds.createNew(
-        largeDataName("tmp-assembleMarkerGraphEdges-edgeIds-" + to_string(threadId)), largeDataPageSize);
-    consensus.createNew(
-        largeDataName("tmp-assembleMarkerGraphEdges-consensus-" + to_string(threadId)), largeDataPageSize);
-    overlappingBaseCountVector.createNew(
-        largeDataName("tmp-assembleMarkerGraphEdges-consensus-overlappingBaseCount" + to_string(threadId)), largeDataPageSize);
+    createNew(edgeIds, "tmp-assembleMarkerGraphEdges-edgeIds-" + to_string(threadId));
+    createNew(consensus, "tmp-assembleMarkerGraphEdges-consensus-" + to_string(threadId));
+    createNew(overlappingBaseCountVector, "tmp-assembleMarkerGraphEdges-consensus-overlappingBaseCount" + to_string(threadId));
 
     if(storeCoverageData) {
         assembleMarkerGraphEdgesData.threadEdgeCoverageData[threadId] =
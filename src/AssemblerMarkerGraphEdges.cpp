@@ -49,9 +49,7 @@ void Assembler::createMarkerGraphEdgesStrict(
 
 
     // Find marker intervals and gather them by source vertex id.
-    createMarkerGraphEdgesStrictData.markerIntervalInfos.createNew(
-        largeDataName("tmp-createMarkerGraphEdgesStrictData-MarkerIntervalInfos"),
-        largeDataPageSize);
+    createNew(createMarkerGraphEdgesStrictData.markerIntervalInfos, "tmp-createMarkerGraphEdgesStrictData-MarkerIntervalInfos");
     createMarkerGraphEdgesStrictData.markerIntervalInfos.beginPass1(markerGraph.vertexCount());
     const uint64_t readCount = getReads().readCount();
     uint64_t batchSize = 10;
@@ -78,12 +76,8 @@ void Assembler::createMarkerGraphEdgesStrict(
 
 
     // Combine the edges found by each thread.
-    markerGraph.edges.createNew(
-            largeDataName("GlobalMarkerGraphEdges"),
-            largeDataPageSize);
-    markerGraph.edgeMarkerIntervals.createNew(
-            largeDataName("GlobalMarkerGraphEdgeMarkerIntervals"),
-            largeDataPageSize);
+    createNew(markerGraph.edges, "GlobalMarkerGraphEdges");
+    createNew(markerGraph.edgeMarkerIntervals, "GlobalMarkerGraphEdgeMarkerIntervals");
     for(size_t threadId=0; threadId<threadCount; threadId++) {
         auto& thisThreadEdges = *createMarkerGraphEdgesStrictData.threadEdges[threadId];
         auto& thisThreadEdgeMarkerIntervals = *createMarkerGraphEdgesStrictData.threadEdgeMarkerIntervals[threadId];
@@ -207,9 +201,7 @@ void Assembler::createMarkerGraphEdgesStrictPass3(size_t threadId)
         make_shared< MemoryMapped::Vector<MarkerGraph::Edge> >();
     createMarkerGraphEdgesStrictData.threadEdges[threadId] = thisThreadEdgesPointer;
     MemoryMapped::Vector<MarkerGraph::Edge>& thisThreadEdges = *thisThreadEdgesPointer;
-    thisThreadEdges.createNew(
-            largeDataName("tmp-ThreadGlobalMarkerGraphEdges-" + to_string(threadId)),
-            largeDataPageSize);
+    createNew(thisThreadEdges, "tmp-ThreadGlobalMarkerGraphEdges-" + to_string(threadId));
 
     // Create the vector to contain the marker intervals for edges found by this thread.
     shared_ptr< MemoryMapped::VectorOfVectors<MarkerInterval, uint64_t> >
@@ -218,9 +210,7 @@ void Assembler::createMarkerGraphEdgesStrictPass3(size_t threadId)
     createMarkerGraphEdgesStrictData.threadEdgeMarkerIntervals[threadId] = thisThreadEdgeMarkerIntervalsPointer;
     MemoryMapped::VectorOfVectors<MarkerInterval, uint64_t>&
         thisThreadEdgeMarkerIntervals = *thisThreadEdgeMarkerIntervalsPointer;
-    thisThreadEdgeMarkerIntervals.createNew(
-            largeDataName("tmp-ThreadGlobalMarkerGraphEdgeMarkerIntervals-" + to_string(threadId)),
-            largeDataPageSize);
+    createNew(thisThreadEdgeMarkerIntervals, "tmp-ThreadGlobalMarkerGraphEdgeMarkerIntervals-" + to_string(threadId));
 
     // Get coverage criteria.
     const uint64_t minEdgeCoverage = createMarkerGraphEdgesStrictData.minEdgeCoverage;
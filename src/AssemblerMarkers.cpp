@@ -11,7 +11,7 @@ void Assembler::findMarkers(size_t threadCount)
     reads->checkReadsAreOpen();
     checkKmersAreOpen();
 
-    markers.createNew(largeDataName("Markers"), largeDataPageSize);
+    createNew(markers, "Markers");
     MarkerFinder markerFinder(
         assemblerInfo->k,
         kmerTable,
@@ -30,6 +30,9 @@ void Assembler::accessMarkers()
 
 void Assembler::checkMarkersAreOpen() const
 {
+    if(!markers.isOpen()) {
+        accessLazy("Markers");
+    }
     if(!markers.isOpen()) {
         throw runtime_error("Markers are not accessible.");
     }
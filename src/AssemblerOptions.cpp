@@ -170,12 +170,31 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         value<string>(&commandLineOnlyOptions.memoryBacking)->
         default_value("4K"),
         "Specify the type of pages used to back memory.\n"
-        "Allowed values: disk, 4K , 2M (for best performance). "
+        "Allowed values: disk, 4K , 2M (for best performance), "
+        "THP (transparent huge pages, only allowed with anonymous memoryMode). "
         "All combinations (memoryMode, memoryBacking) are allowed "
-        "except for (anonymous, disk).\n"
+        "except for (anonymous, disk), (filesystem, THP).\n"
         "Some combinations require root privilege, which is obtained using sudo "
         "and may result in a password prompting depending on your sudo set up.")
 
+        ("memoryGrowthFactor",
+        value<double>(&commandLineOnlyOptions.memoryGrowthFactor)->
+        default_value(1.5),
+        "Factor by which the capacity of a memory mapped vector is increased "
+        "when it grows beyond its current capacity. Must be greater than 1.")
+
+        ("memoryPrefault",
+        value<string>(&commandLineOnlyOptions.memoryPrefault)->
+        default_value("none"),
+        "Prefault large memory allocations in the background. "
+        "Allowed values: none, willneed, populate.")
+
+        ("memoryPrefaultThreshold",
+        value<uint64_t>(&commandLineOnlyOptions.memoryPrefaultThreshold)->
+        default_value(256),
+        "Minimum size in MB of a memory allocation to be prefaulted "
+        "when --memoryPrefault is not none.")
+
         ("threads",
         value<uint32_t>(&commandLineOnlyOptions.threadCount)->
         default_value(0),
@@ -186,6 +205,14 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         default_value(false),
         "Suppress echoing stdout to stdout.log.")
 
+        ("resetPeakMemoryPerPhase",
+        bool_switch(&commandLineOnlyOptions.resetPeakMemoryPerPhase)->
+        default_value(false),
+        "Reset peak resident memory at the beginning of each assembly phase, "
+        "so PhaseTimes.csv reports peak memory for each phase separately. "
+        "This makes the peak memory reported by the operating system to the "
+        "parent process incorrect.")
+
         ("exploreAccess",
         value<string>(&commandLineOnlyOptions.exploreAccess)->
         default_value("user"),
@@ -200,6 +227,96 @@ void AssemblerOptions::addCommandLineOnlyOptions()
         default_value(17100),
         "Port to be used by the http server (command --explore).")
 
+        ("exploreWarmup",
+        bool_switch(&commandLineOnlyOptions.exploreWarmup)->
+        default_value(false),
+        "For --command explore, read ahead binary data in the background "
+        "while the http server starts.")
+
+        ("sharedDataDirectory",
+        value<string>(&commandLineOnlyOptions.sharedDataDirectory),
+        "Shared directory used by --command publishSharedData, cleanupSharedData, "
+        "and explore. A name without slashes is interpreted as /dev/shm/shasta-name.")
+
+        ("simulateOutputPrefix",
+        value<string>(&commandLineOnlyOptions.simulateOutputPrefix)->
+        default_value("Simulated"),
+        "For --command simulateReads, prefix of the output file names.")
+
+        ("simulateGenomeSize",
+        value<uint64_t>(&commandLineOnlyOptions.simulateGenomeSize)->
+        default_value(1000000),
+        "For --command simulateReads, genome size in bases.")
+
+        ("simulateRepeatFraction",
+        value<double>(&commandLineOnlyOptions.simulateRepeatFraction)->
+        default_value(0.05),
+        "For --command simulateReads, fraction of the genome consisting of repeats.")
+
+        ("simulateRepeatLength",
+        value<uint64_t>(&commandLineOnlyOptions.simulateRepeatLength)->
+        default_value(5000),
+        "For --command simulateReads, length of each repeat copy.")
+
+        ("simulateRepeatFamilyCount",
+        value<uint64_t>(&commandLineOnlyOptions.simulateRepeatFamilyCount)->
+        default_value(10),
+        "For --command simulateReads, number of distinct repeat families.")
+
+        ("simulateRepeatDivergence",
+        value<double>(&commandLineOnlyOptions.simulateRepeatDivergence)->
+        default_value(0.01),
+        "For --command simulateReads, substitution rate between copies of a repeat family.")
+
+        ("simulateHeterozygosity",
+        value<double>(&commandLineOnlyOptions.simulateHeterozygosity)->
+        default_value(0.),
+        "For --command simulateReads, rate of heterozygous substitutions "
+        "between the two haplotypes. If 0, the genome is haploid.")
+
+        ("simulateCoverage",
+        value<double>(&commandLineOnlyOptions.simulateCoverage)->
+        default_value(30.),
+        "For --command simulateReads, total coverage of the simulated reads.")
+
+        ("simulateReadLengthMean",
+        value<double>(&commandLineOnlyOptions.simulateReadLengthMean)->
+        default_value(20000.),
+        "For --command simulateReads, mean of the log-normal read length distribution.")
+
+        ("simulateReadLengthStandardDeviation",
+        value<double>(&commandLineOnlyOptions.simulateReadLengthStandardDeviation)->
+        default_value(10000.),
+        "For --command simulateReads, standard deviation of the log-normal read length distribution.")
+
+        ("simulateMinReadLength",
+        value<uint64_t>(&commandLineOnlyOptions.simulateMinReadLength)->
+        default_value(1000),
+        "For --command simulateReads, minimum read length.")
+
+        ("simulateErrorModel",
+        value<string>(&commandLineOnlyOptions.simulateErrorModel)->
+        default_value("guppy-3.6.0-a"),
+        "For --command simulateReads, the Bayesian consensus caller configuration "
+        "(built-in name or configuration file) used to simulate repeat count errors, "
+        "or none.")
+
+        ("simulateSubstitutionRate",
+        value<double>(&commandLineOnlyOptions.simulateSubstitutionRate)->
+        default_value(0.005),
+        "For --command simulateReads, per base substitution error rate.")
+
+        ("simulateIndelRate",
+        value<double>(&commandLineOnlyOptions.simulateIndelRate)->
+        default_value(0.005),
+        "For --command simulateReads, per base insertion plus deletion error rate, "
+        "in addition to repeat count errors.")
+
+        ("simulateSeed",
+        value<uint64_t>(&commandLineOnlyOptions.simulateSeed)->
+        default_value(231),
+        "For --command simulateReads, seed for the random number generator.")
+
         ("alignmentsPafFile",
         value<string>(&commandLineOnlyOptions.alignmentsPafFile),
         "The name of a PAF file containing alignments of reads to "
@@ -771,6 +888,13 @@ void AssemblerOptions::addConfigurableOptions()
         "Maximum ratio of total off-diagonal elements over diagonal element "
         "allowed for detangling.")
 
+        ("Assembly.detangle.inRounds",
+        bool_switch(&assemblyOptions.detangleInRounds)->
+        default_value(false),
+        "Detangle in rounds of tangles that don't conflict with each other, "
+        "computing the tangle matrices of each round in parallel. "
+        "Faster, but results can differ from the default detangling order.")
+
         ("Assembly.iterative",
         bool_switch(&assemblyOptions.iterative)->
         default_value(false),
@@ -857,6 +981,13 @@ void AssemblerOptions::addConfigurableOptions()
         "Component size threshold for bubble removal. "
         "Only used in Mode 2 assembly.")
 
+        ("Assembly.mode2.bubbleRemoval.incremental",
+        bool_switch(&assemblyOptions.mode2Options.incrementalBubbleRemoval)->
+        default_value(false),
+        "After the first iteration of bubble removal, only reprocess superbubbles "
+        "touched by the previous or current iteration. "
+        "Only used in Mode 2 assembly.")
+
         ("Assembly.mode2.phasing.minConcordantReadCount",
         value<uint64_t>(&assemblyOptions.mode2Options.minConcordantReadCountForPhasing)->
         default_value(2),
@@ -1092,6 +1223,8 @@ void AssemblyOptions::write(ostream& s) const
     s << "detangle.diagonalReadCountMin = " << detangleDiagonalReadCountMin << "\n";
     s << "detangle.offDiagonalReadCountMax = " << detangleOffDiagonalReadCountMax << "\n";
     s << "detangle.offDiagonalRatio = " << detangleOffDiagonalRatio << "\n";
+    s << "detangle.inRounds = " <<
+        convertBoolToPythonString(detangleInRounds) << "\n";
     s << "iterative = " <<
         convertBoolToPythonString(iterative) << "\n";
     s << "iterative.iterationCount = " << iterativeIterationCount << "\n";
@@ -1117,6 +1250,8 @@ void Mode2AssemblyOptions::write(ostream& s) const
     s << "mode2.bubbleRemoval.maxDiscordantReadCount = " << maxDiscordantReadCountForBubbleRemoval << "\n";
     s << "mode2.bubbleRemoval.minLogP = " << minLogPForBubbleRemoval << "\n";
     s << "mode2.bubbleRemoval.componentSizeThreshold = " << componentSizeThresholdForBubbleRemoval << "\n";
+    s << "mode2.bubbleRemoval.incremental = " <<
+        convertBoolToPythonString(incrementalBubbleRemoval) << "\n";
     s << "mode2.phasing.minConcordantReadCount = " << minConcordantReadCountForPhasing << "\n";
     s << "mode2.phasing.maxDiscordantReadCount = " << maxDiscordantReadCountForPhasing << "\n";
     s << "mode2.phasing.minLogP = " << minLogPForPhasing << "\n";
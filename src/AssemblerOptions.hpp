@@ -96,10 +96,34 @@ public:
     string command;
     string memoryMode;
     string memoryBacking;
+    double memoryGrowthFactor;
+    string memoryPrefault;
+    uint64_t memoryPrefaultThreshold;
     uint32_t threadCount;
     bool suppressStdoutLog;
+    bool resetPeakMemoryPerPhase;
     string exploreAccess;
     uint16_t port;
+    bool exploreWarmup;
+    string sharedDataDirectory;
+
+    // Options for --command simulateReads.
+    string simulateOutputPrefix;
+    uint64_t simulateGenomeSize;
+    double simulateRepeatFraction;
+    uint64_t simulateRepeatLength;
+    uint64_t simulateRepeatFamilyCount;
+    double simulateRepeatDivergence;
+    double simulateHeterozygosity;
+    double simulateCoverage;
+    double simulateReadLengthMean;
+    double simulateReadLengthStandardDeviation;
+    uint64_t simulateMinReadLength;
+    string simulateErrorModel;
+    double simulateSubstitutionRate;
+    double simulateIndelRate;
+    uint64_t simulateSeed;
+
     string alignmentsPafFile;
 };
 
@@ -283,6 +307,11 @@ public:
     double minLogPForBubbleRemoval;
     uint64_t componentSizeThresholdForBubbleRemoval;
 
+    // If set, after the first iteration of bubble removal
+    // superbubbles are only reprocessed if the previous or current
+    // iteration touched them.
+    bool incrementalBubbleRemoval;
+
     // Parameters for phasing.
     uint64_t minConcordantReadCountForPhasing;
     uint64_t maxDiscordantReadCountForPhasing;
@@ -327,6 +356,7 @@ public:
     uint64_t detangleDiagonalReadCountMin;
     uint64_t detangleOffDiagonalReadCountMax;
     double detangleOffDiagonalRatio;
+    bool detangleInRounds;
 
     // Options that control iterative assembly.
     bool iterative;
@@ -2,9 +2,12 @@
 // Shasta.
 #include "Assembler.hpp"
 #include "deduplicate.hpp"
+#include "dset64-gccAtomic.hpp"
 #include "LocalReadGraph.hpp"
+#include "MurmurHash2.hpp"
 #include "orderPairs.hpp"
 #include "performanceLog.hpp"
+#include "ReadGraphBfs.hpp"
 #include "Reads.hpp"
 #include "shastaLapack.hpp"
 #include "timestamp.hpp"
@@ -26,6 +29,7 @@ using namespace shasta;
 #include <queue>
 #include <random>
 #include <stack>
+#include <thread>
 
 
 
@@ -34,130 +38,179 @@ using namespace shasta;
 // be more than maxAlignmentCount.
 void Assembler::createReadGraph(
     uint32_t maxAlignmentCount,
-    uint32_t maxTrim)
+    uint32_t maxTrim,
+    size_t threadCount)
 {
+    performanceLog << timestamp << "createReadGraph begins." << endl;
+
+    // Select the alignments to be kept.
+    vector<bool> keepAlignment;
+    selectReadGraphAlignments(maxAlignmentCount, false, keepAlignment, threadCount);
+    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
+    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
+
+    // Create the read graph using the alignments we selected.
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
+
+    performanceLog << timestamp << "createReadGraph ends." << endl;
+}
+
+
+
+// For each read, select the best maxAlignmentCount alignments,
+// ranked by number of aligned markers.
+// If useReadGraph2Criteria is true, only alignments that pass
+// passesReadGraph2Criteria are considered.
+// Reads are processed in parallel. Because an alignment
+// can be selected by both of its reads, the selected alignments
+// are first recorded in a bit vector using atomic operations.
+void Assembler::selectReadGraphAlignments(
+    uint32_t maxAlignmentCount,
+    bool useReadGraph2Criteria,
+    vector<bool>& keepAlignment,
+    size_t threadCount)
+{
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     // Find the number of reads and oriented reads.
     const ReadId orientedReadCount = uint32_t(markers.size());
     SHASTA_ASSERT((orientedReadCount % 2) == 0);
     const ReadId readCount = orientedReadCount / 2;
 
-    // Mark all alignments as not to be kept.
-    vector<bool> keepAlignment(alignmentData.size(), false);
+    // Select the alignments in parallel.
+    performanceLog << timestamp << "Selecting read graph alignments." << endl;
+    createReadGraphData.maxAlignmentCount = maxAlignmentCount;
+    createReadGraphData.useReadGraph2Criteria = useReadGraph2Criteria;
+    createReadGraphData.keepAlignmentBits.clear();
+    createReadGraphData.keepAlignmentBits.resize((alignmentData.size() + 63) / 64, 0);
+    setupLoadBalancing(readCount, 1000);
+    runThreads(&Assembler::selectReadGraphAlignmentsThreadFunction, threadCount);
+
+    // Copy the bit vector to the keepAlignment vector.
+    keepAlignment.clear();
+    keepAlignment.resize(alignmentData.size(), false);
+    for(uint64_t alignmentId=0; alignmentId<alignmentData.size(); alignmentId++) {
+        const uint64_t word = createReadGraphData.keepAlignmentBits[alignmentId >> 6];
+        if((word >> (alignmentId & 63)) & 1) {
+            keepAlignment[alignmentId] = true;
+        }
+    }
+    createReadGraphData.keepAlignmentBits.clear();
+    createReadGraphData.keepAlignmentBits.shrink_to_fit();
+}
+
+
+
+void Assembler::selectReadGraphAlignmentsThreadFunction(size_t threadId)
+{
+    const uint32_t maxAlignmentCount = createReadGraphData.maxAlignmentCount;
+    const bool useReadGraph2Criteria = createReadGraphData.useReadGraph2Criteria;
+    uint64_t* keepAlignmentBits = createReadGraphData.keepAlignmentBits.data();
 
     // Vector to keep the alignments for each read,
     // with their number of markers.
     // Contains pairs(marker count, alignment id).
     vector< pair<uint32_t, uint32_t> > readAlignments;
 
-    const bool debug = false;
-    if(debug) {
-        cout << "createReadGraph begins, maxAlignmentCount " << maxAlignmentCount << endl;
-    }
-
-
-    // Loop over reads.
-    for(ReadId readId=0; readId<readCount; readId++) {
-        if(debug) {
-            cout << "Working on read " << readId << endl;
-        }
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
 
-        // Gather the alignments for this read, each with its number of markers.
-        readAlignments.clear();
-        for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
-            const AlignmentData& alignment = alignmentData[alignmentId];
-            readAlignments.push_back(make_pair(alignment.info.markerCount, alignmentId));
-        }
-        if(debug) {
-            cout << "Found " << readAlignments.size() << " alignments." << endl;
-        }
+            // Gather the alignments for this read, each with its number of markers.
+            readAlignments.clear();
+            for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
+                const AlignmentInfo& info = alignmentData[alignmentId].info;
+                if(useReadGraph2Criteria and not passesReadGraph2Criteria(info)) {
+                    continue;
+                }
+                readAlignments.push_back(make_pair(info.markerCount, alignmentId));
+            }
 
-        // Keep the best maxAlignmentCount.
-        if(readAlignments.size() > maxAlignmentCount) {
-            std::nth_element(
-                readAlignments.begin(),
-                readAlignments.begin() + maxAlignmentCount,
-                readAlignments.end(),
-                std::greater< pair<uint32_t, uint32_t> >());
-            readAlignments.resize(maxAlignmentCount);
-        }
-        if(debug) {
-            cout << "Kept " << readAlignments.size() << " alignments." << endl;
-        }
+            // Keep the best maxAlignmentCount.
+            if(readAlignments.size() > maxAlignmentCount) {
+                std::nth_element(
+                    readAlignments.begin(),
+                    readAlignments.begin() + maxAlignmentCount,
+                    readAlignments.end(),
+                    std::greater< pair<uint32_t, uint32_t> >());
+                readAlignments.resize(maxAlignmentCount);
+            }
 
-        // Mark the surviving alignments as to be kept.
-        for(const auto& p: readAlignments) {
-            const uint32_t alignmentId = p.second;
-            keepAlignment[alignmentId] = true;
-            if(debug) {
-                const AlignmentData& alignment = alignmentData[alignmentId];
-                cout << "Marked alignment " << alignment.readIds[0] << " " <<
-                    alignment.readIds[1] << (alignment.isSameStrand ? " same strand" : " opposite strand") << endl;
+            // Mark the surviving alignments as to be kept.
+            for(const auto& p: readAlignments) {
+                const uint32_t alignmentId = p.second;
+                __sync_fetch_and_or(keepAlignmentBits + (alignmentId >> 6), 1ULL << (alignmentId & 63));
             }
         }
     }
-    const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
-    cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
-
-    // Create the read graph using the alignments we selected.
-    createReadGraphUsingSelectedAlignments(keepAlignment);
 }
 
 
 
 // This is called for ReadGraph.creationMethod 0 and 2.
-void Assembler::createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignment)
+// The read graph edges are created in parallel over blocks
+// of alignments, using a prefix sum of the number of kept alignments
+// in each block to find where each block stores its edges.
+// The connectivity is then created with a multithreaded two-pass
+// process, and each connectivity list is sorted at the end
+// to obtain the same ordering as in the sequential version
+// (edge ids in decreasing order).
+void Assembler::createReadGraphUsingSelectedAlignments(
+    vector<bool>& keepAlignment,
+    size_t threadCount)
 {
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    SHASTA_ASSERT(keepAlignment.size() == alignmentData.size());
+    createReadGraphData.keepAlignment = &keepAlignment;
 
+    // Count the alignments to be kept in each block.
+    performanceLog << timestamp << "Creating read graph edges." << endl;
+    const uint64_t blockSize = CreateReadGraphData::blockSize;
+    const uint64_t blockCount = (alignmentData.size() + blockSize - 1) / blockSize;
+    vector<uint64_t>& blockEdgeBegin = createReadGraphData.blockEdgeBegin;
+    blockEdgeBegin.clear();
+    blockEdgeBegin.resize(blockCount + 1, 0);
+    setupLoadBalancing(blockCount, 1);
+    runThreads(&Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction1, threadCount);
+
+    // Prefix sum to find where the edges of each block begin.
+    // Each kept alignment generates two edges.
+    for(uint64_t block=0; block<blockCount; block++) {
+        blockEdgeBegin[block + 1] += blockEdgeBegin[block];
+    }
 
     // Now we can create the read graph.
     // Only the alignments we marked as "keep" generate edges in the read graph.
-    readGraph.edges.createNew(largeDataName("ReadGraphEdges"), largeDataPageSize);
-    for(size_t alignmentId=0; alignmentId<alignmentData.size(); alignmentId++) {
-
-        // Record whether this alignment is used in the read graph.
-        const bool keepThisAlignment = keepAlignment[alignmentId];
-        AlignmentData& alignment = alignmentData[alignmentId];
-        alignment.info.isInReadGraph = uint8_t(keepThisAlignment);
-
-        // If this alignment is not used in the read graph, we are done.
-        if(not keepThisAlignment) {
-            continue;
-        }
-
-        // Create the edge corresponding to this alignment.
-        ReadGraphEdge edge;
-        edge.alignmentId = alignmentId & 0x3fff'ffff'ffff'ffff;
-        edge.crossesStrands = 0;
-        edge.hasInconsistentAlignment = 0;
-        edge.orientedReadIds[0] = OrientedReadId(alignment.readIds[0], 0);
-        edge.orientedReadIds[1] = OrientedReadId(alignment.readIds[1], alignment.isSameStrand ? 0 : 1);
-        SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
-        readGraph.edges.push_back(edge);
-
-        // Also create the reverse complemented edge.
-        edge.orientedReadIds[0].flipStrand();
-        edge.orientedReadIds[1].flipStrand();
-        SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
-        readGraph.edges.push_back(edge);
-    }
+    createNew(readGraph.edges, "ReadGraphEdges");
+    readGraph.edges.resize(blockEdgeBegin.back());
+    setupLoadBalancing(blockCount, 1);
+    runThreads(&Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction2, threadCount);
+    createReadGraphData.keepAlignment = 0;
+    blockEdgeBegin.clear();
+    blockEdgeBegin.shrink_to_fit();
 
     // Release unused allocated memory
     readGraph.unreserve();
 
     // Create read graph connectivity.
-    readGraph.connectivity.createNew(largeDataName("ReadGraphConnectivity"), largeDataPageSize);
+    performanceLog << timestamp << "Creating read graph connectivity." << endl;
+    createNew(readGraph.connectivity, "ReadGraphConnectivity");
     readGraph.connectivity.beginPass1(2 * reads->readCount());
-    for(const ReadGraphEdge& edge: readGraph.edges) {
-        readGraph.connectivity.incrementCount(edge.orientedReadIds[0].getValue());
-        readGraph.connectivity.incrementCount(edge.orientedReadIds[1].getValue());
-    }
+    setupLoadBalancing(readGraph.edges.size(), 100000);
+    runThreads(&Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction3, threadCount);
     readGraph.connectivity.beginPass2();
-    for(size_t i=0; i<readGraph.edges.size(); i++) {
-        const ReadGraphEdge& edge = readGraph.edges[i];
-        readGraph.connectivity.store(edge.orientedReadIds[0].getValue(), uint32_t(i));
-        readGraph.connectivity.store(edge.orientedReadIds[1].getValue(), uint32_t(i));
-    }
+    setupLoadBalancing(readGraph.edges.size(), 100000);
+    runThreads(&Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction4, threadCount);
     readGraph.connectivity.endPass2();
+    setupLoadBalancing(readGraph.connectivity.size(), 10000);
+    runThreads(&Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction5, threadCount);
+    performanceLog << timestamp << "Read graph connectivity created." << endl;
 
     // Count the number of isolated reads and their bases.
     uint64_t isolatedReadCount = 0;
@@ -177,6 +230,124 @@ void Assembler::createReadGraphUsingSelectedAlignments(vector<bool>& keepAlignme
 
 
 
+// Record in each alignment whether it is used in the read graph,
+// and count the read graph edges generated by each block of alignments.
+void Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction1(size_t threadId)
+{
+    const vector<bool>& keepAlignment = *createReadGraphData.keepAlignment;
+    const uint64_t blockSize = CreateReadGraphData::blockSize;
+    vector<uint64_t>& blockEdgeBegin = createReadGraphData.blockEdgeBegin;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t block=begin; block!=end; ++block) {
+            const uint64_t alignmentIdBegin = block * blockSize;
+            const uint64_t alignmentIdEnd = min(alignmentIdBegin + blockSize, uint64_t(alignmentData.size()));
+            uint64_t edgeCount = 0;
+            for(uint64_t alignmentId=alignmentIdBegin; alignmentId!=alignmentIdEnd; ++alignmentId) {
+                const bool keepThisAlignment = keepAlignment[alignmentId];
+                alignmentData[alignmentId].info.isInReadGraph = uint8_t(keepThisAlignment);
+                if(keepThisAlignment) {
+                    edgeCount += 2;
+                }
+            }
+            blockEdgeBegin[block + 1] = edgeCount;
+        }
+    }
+}
+
+
+
+// Create the read graph edges generated by each block of alignments.
+void Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction2(size_t threadId)
+{
+    const vector<bool>& keepAlignment = *createReadGraphData.keepAlignment;
+    const uint64_t blockSize = CreateReadGraphData::blockSize;
+    const vector<uint64_t>& blockEdgeBegin = createReadGraphData.blockEdgeBegin;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t block=begin; block!=end; ++block) {
+            const uint64_t alignmentIdBegin = block * blockSize;
+            const uint64_t alignmentIdEnd = min(alignmentIdBegin + blockSize, uint64_t(alignmentData.size()));
+            ReadGraphEdge* nextEdge = readGraph.edges.begin() + blockEdgeBegin[block];
+
+            for(uint64_t alignmentId=alignmentIdBegin; alignmentId!=alignmentIdEnd; ++alignmentId) {
+
+                // If this alignment is not used in the read graph, we are done.
+                if(not keepAlignment[alignmentId]) {
+                    continue;
+                }
+                const AlignmentData& alignment = alignmentData[alignmentId];
+
+                // Create the edge corresponding to this alignment.
+                ReadGraphEdge edge;
+                edge.alignmentId = alignmentId & 0x3fff'ffff'ffff'ffff;
+                edge.crossesStrands = 0;
+                edge.hasInconsistentAlignment = 0;
+                edge.orientedReadIds[0] = OrientedReadId(alignment.readIds[0], 0);
+                edge.orientedReadIds[1] = OrientedReadId(alignment.readIds[1], alignment.isSameStrand ? 0 : 1);
+                SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
+                *nextEdge++ = edge;
+
+                // Also create the reverse complemented edge.
+                edge.orientedReadIds[0].flipStrand();
+                edge.orientedReadIds[1].flipStrand();
+                SHASTA_ASSERT(edge.orientedReadIds[0] < edge.orientedReadIds[1]);
+                *nextEdge++ = edge;
+            }
+            SHASTA_ASSERT(nextEdge == readGraph.edges.begin() + blockEdgeBegin[block + 1]);
+        }
+    }
+}
+
+
+
+// Pass 1 of read graph connectivity creation.
+void Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction3(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const ReadGraphEdge& edge = readGraph.edges[i];
+            readGraph.connectivity.incrementCountMultithreaded(edge.orientedReadIds[0].getValue());
+            readGraph.connectivity.incrementCountMultithreaded(edge.orientedReadIds[1].getValue());
+        }
+    }
+}
+
+
+
+// Pass 2 of read graph connectivity creation.
+void Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction4(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const ReadGraphEdge& edge = readGraph.edges[i];
+            readGraph.connectivity.storeMultithreaded(edge.orientedReadIds[0].getValue(), uint32_t(i));
+            readGraph.connectivity.storeMultithreaded(edge.orientedReadIds[1].getValue(), uint32_t(i));
+        }
+    }
+}
+
+
+
+// Sort the connectivity of each oriented read by decreasing edge id.
+// This is the order generated by the sequential version of pass 2.
+void Assembler::createReadGraphUsingSelectedAlignmentsThreadFunction5(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            const auto v = readGraph.connectivity[uint32_t(i)];
+            sort(v.begin(), v.end(), std::greater<uint32_t>());
+        }
+    }
+}
+
+
+
 void Assembler::accessReadGraph()
 {
     readGraph.edges.accessExistingReadOnly(largeDataName("ReadGraphEdges"));
@@ -189,6 +360,9 @@ void Assembler::accessReadGraphReadWrite()
 }
 void Assembler::checkReadGraphIsOpen() const
 {
+    if(!readGraph.edges.isOpen || !readGraph.connectivity.isOpen()) {
+        accessLazy("ReadGraphEdges");
+    }
     if(!readGraph.edges.isOpen) {
         throw runtime_error("Read graph edges are not accessible.");
     }
@@ -380,10 +554,13 @@ void Assembler::flagChimericReads(size_t maxDistance, size_t threadCount)
     }
 
     // Multithreaded loop over all reads.
+    const auto tBegin = steady_clock::now();
     setupLoadBalancing(readCount, 10000);
     runThreads(&Assembler::flagChimericReadsThreadFunction, threadCount);
+    const double t = seconds(steady_clock::now() - tBegin);
 
-    performanceLog << timestamp << "Done flagging chimeric reads." << endl;
+    performanceLog << timestamp << "Done flagging chimeric reads. "
+        "The read graph searches took " << t << " s." << endl;
 
     size_t chimericReadCount = 0;
     for(ReadId readId=0; readId!=readCount; readId++) {
@@ -403,27 +580,11 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 {
     const size_t maxDistance = flagChimericReadsData.maxDistance;
 
-    // Vector used for BFS searches by this thread.
-    // It stores the local vertex id in the current BFS assigned to each vertex,
-    // or notReached for vertices not yet reached by the current BFS.
-    // Indexed by orientedRead.getValue().
-    // This is of size equal to the number of oriented reads, and each thread has its own copy.
-    // This is not prohibitive. For example, for a large human size run with
-    // 20 million reads and 100 threads, the total space is only 16 GB.
-    MemoryMapped::Vector<uint32_t> vertexTable;
-    vertexTable.createNew(
-        largeDataName("tmp-FlagChimericReads-VertexTable" + to_string(threadId)),
-        largeDataPageSize);
-    vertexTable.resize(readGraph.connectivity.size());
-    const uint32_t notReached = std::numeric_limits<uint32_t>::max();
-    fill(vertexTable.begin(), vertexTable.end(), notReached);
-
-    // Vector to contain the vertices we found in the current BFS,
-    // each with the distance from the start vertex.
-    vector< pair<OrientedReadId, uint32_t> > localVertices;
-
-    // The queue used for the BFS.
-    std::queue<OrientedReadId> q;
+    // The BFS engine used by this thread. It skips cross-strand edges.
+    ReadGraphBfs bfs(readGraph, true);
+    const vector<OrientedReadId>& localVertices = bfs.vertices;
+    const vector<uint32_t>& localDistances = bfs.distances;
+    const uint32_t notReached = ReadGraphBfs::notReached;
 
     // Vectors used to compute connected components after each BFS.
     vector<uint32_t> rank;
@@ -437,59 +598,12 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
         // Loop over all reads assigned to this batch.
         for(ReadId startReadId=ReadId(begin); startReadId!=ReadId(end); startReadId++) {
 
-            // Check that there is no garbage left by the previous BFS.
-            SHASTA_ASSERT(localVertices.empty());
-            SHASTA_ASSERT(q.empty());
-
             // Begin by flagging this read as not chimeric.
             reads->setChimericFlag(startReadId, false);
 
-
-
             // Do the BFS for this read and strand 0.
             const OrientedReadId startOrientedReadId(startReadId, 0);
-            uint32_t localVertexId = 0;
-            q.push(startOrientedReadId);
-            localVertices.push_back(make_pair(startOrientedReadId, 0));
-            vertexTable[startOrientedReadId.getValue()] = localVertexId++;
-            while(!q.empty()) {
-
-                // Dequeue a vertex.
-                const OrientedReadId v0 = q.front();
-                q.pop();
-                const uint32_t distance0 = localVertices[vertexTable[v0.getValue()]].second;
-                const uint32_t distance1 = distance0 + 1;
-                // out << "Dequeued " << v0 << endl;
-
-                // Loop over edges involving this vertex.
-                const auto edgeIds = readGraph.connectivity[v0.getValue()];
-                for(const uint32_t edgeId: edgeIds) {
-                    const ReadGraphEdge& edge = readGraph.edges[edgeId];
-                    if(edge.crossesStrands) {
-                        continue;
-                    }
-                    const OrientedReadId v1 = edge.getOther(v0);
-                    // out << "Found " << v1 << endl;
-
-                    // If we already encountered this read in this BFS, do nothing.
-                    if(vertexTable[v1.getValue()] != notReached) {
-                        // out << "Previously reached." << endl;
-                        continue;
-                    }
-
-                    // Record this vertex.
-                    // out << "Recording " << v1 << endl;
-                    localVertices.push_back(make_pair(v1, distance1));
-                    vertexTable[v1.getValue()] = localVertexId++;
-
-                    // If at distance less than maxDistance, also enqueue it.
-                    if(distance1 < maxDistance) {
-                        // out << "Enqueueing " << v1 << endl;
-                        q.push(v1);
-                    }
-                }
-            }
-            // out << "BFS found " << localVertices.size() << " vertices." << endl;
+            bfs.run(startOrientedReadId, maxDistance);
 
 
 
@@ -508,13 +622,11 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 
             // Loop over all edges involving the vertices we found during the BFS,
             // but disregarding vertices involving vStart or its reverse complement.
-            for(const auto& p: localVertices) {
-                const OrientedReadId v0 = p.first;
+            for(uint32_t u0=0; u0<n; u0++) {
+                const OrientedReadId v0 = localVertices[u0];
                 if(v0.getReadId() == startOrientedReadId.getReadId()) {
                     continue;   // Skip edges involving vStart or its reverse complement.
                 }
-                const uint32_t u0 = vertexTable[v0.getValue()];
-                SHASTA_ASSERT(u0 != notReached);
                 const auto edges = readGraph.connectivity[v0.getValue()];
                 for(const uint32_t edgeId: edges) {
                     const ReadGraphEdge& edge = readGraph.edges[edgeId];
@@ -525,7 +637,7 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
                     if(v1.getReadId() == startOrientedReadId.getReadId()) {
                         continue;   // Skip edges involving startOrientedReadId.
                     }
-                    const uint32_t u1 = vertexTable[v1.getValue()];
+                    const uint32_t u1 = bfs.getLocalIndex(v1);
                     if(u1 != notReached) {
                         disjointSets.union_set(u0, u1);
                     }
@@ -538,17 +650,15 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
             // removing vStart affects the large scale connectivity of the
             // read graph, and therefore we flag vStart as chimeric.
             uint32_t component = std::numeric_limits<uint32_t>::max();
-            for(const auto& p: localVertices) {
-                if(p.second != maxDistance) {
+            for(uint32_t u=0; u<n; u++) {
+                if(localDistances[u] != maxDistance) {
                     continue;
                 }
-                const OrientedReadId v = p.first;
+                const OrientedReadId v = localVertices[u];
                 if(v.getReadId() == startOrientedReadId.getReadId()) {
                     // Skip the reverse complement of the start vertex.
                     continue;
                 }
-                const uint32_t u = vertexTable[v.getValue()];
-                SHASTA_ASSERT(u != notReached);
                 const uint32_t uComponent = disjointSets.find_set(u);
                 if(component == std::numeric_limits<ReadId>::max()) {
                     component = uComponent;
@@ -564,22 +674,8 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
                     }
                 }
             }
-
-
-            // Before processing the next read, we need to reset
-            // all entries of the distance vector to notReached,
-            // then clear the verticesFound vector.
-            for(const auto& p: localVertices) {
-                const OrientedReadId orientedReadId = p.first;
-                vertexTable[orientedReadId.getValue()] = notReached;
-            }
-            localVertices.clear();
         }
     }
-
-    // Remove our work vector.
-    vertexTable.remove();
-
 }
 
 
@@ -587,7 +683,7 @@ void Assembler::flagChimericReadsThreadFunction(size_t threadId)
 // Compute connected components of the read graph.
 // This just writes a csv file and has no other side effects
 // (nothing is stored).
-void Assembler::computeReadGraphConnectedComponents() const
+void Assembler::computeReadGraphConnectedComponents(size_t threadCount)
 {
     // Check that we have what we need.
     reads->checkReadFlagsAreOpen();
@@ -597,72 +693,80 @@ void Assembler::computeReadGraphConnectedComponents() const
     SHASTA_ASSERT(readGraph.connectivity.size() == orientedReadCount);
     checkAlignmentDataAreOpen();
 
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    ComputeReadGraphConnectedComponentsData& data = computeReadGraphConnectedComponentsData;
+
 
 
     // Compute connected components of the read graph,
     // treating chimeric reads as isolated and ignoring
     // edges flagged as crossesStrands or hasInconsistentAlignment.
-    vector<ReadId> rank(orientedReadCount);
-    vector<ReadId> parent(orientedReadCount);
-    boost::disjoint_sets<ReadId*, ReadId*> disjointSets(&rank[0], &parent[0]);
+    // This uses the lock-free DisjointSets data structure,
+    // so all edges can be processed in parallel.
     performanceLog << timestamp << "Computing connected components of the read graph." << endl;
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            disjointSets.make_set(OrientedReadId(readId, strand).getValue());
-        }
-    }
-    for(const ReadGraphEdge& edge: readGraph.edges) {
-        if(edge.crossesStrands) {
-            continue;
-        }
-        if(edge.hasInconsistentAlignment) {
-            continue;
-        }
-        const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
-        const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
-        const ReadId readId0 = orientedReadId0.getReadId();
-        const ReadId readId1 = orientedReadId1.getReadId();
-        if(reads->getFlags(readId0).isChimeric) {
-            continue;
-        }
-        if(reads->getFlags(readId1).isChimeric) {
-            continue;
+    vector<DisjointSets::Aint> disjointSetTable(orientedReadCount);
+    data.disjointSetsPointer = std::make_shared<DisjointSets>(
+        disjointSetTable.data(), orientedReadCount);
+    const size_t batchSize = 10000;
+    setupLoadBalancing(readGraph.edges.size(), batchSize);
+    runThreads(&Assembler::computeReadGraphConnectedComponentsThreadFunction1, threadCount);
+
+    // Find the set representative of each oriented read.
+    // Once all the unions are done, find always returns the correct
+    // representative, so there is no need to iterate to convergence.
+    data.component.resize(orientedReadCount);
+    setupLoadBalancing(orientedReadCount, batchSize);
+    runThreads(&Assembler::computeReadGraphConnectedComponentsThreadFunction2, threadCount);
+    data.disjointSetsPointer = 0;
+    disjointSetTable.clear();
+    disjointSetTable.shrink_to_fit();
+
+
+
+    // Gather what we need for each component: its size,
+    // and its first two oriented reads in OrientedReadId order.
+    // Because we loop over oriented reads in order,
+    // the first oriented read found in each component
+    // is the one with the lowest id.
+    const ReadId notFound = std::numeric_limits<ReadId>::max();
+    vector<ReadId> componentSize(orientedReadCount, 0);
+    vector< array<ReadId, 2> > componentFront(orientedReadCount, {notFound, notFound});
+    for(ReadId i=0; i<orientedReadCount; i++) {
+        const ReadId componentId = data.component[i];
+        const ReadId n = componentSize[componentId]++;
+        if(n < 2) {
+            componentFront[componentId][n] = i;
         }
-        disjointSets.union_set(orientedReadId0.getValue(), orientedReadId1.getValue());
     }
+    data.component.clear();
+    data.component.shrink_to_fit();
 
 
 
-    // Gather the vertices of each component.
-    std::map<ReadId, vector<OrientedReadId> > componentMap;
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const ReadId componentId = disjointSets.find_set(orientedReadId.getValue());
-            componentMap[componentId].push_back(orientedReadId);
+    // Sort the components by decreasing size (number of reads).
+    // componentTable contains pairs(size, set representative).
+    // Ties are broken using the lowest oriented read id in each component,
+    // so the order does not depend on the order in which unions were done.
+    vector< pair<size_t, ReadId> > componentTable;
+    for(ReadId componentId=0; componentId<orientedReadCount; componentId++) {
+        const ReadId n = componentSize[componentId];
+        if(n > 0) {
+            componentTable.push_back(make_pair(n, componentId));
         }
     }
-    cout << "The read graph has " << componentMap.size() <<
+    cout << "The read graph has " << componentTable.size() <<
         " connected components." << endl;
-
-
-
-    // Sort the components by decreasing size (number of reads).
-    // componentTable contains pairs(size, componentId as key in componentMap).
-    vector< pair<size_t, uint32_t> > componentTable;
-    for(const auto& p: componentMap) {
-        const vector<OrientedReadId>& component = p.second;
-        componentTable.push_back(make_pair(component.size(), p.first));
-    }
-    sort(componentTable.begin(), componentTable.end(), std::greater<pair<size_t, uint32_t>>());
-
-
-
-    // Store components in this order of decreasing size.
-    vector< vector<OrientedReadId> > components;
-    for(const auto& p: componentTable) {
-        components.push_back(componentMap[p.second]);
-    }
+    sort(componentTable.begin(), componentTable.end(),
+        [&componentFront](const pair<size_t, ReadId>& x, const pair<size_t, ReadId>& y)
+        {
+            if(x.first != y.first) {
+                return x.first > y.first;
+            }
+            return componentFront[x.second][0] < componentFront[y.second][0];
+        });
     performanceLog << timestamp << "Done computing connected components of the read graph." << endl;
 
 
@@ -673,28 +777,30 @@ void Assembler::computeReadGraphConnectedComponents() const
         "AccumulatedOrientedReadCount,"
         "AccumulatedOrientedReadCountFraction\n";
     size_t accumulatedOrientedReadCount = 0;
-    for(ReadId componentId=0; componentId<components.size(); componentId++) {
-        const vector<OrientedReadId>& component = components[componentId];
+    for(ReadId componentId=0; componentId<componentTable.size(); componentId++) {
+        const size_t componentSize = componentTable[componentId].first;
+        const array<ReadId, 2>& front = componentFront[componentTable[componentId].second];
 
         // Stop writing when we reach connected components
         // consisting of a single isolated read.
-        if(component.size() == 1) {
+        if(componentSize == 1) {
             break;
         }
 
-        accumulatedOrientedReadCount += component.size();
+        accumulatedOrientedReadCount += componentSize;
         const double accumulatedOrientedReadCountFraction =
             double(accumulatedOrientedReadCount)/double(orientedReadCount);
 
+        const OrientedReadId orientedReadId0 = OrientedReadId::fromValue(front[0]);
+        const OrientedReadId orientedReadId1 = OrientedReadId::fromValue(front[1]);
         const bool isSelfComplementary =
-            component.size() > 1 &&
-            (component[0].getReadId() == component[1].getReadId());
+            orientedReadId0.getReadId() == orientedReadId1.getReadId();
 
 
         // Write out.
         csv << componentId << ",";
-        csv << component.front() << ",";
-        csv << component.size() << ",";
+        csv << orientedReadId0 << ",";
+        csv << componentSize << ",";
         csv << (isSelfComplementary ? "Yes" : "No") << ",";
         csv << accumulatedOrientedReadCount << ",";
         csv << accumulatedOrientedReadCountFraction << "\n";
@@ -703,6 +809,50 @@ void Assembler::computeReadGraphConnectedComponents() const
 
 
 
+void Assembler::computeReadGraphConnectedComponentsThreadFunction1(size_t threadId)
+{
+    DisjointSets& disjointSets = *computeReadGraphConnectedComponentsData.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t edgeId=begin; edgeId!=end; edgeId++) {
+            const ReadGraphEdge& edge = readGraph.edges[edgeId];
+            if(edge.crossesStrands) {
+                continue;
+            }
+            if(edge.hasInconsistentAlignment) {
+                continue;
+            }
+            const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
+            const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
+            if(reads->getFlags(orientedReadId0.getReadId()).isChimeric) {
+                continue;
+            }
+            if(reads->getFlags(orientedReadId1.getReadId()).isChimeric) {
+                continue;
+            }
+            disjointSets.unite(orientedReadId0.getValue(), orientedReadId1.getValue());
+        }
+    }
+}
+
+
+
+void Assembler::computeReadGraphConnectedComponentsThreadFunction2(size_t threadId)
+{
+    ComputeReadGraphConnectedComponentsData& data = computeReadGraphConnectedComponentsData;
+    DisjointSets& disjointSets = *data.disjointSetsPointer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            data.component[i] = ReadId(disjointSets.find(i));
+        }
+    }
+}
+
+
+
 // Write a FASTA file containing all reads that appear in
 // the local read graph.
 void Assembler::writeLocalReadGraphReads(
@@ -811,9 +961,12 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
     flagCrossStrandReadGraphEdges1Data.isNearStrandJump.clear();
     flagCrossStrandReadGraphEdges1Data.isNearStrandJump.resize(orientedReadCount, false);
     const size_t batchSize = 10000;
+    const auto tBegin = steady_clock::now();
     setupLoadBalancing(readCount, batchSize);
     runThreads(&Assembler::flagCrossStrandReadGraphEdges1ThreadFunction, threadCount);
     const auto& isNearStrandJump = flagCrossStrandReadGraphEdges1Data.isNearStrandJump;
+    performanceLog << timestamp << "Read graph searches for flagCrossStrandReadGraphEdges took " <<
+        seconds(steady_clock::now() - tBegin) << " s." << endl;
 
 
     size_t nearStrandJumpVertexCount = 0;
@@ -1014,24 +1167,21 @@ void Assembler::flagCrossStrandReadGraphEdges1(int maxDistance, size_t threadCou
 
 void Assembler::flagCrossStrandReadGraphEdges1ThreadFunction(size_t threadId)
 {
-    const size_t readCount = reads->readCount();
     const size_t maxDistance = flagCrossStrandReadGraphEdges1Data.maxDistance;
     auto& isNearStrandJump = flagCrossStrandReadGraphEdges1Data.isNearStrandJump;
-    vector<uint32_t> distance(2*readCount, ReadGraph::infiniteDistance);
-    vector<OrientedReadId> reachedVertices;
-    vector<uint32_t> parentEdges(2*readCount);
-    vector<uint32_t> shortestPath;
-    uint64_t begin, end;
 
+    // The BFS engine used by this thread. It skips cross-strand edges.
+    // We only need to know whether the reverse complement
+    // is reached, so each BFS stops as soon as that happens.
+    ReadGraphBfs bfs(readGraph, true);
+
+    uint64_t begin, end;
     while(getNextBatch(begin, end)) {
 
         for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
             const OrientedReadId orientedReadId0(readId, 0);
             const OrientedReadId orientedReadId1(readId, 1);
-            readGraph.computeShortPath(orientedReadId0, orientedReadId1,
-                maxDistance, shortestPath,
-                distance, reachedVertices, parentEdges);
-            if(!shortestPath.empty()) {
+            if(bfs.run(orientedReadId0, maxDistance, orientedReadId1)) {
                 isNearStrandJump[orientedReadId0.getValue()] = true;
                 isNearStrandJump[orientedReadId1.getValue()] = true;
             }
@@ -1048,8 +1198,16 @@ void Assembler::flagCrossStrandReadGraphEdges1ThreadFunction(size_t threadId)
 // In other words, for any ReadId x, the two oriented reads
 // x-0 and x-1 are guaranteed to be in distinct components of the
 // read graph.
-void Assembler::flagCrossStrandReadGraphEdges2()
+void Assembler::flagCrossStrandReadGraphEdges2(size_t threadCount)
 {
+    performanceLog << timestamp << "flagCrossStrandReadGraphEdges2 begins." << endl;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    FlagCrossStrandReadGraphEdges2Data& data = flagCrossStrandReadGraphEdges2Data;
+
     // Each alignment used in the read graph generates a pair of
     // consecutively numbered edges in the read graph
     // which are the reverse complement of each other.
@@ -1107,6 +1265,18 @@ void Assembler::flagCrossStrandReadGraphEdges2()
         edgeTable[alignedMarkerCount].push_back(edgeId);
     }
 
+    // Store the pairs in the order in which they will be processed,
+    // that is, in order of decreasing alignedMarkerCount.
+    data.edgeIds.clear();
+    for(auto it=edgeTable.rbegin(); it!=edgeTable.rend(); ++it) {
+        const vector<uint64_t>& v = *it;
+        copy(v.begin(), v.end(), back_inserter(data.edgeIds));
+    }
+    edgeTable.clear();
+    edgeTable.shrink_to_fit();
+    performanceLog << timestamp << "Found " << data.edgeIds.size() <<
+        " read graph edge pairs to be processed." << endl;
+
 
     // Create and initialize the disjoint sets data structure needed below.
     const size_t readCount = reads->readCount();
@@ -1135,12 +1305,48 @@ void Assembler::flagCrossStrandReadGraphEdges2()
     // so we mark them as cross-strand edges and don't add them to the
     // disjoint set data structure.
     // Otherwise, the two edges are added to the disjoint set data structure.
+    //
+    // Pairs are processed in batches. Because connected components
+    // can only merge, a pair for which a0==b0 or a0==b1 at the beginning
+    // of a batch is guaranteed to still be in that situation when
+    // it is reached in sequential order. So we first classify all pairs
+    // of the batch in parallel, using read-only lookups in the
+    // disjoint sets data structure, and then we process the batch
+    // sequentially, doing disjoint set lookups and updates only for the pairs
+    // that could not be classified. This gives the same results
+    // as processing all pairs sequentially.
+    performanceLog << timestamp << "Strand separation begins." << endl;
+    data.parent = parent.data();
     uint64_t crossStrandEdgeCount = 0;
-    for(auto it=edgeTable.rbegin(); it!=edgeTable.rend(); ++it) {
-        const vector<uint64_t>& v = *it;
-        for(const uint64_t edgeId: v) {
+    uint64_t sequentialPairCount = 0;
+    const uint64_t batchSize = 1000000;
+    for(data.batchBegin=0; data.batchBegin<data.edgeIds.size(); data.batchBegin=data.batchEnd) {
+        data.batchEnd = min(data.batchBegin + batchSize, uint64_t(data.edgeIds.size()));
+
+        // Classify the pairs in this batch in parallel.
+        data.status.resize(data.batchEnd - data.batchBegin);
+        setupLoadBalancing(data.batchEnd - data.batchBegin, 1000);
+        runThreads(&Assembler::flagCrossStrandReadGraphEdges2ThreadFunction, threadCount);
+
+        // Process them sequentially.
+        for(uint64_t i=data.batchBegin; i!=data.batchEnd; i++) {
+            const uint64_t edgeId = data.edgeIds[i];
             ReadGraphEdge& edge = readGraph.edges[edgeId];
             ReadGraphEdge& nextEdge = readGraph.edges[edgeId + 1];
+
+            const uint8_t status = data.status[i - data.batchBegin];
+            if(status == FlagCrossStrandReadGraphEdges2Data::sameComponent) {
+                continue;
+            }
+            if(status == FlagCrossStrandReadGraphEdges2Data::crossStrand) {
+                edge.crossesStrands = 1;
+                nextEdge.crossesStrands = 1;
+                alignmentData[edge.alignmentId].info.isInReadGraph = false;
+                crossStrandEdgeCount += 2;
+                continue;
+            }
+            ++sequentialPairCount;
+
             const OrientedReadId A0 = edge.orientedReadIds[0];
             const OrientedReadId B0 = edge.orientedReadIds[1];
             const OrientedReadId A1 = nextEdge.orientedReadIds[0];
@@ -1189,19 +1395,32 @@ void Assembler::flagCrossStrandReadGraphEdges2()
         }
     }
 
+    data.status.clear();
+    data.status.shrink_to_fit();
+    data.edgeIds.clear();
+    data.edgeIds.shrink_to_fit();
+    performanceLog << timestamp << "Strand separation ends. " << sequentialPairCount <<
+        " read graph edge pairs required sequential processing." << endl;
+
     cout << "Strand separation flagged " << crossStrandEdgeCount <<
         " read graph edges out of " << readGraph.edges.size() << " total." << endl;
 
 
 
+    // Find the connected component of each oriented read, in parallel.
+    data.component.resize(orientedReadCount);
+    setupLoadBalancing(orientedReadCount, 10000);
+    runThreads(&Assembler::flagCrossStrandReadGraphEdges2ThreadFunctionComponents, threadCount);
+    data.parent = 0;
+
     // Verify that for any read the two oriented reads are in distinct
     // connected components.
     for(ReadId readId=0; readId<readCount; readId++) {
         const OrientedReadId orientedReadId0(readId, 0);
         const OrientedReadId orientedReadId1(readId, 1);
         SHASTA_ASSERT(
-            disjointSets.find_set(orientedReadId0.getValue()) !=
-            disjointSets.find_set(orientedReadId1.getValue())
+            data.component[orientedReadId0.getValue()] !=
+            data.component[orientedReadId1.getValue()]
         );
     }
 
@@ -1211,10 +1430,12 @@ void Assembler::flagCrossStrandReadGraphEdges2()
     for(ReadId readId=0; readId<readCount; readId++) {
         for(Strand strand=0; strand<2; strand++) {
             const OrientedReadId orientedReadId(readId, strand);
-            const ReadId componentId = disjointSets.find_set(orientedReadId.getValue());
+            const ReadId componentId = data.component[orientedReadId.getValue()];
             componentMap[componentId].push_back(orientedReadId);
         }
     }
+    data.component.clear();
+    data.component.shrink_to_fit();
     cout << "The read graph has " << componentMap.size() <<
         " connected components." << endl;
 
@@ -1302,6 +1523,69 @@ void Assembler::flagCrossStrandReadGraphEdges2()
     }
     SHASTA_ASSERT(n == readCount);
 
+    performanceLog << timestamp << "flagCrossStrandReadGraphEdges2 ends." << endl;
+}
+
+
+
+// Find the root of the disjoint set containing oriented read x
+// without modifying the disjoint sets data structure.
+// This is used during the multithreaded portions of
+// flagCrossStrandReadGraphEdges2, while no other
+// thread modifies the disjoint sets data structure.
+ReadId Assembler::FlagCrossStrandReadGraphEdges2Data::findRoot(ReadId x) const
+{
+    while(parent[x] != x) {
+        x = parent[x];
+    }
+    return x;
+}
+
+
+
+// Classify the edge pairs of the current batch.
+void Assembler::flagCrossStrandReadGraphEdges2ThreadFunction(size_t threadId)
+{
+    FlagCrossStrandReadGraphEdges2Data& data = flagCrossStrandReadGraphEdges2Data;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const uint64_t edgeId = data.edgeIds[data.batchBegin + i];
+            const ReadGraphEdge& edge = readGraph.edges[edgeId];
+            const OrientedReadId A0 = edge.orientedReadIds[0];
+            const OrientedReadId B0 = edge.orientedReadIds[1];
+            OrientedReadId B1 = B0;
+            B1.flipStrand();
+
+            const ReadId a0 = data.findRoot(A0.getValue());
+            const ReadId b0 = data.findRoot(B0.getValue());
+            const ReadId b1 = data.findRoot(B1.getValue());
+
+            uint8_t status = FlagCrossStrandReadGraphEdges2Data::unknown;
+            if(a0 == b0) {
+                status = FlagCrossStrandReadGraphEdges2Data::sameComponent;
+            } else if(a0 == b1) {
+                status = FlagCrossStrandReadGraphEdges2Data::crossStrand;
+            }
+            data.status[i] = status;
+        }
+    }
+}
+
+
+
+// Find the connected component of each oriented read.
+void Assembler::flagCrossStrandReadGraphEdges2ThreadFunctionComponents(size_t threadId)
+{
+    FlagCrossStrandReadGraphEdges2Data& data = flagCrossStrandReadGraphEdges2Data;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            data.component[i] = data.findRoot(ReadId(i));
+        }
+    }
 }
 
 
@@ -1325,7 +1609,10 @@ void Assembler::removeReadGraphBridges(uint64_t maxDistance)
         " alignments out of " << alignmentData.size() << endl;
 
     // Unflag alignments corresponding to read graph bridges.
+    const auto tBegin = steady_clock::now();
     readGraph.findBridges(keepAlignment, maxDistance);
+    performanceLog << timestamp << "Finding read graph bridges took " <<
+        seconds(steady_clock::now() - tBegin) << " s." << endl;
 
     // Recreate the read graph using the surviving alignments.
     readGraph.edges.remove();
@@ -1438,42 +1725,75 @@ void Assembler::readGraphClustering()
 
 
 // This version runs the clustering many times.
-void Assembler::readGraphClustering()
+// Each run does label propagation in parallel, directly on the read graph.
+// ReadGraph::clustering updates one randomly chosen vertex at a time,
+// which cannot be done in parallel. Here, each sweep
+// updates about half of the vertices, chosen by hashing
+// the run, the sweep, and the vertex, and all these updates
+// use the clusters from the previous sweep. Ties between equally
+// frequent neighbor clusters are broken in favor of the lowest cluster id,
+// as in ReadGraph::clustering. As a result, the results
+// do not depend on the number of threads or on the order in which
+// vertices are processed. They are not the same as those
+// obtained with ReadGraph::clustering.
+void Assembler::readGraphClustering(size_t threadCount)
 {
     SHASTA_ASSERT(readGraph.edges.isOpen);
     SHASTA_ASSERT(readGraph.connectivity.isOpen());
 
-    const uint32_t seed = 231;
-    std::mt19937 randomSource(seed);
-
-    vector<ReadId> cluster;
-    const bool debug = false;
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    ReadGraphClusteringData& data = readGraphClusteringData;
+    data.seed = 231;
 
     // Vector to count, for each edge, how many times
     // the two vertices belong to the same cluster.
-    vector<uint64_t> isSameClusterEdge(readGraph.edges.size(), 0);
+    const uint64_t edgeCount = readGraph.edges.size();
+    data.isSameClusterEdge.clear();
+    data.isSameClusterEdge.resize(edgeCount, 0);
+    const vector<uint64_t>& isSameClusterEdge = data.isSameClusterEdge;
 
     // Do the clustering many times.
+    // Each sweep updates about half of the vertices, so each vertex
+    // is updated about 100 times in each run, as in ReadGraph::clustering.
     const uint64_t iterationCount = 1000;
-    for(uint64_t iteration=0; iteration<iterationCount; iteration++) {
-        readGraph.clustering(randomSource, cluster, debug);
+    const uint64_t sweepCount = 200;
+    const ReadId vertexCount = ReadId(readGraph.connectivity.size());
+    const uint64_t batchSize = 10000;
+    performanceLog << timestamp << "Read graph clustering begins." << endl;
+    const auto tBegin = steady_clock::now();
+    for(data.run=0; data.run<iterationCount; data.run++) {
+
+        // Initialize each vertex to its own cluster.
+        data.cluster.resize(vertexCount);
+        data.newCluster.resize(vertexCount);
+        for(ReadId i=0; i<vertexCount; i++) {
+            data.cluster[i] = i;
+        }
 
-        // Increment isSameClusterEdge counters for each edge.
-        for(uint64_t edgeId=0; edgeId<readGraph.edges.size(); edgeId++) {
-            const ReadGraphEdge& edge = readGraph.edges[edgeId];
-            const OrientedReadId orientedReadId0 = edge.orientedReadIds[0];
-            const OrientedReadId orientedReadId1 = edge.orientedReadIds[1];
-            const ReadId cluster0 = cluster[orientedReadId0.getValue()];
-            const ReadId cluster1 = cluster[orientedReadId1.getValue()];
-            if(cluster0 == cluster1) {
-                ++isSameClusterEdge[edgeId];
-            }
+        // Label propagation.
+        for(data.sweep=0; data.sweep<sweepCount; data.sweep++) {
+            setupLoadBalancing(vertexCount, batchSize);
+            runThreads(&Assembler::readGraphClusteringThreadFunction1, threadCount);
+            data.cluster.swap(data.newCluster);
         }
+
+        // Increment isSameClusterEdge counters for each edge.
+        setupLoadBalancing(edgeCount, batchSize);
+        runThreads(&Assembler::readGraphClusteringThreadFunction2, threadCount);
     }
+    data.cluster.clear();
+    data.cluster.shrink_to_fit();
+    data.newCluster.clear();
+    data.newCluster.shrink_to_fit();
+    performanceLog << timestamp << "Read graph clustering ends. "
+        "Clustering took " << seconds(steady_clock::now() - tBegin) << " s." << endl;
 
 
     // Histogram isSameClusterEdge.
-    vector<uint64_t> histogram(iterationCount, 0);
+    vector<uint64_t> histogram(iterationCount + 1, 0);
     for(uint64_t edgeId=0; edgeId<readGraph.edges.size(); edgeId++) {
         histogram[isSameClusterEdge[edgeId]]++;
     }
@@ -1489,7 +1809,6 @@ void Assembler::readGraphClustering()
     ofstream graphOut("ReadGraph.dot");
     graphOut << "graph ReadGraph {\n"
         "tooltip=\" \"";
-    const ReadId vertexCount = ReadId(readGraph.connectivity.size());
     for(ReadId vertexId=0; vertexId<vertexCount; vertexId++) {
         const OrientedReadId orientedReadId = OrientedReadId::fromValue(vertexId);
         graphOut << "\"" << orientedReadId << "\"[" <<
@@ -1519,6 +1838,83 @@ void Assembler::readGraphClustering()
 
 
 
+// One label propagation sweep of readGraphClustering.
+// Reads data.cluster and writes data.newCluster.
+void Assembler::readGraphClusteringThreadFunction1(size_t threadId)
+{
+    ReadGraphClusteringData& data = readGraphClusteringData;
+    const vector<ReadId>& cluster = data.cluster;
+    vector<ReadId>& newCluster = data.newCluster;
+
+    vector<ReadId> neighborLabels;
+    vector<ReadId> labelFrequencies;
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId vertexId0=ReadId(begin); vertexId0!=ReadId(end); vertexId0++) {
+
+            // Decide if this vertex is updated in this sweep.
+            const array<uint64_t, 3> hashInput = {data.run, data.sweep, vertexId0};
+            const bool update =
+                (MurmurHash64A(&hashInput, sizeof(hashInput), data.seed) & 1) == 0;
+            if(not update) {
+                newCluster[vertexId0] = cluster[vertexId0];
+                continue;
+            }
+
+            // Get the clusters of its neighbors.
+            const OrientedReadId orientedReadId0 = OrientedReadId::fromValue(vertexId0);
+            neighborLabels.clear();
+            for(const uint32_t edgeId: readGraph.connectivity[vertexId0]) {
+                const ReadGraphEdge& edge = readGraph.edges[edgeId];
+                const OrientedReadId orientedReadId1 = edge.getOther(orientedReadId0);
+                neighborLabels.push_back(cluster[orientedReadId1.getValue()]);
+            }
+            if(neighborLabels.empty()) {
+                newCluster[vertexId0] = cluster[vertexId0];
+                continue;
+            }
+
+            // Count the occurrences of each label.
+            // They are sorted, so for ties the lowest label wins.
+            deduplicateAndCount(neighborLabels, labelFrequencies);
+
+            // Assign to this vertex the most frequent cluster in its neighbors.
+            ReadId bestLabel = neighborLabels.front();
+            ReadId bestLabelFrequency = labelFrequencies.front();
+            for(uint64_t i=1; i<neighborLabels.size(); i++) {
+                if(labelFrequencies[i] > bestLabelFrequency) {
+                    bestLabel = neighborLabels[i];
+                    bestLabelFrequency = labelFrequencies[i];
+                }
+            }
+            newCluster[vertexId0] = bestLabel;
+        }
+    }
+}
+
+
+
+// Increment isSameClusterEdge counters for each edge
+// at the end of a run of readGraphClustering.
+void Assembler::readGraphClusteringThreadFunction2(size_t threadId)
+{
+    ReadGraphClusteringData& data = readGraphClusteringData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t edgeId=begin; edgeId!=end; edgeId++) {
+            const ReadGraphEdge& edge = readGraph.edges[edgeId];
+            const ReadId cluster0 = data.cluster[edge.orientedReadIds[0].getValue()];
+            const ReadId cluster1 = data.cluster[edge.orientedReadIds[1].getValue()];
+            if(cluster0 == cluster1) {
+                ++data.isSameClusterEdge[edgeId];
+            }
+        }
+    }
+}
+
+
+
 // Singular value decomposition analysis of the local read graph.
 
 // Call x the vector of estimated center positions for the oriented reads
@@ -1636,11 +2032,15 @@ void Assembler::leastSquareAnalysis(
 
 
     // Compute the SVD.
-    const string JOBU = "A";
+    // We only need the first min(M, N) columns of U,
+    // so we don't compute the full M by M matrix.
+    // This matters because M is usually much larger than N.
+    const string JOBU = "S";
     const string JOBVT = "A";
     const int LDA = M;
-    S.resize(min(M, N));
-    vector<double> U(M*M);
+    const int K = min(M, N);
+    S.resize(K);
+    vector<double> U(M*K);
     const int LDU = M;
     vector<double> VT(N*N);
     const int LDVT = N;
@@ -1674,10 +2074,10 @@ void Assembler::leastSquareAnalysis(
 
     // Compute BB = UT * B, the right hand side in the space transformed
     // according to the SVD.
-    vector<double> BB(M, 0.);
+    vector<double> BB(K, 0.);
     const string TRANS = "T";
     dgemv_(
-        TRANS.data(), M, M,
+        TRANS.data(), M, K,
         1.,
         &U[0], M,
         &B[0], 1,
@@ -1687,7 +2087,7 @@ void Assembler::leastSquareAnalysis(
     // Solve for XX = VT * X, the solution vector in the space transformed
     // according to the SVD. In this space, the solution is trivial.
     vector<double> XX(N, 0.);
-    for(int i=0; i<N-1; i++) {
+    for(int i=0; i<min(N-1, K); i++) {
         const double sv = S[i];
         SHASTA_ASSERT(sv >= 0.);
         if(sv > svThreshold) {
@@ -1846,21 +2246,58 @@ void Assembler::flagInconsistentAlignments(
 
     // Compute the alignment offset for each edge of the read graph,
     // oriented with the lowest OrientedReadId first.
-    flagInconsistentAlignmentsData.edgeOffset.createNew(
-        largeDataName("tmp-FlagInconsistentAlignmentsDataOffset"), largeDataPageSize);
+    createNew(flagInconsistentAlignmentsData.edgeOffset, "tmp-FlagInconsistentAlignmentsDataOffset");
     flagInconsistentAlignmentsData.edgeOffset.resize(readGraph.edges.size());
     setupLoadBalancing(readGraph.edges.size(), 1000);
     runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction1, threadCount);
 
+
+
+    // Create the triangle index.
+    // See FlagInconsistentAlignmentsData for details.
+    performanceLog << timestamp << "Creating the triangle index." << endl;
+    const auto t0 = steady_clock::now();
+    const uint64_t orientedReadCount = readGraph.connectivity.size();
+    FlagInconsistentAlignmentsData& data = flagInconsistentAlignmentsData;
+
+    // Compute the degree of each vertex.
+    createNew(data.degree, "tmp-FlagInconsistentAlignmentsDegree");
+    data.degree.resize(orientedReadCount);
+    setupLoadBalancing(orientedReadCount, 1000);
+    runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction11, threadCount);
+
+    // Fill in the triangle index. Each list is only
+    // accessed by one thread, so we don't need atomics.
+    createNew(data.triangleIndex, "tmp-FlagInconsistentAlignmentsTriangleIndex");
+    data.triangleIndex.beginPass1(orientedReadCount);
+    setupLoadBalancing(orientedReadCount, 1000);
+    runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction12, threadCount);
+    data.triangleIndex.beginPass2();
+    setupLoadBalancing(orientedReadCount, 1000);
+    runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction13, threadCount);
+    data.triangleIndex.endPass2();
+    data.degree.remove();
+    const auto t1 = steady_clock::now();
+    performanceLog << timestamp << "Creating the triangle index took " << seconds(t1 - t0) <<
+        " s. The triangle index has " << data.triangleIndex.totalSize() << " entries." << endl;
+
+
+
     // Loop over triangles in the read graph.
-    flagInconsistentAlignmentsData.threadEdgeIds.clear();
-    flagInconsistentAlignmentsData.threadEdgeIds.resize(threadCount);
-    const uint64_t readCount = readGraph.connectivity.size() / 2;
-    setupLoadBalancing(readCount, 100);
+    data.threadEdgeIds.clear();
+    data.threadEdgeIds.resize(threadCount);
+    data.triangleCount = 0;
+    data.inconsistentTriangleCount = 0;
+    setupLoadBalancing(orientedReadCount, 100);
     runThreads(&Assembler::flagInconsistentAlignmentsThreadFunction2, threadCount);
+    const auto t2 = steady_clock::now();
+    performanceLog << timestamp << "Triangle and least square analysis took " << seconds(t2 - t1) <<
+        " s. Found " << data.triangleCount << " triangles, of which " <<
+        data.inconsistentTriangleCount << " were analyzed further." << endl;
 
-    // We no longer need the offsets.
-    flagInconsistentAlignmentsData.edgeOffset.remove();
+    // We no longer need the offsets and the triangle index.
+    data.edgeOffset.remove();
+    data.triangleIndex.remove();
 
     // Gather the inconsistent edge ids found by all threads.
     vector<uint64_t> edgeIds;
@@ -1915,15 +2352,117 @@ void Assembler::flagInconsistentAlignmentsThreadFunction1(size_t threadId)
 
 
 
-// Here we loop over triangles.
-// We only consider triangles with oriented read ids 012 where:
-// - orientedReadId0 is on strand 0.
+// Return true if a read graph edge is used in triangle enumeration.
+// We exclude edges marked as cross-strand edges or as inconsistent
+// and edges involving chimeric reads.
+bool Assembler::flagInconsistentAlignmentsUsesEdge(uint32_t edgeId) const
+{
+    const ReadGraphEdge& edge = readGraph.edges[edgeId];
+    return
+        (not edge.crossesStrands) and
+        (not edge.hasInconsistentAlignment) and
+        (not reads->getFlags(edge.orientedReadIds[0].getReadId()).isChimeric) and
+        (not reads->getFlags(edge.orientedReadIds[1].getReadId()).isChimeric);
+}
+
+
+
+// Return true if w ranks higher than v in the ordering
+// used by the triangle index (by degree, then by OrientedReadId).
+bool Assembler::flagInconsistentAlignmentsRanksHigher(
+    OrientedReadId w,
+    OrientedReadId v) const
+{
+    const auto& degree = flagInconsistentAlignmentsData.degree;
+    const uint32_t degreeV = degree[v.getValue()];
+    const uint32_t degreeW = degree[w.getValue()];
+    return (degreeW > degreeV) or ((degreeW == degreeV) and (v < w));
+}
+
+
+
+// Compute the degree of each vertex, counting only
+// edges used in triangle enumeration.
+void Assembler::flagInconsistentAlignmentsThreadFunction11(size_t threadId)
+{
+    auto& degree = flagInconsistentAlignmentsData.degree;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            uint32_t n = 0;
+            for(const uint32_t edgeId: readGraph.connectivity[uint32_t(i)]) {
+                if(flagInconsistentAlignmentsUsesEdge(edgeId)) {
+                    ++n;
+                }
+            }
+            degree[i] = n;
+        }
+    }
+}
+
+
+
+// Pass 1 of triangle index creation.
+void Assembler::flagInconsistentAlignmentsThreadFunction12(size_t threadId)
+{
+    auto& triangleIndex = flagInconsistentAlignmentsData.triangleIndex;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const OrientedReadId v = OrientedReadId::fromValue(ReadId(i));
+            for(const uint32_t edgeId: readGraph.connectivity[uint32_t(i)]) {
+                if(not flagInconsistentAlignmentsUsesEdge(edgeId)) {
+                    continue;
+                }
+                const OrientedReadId w = readGraph.edges[edgeId].getOther(v);
+                if(flagInconsistentAlignmentsRanksHigher(w, v)) {
+                    triangleIndex.incrementCount(i);
+                }
+            }
+        }
+    }
+}
+
+
+
+// Pass 2 of triangle index creation.
+void Assembler::flagInconsistentAlignmentsThreadFunction13(size_t threadId)
+{
+    auto& triangleIndex = flagInconsistentAlignmentsData.triangleIndex;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const OrientedReadId v = OrientedReadId::fromValue(ReadId(i));
+            for(const uint32_t edgeId: readGraph.connectivity[uint32_t(i)]) {
+                if(not flagInconsistentAlignmentsUsesEdge(edgeId)) {
+                    continue;
+                }
+                const OrientedReadId w = readGraph.edges[edgeId].getOther(v);
+                if(flagInconsistentAlignmentsRanksHigher(w, v)) {
+                    triangleIndex.store(i, make_pair(w, edgeId));
+                }
+            }
+            sort(triangleIndex.begin(i), triangleIndex.end(i));
+        }
+    }
+}
+
+
+
+// Here we loop over triangles, using the triangle index.
+// For each vertex v0, we find triangles in which v0 is the
+// lowest ranking vertex by intersecting the triangle index lists
+// of v0 and of each vertex v1 in its list.
+// This way each triangle is found exactly once.
+// We then only consider triangles with oriented read ids 012 where:
 // - orientedReadId0<orientedReadId1<orientedReadId2.
+// - orientedReadId0 is on strand 0.
 // This way each pair of reverse complemented triangles gets looked at exactly once.
-// This code is written with a triple loop for each start vertex,
-// but could be made faster if necessary.
-// In the triple loop, we exclude vertices corresponding to chimeric reads
-// and edges marked as cross-strand edges.
+// Vertices corresponding to chimeric reads
+// and edges marked as cross-strand edges are not in the triangle index.
 
 void Assembler::flagInconsistentAlignmentsThreadFunction2(size_t threadId)
 {
@@ -1936,158 +2475,157 @@ void Assembler::flagInconsistentAlignmentsThreadFunction2(size_t threadId)
         out.open("flagInconsistentAlignments-" + to_string(threadId) + ".log");
     }
 
-    const uint64_t triangleErrorThreshold = flagInconsistentAlignmentsData.triangleErrorThreshold;
-    const double leastSquareErrorThreshold = double(flagInconsistentAlignmentsData.leastSquareErrorThreshold);
-    const uint64_t leastSquareMaxDistance = flagInconsistentAlignmentsData.leastSquareMaxDistance;
-    vector<uint64_t>& inconsistentEdgeIds = flagInconsistentAlignmentsData.threadEdgeIds[threadId];
+    FlagInconsistentAlignmentsData& data = flagInconsistentAlignmentsData;
+    const uint64_t triangleErrorThreshold = data.triangleErrorThreshold;
+    const double leastSquareErrorThreshold = double(data.leastSquareErrorThreshold);
+    const uint64_t leastSquareMaxDistance = data.leastSquareMaxDistance;
+    const auto& triangleIndex = data.triangleIndex;
+    vector<uint64_t>& inconsistentEdgeIds = data.threadEdgeIds[threadId];
+    uint64_t triangleCount = 0;
+    uint64_t inconsistentTriangleCount = 0;
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
 
-        // Loop over all reads assigned to this batch.
-        for(ReadId readId0=ReadId(begin); readId0!=ReadId(end); readId0++) {
-            if(reads->getFlags(readId0).isChimeric) {
-                continue;
-            }
-            const OrientedReadId orientedReadId0(readId0, 0);
-
-            // Loop over edges of orientedReadId0.
-            const span<uint32_t> edgeIds0 = readGraph.connectivity[orientedReadId0.getValue()];
-            for(uint32_t edgeId01: edgeIds0){
-                const ReadGraphEdge edge01 = readGraph.edges[edgeId01];
-                const OrientedReadId orientedReadId1 = edge01.getOther(orientedReadId0);
-                if(orientedReadId1 < orientedReadId0) {
-                    continue;
-                }
-                if(reads->getFlags(orientedReadId1.getReadId()).isChimeric) {
-                    continue;
-                }
-                if(edge01.crossesStrands) {
-                    continue;
-                }
-                if(edge01.hasInconsistentAlignment) {
-                    continue;
-                }
-                const int32_t offset01 = flagInconsistentAlignmentsData.edgeOffset[edgeId01];
-
-                // Loop over edges of orientedReadId1.
-                const span<uint32_t> edgeIds1 = readGraph.connectivity[orientedReadId1.getValue()];
-                for(uint32_t edgeId12: edgeIds1){
-                    const ReadGraphEdge edge12 = readGraph.edges[edgeId12];
-                    const OrientedReadId orientedReadId2 = edge12.getOther(orientedReadId1);
-                    if(orientedReadId2 < orientedReadId1) {
+        // Loop over all oriented reads assigned to this batch.
+        for(uint64_t i0=begin; i0!=end; i0++) {
+            const auto list0 = triangleIndex[i0];
+
+            for(const auto& p01: list0) {
+                const OrientedReadId w1 = p01.first;
+                const auto list1 = triangleIndex[w1.getValue()];
+
+                // Intersect the two sorted lists.
+                auto it0 = list0.begin();
+                auto it1 = list1.begin();
+                while(it0!=list0.end() and it1!=list1.end()) {
+                    if(it0->first < it1->first) {
+                        ++it0;
                         continue;
                     }
-                    if(reads->getFlags(orientedReadId2.getReadId()).isChimeric) {
+                    if(it1->first < it0->first) {
+                        ++it1;
                         continue;
                     }
-                    if(edge12.crossesStrands) {
+
+                    // We found a triangle.
+                    const OrientedReadId w2 = it0->first;
+                    const uint32_t edgeIdA = p01.second;    // Between i0 and w1.
+                    const uint32_t edgeIdB = it0->second;   // Between i0 and w2.
+                    const uint32_t edgeIdC = it1->second;   // Between w1 and w2.
+                    ++it0;
+                    ++it1;
+                    ++triangleCount;
+
+                    // Sort its vertices by OrientedReadId.
+                    array< pair<OrientedReadId, array<uint32_t, 2> >, 3> triangle = {
+                        make_pair(OrientedReadId::fromValue(ReadId(i0)), array<uint32_t, 2>({edgeIdA, edgeIdB})),
+                        make_pair(w1, array<uint32_t, 2>({edgeIdA, edgeIdC})),
+                        make_pair(w2, array<uint32_t, 2>({edgeIdB, edgeIdC}))
+                    };
+                    sort(triangle.begin(), triangle.end());
+                    const OrientedReadId orientedReadId0 = triangle[0].first;
+                    const OrientedReadId orientedReadId1 = triangle[1].first;
+                    const OrientedReadId orientedReadId2 = triangle[2].first;
+                    if(orientedReadId0.getStrand() != 0) {
                         continue;
                     }
-                    if(edge12.hasInconsistentAlignment) {
+
+                    // Find the edges of the triangle.
+                    // The edge 01 is the one shared by vertices 0 and 1, and so on.
+                    auto sharedEdge = [](const array<uint32_t, 2>& x, const array<uint32_t, 2>& y)
+                    {
+                        return (x[0] == y[0] or x[0] == y[1]) ? x[0] : x[1];
+                    };
+                    const uint32_t edgeId01 = sharedEdge(triangle[0].second, triangle[1].second);
+                    const uint32_t edgeId12 = sharedEdge(triangle[1].second, triangle[2].second);
+                    const uint32_t edgeId20 = sharedEdge(triangle[2].second, triangle[0].second);
+                    const int32_t offset01 = data.edgeOffset[edgeId01];
+                    const int32_t offset12 = data.edgeOffset[edgeId12];
+                    const int32_t offset20 = -data.edgeOffset[edgeId20];
+                    const int32_t offsetError = offset01 + offset12 + offset20;
+
+                    // If the error is small, don't do anything.
+                    if(abs(offsetError) < triangleErrorThreshold) {
                         continue;
                     }
-                    const int32_t offset12 = flagInconsistentAlignmentsData.edgeOffset[edgeId12];
-                    const int32_t offset02 = offset01 + offset12;
-
-                    // Loop over edges of orientedReadId2.
-                    const span<uint32_t> edgeIds2 = readGraph.connectivity[orientedReadId2.getValue()];
-                    for(uint32_t edgeId20: edgeIds2){
-                        const ReadGraphEdge edge20 = readGraph.edges[edgeId20];
-                        if(edge20.crossesStrands) {
-                            continue;
-                        }
-                        if(edge20.hasInconsistentAlignment) {
-                            continue;
-                        }
-                        if(edge20.getOther(orientedReadId2) != orientedReadId0) {
-                            continue;
-                        }
-
-                        // We found a triangle.
-                        const int32_t offset20 = -flagInconsistentAlignmentsData.edgeOffset[edgeId20];
-                        const int32_t offsetError = offset02 + offset20;
+                    ++inconsistentTriangleCount;
+
+                    if(debug) {
+                        out << "Working on triangle ";
+                        out << orientedReadId0 << " ";
+                        out << orientedReadId1 << " ";
+                        out << orientedReadId2 << " ";
+                        out << offset01 << " ";
+                        out << offset12 << " ";
+                        out << offset20 << " ";
+                        out << offsetError << "\n";
+                    }
 
-                        // If the error is small, don't do anything.
-                        if(abs(offsetError) < triangleErrorThreshold) {
-                            continue;
+                    // Construct a local read graph around this triangle.
+                    LocalReadGraph graph;
+                    const vector<OrientedReadId> orientedReadIds =
+                        {orientedReadId0, orientedReadId1, orientedReadId2};
+                    createLocalReadGraph(orientedReadIds,
+                        uint32_t(leastSquareMaxDistance), false, false, false, 0., graph);
+
+                    // Iterate, removing one edge at a time
+                    // until all residuals are small.
+                    while(true) {
+
+                        // Perform least square analysis.
+                        vector<double> singularValues;
+                        leastSquareAnalysis(graph, singularValues);
+
+                        // Find the edge with the worst residual absolute value.
+                        double maxResidual = -1.;
+                        LocalReadGraph::edge_iterator it, end, itWorst;
+                        tie(it, end) = edges(graph);
+                        for(; it!=end; ++it) {
+                            const edge_descriptor e = *it;
+                            const vertex_descriptor v0 = source(e, graph);
+                            const vertex_descriptor v1 = target(e, graph);
+                            const double x0 = graph[v0].leastSquarePosition;
+                            const double x1 = graph[v1].leastSquarePosition;
+                            const double residual = abs((x1 - x0) - graph[e].averageAlignmentOffset);
+                            if(residual > maxResidual) {
+                                maxResidual = residual;
+                                itWorst = it;
+                            }
                         }
-
+                        const edge_descriptor eWorst = *itWorst;
+                        const uint64_t globalEdgeId = graph[eWorst].globalEdgeId;
                         if(debug) {
-                            out << "Working on triangle ";
-                            out << orientedReadId0 << " ";
-                            out << orientedReadId1 << " ";
-                            out << orientedReadId2 << " ";
-                            out << offset01 << " ";
-                            out << offset12 << " ";
-                            out << offset20 << " ";
-                            out << offsetError << "\n";
+                             out << "Edge with worst residual " <<
+                                graph[source(eWorst, graph)].orientedReadId << " " <<
+                                graph[target(eWorst, graph)].orientedReadId << " " << maxResidual << endl;
                         }
 
-                        // Construct a local read graph around this triangle.
-                        LocalReadGraph graph;
-                        const vector<OrientedReadId> orientedReadIds =
-                            {orientedReadId0, orientedReadId1, orientedReadId2};
-                        createLocalReadGraph(orientedReadIds,
-                            uint32_t(leastSquareMaxDistance), false, false, false, 0., graph);
-
-                        // Iterate, removing one edge at a time
-                        // until all residuals are small.
-                        while(true) {
-
-                            // Perform least square analysis.
-                            vector<double> singularValues;
-                            leastSquareAnalysis(graph, singularValues);
-
-                            // Find the edge with the worst residual absolute value.
-                            double maxResidual = -1.;
-                            LocalReadGraph::edge_iterator it, end, itWorst;
-                            tie(it, end) = edges(graph);
-                            for(; it!=end; ++it) {
-                                const edge_descriptor e = *it;
-                                const vertex_descriptor v0 = source(e, graph);
-                                const vertex_descriptor v1 = target(e, graph);
-                                const double x0 = graph[v0].leastSquarePosition;
-                                const double x1 = graph[v1].leastSquarePosition;
-                                const double residual = abs((x1 - x0) - graph[e].averageAlignmentOffset);
-                                if(residual > maxResidual) {
-                                    maxResidual = residual;
-                                    itWorst = it;
-                                }
-                            }
-                            const edge_descriptor eWorst = *itWorst;
-                            const uint64_t globalEdgeId = graph[eWorst].globalEdgeId;
-                            if(debug) {
-                                 out << "Edge with worst residual " <<
-                                    graph[source(eWorst, graph)].orientedReadId << " " <<
-                                    graph[target(eWorst, graph)].orientedReadId << " " << maxResidual << endl;
-                            }
+                        // If the residual is small, end the iteration.
+                        if(maxResidual < leastSquareErrorThreshold) {
+                            break;
+                        }
 
-                            // If the residual is small, end the iteration.
-                            if(maxResidual < leastSquareErrorThreshold) {
-                                break;
+                        // Remove the edge with the worst residual and its
+                        // reverse complement.
+                        inconsistentEdgeIds.push_back(globalEdgeId);
+                        inconsistentEdgeIds.push_back(readGraph.getReverseComplementEdgeId(globalEdgeId));
+                        if(debug) {
+                            const ReadGraphEdge& globalEdge = readGraph.edges[globalEdgeId];
+                            const AlignmentData& ad = alignmentData[globalEdge.alignmentId];
+                            out << "Alignment " << globalEdge.alignmentId << " " <<
+                                ad.readIds[0] << " " << ad.readIds[1] << " " << int(ad.isSameStrand) <<
+                                " flagged as inconsistent." << endl;
                             }
-
-                            // Remove the edge with the worst residual and its
-                            // reverse complement.
-                            inconsistentEdgeIds.push_back(globalEdgeId);
-                            inconsistentEdgeIds.push_back(readGraph.getReverseComplementEdgeId(globalEdgeId));
-                            if(debug) {
-                                const ReadGraphEdge& globalEdge = readGraph.edges[globalEdgeId];
-                                const AlignmentData& ad = alignmentData[globalEdge.alignmentId];
-                                out << "Alignment " << globalEdge.alignmentId << " " <<
-                                    ad.readIds[0] << " " << ad.readIds[1] << " " << int(ad.isSameStrand) <<
-                                    " flagged as inconsistent." << endl;
-                                }
-                            remove_edge(eWorst, graph);
-                        }
+                        remove_edge(eWorst, graph);
                     }
                 }
             }
-
         }
     }
+    __sync_fetch_and_add(&data.triangleCount, triangleCount);
+    __sync_fetch_and_add(&data.inconsistentTriangleCount, inconsistentTriangleCount);
     deduplicate(inconsistentEdgeIds);
 }
 
@@ -180,7 +180,8 @@ void Assembler::createReadGraph2(
     double alignedFractionPercentile,
     double maxSkipPercentile,
     double maxDriftPercentile,
-    double maxTrimPercentile)
+    double maxTrimPercentile,
+    size_t threadCount)
 {
     // First find thresholds based on the observed
     // distribution of alignment quality indicators
@@ -191,53 +192,11 @@ void Assembler::createReadGraph2(
             maxDriftPercentile,
             maxTrimPercentile);
 
-    vector<bool> keepAlignment(alignmentData.size(), false);
-
-    // Find the number of reads and oriented reads.
-    const ReadId orientedReadCount = uint32_t(markers.size());
-    SHASTA_ASSERT((orientedReadCount % 2) == 0);
-    const ReadId readCount = orientedReadCount / 2;
-
-    // Vector to keep the alignments for each read,
-    // with their number of markers.
-    // Contains pairs(marker count, alignment id).
-    vector< pair<uint32_t, uint32_t> > readAlignments;
-
-    // Loop over reads.
-    for(ReadId readId=0; readId<readCount; readId++) {
-
-        // Gather the alignments for this read, each with its number of markers.
-        readAlignments.clear();
-        for(const uint32_t alignmentId: alignmentTable[OrientedReadId(readId, 0).getValue()]) {
-            const AlignmentInfo& info = alignmentData[alignmentId].info;
-
-            // Discard each alignment if it does not pass the chosen thresholds
-            if(not passesReadGraph2Criteria(info)){
-                continue;
-            }
-
-            // Otherwise add it to the list of candidate alignments for this read (to be ranked)
-            readAlignments.push_back(make_pair(info.markerCount, alignmentId));
-        }
-
-        // Keep the best maxAlignmentCount.
-        if(readAlignments.size() > maxAlignmentCount) {
-            std::nth_element(
-                    readAlignments.begin(),
-                    readAlignments.begin() + maxAlignmentCount,
-                    readAlignments.end(),
-                    std::greater< pair<uint32_t, uint32_t> >());
-            readAlignments.resize(maxAlignmentCount);
-        }
-
-        // Mark the surviving alignments as to be kept.
-        for(const auto& p: readAlignments) {
-            const uint32_t alignmentId = p.second;
-            keepAlignment[alignmentId] = true;
-        }
-    }
+    // Select the alignments to be kept.
+    vector<bool> keepAlignment;
+    selectReadGraphAlignments(maxAlignmentCount, true, keepAlignment, threadCount);
     const size_t keepCount = count(keepAlignment.begin(), keepAlignment.end(), true);
     cout << "Keeping " << keepCount << " alignments of " << keepAlignment.size() << endl;
 
-    createReadGraphUsingSelectedAlignments(keepAlignment);
+    createReadGraphUsingSelectedAlignments(keepAlignment, threadCount);
 }
@@ -0,0 +1,459 @@
+// Test of the parallel assembly graph output (writeGfa1, writeGfa1BothStrands,
+// writeGfa1BothStrandsNoSequence, writeFasta) against the serial
+// writers they replaced.
+// Use it on a small assembly, for example the one created from
+// shasta/tests/TinyTest.fasta.gz, via shasta/scripts/TestWriteAssemblyGraph.py.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "AssemblyGraph.hpp"
+#include "platformDependent.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+// Standard library.
+#include <filesystem>
+#include "fstream.hpp"
+#include <sstream>
+#include <thread>
+
+
+
+// Read an entire file into a string.
+static string readTestOutput(const string& fileName)
+{
+    ifstream file(fileName, std::ios::binary);
+    if(not file) {
+        throw runtime_error("Error opening " + fileName);
+    }
+    std::ostringstream s;
+    s << file.rdbuf();
+    return s.str();
+}
+
+
+
+void Assembler::testWriteAssemblyGraph(size_t threadCount)
+{
+    using Format = WriteAssemblyGraphData::Format;
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const vector< pair<Format, string> > formats = {
+        {Format::Gfa1, "Gfa1"},
+        {Format::Gfa1BothStrands, "Gfa1BothStrands"},
+        {Format::Gfa1BothStrandsNoSequence, "Gfa1BothStrandsNoSequence"},
+        {Format::Fasta, "Fasta"}
+    };
+    const string fileNamePrefix = tmpDirectory() +
+        to_string(boost::uuids::random_generator()()) + ".testWriteAssemblyGraph";
+    const string fileName = fileNamePrefix + ".out";
+    const string referenceFileName = fileNamePrefix + ".reference";
+
+    for(const auto& p: formats) {
+        const Format format = p.first;
+        const string& formatName = p.second;
+
+        // Reference output, written by the serial writer.
+        switch(format) {
+        case Format::Gfa1:
+            writeGfa1Baseline(referenceFileName);
+            break;
+        case Format::Gfa1BothStrands:
+            writeGfa1BothStrandsBaseline(referenceFileName);
+            break;
+        case Format::Gfa1BothStrandsNoSequence:
+            assemblyGraphPointer->writeGfa1BothStrandsNoSequence(referenceFileName);
+            break;
+        case Format::Fasta:
+            writeFastaBaseline(referenceFileName);
+            break;
+        }
+        const string reference = readTestOutput(referenceFileName);
+        std::filesystem::remove(referenceFileName);
+
+        for(const size_t testThreadCount: {size_t(1), threadCount}) {
+
+            // Write using the parallel code and read it back.
+            writeAssemblyGraph(fileName, format, testThreadCount);
+            const string output = readTestOutput(fileName);
+            std::filesystem::remove(fileName);
+
+            // Compare.
+            if(output != reference) {
+                uint64_t offset = 0;
+                while(offset < output.size() and offset < reference.size() and
+                    output[offset] == reference[offset]) {
+                    ++offset;
+                }
+                throw runtime_error("testWriteAssemblyGraph failed for format " + formatName +
+                    " with " + to_string(testThreadCount) + " threads: output has " +
+                    to_string(output.size()) + " bytes, reference has " +
+                    to_string(reference.size()) + " bytes, first difference at offset " +
+                    to_string(offset) + ".");
+            }
+            cout << "testWriteAssemblyGraph: format " << formatName << " with " <<
+                testThreadCount << " threads, " << output.size() <<
+                " bytes identical to reference." << endl;
+        }
+    }
+}
+
+
+
+// The serial writers used before the output was parallelized.
+// These are unmodified copies of the original writeGfa1, writeGfa1BothStrands,
+// and writeFasta, except for the function names and the
+// removal of performanceLog messages. Do not change them:
+// they are the reference for testWriteAssemblyGraph.
+// The original writeGfa1BothStrandsNoSequence is
+// AssemblyGraph::writeGfa1BothStrandsNoSequence, which is still in use.
+
+void Assembler::writeGfa1Baseline(const string& fileName)
+{
+    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using VertexId = AssemblyGraph::VertexId;
+    using EdgeId = AssemblyGraph::EdgeId;
+
+    ofstream gfa(fileName);
+
+    // Write the header line.
+    gfa << "H\tVN:Z:1.0\n";
+
+    // Write a segment record for each edge.
+    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+        if(assemblyGraph.edges[edgeId].wasRemoved()) {
+            continue;
+        }
+
+        // Only output one of each pair of reverse complemented edges.
+        if(!assemblyGraph.isAssembledEdge(edgeId)) {
+            continue;
+        }
+
+        const auto sequence = assemblyGraph.sequences[edgeId];
+        const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
+        SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+        gfa << "S\t" << edgeId << "\t";
+
+        // Write the sequence.
+        for(size_t i=0; i<sequence.baseCount; i++) {
+            const Base b = sequence[i];
+            const uint8_t repeatCount = repeatCounts[i];
+            for(size_t k=0; k<repeatCount; k++) {
+                gfa << b;
+            }
+        }
+
+        // Write "number of reads" as average edge coverage
+        // times number of bases.
+        const uint32_t averageEdgeCoverage =
+            assemblyGraph.edges[edgeId].averageEdgeCoverage;
+        gfa << "\tRC:i:" << averageEdgeCoverage * sequence.baseCount;
+
+        gfa << "\n";
+    }
+
+
+    // Write GFA links.
+    // For each vertex in the assembly graph there is a link for
+    // each combination of in-edges and out-edges.
+    // Therefore each assembly graph vertex generates a number of
+    // links equal to the product of its in-degree and out-degree.
+    const size_t k = assemblerInfo->k;
+    string cigarString;
+    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
+
+        // In-edges.
+        const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
+
+        // Out-edges.
+        const span<EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
+
+        // Loop over combinations of in-edges and out-edges.
+        for(const EdgeId edge0: edges0) {
+            if(assemblyGraph.edges[edge0].wasRemoved()) {
+                continue;
+            }
+            const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
+
+            // Get the last k repeat counts of edge0.
+            vector<uint8_t> lastRepeatCounts0(k);
+            if(assemblyGraph.isAssembledEdge(edge0)) {
+                const span<uint8_t> storedRepeatCounts0 = assemblyGraph.repeatCounts[edge0];
+                const auto end0 = storedRepeatCounts0.end();
+                copy(end0-k, end0, lastRepeatCounts0.begin());
+            } else {
+                SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge0Rc));
+                const span<uint8_t> storedRepeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
+                const auto begin0Rc = storedRepeatCounts0Rc.begin();
+                copy(begin0Rc, begin0Rc+k, lastRepeatCounts0.begin());
+                std::reverse(lastRepeatCounts0.begin(), lastRepeatCounts0.end());
+            }
+
+            for(const EdgeId edge1: edges1) {
+                if(assemblyGraph.edges[edge1].wasRemoved()) {
+                    continue;
+                }
+                const EdgeId edge1Rc = assemblyGraph.reverseComplementEdge[edge1];
+
+                // Get the first k repeat counts of edge1.
+                vector<uint8_t> firstRepeatCounts1(k);
+                if(assemblyGraph.isAssembledEdge(edge1)) {
+                    const span<uint8_t> storedRepeatCounts1 = assemblyGraph.repeatCounts[edge1];
+                    const auto begin1 = storedRepeatCounts1.begin();
+                    copy(begin1, begin1+k, firstRepeatCounts1.begin());
+                } else {
+                    SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge1Rc));
+                    const span<uint8_t> storedRepeatCounts1Rc = assemblyGraph.repeatCounts[edge1Rc];
+                    const auto end1Rc = storedRepeatCounts1Rc.end();
+                    copy(end1Rc-k, end1Rc, firstRepeatCounts1.begin());
+                    std::reverse(firstRepeatCounts1.begin(), firstRepeatCounts1.end());
+                }
+
+                // Construct the cigar string.
+                constructCigarString(
+                    span<uint8_t>(
+                        lastRepeatCounts0.data(),
+                        lastRepeatCounts0.data() + lastRepeatCounts0.size()),
+                    span<uint8_t>(
+                        firstRepeatCounts1.data(),
+                        firstRepeatCounts1.data() + firstRepeatCounts1.size()),
+                    cigarString);
+
+                // Keep track of which edges are actually assembled and output.
+                EdgeId edge0Out = edge0;
+                EdgeId edge1Out = edge1;
+                bool reverse0 = false;
+                bool reverse1 = false;
+                if(!assemblyGraph.isAssembledEdge(edge0Out)) {
+                    edge0Out = assemblyGraph.reverseComplementEdge[edge0Out];
+                    reverse0 = true;
+                }
+                if(!assemblyGraph.isAssembledEdge(edge1Out)) {
+                    edge1Out = assemblyGraph.reverseComplementEdge[edge1Out];
+                    reverse1 = true;
+                }
+
+                // Avoid writing links twice.
+                if(edge0Out > edge1Out) {
+                    continue;
+                }
+                if(edge0Out == edge1Out && reverse0) {
+                    continue;
+                }
+
+                // Write out the link record for this edge.
+                gfa << "L\t" <<
+                    edge0Out << "\t" <<
+                    (reverse0 ? "-" : "+") << "\t" <<
+                    edge1Out << "\t" <<
+                    (reverse1 ? "-" : "+") << "\t" <<
+                    cigarString << "\n";
+            }
+        }
+
+    }
+}
+
+
+
+void Assembler::writeGfa1BothStrandsBaseline(const string& fileName)
+{
+    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using VertexId = AssemblyGraph::VertexId;
+    using EdgeId = AssemblyGraph::EdgeId;
+
+    ofstream gfa(fileName);
+
+    // Write the header line.
+    gfa << "H\tVN:Z:1.0\n";
+
+    // Write a segment record for each edge.
+    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+        if(assemblyGraph.edges[edgeId].wasRemoved()) {
+            continue;
+        }
+
+        // Get the id of the reverse complemented edge.
+        const EdgeId edgeIdRc = assemblyGraph.reverseComplementEdge[edgeId];
+
+        // Write the name to make it easy to keep track of reverse
+        // complemented edges.
+        gfa << "S\t" << edgeId << "\t";
+
+        // Write the sequence.
+        size_t sequenceLength;
+        if(assemblyGraph.isAssembledEdge(edgeId)) {
+
+            // This edge was assembled. We can just write the stored sequence.
+            const auto sequence = assemblyGraph.sequences[edgeId];
+            const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
+            SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+            sequenceLength = sequence.baseCount;
+            for(size_t i=0; i<sequence.baseCount; i++) {
+                const Base b = sequence[i];
+                const uint8_t repeatCount = repeatCounts[i];
+                for(size_t k=0; k<repeatCount; k++) {
+                    gfa << b;
+                }
+            }
+        } else {
+
+            // This edge was not assembled. We write out the reverse
+            // complemented sequence of the reverse complemented edge.
+            SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edgeIdRc));
+            const auto sequence = assemblyGraph.sequences[edgeIdRc];
+            const auto repeatCounts = assemblyGraph.repeatCounts[edgeIdRc];
+            SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+            sequenceLength = sequence.baseCount;
+            for(size_t i=0; i<sequence.baseCount; i++) {
+                const size_t j = sequence.baseCount - 1 - i;
+                const Base b = sequence[j].complement();
+                const uint8_t repeatCount = repeatCounts[j];
+                for(size_t k=0; k<repeatCount; k++) {
+                    gfa << b;
+                }
+            }
+
+
+        }
+
+        // Write "number of reads" as average edge coverage
+        // times number of bases.
+        const uint32_t averageEdgeCoverage =
+            assemblyGraph.edges[edgeId].averageEdgeCoverage;
+        gfa << "\tRC:i:" << averageEdgeCoverage * sequenceLength;
+;
+        gfa << "\n";
+    }
+
+  
+    // Write GFA links.
+    // For each vertex in the assembly graph there is a link for
+    // each combination of in-edges and out-edges.
+    // Therefore each assembly graph vertex generates a number of
+    // links equal to the product of its in-degree and out-degree.
+    const size_t k = assemblerInfo->k;
+    string cigarString;
+    for(VertexId vertexId=0; vertexId<assemblyGraph.vertices.size(); vertexId++) {
+
+        // In-edges.
+        const span<EdgeId> edges0 = assemblyGraph.edgesByTarget[vertexId];
+
+        // Out-edges.
+        const span<EdgeId> edges1 = assemblyGraph.edgesBySource[vertexId];
+
+        // Loop over in-edges.
+        for(const EdgeId edge0: edges0) {
+            if(assemblyGraph.edges[edge0].wasRemoved()) {
+                continue;
+            }
+            const EdgeId edge0Rc = assemblyGraph.reverseComplementEdge[edge0];
+
+            // Get the last k repeat counts of edge0.
+            vector<uint8_t> lastRepeatCounts0(k);
+            if(assemblyGraph.isAssembledEdge(edge0)) {
+                const span<uint8_t> storedRepeatCounts0 = assemblyGraph.repeatCounts[edge0];
+                const auto end0 = storedRepeatCounts0.end();
+                copy(end0-k, end0, lastRepeatCounts0.begin());
+            } else {
+                SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge0Rc));
+                const span<uint8_t> storedRepeatCounts0Rc = assemblyGraph.repeatCounts[edge0Rc];
+                const auto begin0Rc = storedRepeatCounts0Rc.begin();
+                copy(begin0Rc, begin0Rc+k, lastRepeatCounts0.begin());
+                std::reverse(lastRepeatCounts0.begin(), lastRepeatCounts0.end());
+            }
+
+            // Loop over in-edges.
+            for(const EdgeId edge1: edges1) {
+                if(assemblyGraph.edges[edge1].wasRemoved()) {
+                    continue;
+                }
+                const EdgeId edge1Rc = assemblyGraph.reverseComplementEdge[edge1];
+
+                // Get the first k repeat counts of edge1.
+                vector<uint8_t> firstRepeatCounts1(k);
+                if(assemblyGraph.isAssembledEdge(edge1)) {
+                    const span<uint8_t> storedRepeatCounts1 = assemblyGraph.repeatCounts[edge1];
+                    const auto begin1 = storedRepeatCounts1.begin();
+                    copy(begin1, begin1+k, firstRepeatCounts1.begin());
+                } else {
+                    SHASTA_ASSERT(assemblyGraph.isAssembledEdge(edge1Rc));
+                    const span<uint8_t> storedRepeatCounts1Rc = assemblyGraph.repeatCounts[edge1Rc];
+                    const auto end1Rc = storedRepeatCounts1Rc.end();
+                    copy(end1Rc-k, end1Rc, firstRepeatCounts1.begin());
+                    std::reverse(firstRepeatCounts1.begin(), firstRepeatCounts1.end());
+                }
+
+
+                // Construct the cigar string.
+                constructCigarString(
+                    span<uint8_t>(
+                        lastRepeatCounts0.data(),
+                        lastRepeatCounts0.data() + lastRepeatCounts0.size()),
+                    span<uint8_t>(
+                        firstRepeatCounts1.data(),
+                        firstRepeatCounts1.data() + firstRepeatCounts1.size()),
+                    cigarString);
+
+
+                // Write out the link record for this edge.
+                // Note that in the double stranded version of GFA
+                // output all links are written with orientation ++.
+                gfa << "L\t" <<
+                    edge0 << "\t+\t" <<
+                    edge1 << "\t+\t" <<
+                    cigarString << "\n";
+            }
+        }
+    }
+}
+
+
+
+void Assembler::writeFastaBaseline(const string& fileName)
+{
+    AssemblyGraph& assemblyGraph = *assemblyGraphPointer;
+    using EdgeId = AssemblyGraph::EdgeId;
+
+    ofstream fasta(fileName);
+
+    // Write a sequence for each edge of the assembly graph.
+    for(EdgeId edgeId=0; edgeId<assemblyGraph.sequences.size(); edgeId++) {
+        if(assemblyGraph.edges[edgeId].wasRemoved()) {
+            continue;
+        }
+
+        // Only output one of each pair of reverse complemented edges.
+        if(!assemblyGraph.isAssembledEdge(edgeId)) {
+            continue;
+        }
+
+        const auto sequence = assemblyGraph.sequences[edgeId];
+        const auto repeatCounts = assemblyGraph.repeatCounts[edgeId];
+        SHASTA_ASSERT(sequence.baseCount == repeatCounts.size());
+
+        // Compute the length so we can write it in the header.
+        size_t length = 0;
+        for(const uint8_t repeatCount: repeatCounts) {
+            length += repeatCount;
+        }
+
+        fasta << ">" << edgeId << " length " << length << "\n";
+        for(size_t i=0; i<sequence.baseCount; i++) {
+            const Base b = sequence[i];
+            const uint8_t repeatCount = repeatCounts[i];
+            for(size_t k=0; k<repeatCount; k++) {
+                fasta << b;
+            }
+        }
+        fasta << "\n";
+    }
+}
+
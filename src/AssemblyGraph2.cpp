@@ -12,6 +12,7 @@
 #include "findMarkerId.hpp"
 #include "GfaAssemblyGraph.hpp"
 #include "orderPairs.hpp"
+#include "OrderedFileWriter.hpp"
 #include "PhasingGraph.hpp"
 #include "performanceLog.hpp"
 #include "ReadFlags.hpp"
@@ -33,6 +34,7 @@ using namespace shasta;
 #include <limits>
 #include <map>
 #include <numeric>
+#include <thread>
 
 
 // The constructor creates an edge for each linear path
@@ -47,6 +49,8 @@ AssemblyGraph2::AssemblyGraph2(
     uint64_t pruneLength,
     const Mode2AssemblyOptions& mode2Options,
     AssemblyGraph2Statistics& statistics,
+    const string& largeDataFileNamePrefix,
+    size_t largeDataPageSize,
     size_t threadCount,
     bool debug
     ) :
@@ -75,11 +79,7 @@ AssemblyGraph2::AssemblyGraph2(
     const uint64_t maxDiscordantReadCountForBubbleRemoval = mode2Options.maxDiscordantReadCountForBubbleRemoval;
     const double minLogPForBubbleRemoval = mode2Options.minLogPForBubbleRemoval;
     const uint64_t componentSizeThresholdForBubbleRemoval = mode2Options.componentSizeThresholdForBubbleRemoval;
-
-    // Parameters for phasing.
-    const uint64_t minConcordantReadCountForPhasing = mode2Options.minConcordantReadCountForPhasing;
-    const uint64_t maxDiscordantReadCountForPhasing = mode2Options.maxDiscordantReadCountForPhasing;
-    const double minLogPForPhasing = mode2Options.minLogPForPhasing;
+    const bool incrementalBubbleRemoval = mode2Options.incrementalBubbleRemoval;
 
     // Parameters for superbubble removal.
     const uint64_t maxSuperbubbleSize = mode2Options.maxSuperbubbleSize;
@@ -109,13 +109,15 @@ AssemblyGraph2::AssemblyGraph2(
 
     // Handle superbubbles.
     handleSuperbubbles0(superbubbleRemovalEdgeLengthThreshold,
-        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false);
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false,
+        threadCount);
     merge(false, false);
     if(debug) {
         writeDetailedEarly("Assembly-Detailed-Debug-2");
     }
     handleSuperbubbles1(
-        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false);
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, false, false,
+        threadCount);
     merge(false, false);
     if(debug) {
         writeDetailedEarly("Assembly-Detailed-Debug-3");
@@ -158,12 +160,44 @@ AssemblyGraph2::AssemblyGraph2(
         maxSuperbubbleChunkPathCount,
         pruneLength,
         componentSizeThresholdForBubbleRemoval,
+        incrementalBubbleRemoval,
         threadCount);
+
+    // Store the graph as it is before phasing, so phasing
+    // can later be redone with different parameters (see phaseAndWriteOutput).
+    save(largeDataFileNamePrefix, largeDataPageSize, true, threadCount);
+
+    // Phase, then write out what we have.
+    phaseAndWriteOutput(pruneLength, mode2Options, statistics, threadCount, debug);
+
+    performanceLog << timestamp << "AssemblyGraph2 constructor ends." << endl;
+}
+
+
+
+// Phase, do final pruning, find bubble chains and phasing regions,
+// then write the output and store statistics.
+// This is called by the constructor after bad bubble removal,
+// and by Assembler::rephaseAssemblyGraph2 on a graph reconstructed
+// from the state stored before phasing.
+void AssemblyGraph2::phaseAndWriteOutput(
+    uint64_t pruneLength,
+    const Mode2AssemblyOptions& mode2Options,
+    AssemblyGraph2Statistics& statistics,
+    size_t threadCount,
+    bool debug)
+{
+    performanceLog << timestamp << "AssemblyGraph2::phaseAndWriteOutput begins." << endl;
+
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
     hierarchicalPhase(
-        minConcordantReadCountForPhasing,
-        maxDiscordantReadCountForPhasing,
-        minLogPForPhasing,
-        epsilon,
+        mode2Options.minConcordantReadCountForPhasing,
+        mode2Options.maxDiscordantReadCountForPhasing,
+        mode2Options.minLogPForPhasing,
+        mode2Options.epsilon,
         threadCount);
 
     if(debug) {
@@ -175,6 +209,7 @@ AssemblyGraph2::AssemblyGraph2(
 
     // Find chains of bubbles.
     // These are linear chains of edges of length at least 2.
+    clearBubbleChains();
     findBubbleChains();
     writeBubbleChains();
     findPhasingRegions();
@@ -186,28 +221,7 @@ AssemblyGraph2::AssemblyGraph2(
 
     // Write out what we have.
     storeGfaSequence();
-    if(not mode2Options.suppressDetailedOutput) {
-        writeDetailed("Assembly-Detailed", true, false, true,
-            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput);
-        if(not mode2Options.suppressGfaOutput) {
-            writeDetailed("Assembly-Detailed-NoSequence", false, false, false, true, false);
-        }
-    }
-    if(not mode2Options.suppressHaploidOutput) {
-        writeHaploid("Assembly-Haploid", true, true,
-            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput, &statistics);
-        if(not mode2Options.suppressGfaOutput) {
-            writeHaploid("Assembly-Haploid-NoSequence", false, false, true, false);
-        }
-    }
-    if(not mode2Options.suppressPhasedOutput) {
-        writePhased("Assembly-Phased", true, true,
-            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput, &statistics);
-        if(not mode2Options.suppressGfaOutput) {
-            writePhased("Assembly-Phased-NoSequence", false, false, true, false);
-        }
-        writePhasedDetails();
-    }
+    writeOutput(mode2Options, &statistics, threadCount);
 
     // Het snp statistics.
     uint64_t transitionCount, transversionCount, nonSnpCount;
@@ -227,7 +241,40 @@ AssemblyGraph2::AssemblyGraph2(
     statistics.simpleSnpBubbleTransversionCount = transversionCount;
     statistics.nonSimpleSnpBubbleCount = nonSnpCount;
 
-    performanceLog << timestamp << "AssemblyGraph2 constructor ends." << endl;
+    performanceLog << timestamp << "AssemblyGraph2::phaseAndWriteOutput ends." << endl;
+}
+
+
+
+// Write the detailed, haploid, and phased output,
+// as controlled by the given options.
+void AssemblyGraph2::writeOutput(
+    const Mode2AssemblyOptions& mode2Options,
+    AssemblyGraph2Statistics* statistics,
+    size_t threadCount)
+{
+    if(not mode2Options.suppressDetailedOutput) {
+        writeDetailed("Assembly-Detailed", true, false, true,
+            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput, threadCount);
+        if(not mode2Options.suppressGfaOutput) {
+            writeDetailed("Assembly-Detailed-NoSequence", false, false, false, true, false, threadCount);
+        }
+    }
+    if(not mode2Options.suppressHaploidOutput) {
+        writeHaploid("Assembly-Haploid", true, true,
+            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput, statistics, threadCount);
+        if(not mode2Options.suppressGfaOutput) {
+            writeHaploid("Assembly-Haploid-NoSequence", false, false, true, false, 0, threadCount);
+        }
+    }
+    if(not mode2Options.suppressPhasedOutput) {
+        writePhased("Assembly-Phased", true, true,
+            not mode2Options.suppressGfaOutput, not mode2Options.suppressFastaOutput, statistics, threadCount);
+        if(not mode2Options.suppressGfaOutput) {
+            writePhased("Assembly-Phased-NoSequence", false, false, true, false, 0, threadCount);
+        }
+        writePhasedDetails();
+    }
 }
 
 
@@ -960,7 +1007,8 @@ void AssemblyGraph2::writeDetailed(
     bool writeSequenceLengthInMarkers,
     bool writeCsv,
     bool writeGfa,
-    bool writeFasta) const
+    bool writeFasta,
+    size_t threadCount)
 {
     performanceLog << timestamp << "AssemblyGraph2::writeDetailed begins." << endl;
 
@@ -989,11 +1037,8 @@ void AssemblyGraph2::writeDetailed(
     }
 
 
-    // Open the fasta file.
-    ofstream fasta;
-    if(writeFasta) {
-        fasta.open(baseName + ".fasta");
-    }
+    // The FASTA records are gathered here and written out at the end.
+    writeOutputData.fastaRecords.clear();
 
     // Create a GFA with a segment for each branch, then write it out.
     GfaAssemblyGraph<vertex_descriptor> gfa;
@@ -1007,7 +1052,8 @@ void AssemblyGraph2::writeDetailed(
 
             if(writeGfa) {
                 if(writeSequence) {
-                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence);
+                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence,
+                        double(branch.averageCoverage()));
                 } else {
                     if(writeSequenceLengthInMarkers) {
                         gfa.addSegment(edge.pathId(branchId), v0, v1, branch.path.size());
@@ -1018,9 +1064,7 @@ void AssemblyGraph2::writeDetailed(
             }
 
             if(writeFasta) {
-                fasta << ">" << edge.pathId(branchId) << " " << branch.gfaSequence.size() << "\n";
-                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
-                fasta << "\n";
+                writeOutputData.fastaRecords.push_back(make_pair(edge.pathId(branchId), &branch.gfaSequence));
             }
 
 
@@ -1162,10 +1206,17 @@ void AssemblyGraph2::writeDetailed(
 
 
 
-    // Write out the GFA.
+    // Write out the GFA and FASTA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa", threadCount);
+        if(writeSequence) {
+            gfa.writeBinary(baseName + "-Graph.bin");
+        }
+    }
+    if(writeFasta) {
+        writeFastaRecords(baseName + ".fasta", threadCount);
     }
+    writeOutputData = WriteOutputData();
 
     performanceLog << timestamp << "AssemblyGraph2::writeDetailed ends." << endl;
 }
@@ -1192,7 +1243,8 @@ void AssemblyGraph2::writeHaploid(
     bool writeCsv,
     bool writeGfa,
     bool writeFasta,
-    AssemblyGraph2Statistics* statistics) const
+    AssemblyGraph2Statistics* statistics,
+    size_t threadCount)
 {
     performanceLog << timestamp << "AssemblyGraph2::writeHaploid begins." << endl;
     const G& g = *this;
@@ -1200,11 +1252,8 @@ void AssemblyGraph2::writeHaploid(
     vector<uint64_t> bubbleChainLengths;
     uint64_t totalNonBubbleChainLength = 0;
 
-    // Open the fasta file.
-    ofstream fasta;
-    if(writeFasta) {
-        fasta.open(baseName + ".fasta");
-    }
+    // The FASTA records are gathered here and written out at the end.
+    writeOutputData.fastaRecords.clear();
 
     // Create a GFA and add a segment for each edge that is not part
     // of a bubble chain.
@@ -1224,30 +1273,36 @@ void AssemblyGraph2::writeHaploid(
 
             if(writeGfa) {
                 if(writeSequence) {
-                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence);
+                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence,
+                        double(branch.averageCoverage()));
                 } else {
                     gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence.size());
                 }
             }
 
             if(writeFasta) {
-                fasta << ">" << edge.pathId(branchId) << " " << branch.gfaSequence.size() << "\n";
-                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
-                fasta << "\n";
+                writeOutputData.fastaRecords.push_back(make_pair(edge.pathId(branchId), &branch.gfaSequence));
             }
         }
     }
 
 
 
+    // Compute in parallel the sequence of each bubble chain.
+    writeOutputData.sequenceRequests.clear();
+    for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+        writeOutputData.sequenceRequests.push_back(
+            {bubbleChainId, std::numeric_limits<uint64_t>::max(), 0});
+    }
+    computeOutputSequences(threadCount);
+
     // Add a segment for each bubble chain.
     for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
         const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
         const vertex_descriptor v0 = source(bubbleChain.edges.front(), g);
         const vertex_descriptor v1 = target(bubbleChain.edges.back(), g);
 
-        vector<Base> sequence;
-        computeBubbleChainGfaSequence(bubbleChain, sequence);
+        const vector<Base>& sequence = writeOutputData.sequences[bubbleChainId];
         bubbleChainLengths.push_back(uint64_t(sequence.size()));
 
         const string idString = "BC." + to_string(bubbleChainId);
@@ -1261,18 +1316,23 @@ void AssemblyGraph2::writeHaploid(
         }
 
         if(writeFasta) {
-            fasta << ">" << idString << " " << sequence.size() << "\n";
-            copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
-            fasta << "\n";
+            writeOutputData.fastaRecords.push_back(make_pair(idString, &sequence));
         }
     }
 
 
 
-    // Write the GFA.
+    // Write the GFA and FASTA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa", threadCount);
+        if(writeSequence) {
+            gfa.writeBinary(baseName + "-Graph.bin");
+        }
     }
+    if(writeFasta) {
+        writeFastaRecords(baseName + ".fasta", threadCount);
+    }
+    writeOutputData = WriteOutputData();
 
 
 
@@ -1360,7 +1420,8 @@ void AssemblyGraph2::writePhased(
     bool writeCsv,
     bool writeGfa,
     bool writeFasta,
-    AssemblyGraph2Statistics* statistics) const
+    AssemblyGraph2Statistics* statistics,
+    size_t threadCount)
 {
     performanceLog << timestamp << "AssemblyGraph2::writePhased begins." << endl;
     const G& g = *this;
@@ -1382,11 +1443,8 @@ void AssemblyGraph2::writePhased(
         csv << "Name,Position in bubble chain,Ploidy,Bubble chain,Component,Haplotype,Length,Color\n";
     }
 
-    // Open the fasta file.
-    ofstream fasta;
-    if(writeFasta) {
-        fasta.open(baseName + ".fasta");
-    }
+    // The FASTA records are gathered here and written out at the end.
+    writeOutputData.fastaRecords.clear();
 
     // Create a GFA and add a segment for each edge that is not part
     // of a bubble chain.
@@ -1406,16 +1464,15 @@ void AssemblyGraph2::writePhased(
 
             if(writeGfa) {
                 if(writeSequence) {
-                    gfa.addSegment(segmentId, v0, v1, branch.gfaSequence);
+                    gfa.addSegment(segmentId, v0, v1, branch.gfaSequence,
+                        double(branch.averageCoverage()));
                 } else {
                     gfa.addSegment(segmentId, v0, v1, branch.gfaSequence.size());
                 }
             }
 
             if(writeFasta) {
-                fasta << ">" << segmentId << " " << branch.gfaSequence.size() << "\n";
-                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
-                fasta << "\n";
+                writeOutputData.fastaRecords.push_back(make_pair(segmentId, &branch.gfaSequence));
             }
 
             if(writeCsv) {
@@ -1427,9 +1484,25 @@ void AssemblyGraph2::writePhased(
 
 
 
+    // Compute in parallel the sequences of each phasing region
+    // of each bubble chain: two for a phased region, one for an unphased region.
+    // They are used below in the same order.
+    writeOutputData.sequenceRequests.clear();
+    for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+        const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
+        for(uint64_t phasingRegionId=0;
+            phasingRegionId<uint64_t(bubbleChain.phasingRegions.size()); phasingRegionId++) {
+            writeOutputData.sequenceRequests.push_back({bubbleChainId, phasingRegionId, 0});
+            if(bubbleChain.phasingRegions[phasingRegionId].isPhased) {
+                writeOutputData.sequenceRequests.push_back({bubbleChainId, phasingRegionId, 1});
+            }
+        }
+    }
+    computeOutputSequences(threadCount);
+    uint64_t sequenceIndex = 0;
+
     // Add one or two segments, depending on ploidy, for each phasing region
     // of each bubble chain.
-    vector<Base> sequence;
     for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
         const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
         for(uint64_t phasingRegionId=0;
@@ -1448,24 +1521,22 @@ void AssemblyGraph2::writePhased(
                     to_string(phasingRegion.componentId) + ".";
 
                 const string name0 = namePrefix + "0";
-                computePhasedRegionGfaSequence(bubbleChain, phasingRegion, 0, sequence);
+                const vector<Base>& sequence0 = writeOutputData.sequences[sequenceIndex++];
 
                 if(writeGfa) {
                     if(writeSequence) {
-                        gfa.addSegment(name0, v0, v1, sequence);
+                        gfa.addSegment(name0, v0, v1, sequence0);
                     } else {
-                        gfa.addSegment(name0, v0, v1, sequence.size());
+                        gfa.addSegment(name0, v0, v1, sequence0.size());
                     }
                 }
 
                 if(writeFasta) {
-                    fasta << ">" << name0 << " " << sequence.size() << "\n";
-                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
-                    fasta << "\n";
+                    writeOutputData.fastaRecords.push_back(make_pair(name0, &sequence0));
                 }
 
-                totalDiploidBases += uint64_t(sequence.size());
-                diploidLengths.push_back(uint64_t(sequence.size()));
+                totalDiploidBases += uint64_t(sequence0.size());
+                diploidLengths.push_back(uint64_t(sequence0.size()));
 
                 if(writeCsv) {
                     csv <<
@@ -1475,29 +1546,27 @@ void AssemblyGraph2::writePhased(
                         bubbleChainId << "," <<
                         phasingRegion.componentId << "," <<
                         "0," <<
-                        sequence.size() << ","
+                        sequence0.size() << ","
                         "Green\n";
                 }
 
                 const string name1 = namePrefix + "1";
-                computePhasedRegionGfaSequence(bubbleChain, phasingRegion, 1, sequence);
+                const vector<Base>& sequence1 = writeOutputData.sequences[sequenceIndex++];
 
                 if(writeGfa) {
                     if(writeSequence) {
-                        gfa.addSegment(name1, v0, v1, sequence);
+                        gfa.addSegment(name1, v0, v1, sequence1);
                     } else {
-                        gfa.addSegment(name1, v0, v1, sequence.size());
+                        gfa.addSegment(name1, v0, v1, sequence1.size());
                     }
                 }
 
                 if(writeFasta) {
-                    fasta << ">" << name1 << " " << sequence.size() << "\n";
-                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
-                    fasta << "\n";
+                    writeOutputData.fastaRecords.push_back(make_pair(name1, &sequence1));
                 }
 
-                totalDiploidBases += uint64_t(sequence.size());
-                diploidLengths.push_back(uint64_t(sequence.size()));
+                totalDiploidBases += uint64_t(sequence1.size());
+                diploidLengths.push_back(uint64_t(sequence1.size()));
 
                 if(writeCsv) {
                     csv <<
@@ -1507,13 +1576,13 @@ void AssemblyGraph2::writePhased(
                         bubbleChainId << "," <<
                         phasingRegion.componentId << "," <<
                         "1," <<
-                        sequence.size() << ","
+                        sequence1.size() << ","
                         "Green\n";
                 }
 
             } else {
 
-                computeUnphasedRegionGfaSequence(bubbleChain, phasingRegion, sequence);
+                const vector<Base>& sequence = writeOutputData.sequences[sequenceIndex++];
                 const string name = "UR." + to_string(bubbleChainId) + "." + to_string(phasingRegionId);
 
                 if(writeGfa) {
@@ -1528,9 +1597,7 @@ void AssemblyGraph2::writePhased(
                 haploidLengths.push_back(uint64_t(sequence.size()));
 
                 if(writeFasta) {
-                    fasta << ">" << name << " " << sequence.size() << "\n";
-                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
-                    fasta << "\n";
+                    writeOutputData.fastaRecords.push_back(make_pair(name, &sequence));
                 }
 
                 if(writeCsv) {
@@ -1549,13 +1616,21 @@ void AssemblyGraph2::writePhased(
 
         }
     }
+    SHASTA_ASSERT(sequenceIndex == writeOutputData.sequences.size());
 
 
 
-    // Write the GFA.
+    // Write the GFA and FASTA.
     if(writeGfa) {
-        gfa.write(baseName + ".gfa");
+        gfa.write(baseName + ".gfa", threadCount);
+        if(writeSequence) {
+            gfa.writeBinary(baseName + "-Graph.bin");
+        }
+    }
+    if(writeFasta) {
+        writeFastaRecords(baseName + ".fasta", threadCount);
     }
+    writeOutputData = WriteOutputData();
 
 
 
@@ -1821,6 +1896,95 @@ void AssemblyGraph2::computePhasedRegionGfaSequence(
 
 
 
+// Compute in parallel the sequences in writeOutputData.sequenceRequests
+// and store them in writeOutputData.sequences.
+void AssemblyGraph2::computeOutputSequences(size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    writeOutputData.sequences.clear();
+    writeOutputData.sequences.resize(writeOutputData.sequenceRequests.size());
+    setupLoadBalancing(writeOutputData.sequenceRequests.size(), 1);
+    runThreads(&AssemblyGraph2::computeOutputSequencesThreadFunction, threadCount);
+}
+
+
+
+void AssemblyGraph2::computeOutputSequencesThreadFunction(size_t)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const WriteOutputData::SequenceRequest& request = writeOutputData.sequenceRequests[i];
+            vector<Base>& sequence = writeOutputData.sequences[i];
+            const BubbleChain& bubbleChain = bubbleChains[request.bubbleChainId];
+            if(request.phasingRegionId == std::numeric_limits<uint64_t>::max()) {
+                computeBubbleChainGfaSequence(bubbleChain, sequence);
+            } else {
+                const auto& phasingRegion = bubbleChain.phasingRegions[request.phasingRegionId];
+                if(phasingRegion.isPhased) {
+                    computePhasedRegionGfaSequence(bubbleChain, phasingRegion, request.haplotype, sequence);
+                } else {
+                    computeUnphasedRegionGfaSequence(bubbleChain, phasingRegion, sequence);
+                }
+            }
+        }
+    }
+}
+
+
+
+// Write the FASTA records in writeOutputData.fastaRecords.
+// They are formatted in parallel, in batches, and written out in order.
+void AssemblyGraph2::writeFastaRecords(const string& fileName, size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    OrderedFileWriter writer(fileName);
+    writeOutputData.fastaWriter = &writer;
+    setupLoadBalancing(writeOutputData.fastaRecords.size(), WriteOutputData::fastaBatchSize);
+    runThreads(&AssemblyGraph2::writeFastaRecordsThreadFunction, threadCount);
+    writeOutputData.fastaWriter = 0;
+}
+
+
+
+void AssemblyGraph2::writeFastaRecordsThreadFunction(size_t)
+{
+    OrderedFileWriter& writer = *writeOutputData.fastaWriter;
+    string buffer;
+
+    // If this thread fails, the writer is aborted, so other
+    // threads don't wait forever for the batch that was not written.
+    try {
+        uint64_t begin, end;
+        while(getNextBatch(begin, end)) {
+            buffer.clear();
+            for(uint64_t i=begin; i!=end; i++) {
+                const string& name = writeOutputData.fastaRecords[i].first;
+                const vector<Base>& sequence = *writeOutputData.fastaRecords[i].second;
+                buffer.append(">");
+                buffer.append(name);
+                buffer.append(" ");
+                buffer.append(to_string(sequence.size()));
+                buffer.append("\n");
+                for(const Base b: sequence) {
+                    buffer.push_back(b.character());
+                }
+                buffer.append("\n");
+            }
+            writer.write(begin / WriteOutputData::fastaBatchSize, buffer);
+        }
+    } catch(...) {
+        writer.abort();
+        throw;
+    }
+}
+
+
+
 string AssemblyGraph2Edge::color(uint64_t branchId) const
 {
     if(isBubble()) {
@@ -3130,7 +3294,9 @@ void AssemblyGraph2::handleSuperbubbles0(
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
     bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
+    bool assemble,              // If true, assemble sequence for newly created edges
+    size_t threadCount,
+    const std::set<vertex_descriptor>* dirtyVertices
     )
 {
     G& g = *this;
@@ -3165,27 +3331,13 @@ void AssemblyGraph2::handleSuperbubbles0(
     }
 
     // Gather the vertices in each connected component.
-    std::map<uint64_t, vector<vertex_descriptor> > components;
-    BGL_FORALL_VERTICES(v, g, G) {
-        const uint64_t component = disjointSets.find_set(vertexMap[v]);
-        components[component].push_back(v);
-    }
-
+    vector< vector<vertex_descriptor> > components;
+    gatherSuperbubbleComponents(disjointSets, vertexMap, components);
 
-
-    // Process one components one at a time.
     // Each component is used to create a superbubble.
-    for(const auto& p: components) {
-        const vector<vertex_descriptor>& componentVertices = p.second;
-
-        // Create a superbubble with this component.
-        Superbubble superbubble(g, componentVertices, edgeLengthThreshold);
-
-        // Process it.
-        handleSuperbubble1(superbubble,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
-            storeReadInformation, assemble);
-    }
+    handleSuperbubbles(components, true, edgeLengthThreshold,
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
+        storeReadInformation, assemble, threadCount, dirtyVertices);
     performanceLog << timestamp << "AssemblyGraph2::handleSuperbubbles0 ends." << endl;
 }
 
@@ -3197,7 +3349,9 @@ void AssemblyGraph2::handleSuperbubbles1(
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
     bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
+    bool assemble,              // If true, assemble sequence for newly created edges
+    size_t threadCount,
+    const std::set<vertex_descriptor>* dirtyVertices
     )
 {
     G& g = *this;
@@ -3235,29 +3389,198 @@ void AssemblyGraph2::handleSuperbubbles1(
     }
 
     // Gather the vertices in each connected component.
-    std::map<uint64_t, vector<vertex_descriptor> > components;
+    vector< vector<vertex_descriptor> > components;
+    gatherSuperbubbleComponents(disjointSets, vertexMap, components);
+
+    // Each component is used to create a superbubble.
+    handleSuperbubbles(components, false, 0,
+        maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
+        storeReadInformation, assemble, threadCount, dirtyVertices);
+
+    clearBubbleChains();
+    performanceLog << timestamp << "AssemblyGraph2::handleSuperbubbles1 ends." << endl;
+}
+
+
+
+// Gather the vertices in each connected component
+// found by handleSuperbubbles0 or handleSuperbubbles1.
+// Components are stored in order of increasing representative
+// in the disjoint sets data structure.
+// Components consisting of a single vertex are skipped,
+// because handleSuperbubble1 never does anything for them:
+// the only possible superbubble edges are self-loops,
+// so the superbubble has no entrances.
+template<class DisjointSets> void AssemblyGraph2::gatherSuperbubbleComponents(
+    DisjointSets& disjointSets,
+    const std::map<vertex_descriptor, uint64_t>& vertexMap,
+    vector< vector<vertex_descriptor> >& components) const
+{
+    const G& g = *this;
+
+    std::map<uint64_t, vector<vertex_descriptor> > componentMap;
     BGL_FORALL_VERTICES(v, g, G) {
-        const uint64_t component = disjointSets.find_set(vertexMap[v]);
-        components[component].push_back(v);
+        const uint64_t component = disjointSets.find_set(vertexMap.find(v)->second);
+        componentMap[component].push_back(v);
     }
 
-    // Process one components one at a time.
-    // Each component is used to create a superbubble.
-    for(const auto& p: components) {
-        const vector<vertex_descriptor>& componentVertices = p.second;
+    components.clear();
+    for(auto& p: componentMap) {
+        if(p.second.size() > 1) {
+            components.push_back(vector<vertex_descriptor>());
+            components.back().swap(p.second);
+        }
+    }
+}
 
-        // Create a superbubble with this component.
-        Superbubble superbubble(g, componentVertices);
-        // superbubble.writeGraphviz(cout, g);
 
-        // Process it.
-        handleSuperbubble1(superbubble,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount,
-            storeReadInformation, assemble);
+
+// Process in parallel the superbubbles defined by the given components,
+// then apply the resulting changes sequentially, in the same order
+// that would be used to process the superbubbles sequentially.
+// This gives results identical to sequential processing because
+// each superbubble only reads and modifies edges with both
+// vertices in its component, and components don't share vertices.
+// If dirtyVertices is not null, components that don't contain
+// any of those vertices are skipped.
+void AssemblyGraph2::handleSuperbubbles(
+    vector< vector<vertex_descriptor> >& components,
+    bool useEdgeLengthThreshold,
+    uint64_t edgeLengthThreshold,
+    uint64_t maxSuperbubbleSize,
+    uint64_t maxSuperbubbleChunkSize,
+    uint64_t maxSuperbubbleChunkPathCount,
+    bool storeReadInformation,
+    bool assemble,
+    size_t threadCount,
+    const std::set<vertex_descriptor>* dirtyVertices)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // If requested, only keep the components that contain a dirty vertex.
+    if(dirtyVertices) {
+        const uint64_t oldComponentCount = components.size();
+        uint64_t j = 0;
+        for(uint64_t i=0; i<components.size(); i++) {
+            bool isDirty = false;
+            for(const vertex_descriptor v: components[i]) {
+                if(dirtyVertices->find(v) != dirtyVertices->end()) {
+                    isDirty = true;
+                    break;
+                }
+            }
+            if(isDirty) {
+                if(j != i) {
+                    components[j].swap(components[i]);
+                }
+                ++j;
+            }
+        }
+        components.resize(j);
+        performanceLog << timestamp << "Skipped " << oldComponentCount - j <<
+            " superbubbles with no dirty vertices." << endl;
+    }
+
+    // Compute the changes in parallel.
+    performanceLog << timestamp << "Processing " << components.size() << " superbubbles." << endl;
+    handleSuperbubblesData.useEdgeLengthThreshold = useEdgeLengthThreshold;
+    handleSuperbubblesData.edgeLengthThreshold = edgeLengthThreshold;
+    handleSuperbubblesData.maxSuperbubbleSize = maxSuperbubbleSize;
+    handleSuperbubblesData.maxSuperbubbleChunkSize = maxSuperbubbleChunkSize;
+    handleSuperbubblesData.maxSuperbubbleChunkPathCount = maxSuperbubbleChunkPathCount;
+    handleSuperbubblesData.components = &components;
+    handleSuperbubblesData.changes.clear();
+    handleSuperbubblesData.changes.resize(components.size());
+    setupLoadBalancing(components.size(), 1);
+    runThreads(&AssemblyGraph2::handleSuperbubblesThreadFunction, threadCount);
+
+    // Apply the changes sequentially.
+    performanceLog << timestamp << "Applying superbubble changes." << endl;
+    vector<edge_descriptor> newEdges;
+    for(const SuperbubbleChanges& changes: handleSuperbubblesData.changes) {
+        applySuperbubbleChanges(changes, newEdges);
+    }
+    handleSuperbubblesData.changes.clear();
+    handleSuperbubblesData.components = 0;
+
+    // Store read information and assemble the new edges, in parallel.
+    if(storeReadInformation) {
+        storeReadInformationParallelData.allEdges = newEdges;
+        setupLoadBalancing(newEdges.size(), 100);
+        runThreads(&AssemblyGraph2::storeReadInformationThreadFunction, threadCount);
+        storeReadInformationParallelData.allEdges.clear();
     }
+    if(assemble) {
+        assembleParallelData.allEdges = newEdges;
+        setupLoadBalancing(newEdges.size(), 100);
+        runThreads(&AssemblyGraph2::assembleThreadFunction, threadCount);
+        assembleParallelData.allEdges.clear();
+    }
+}
 
-    clearBubbleChains();
-    performanceLog << timestamp << "AssemblyGraph2::handleSuperbubbles1 ends." << endl;
+
+
+void AssemblyGraph2::handleSuperbubblesThreadFunction(size_t threadId)
+{
+    G& g = *this;
+    const vector< vector<vertex_descriptor> >& components = *handleSuperbubblesData.components;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+
+            // Create a superbubble with this component.
+            if(handleSuperbubblesData.useEdgeLengthThreshold) {
+                Superbubble superbubble(g, components[i], handleSuperbubblesData.edgeLengthThreshold);
+                handleSuperbubble1(superbubble,
+                    handleSuperbubblesData.maxSuperbubbleSize,
+                    handleSuperbubblesData.maxSuperbubbleChunkSize,
+                    handleSuperbubblesData.maxSuperbubbleChunkPathCount,
+                    handleSuperbubblesData.changes[i]);
+            } else {
+                Superbubble superbubble(g, components[i]);
+                handleSuperbubble1(superbubble,
+                    handleSuperbubblesData.maxSuperbubbleSize,
+                    handleSuperbubblesData.maxSuperbubbleChunkSize,
+                    handleSuperbubblesData.maxSuperbubbleChunkPathCount,
+                    handleSuperbubblesData.changes[i]);
+            }
+        }
+    }
+}
+
+
+
+// Apply the changes computed by handleSuperbubble1 for one superbubble.
+// Newly created edges are added to the last argument.
+// They don't have read information or sequence.
+void AssemblyGraph2::applySuperbubbleChanges(
+    const SuperbubbleChanges& changes,
+    vector<edge_descriptor>& newEdges)
+{
+    G& g = *this;
+
+    for(const SuperbubbleChanges::NewEdge& newEdge: changes.newEdges) {
+        if(newEdge.path1.empty()) {
+            newEdges.push_back(addEdge(newEdge.path0, newEdge.containsSecondaryEdges0, false, false));
+        } else {
+            edge_descriptor eNew;
+            bool edgeWasAdded = false;
+            tie(eNew, edgeWasAdded) = add_edge(newEdge.v0, newEdge.v1,
+                E(nextId++,
+                newEdge.path0, newEdge.containsSecondaryEdges0,
+                newEdge.path1, newEdge.containsSecondaryEdges1),
+                g);
+            SHASTA_ASSERT(edgeWasAdded);
+            newEdges.push_back(eNew);
+        }
+    }
+
+    for(const edge_descriptor e: changes.edgesToBeRemoved) {
+        boost::remove_edge(e, g);
+    }
 }
 
 
@@ -3322,8 +3645,7 @@ void AssemblyGraph2::handleSuperbubble1(
     uint64_t maxSuperbubbleSize,
     uint64_t maxSuperbubbleChunkSize,
     uint64_t maxSuperbubbleChunkPathCount,
-    bool storeReadInformation,  // If true, store read information for newly created edges.
-    bool assemble               // If true, assemble sequence for newly created edges
+    SuperbubbleChanges& changes
     )
 {
     G& g = *this;
@@ -3484,7 +3806,7 @@ void AssemblyGraph2::handleSuperbubble1(
             cout << "Removing edge " << g[sEdge.ae].pathId(sEdge.branchId) << endl;
         }
         if(sEdge.branchId==0) {
-            boost::remove_edge(sEdge.ae, g);
+            changes.edgesToBeRemoved.push_back(sEdge.ae);
         }
         boost::remove_edge(se, superbubble);
     }
@@ -3654,7 +3976,10 @@ void AssemblyGraph2::handleSuperbubble1(
             }
 
             // Create a new haploid edge with this path.
-            addEdge(markerGraphPath, containsSecondaryEdges, storeReadInformation, assemble);
+            SuperbubbleChanges::NewEdge newEdge;
+            newEdge.path0.swap(markerGraphPath);
+            newEdge.containsSecondaryEdges0 = containsSecondaryEdges;
+            changes.newEdges.push_back(newEdge);
         }
 
 
@@ -3710,20 +4035,14 @@ void AssemblyGraph2::handleSuperbubble1(
                     containsSecondaryEdges1 = true;
                 }
             }
-            edge_descriptor eNew;
-            bool edgeWasAdded = false;
-            tie(eNew, edgeWasAdded) = add_edge(av0, av1,
-                E(nextId++,
-                markerGraphPath0, containsSecondaryEdges0,
-                markerGraphPath1, containsSecondaryEdges1),
-                g);
-            SHASTA_ASSERT(edgeWasAdded);
-            if(storeReadInformation) {
-                g[eNew].storeReadInformation(markerGraph);
-            }
-            if(assemble) {
-                AssemblyGraph2::assemble(eNew);
-            }
+            SuperbubbleChanges::NewEdge newEdge;
+            newEdge.v0 = av0;
+            newEdge.v1 = av1;
+            newEdge.path0.swap(markerGraphPath0);
+            newEdge.containsSecondaryEdges0 = containsSecondaryEdges0;
+            newEdge.path1.swap(markerGraphPath1);
+            newEdge.containsSecondaryEdges1 = containsSecondaryEdges1;
+            changes.newEdges.push_back(newEdge);
         }
 
 
@@ -3748,7 +4067,10 @@ void AssemblyGraph2::handleSuperbubble1(
             }
 
             // Create a new haploid edge with this path.
-            addEdge(markerGraphPath, containsSecondaryEdges, storeReadInformation, assemble);
+            SuperbubbleChanges::NewEdge newEdge;
+            newEdge.path0.swap(markerGraphPath);
+            newEdge.containsSecondaryEdges0 = containsSecondaryEdges;
+            changes.newEdges.push_back(newEdge);
         }
 
 
@@ -3757,7 +4079,7 @@ void AssemblyGraph2::handleSuperbubble1(
         for(const Superbubble::edge_descriptor se: superbubble.chunkEdges[chunkId]) {
             const SuperbubbleEdge& sEdge = superbubble[se];
             if(sEdge.branchId == 0) {
-                boost::remove_edge(sEdge.ae, g);
+                changes.edgesToBeRemoved.push_back(sEdge.ae);
             }
         }
     }
@@ -4299,6 +4621,7 @@ void AssemblyGraph2::removeBadBubblesIterative(
     uint64_t maxSuperbubbleChunkPathCount,
     uint64_t pruneLength,
     uint64_t componentSizeThreshold,
+    bool incremental,
     size_t threadCount)
 {
     performanceLog << timestamp << "AssemblyGraph2::removeBadBubblesIterative begins." << endl;
@@ -4306,7 +4629,26 @@ void AssemblyGraph2::removeBadBubblesIterative(
     G& g = *this;
     const bool debug = false;
 
+    // For incremental processing, the value of nextId
+    // at the beginning of the previous iteration.
+    // Edges with id at least this value were created since then.
+    uint64_t previousIterationFirstId = 0;
+
+    // For incremental processing, the source and target of the edges
+    // that existed at the beginning of the previous and current iteration.
+    // These are used to find the vertices that lost an edge.
+    std::map<uint64_t, pair<vertex_descriptor, vertex_descriptor> > previousIterationEdges;
+    std::map<uint64_t, pair<vertex_descriptor, vertex_descriptor> > iterationEdges;
+
     for(uint64_t iteration=0; ; iteration++) {
+        const uint64_t iterationFirstId = nextId;
+        if(incremental) {
+            iterationEdges.clear();
+            BGL_FORALL_EDGES(e, g, G) {
+                iterationEdges.insert(make_pair(g[e].id, make_pair(source(e, g), target(e, g))));
+            }
+        }
+
         performanceLog << timestamp << "Removing bad bubbles: iteration " << iteration << " begins." << endl;
 
         // Assign each diploid bubble to its own component.
@@ -4418,11 +4760,17 @@ void AssemblyGraph2::removeBadBubblesIterative(
         }
 
         // Remove the bubbles we marked as bad.
+        // For incremental processing, their vertices become dirty.
+        std::set<vertex_descriptor> dirtyVertices;
         for(const PhasingGraph::vertex_descriptor v: badBubbles) {
             const PhasingGraphVertex& vertex = phasingGraph[v];
             SHASTA_ASSERT(vertex.bubbles.size() == 1);
             const AssemblyGraph2::edge_descriptor e = vertex.bubbles.front().first;
             g[e].removeAllBranchesExceptStrongest();
+            if(incremental) {
+                dirtyVertices.insert(source(e, g));
+                dirtyVertices.insert(target(e, g));
+            }
         }
 
         /*
@@ -4438,14 +4786,31 @@ void AssemblyGraph2::removeBadBubblesIterative(
         forceMaximumPloidy(2);
 
         // Handle superbubbles that may have appeared as a result of removing bubbles.
+        // For incremental processing, after the first iteration only process
+        // superbubbles that contain a vertex touched since the
+        // beginning of the previous iteration. The first iteration
+        // processes all superbubbles because the changes made before
+        // removeBadBubblesIterative was called are not tracked.
+        const bool useDirtyVertices = incremental and (iteration > 0);
+        if(useDirtyVertices) {
+            addDirtyVertices(previousIterationFirstId, previousIterationEdges, dirtyVertices);
+        }
         handleSuperbubbles0(superbubbleRemovalEdgeLengthThreshold,
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true);
+            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true,
+            threadCount, useDirtyVertices ? &dirtyVertices : 0);
         merge(true, true);
+        if(useDirtyVertices) {
+            addDirtyVertices(previousIterationFirstId, previousIterationEdges, dirtyVertices);
+        }
         handleSuperbubbles1(
-            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true);
+            maxSuperbubbleSize, maxSuperbubbleChunkSize, maxSuperbubbleChunkPathCount, true, true,
+            threadCount, useDirtyVertices ? &dirtyVertices : 0);
         merge(true, true);
         prune(pruneLength);
 
+        previousIterationFirstId = iterationFirstId;
+        previousIterationEdges.swap(iterationEdges);
+
         performanceLog << timestamp << "Removing bad bubbles: iteration " << iteration << " ends." << endl;
     }
 
@@ -4454,6 +4819,40 @@ void AssemblyGraph2::removeBadBubblesIterative(
 
 
 
+// Add to dirtyVertices the source and target of:
+// - All edges with id at least firstId, that is, edges created
+//   after nextId was equal to firstId.
+// - All edges in oldEdges that no longer exist.
+//   The vertices of these edges may also no longer exist,
+//   but this is harmless because dirtyVertices is only used
+//   to look up vertices that exist.
+void AssemblyGraph2::addDirtyVertices(
+    uint64_t firstId,
+    const std::map<uint64_t, pair<vertex_descriptor, vertex_descriptor> >& oldEdges,
+    std::set<vertex_descriptor>& dirtyVertices) const
+{
+    const G& g = *this;
+
+    std::set<uint64_t> edgeIds;
+    BGL_FORALL_EDGES(e, g, G) {
+        const uint64_t id = g[e].id;
+        edgeIds.insert(id);
+        if(id >= firstId) {
+            dirtyVertices.insert(source(e, g));
+            dirtyVertices.insert(target(e, g));
+        }
+    }
+
+    for(const auto& p: oldEdges) {
+        if(edgeIds.find(p.first) == edgeIds.end()) {
+            dirtyVertices.insert(p.second.first);
+            dirtyVertices.insert(p.second.second);
+        }
+    }
+}
+
+
+
 void AssemblyGraph2::hierarchicalPhase(
     uint64_t minConcordantReadCount,
     uint64_t maxDiscordantReadCount,
@@ -4626,3 +5025,282 @@ void AssemblyGraph2::updateMarkerGraph()
         }
     }
 }
+
+
+
+// File name prefix for the binary data of a stored AssemblyGraph2.
+string AssemblyGraph2::storedDataPrefix(
+    const string& largeDataFileNamePrefix,
+    bool beforePhasing)
+{
+    return largeDataFileNamePrefix +
+        (beforePhasing ? "AssemblyGraph2-BeforePhasing-" : "AssemblyGraph2-");
+}
+
+
+
+// Store the AssemblyGraph2 in binary data.
+void AssemblyGraph2::save(
+    const string& largeDataFileNamePrefix,
+    size_t largeDataPageSize,
+    bool beforePhasing,
+    size_t threadCount)
+{
+    G& g = *this;
+
+    // If using anonymous memory, there is nothing to do.
+    if(largeDataFileNamePrefix.empty()) {
+        return;
+    }
+
+    performanceLog << timestamp << "AssemblyGraph2::save begins." << endl;
+    const string prefix = storedDataPrefix(largeDataFileNamePrefix, beforePhasing);
+    StoredData storedData;
+
+    // Store the vertices.
+    std::map<vertex_descriptor, uint64_t> vertexIndexMap;
+    storedData.vertices.createNew(prefix + "Vertices", largeDataPageSize);
+    BGL_FORALL_VERTICES(v, g, G) {
+        vertexIndexMap.insert(make_pair(v, storedData.vertices.size()));
+        storedData.vertices.push_back(g[v].markerGraphVertexId);
+    }
+
+    // Store the edges and branches.
+    storedData.edges.createNew(prefix + "Edges", largeDataPageSize);
+    storedData.branches.createNew(prefix + "Branches", largeDataPageSize);
+    persistenceData.allEdges.clear();
+    BGL_FORALL_EDGES(e, g, G) {
+        const E& edge = g[e];
+        persistenceData.allEdges.push_back(e);
+
+        StoredEdge storedEdge;
+        storedEdge.id = edge.id;
+        storedEdge.vertexIndex0 = vertexIndexMap[source(e, g)];
+        storedEdge.vertexIndex1 = vertexIndexMap[target(e, g)];
+        storedEdge.firstBranch = storedData.branches.size();
+        storedEdge.ploidy = edge.ploidy();
+        storedEdge.componentId = edge.componentId;
+        storedEdge.phase = edge.phase;
+        storedEdge.period = edge.period;
+        storedEdge.backwardTransferCount = edge.backwardTransferCount;
+        storedEdge.forwardTransferCount = edge.forwardTransferCount;
+        storedEdge.isBad = edge.isBad;
+        storedData.edges.push_back(storedEdge);
+
+        for(const E::Branch& branch: edge.branches) {
+            StoredBranch storedBranch;
+            storedBranch.containsSecondaryEdges = branch.containsSecondaryEdges;
+            storedBranch.minimumCoverage = branch.minimumCoverage;
+            storedBranch.coverageSum = branch.coverageSum;
+            storedData.branches.push_back(storedBranch);
+        }
+    }
+    const uint64_t branchCount = storedData.branches.size();
+
+    // Store the header.
+    storedData.header.createNew(prefix + "Header", largeDataPageSize);
+    storedData.header->vertexCount = storedData.vertices.size();
+    storedData.header->edgeCount = storedData.edges.size();
+    storedData.header->branchCount = branchCount;
+    storedData.header->nextId = nextId;
+    storedData.header->beforePhasing = beforePhasing;
+
+    // Allocate space for the variable length information of each branch.
+    storedData.paths.createNew(prefix + "BranchPaths", largeDataPageSize);
+    storedData.rawSequences.createNew(prefix + "BranchRawSequences", largeDataPageSize);
+    storedData.gfaSequences.createNew(prefix + "BranchGfaSequences", largeDataPageSize);
+    storedData.orientedReadIds.createNew(prefix + "BranchOrientedReadIds", largeDataPageSize);
+    storedData.paths.beginPass1(branchCount);
+    storedData.rawSequences.beginPass1(branchCount);
+    storedData.gfaSequences.beginPass1(branchCount);
+    storedData.orientedReadIds.beginPass1(branchCount);
+    uint64_t branchIndex = 0;
+    for(const edge_descriptor e: persistenceData.allEdges) {
+        for(const E::Branch& branch: g[e].branches) {
+            storedData.paths.incrementCount(branchIndex, branch.path.size());
+            storedData.rawSequences.incrementCount(branchIndex, branch.rawSequence.size());
+            storedData.gfaSequences.incrementCount(branchIndex, branch.gfaSequence.size());
+            storedData.orientedReadIds.incrementCount(branchIndex, branch.orientedReadIds.size());
+            ++branchIndex;
+        }
+    }
+    storedData.paths.beginPass2();
+    storedData.rawSequences.beginPass2();
+    storedData.gfaSequences.beginPass2();
+    storedData.orientedReadIds.beginPass2();
+    storedData.paths.endPass2(false);
+    storedData.rawSequences.endPass2(false);
+    storedData.gfaSequences.endPass2(false);
+    storedData.orientedReadIds.endPass2(false);
+
+    // Copy the variable length information in parallel.
+    persistenceData.storedData = &storedData;
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(persistenceData.allEdges.size(), batchSize);
+    runThreads(&AssemblyGraph2::saveThreadFunction, threadCount);
+    persistenceData.storedData = 0;
+    persistenceData.allEdges.clear();
+
+    performanceLog << timestamp << "AssemblyGraph2::save ends." << endl;
+}
+
+
+
+void AssemblyGraph2::saveThreadFunction(size_t threadId)
+{
+    const G& g = *this;
+    StoredData& storedData = *persistenceData.storedData;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all edges assigned to this batch.
+        for(uint64_t i=begin; i!=end; ++i) {
+            const E& edge = g[persistenceData.allEdges[i]];
+            const StoredEdge& storedEdge = storedData.edges[i];
+
+            for(uint64_t j=0; j<edge.branches.size(); j++) {
+                const E::Branch& branch = edge.branches[j];
+                const uint64_t branchIndex = storedEdge.firstBranch + j;
+                copy(branch.path.begin(), branch.path.end(),
+                    storedData.paths.begin(branchIndex));
+                copy(branch.rawSequence.begin(), branch.rawSequence.end(),
+                    storedData.rawSequences.begin(branchIndex));
+                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(),
+                    storedData.gfaSequences.begin(branchIndex));
+                copy(branch.orientedReadIds.begin(), branch.orientedReadIds.end(),
+                    storedData.orientedReadIds.begin(branchIndex));
+            }
+        }
+    }
+}
+
+
+
+// Constructor from binary data stored by save.
+AssemblyGraph2::AssemblyGraph2(
+    uint64_t readRepresentation,
+    uint64_t k, // Marker length
+    const MemoryMapped::Vector<ReadFlags>& readFlags,
+    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    MarkerGraph& markerGraph,
+    const string& largeDataFileNamePrefix,
+    bool beforePhasing,
+    size_t threadCount
+    ) :
+    MultithreadedObject<AssemblyGraph2>(*this),
+    readRepresentation(readRepresentation),
+    k(k),
+    readFlags(readFlags),
+    markers(markers),
+    markerGraph(markerGraph)
+{
+    G& g = *this;
+    performanceLog << timestamp << "AssemblyGraph2 reconstruction from binary data begins." << endl;
+
+    // Access the binary data.
+    const string prefix = storedDataPrefix(largeDataFileNamePrefix, beforePhasing);
+    StoredData storedData;
+    storedData.header.accessExistingReadOnly(prefix + "Header");
+    storedData.vertices.accessExistingReadOnly(prefix + "Vertices");
+    storedData.edges.accessExistingReadOnly(prefix + "Edges");
+    storedData.branches.accessExistingReadOnly(prefix + "Branches");
+    storedData.paths.accessExistingReadOnly(prefix + "BranchPaths");
+    storedData.rawSequences.accessExistingReadOnly(prefix + "BranchRawSequences");
+    storedData.gfaSequences.accessExistingReadOnly(prefix + "BranchGfaSequences");
+    storedData.orientedReadIds.accessExistingReadOnly(prefix + "BranchOrientedReadIds");
+    SHASTA_ASSERT(storedData.header->vertexCount == storedData.vertices.size());
+    SHASTA_ASSERT(storedData.header->edgeCount == storedData.edges.size());
+    SHASTA_ASSERT(storedData.header->branchCount == storedData.branches.size());
+    SHASTA_ASSERT(storedData.header->beforePhasing == beforePhasing);
+    nextId = storedData.header->nextId;
+
+    // Create the vertices.
+    vector<vertex_descriptor> vertexTable;
+    vertexTable.reserve(storedData.vertices.size());
+    for(const MarkerGraph::VertexId markerGraphVertexId: storedData.vertices) {
+        const vertex_descriptor v = add_vertex(V(markerGraphVertexId), g);
+        vertexTable.push_back(v);
+        vertexMap.insert(make_pair(markerGraphVertexId, v));
+    }
+
+    // Create the edges, without their branches.
+    // This is sequential because it modifies the graph structure.
+    persistenceData.allEdges.clear();
+    persistenceData.allEdges.reserve(storedData.edges.size());
+    for(const StoredEdge& storedEdge: storedData.edges) {
+        edge_descriptor e;
+        tie(e, ignore) = add_edge(
+            vertexTable[storedEdge.vertexIndex0],
+            vertexTable[storedEdge.vertexIndex1],
+            E(storedEdge.id), g);
+        persistenceData.allEdges.push_back(e);
+    }
+
+    // Fill in the edges and their branches in parallel.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    persistenceData.storedData = &storedData;
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(persistenceData.allEdges.size(), batchSize);
+    runThreads(&AssemblyGraph2::loadThreadFunction, threadCount);
+    persistenceData.storedData = 0;
+    persistenceData.allEdges.clear();
+
+    // Recreate the bubble chains and phasing regions.
+    // Before phasing they don't exist yet.
+    if(not beforePhasing) {
+        findBubbleChains();
+        findPhasingRegions();
+    }
+
+    cout << "Reconstructed the mode 2 assembly graph with " << num_vertices(g) <<
+        " vertices and " << num_edges(g) << " edges." << endl;
+    performanceLog << timestamp << "AssemblyGraph2 reconstruction from binary data ends." << endl;
+}
+
+
+
+void AssemblyGraph2::loadThreadFunction(size_t threadId)
+{
+    G& g = *this;
+    const StoredData& storedData = *persistenceData.storedData;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all edges assigned to this batch.
+        for(uint64_t i=begin; i!=end; ++i) {
+            E& edge = g[persistenceData.allEdges[i]];
+            const StoredEdge& storedEdge = storedData.edges[i];
+            edge.componentId = storedEdge.componentId;
+            edge.phase = storedEdge.phase;
+            edge.period = storedEdge.period;
+            edge.backwardTransferCount = storedEdge.backwardTransferCount;
+            edge.forwardTransferCount = storedEdge.forwardTransferCount;
+            edge.isBad = storedEdge.isBad;
+
+            edge.branches.resize(storedEdge.ploidy);
+            for(uint64_t j=0; j<storedEdge.ploidy; j++) {
+                E::Branch& branch = edge.branches[j];
+                const uint64_t branchIndex = storedEdge.firstBranch + j;
+                const StoredBranch& storedBranch = storedData.branches[branchIndex];
+                branch.containsSecondaryEdges = storedBranch.containsSecondaryEdges;
+                branch.minimumCoverage = storedBranch.minimumCoverage;
+                branch.coverageSum = storedBranch.coverageSum;
+
+                const auto path = storedData.paths[branchIndex];
+                branch.path.assign(path.begin(), path.end());
+                const auto rawSequence = storedData.rawSequences[branchIndex];
+                branch.rawSequence.assign(rawSequence.begin(), rawSequence.end());
+                const auto gfaSequence = storedData.gfaSequences[branchIndex];
+                branch.gfaSequence.assign(gfaSequence.begin(), gfaSequence.end());
+                const auto orientedReadIds = storedData.orientedReadIds[branchIndex];
+                branch.orientedReadIds.assign(orientedReadIds.begin(), orientedReadIds.end());
+            }
+        }
+    }
+}
@@ -6,6 +6,8 @@
 // Shasta.
 #include "Marker.hpp"
 #include "MarkerGraph.hpp"
+#include "MemoryMappedObject.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 
 // Boost libraries.
@@ -13,6 +15,7 @@
 
 // Standard library.
 #include <map>
+#include <set>
 #include "string.hpp"
 #include "vector.hpp"
 
@@ -26,6 +29,7 @@ namespace shasta {
     class BubbleChain;
     class MarkerGraph;
     class Mode2AssemblyOptions;
+    class OrderedFileWriter;
     class ReadFlags;
 
     using AssemblyGraph2BaseClass =
@@ -260,10 +264,59 @@ public:
         uint64_t pruneLength,
         const Mode2AssemblyOptions&,
         AssemblyGraph2Statistics&,
+        const string& largeDataFileNamePrefix,
+        size_t largeDataPageSize,
         size_t threadCount,
         bool debug
         );
 
+    // Constructor from binary data stored by save.
+    // The graph is reconstructed in the same state
+    // it was in when save was called.
+    // For the final state (beforePhasing false) this includes bubble chains
+    // and phasing regions, so all output functions can be called.
+    // For the state stored before phasing, call phaseAndWriteOutput next.
+    AssemblyGraph2(
+        uint64_t readRepresentation,
+        uint64_t k, // Marker length
+        const MemoryMapped::Vector<ReadFlags>& readFlags,
+        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        MarkerGraph&,
+        const string& largeDataFileNamePrefix,
+        bool beforePhasing,
+        size_t threadCount
+        );
+
+    // Store the AssemblyGraph2 in binary data, using the given
+    // file name prefix for large data (normally Data/).
+    // The constructor stores the graph before phasing (beforePhasing true),
+    // and the Assembler stores the final graph (beforePhasing false).
+    // The two states use different file names.
+    // This does nothing if the prefix is empty (anonymous memory).
+    void save(
+        const string& largeDataFileNamePrefix,
+        size_t largeDataPageSize,
+        bool beforePhasing,
+        size_t threadCount);
+
+    // Phase, do final pruning, find bubble chains and phasing regions,
+    // update the marker graph, write the output, and store statistics.
+    // The constructor calls this after bad bubble removal.
+    // It can also be called on a graph reconstructed from the state
+    // stored before phasing, to redo phasing with different parameters
+    // without recomputing the graph.
+    void phaseAndWriteOutput(
+        uint64_t pruneLength,
+        const Mode2AssemblyOptions&,
+        AssemblyGraph2Statistics&,
+        size_t threadCount,
+        bool debug = false);
+
+    // Write the detailed, haploid, and phased output,
+    // as controlled by the given options.
+    // The statistics pointer can be zero.
+    void writeOutput(const Mode2AssemblyOptions&, AssemblyGraph2Statistics*, size_t threadCount);
+
     void writeCsv(const string& baseName) const;
     void writeVerticesCsv(const string& baseName) const;
     void writeEdgesCsv(const string& baseName) const;
@@ -273,13 +326,17 @@ public:
     // These must be called after storeGfaSequence,
     // but writeDetailed can be caller earlier for some combinations of flags
     // (see writeDetailedEarly).
+    // Sequences of bubble chains and phasing regions are computed in parallel,
+    // and GFA segments and FASTA records are formatted in parallel
+    // and written out in order using an OrderedFileWriter.
     void writeDetailed(
         const string& baseName,
         bool writeSequence,
         bool writeSequenceLengthInMarkers,
         bool writeCsv,
         bool writeGfa,
-        bool writeFasta) const;
+        bool writeFasta,
+        size_t threadCount = 0);
     void writeDetailedEarly(const string& baseName);
     void writeHaploid(
         const string& baseName,
@@ -287,16 +344,28 @@ public:
         bool writeCsv,
         bool writeGfa,
         bool writeFasta,
-        AssemblyGraph2Statistics* statistics = 0) const;
+        AssemblyGraph2Statistics* statistics = 0,
+        size_t threadCount = 0);
     void writePhased(
         const string& baseName,
         bool writeSequence,
         bool writeCsv,
         bool writeGfa,
         bool writeFasta,
-        AssemblyGraph2Statistics* statistics = 0) const;
+        AssemblyGraph2Statistics* statistics = 0,
+        size_t threadCount = 0);
     void writePhasedDetails() const;
 
+    // Check that writeDetailed, writeHaploid, and writePhased
+    // write output files that are byte-for-byte identical
+    // to the serial writers they replaced, for 1 thread and for threadCount threads.
+    // Throws an exception if a difference is found.
+    void testWriteOutput(size_t threadCount = 0);
+
+    // Check that save followed by the constructor from binary data
+    // reconstructs an identical graph.
+    void testSave(size_t threadCount = 0);
+
     // Hide a AssemblyGraph2BaseClass::Base.
     using Base = shasta::Base;
 
@@ -334,6 +403,9 @@ private:
 
     // Superbubble removal.
 
+    // If dirtyVertices is not null, only superbubbles
+    // that contain at least one of those vertices are processed.
+
     // This creates superbubbles using edges shorter than a length threshold (in markers).
     void handleSuperbubbles0(
         uint64_t edgeLengthThreshold,
@@ -341,7 +413,9 @@ private:
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
         bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        bool assemble,              // If true, assemble sequence for newly created edges
+        size_t threadCount,
+        const std::set<vertex_descriptor>* dirtyVertices = 0
         );
 
     // This creates superbubbles using all edges not in bubble chains.
@@ -350,23 +424,88 @@ private:
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
         bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        bool assemble,              // If true, assemble sequence for newly created edges
+        size_t threadCount,
+        const std::set<vertex_descriptor>* dirtyVertices = 0
         );
 
     class Superbubble;
 
+    // The changes to the AssemblyGraph2 decided by handleSuperbubble1
+    // for a single superbubble. They are computed in parallel
+    // for all superbubbles, then applied sequentially
+    // by applySuperbubbleChanges.
+    class SuperbubbleChanges {
+    public:
+
+        // The edges to be created, in the order in which they must be created.
+        // A haploid edge has an empty path1.
+        class NewEdge {
+        public:
+            vertex_descriptor v0;
+            vertex_descriptor v1;
+            MarkerGraphPath path0;
+            bool containsSecondaryEdges0 = false;
+            MarkerGraphPath path1;
+            bool containsSecondaryEdges1 = false;
+        };
+        vector<NewEdge> newEdges;
+
+        // The edges to be removed.
+        vector<edge_descriptor> edgesToBeRemoved;
+    };
+
     // This uses a dominator tree to find choking points
     // and partition the superbubble into chunks,
     // then does path enumeration on individual chunks.
+    // It does not modify the graph structure, so it can be called
+    // in parallel for different superbubbles. It only stores
+    // read information on the edges of the superbubble
+    // and stores the changes to be made in its last argument.
     void handleSuperbubble1(
         Superbubble&,
         uint64_t maxSuperbubbleSize,
         uint64_t maxSuperbubbleChunkSize,
         uint64_t maxSuperbubbleChunkPathCount,
-        bool storeReadInformation,  // If true, store read information for newly created edges.
-        bool assemble               // If true, assemble sequence for newly created edges
+        SuperbubbleChanges&
         );
 
+    // Data and functions used to process superbubbles in parallel.
+    void handleSuperbubbles(
+        vector< vector<vertex_descriptor> >& components,
+        bool useEdgeLengthThreshold,
+        uint64_t edgeLengthThreshold,
+        uint64_t maxSuperbubbleSize,
+        uint64_t maxSuperbubbleChunkSize,
+        uint64_t maxSuperbubbleChunkPathCount,
+        bool storeReadInformation,
+        bool assemble,
+        size_t threadCount,
+        const std::set<vertex_descriptor>* dirtyVertices);
+    void handleSuperbubblesThreadFunction(size_t threadId);
+    template<class DisjointSets> void gatherSuperbubbleComponents(
+        DisjointSets&,
+        const std::map<vertex_descriptor, uint64_t>& vertexMap,
+        vector< vector<vertex_descriptor> >& components) const;
+    void applySuperbubbleChanges(
+        const SuperbubbleChanges&,
+        vector<edge_descriptor>& newEdges);
+    class HandleSuperbubblesData {
+    public:
+        bool useEdgeLengthThreshold;
+        uint64_t edgeLengthThreshold;
+        uint64_t maxSuperbubbleSize;
+        uint64_t maxSuperbubbleChunkSize;
+        uint64_t maxSuperbubbleChunkPathCount;
+
+        // The vertices of each superbubble to be processed.
+        vector< vector<vertex_descriptor> >* components = 0;
+
+        // The changes computed for each superbubble.
+        vector<SuperbubbleChanges> changes;
+    };
+    HandleSuperbubblesData handleSuperbubblesData;
+
 
 
     // Remove short loop-back edges.
@@ -498,6 +637,61 @@ private:
     // in the final AssemblyGraph2.
     void updateMarkerGraph();
 
+    // Data and functions used by writeDetailed, writeHaploid, and writePhased
+    // to compute sequences and write FASTA output in parallel.
+    class WriteOutputData {
+    public:
+
+        // The sequences of bubble chains or phasing regions
+        // to be computed by computeOutputSequences.
+        // If phasingRegionId is invalid, this is the sequence of the entire
+        // bubble chain. Otherwise, it is the sequence of a phasing region,
+        // and haplotype is only used if the phasing region is phased.
+        class SequenceRequest {
+        public:
+            uint64_t bubbleChainId;
+            uint64_t phasingRegionId;
+            uint64_t haplotype;
+        };
+        vector<SequenceRequest> sequenceRequests;
+        vector< vector<Base> > sequences;
+
+        // The FASTA records to be written by writeFastaRecords, in order.
+        // The sequences are not owned.
+        vector< pair<string, const vector<Base>*> > fastaRecords;
+        OrderedFileWriter* fastaWriter = 0;
+        static const uint64_t fastaBatchSize = 100;
+    };
+    WriteOutputData writeOutputData;
+    void computeOutputSequences(size_t threadCount);
+    void computeOutputSequencesThreadFunction(size_t threadId);
+    void writeFastaRecords(const string& fileName, size_t threadCount);
+    void writeFastaRecordsThreadFunction(size_t threadId);
+
+    // The serial writers used before the output was parallelized.
+    // Only used by testWriteOutput.
+    void writeDetailedBaseline(
+        const string& baseName,
+        bool writeSequence,
+        bool writeSequenceLengthInMarkers,
+        bool writeCsv,
+        bool writeGfa,
+        bool writeFasta) const;
+    void writeHaploidBaseline(
+        const string& baseName,
+        bool writeSequence,
+        bool writeCsv,
+        bool writeGfa,
+        bool writeFasta,
+        AssemblyGraph2Statistics* statistics = 0) const;
+    void writePhasedBaseline(
+        const string& baseName,
+        bool writeSequence,
+        bool writeCsv,
+        bool writeGfa,
+        bool writeFasta,
+        AssemblyGraph2Statistics* statistics = 0) const;
+
     // Compute the gfa sequence of a bubble chain
     // by concatenating gfa sequence of the strongest branch of
     // each of this edges.
@@ -618,6 +812,9 @@ private:
 
 
     // Iteratively remove bad bubbles using the PhasingGraph.
+    // If incremental is true, after the first iteration superbubbles
+    // are only processed if they contain a vertex touched by the previous
+    // or current iteration (see addDirtyVertices).
     void removeBadBubblesIterative(
         uint64_t minConcordantReadCount,
         uint64_t maxDiscordantReadCount,
@@ -629,8 +826,18 @@ private:
         uint64_t maxSuperbubbleChunkPathCount,
         uint64_t pruneLength,
         uint64_t componentSizeThreshold,
+        bool incremental,
         size_t threadCount);
 
+    // Add to dirtyVertices the source and target of all edges
+    // with id at least firstId and of all edges in oldEdges
+    // that no longer exist. Edge ids are assigned in increasing order,
+    // so the first are the edges created after nextId was equal to firstId.
+    void addDirtyVertices(
+        uint64_t firstId,
+        const std::map<uint64_t, pair<vertex_descriptor, vertex_descriptor> >& oldEdges,
+        std::set<vertex_descriptor>& dirtyVertices) const;
+
     // Hierarchical phasing using the PhasingGraph.
     void hierarchicalPhase(
         uint64_t minConcordantReadCount,
@@ -642,6 +849,71 @@ private:
     // Renumber component to make them contiguous starting at 0.
     void renumberComponents();
 
+
+
+    // Classes used by save and by the constructor from binary data.
+    // Vertices are stored in the order of a vertex iteration,
+    // and edges in the order of an edge iteration.
+    // This way, the reconstructed graph iterates over vertices and edges
+    // in the same order as the original graph.
+    // The branches of each edge are stored contiguously.
+    class StoredHeader {
+    public:
+        uint64_t vertexCount;
+        uint64_t edgeCount;
+        uint64_t branchCount;
+        uint64_t nextId;
+        bool beforePhasing;
+    };
+    class StoredEdge {
+    public:
+        uint64_t id;
+        uint64_t vertexIndex0;
+        uint64_t vertexIndex1;
+        uint64_t firstBranch;
+        uint64_t ploidy;
+        uint64_t componentId;
+        uint64_t phase;
+        uint64_t period;
+        uint64_t backwardTransferCount;
+        uint64_t forwardTransferCount;
+        bool isBad;
+    };
+    class StoredBranch {
+    public:
+        bool containsSecondaryEdges;
+        uint64_t minimumCoverage;
+        uint64_t coverageSum;
+    };
+    class StoredData {
+    public:
+        MemoryMapped::Object<StoredHeader> header;
+        MemoryMapped::Vector<MarkerGraph::VertexId> vertices;
+        MemoryMapped::Vector<StoredEdge> edges;
+        MemoryMapped::Vector<StoredBranch> branches;
+
+        // Indexed by global branch index.
+        MemoryMapped::VectorOfVectors<MarkerGraph::EdgeId, uint64_t> paths;
+        MemoryMapped::VectorOfVectors<Base, uint64_t> rawSequences;
+        MemoryMapped::VectorOfVectors<Base, uint64_t> gfaSequences;
+        MemoryMapped::VectorOfVectors<OrientedReadId, uint64_t> orientedReadIds;
+    };
+
+    // Data used by the multithreaded portions of save and
+    // of the constructor from binary data.
+    class PersistenceData {
+    public:
+        vector<edge_descriptor> allEdges;
+        StoredData* storedData = 0;
+    };
+    PersistenceData persistenceData;
+    void saveThreadFunction(size_t threadId);
+    void loadThreadFunction(size_t threadId);
+    static string storedDataPrefix(const string& largeDataFileNamePrefix, bool beforePhasing);
+
+    // Only used by testSave.
+    void compare(const AssemblyGraph2&, bool beforePhasing) const;
+
 };
 
 
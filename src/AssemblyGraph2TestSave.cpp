@@ -0,0 +1,185 @@
+// Round trip test of AssemblyGraph2::save and of the constructor
+// from binary data.
+// Use it on a small mode 2 assembly via shasta/scripts/TestSaveAssemblyGraph2.py.
+
+// Shasta.
+#include "AssemblyGraph2.hpp"
+#include "platformDependent.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/graph/iteration_macros.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+// Standard library.
+#include <filesystem>
+#include "iostream.hpp"
+#include <thread>
+
+
+
+// Save this AssemblyGraph2 to a temporary location, reconstruct it,
+// and check that the reconstructed graph is identical,
+// including vertex and edge iteration order, all edge and branch fields,
+// bubble chains, and phasing regions.
+// Both stored states (before and after phasing) are exercised.
+// For the state before phasing, the reconstructed graph
+// is expected to have no bubble chains.
+// Throws an exception if a difference is found.
+void AssemblyGraph2::testSave(size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const string directory = tmpDirectory();
+    const string fileNamePrefix = to_string(boost::uuids::random_generator()()) + ".testSave-";
+    const size_t pageSize = 4096;
+
+    for(const bool beforePhasing: {false, true}) {
+        const string description = beforePhasing ? "before phasing" : "after phasing";
+        save(directory + fileNamePrefix, pageSize, beforePhasing, threadCount);
+        const AssemblyGraph2 reconstructedGraph(readRepresentation, k, readFlags, markers, markerGraph,
+            directory + fileNamePrefix, beforePhasing, threadCount);
+
+        // Remove the binary data before checking, so a failure does not leave it behind.
+        for(const auto& entry: std::filesystem::directory_iterator(directory)) {
+            if(entry.path().filename().string().find(fileNamePrefix) == 0) {
+                std::filesystem::remove(entry.path());
+            }
+        }
+
+        try {
+            compare(reconstructedGraph, beforePhasing);
+        } catch(const exception& e) {
+            throw runtime_error("AssemblyGraph2::testSave failed " + description + ": " + e.what());
+        }
+        cout << "AssemblyGraph2::testSave: reconstructed graph " << description <<
+            " is identical to the original (" <<
+            num_vertices(reconstructedGraph) << " vertices, " <<
+            num_edges(reconstructedGraph) << " edges, " <<
+            reconstructedGraph.bubbleChains.size() << " bubble chains)." << endl;
+    }
+}
+
+
+
+// Check that another AssemblyGraph2 is identical to this one.
+// Throws an exception if a difference is found.
+// If beforePhasing is true, bubble chains and phasing regions
+// of the other graph are expected to be empty.
+void AssemblyGraph2::compare(const AssemblyGraph2& that, bool beforePhasing) const
+{
+    const G& g0 = *this;
+    const G& g1 = that;
+
+    if(nextId != that.nextId) {
+        throw runtime_error("Different nextId.");
+    }
+    if(num_vertices(g0) != num_vertices(g1)) {
+        throw runtime_error("Different number of vertices.");
+    }
+    if(num_edges(g0) != num_edges(g1)) {
+        throw runtime_error("Different number of edges.");
+    }
+
+    // Compare vertices in iteration order.
+    // Also construct a map from the vertices of this graph
+    // to the vertices of the other graph.
+    std::map<vertex_descriptor, vertex_descriptor> vertexTable;
+    {
+        auto it1 = vertices(g1).first;
+        BGL_FORALL_VERTICES(v0, g0, G) {
+            const vertex_descriptor v1 = *it1++;
+            if(g0[v0].markerGraphVertexId != g1[v1].markerGraphVertexId) {
+                throw runtime_error("Different vertex.");
+            }
+            vertexTable.insert(make_pair(v0, v1));
+        }
+    }
+
+    // Compare edges in iteration order.
+    // Also construct a map from the edges of this graph
+    // to the edges of the other graph.
+    std::map<edge_descriptor, edge_descriptor> edgeTable;
+    {
+        auto it1 = edges(g1).first;
+        BGL_FORALL_EDGES(e0, g0, G) {
+            const edge_descriptor e1 = *it1++;
+            edgeTable.insert(make_pair(e0, e1));
+            const E& edge0 = g0[e0];
+            const E& edge1 = g1[e1];
+            const string message = "Different edge " + to_string(edge0.id) + ".";
+
+            if(vertexTable[source(e0, g0)] != source(e1, g1) or
+                vertexTable[target(e0, g0)] != target(e1, g1)) {
+                throw runtime_error(message);
+            }
+            if(edge0.id != edge1.id or
+                edge0.ploidy() != edge1.ploidy() or
+                edge0.componentId != edge1.componentId or
+                edge0.phase != edge1.phase or
+                edge0.period != edge1.period or
+                edge0.backwardTransferCount != edge1.backwardTransferCount or
+                edge0.forwardTransferCount != edge1.forwardTransferCount or
+                edge0.isBad != edge1.isBad) {
+                throw runtime_error(message);
+            }
+
+            for(uint64_t branchId=0; branchId<edge0.ploidy(); branchId++) {
+                const E::Branch& branch0 = edge0.branches[branchId];
+                const E::Branch& branch1 = edge1.branches[branchId];
+                if(branch0.path != branch1.path or
+                    branch0.containsSecondaryEdges != branch1.containsSecondaryEdges or
+                    branch0.rawSequence != branch1.rawSequence or
+                    branch0.gfaSequence != branch1.gfaSequence or
+                    branch0.orientedReadIds != branch1.orientedReadIds or
+                    branch0.minimumCoverage != branch1.minimumCoverage or
+                    branch0.coverageSum != branch1.coverageSum) {
+                    throw runtime_error(message);
+                }
+            }
+        }
+    }
+
+    // Compare bubble chains and their phasing regions.
+    if(beforePhasing) {
+        if(not that.bubbleChains.empty()) {
+            throw runtime_error("Unexpected bubble chains.");
+        }
+        return;
+    }
+    if(bubbleChains.size() != that.bubbleChains.size()) {
+        throw runtime_error("Different number of bubble chains.");
+    }
+    for(uint64_t bubbleChainId=0; bubbleChainId<bubbleChains.size(); bubbleChainId++) {
+        const BubbleChain& bubbleChain0 = bubbleChains[bubbleChainId];
+        const BubbleChain& bubbleChain1 = that.bubbleChains[bubbleChainId];
+        const string message = "Different bubble chain " + to_string(bubbleChainId) + ".";
+
+        if(bubbleChain0.edges.size() != bubbleChain1.edges.size()) {
+            throw runtime_error(message);
+        }
+        for(uint64_t position=0; position<bubbleChain0.edges.size(); position++) {
+            if(edgeTable[bubbleChain0.edges[position]] != bubbleChain1.edges[position]) {
+                throw runtime_error(message);
+            }
+        }
+
+        if(bubbleChain0.phasingRegions.size() != bubbleChain1.phasingRegions.size()) {
+            throw runtime_error(message);
+        }
+        for(uint64_t i=0; i<bubbleChain0.phasingRegions.size(); i++) {
+            const BubbleChain::PhasingRegion& phasingRegion0 = bubbleChain0.phasingRegions[i];
+            const BubbleChain::PhasingRegion& phasingRegion1 = bubbleChain1.phasingRegions[i];
+            if(phasingRegion0.firstPosition != phasingRegion1.firstPosition or
+                phasingRegion0.lastPosition != phasingRegion1.lastPosition or
+                phasingRegion0.isPhased != phasingRegion1.isPhased or
+                phasingRegion0.componentId != phasingRegion1.componentId) {
+                throw runtime_error(message);
+            }
+        }
+    }
+}
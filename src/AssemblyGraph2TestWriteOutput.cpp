@@ -0,0 +1,793 @@
+// Test of the parallel mode 2 assembly output (writeDetailed, writeHaploid,
+// writePhased) against the serial writers they replaced.
+// Use it on a small mode 2 assembly via shasta/scripts/TestWriteAssemblyGraph2.py.
+
+// Shasta.
+#include "AssemblyGraph2.hpp"
+#include "AssemblyGraph2Statistics.hpp"
+#include "GfaAssemblyGraph.hpp"
+#include "platformDependent.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/graph/iteration_macros.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+// Standard library.
+#include <filesystem>
+#include "fstream.hpp"
+#include "iostream.hpp"
+#include "iterator.hpp"
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+
+
+// Compare two output files and remove them.
+// Throws an exception if they differ.
+static void compareTestOutput(
+    const string& fileName,
+    const string& referenceFileName,
+    const string& description)
+{
+    const bool exists = std::filesystem::exists(fileName);
+    const bool referenceExists = std::filesystem::exists(referenceFileName);
+    if(exists != referenceExists) {
+        throw runtime_error("AssemblyGraph2::testWriteOutput failed for " + description +
+            ": only one of " + fileName + " and " + referenceFileName + " exists.");
+    }
+    if(not exists) {
+        return;
+    }
+
+    string output;
+    string reference;
+    {
+        ifstream file(fileName, std::ios::binary);
+        std::ostringstream s;
+        s << file.rdbuf();
+        output = s.str();
+    }
+    {
+        ifstream file(referenceFileName, std::ios::binary);
+        std::ostringstream s;
+        s << file.rdbuf();
+        reference = s.str();
+    }
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(referenceFileName);
+
+    if(output != reference) {
+        uint64_t offset = 0;
+        while(offset < output.size() and offset < reference.size() and
+            output[offset] == reference[offset]) {
+            ++offset;
+        }
+        throw runtime_error("AssemblyGraph2::testWriteOutput failed for " + description +
+            ": output has " + to_string(output.size()) + " bytes, reference has " +
+            to_string(reference.size()) + " bytes, first difference at offset " +
+            to_string(offset) + ".");
+    }
+    cout << "AssemblyGraph2::testWriteOutput: " << description << ", " <<
+        output.size() << " bytes identical to reference." << endl;
+}
+
+
+
+void AssemblyGraph2::testWriteOutput(size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const string prefix = tmpDirectory() +
+        to_string(boost::uuids::random_generator()()) + ".testWriteOutput";
+    const string baseName = prefix + "-Output";
+    const string referenceBaseName = prefix + "-Reference";
+
+    // The combinations of flags used by writeOutput and writeDetailedEarly.
+    // Each entry is writeSequence, writeSequenceLengthInMarkers (writeDetailed only),
+    // writeCsv, writeGfa, writeFasta.
+    const vector< array<bool, 5> > detailedFlags = {
+        {true, false, true, true, true},
+        {false, false, false, true, false},
+        {false, true, true, true, false}};
+    const vector< array<bool, 5> > haploidAndPhasedFlags = {
+        {true, false, true, true, true},
+        {false, false, false, true, false}};
+
+    for(const size_t testThreadCount: {size_t(1), threadCount}) {
+        const string threadsString = " with " + to_string(testThreadCount) + " threads";
+
+        for(const auto& flags: detailedFlags) {
+            writeDetailed(baseName, flags[0], flags[1], flags[2], flags[3], flags[4], testThreadCount);
+            writeDetailedBaseline(referenceBaseName, flags[0], flags[1], flags[2], flags[3], flags[4]);
+            std::filesystem::remove(baseName + "-Graph.bin");
+            for(const string extension: {".gfa", ".fasta", ".csv"}) {
+                compareTestOutput(baseName + extension, referenceBaseName + extension,
+                    "writeDetailed " + extension + threadsString);
+            }
+        }
+
+        for(const auto& flags: haploidAndPhasedFlags) {
+            AssemblyGraph2Statistics statistics;
+            AssemblyGraph2Statistics referenceStatistics;
+            writeHaploid(baseName, flags[0], flags[2], flags[3], flags[4], &statistics, testThreadCount);
+            writeHaploidBaseline(referenceBaseName, flags[0], flags[2], flags[3], flags[4], &referenceStatistics);
+            std::filesystem::remove(baseName + "-Graph.bin");
+            for(const string extension: {".gfa", ".fasta", ".csv"}) {
+                compareTestOutput(baseName + extension, referenceBaseName + extension,
+                    "writeHaploid " + extension + threadsString);
+            }
+            SHASTA_ASSERT(statistics.totalBubbleChainLength == referenceStatistics.totalBubbleChainLength);
+            SHASTA_ASSERT(statistics.bubbleChainN50 == referenceStatistics.bubbleChainN50);
+        }
+
+        for(const auto& flags: haploidAndPhasedFlags) {
+            AssemblyGraph2Statistics statistics;
+            AssemblyGraph2Statistics referenceStatistics;
+            writePhased(baseName, flags[0], flags[2], flags[3], flags[4], &statistics, testThreadCount);
+            writePhasedBaseline(referenceBaseName, flags[0], flags[2], flags[3], flags[4], &referenceStatistics);
+            std::filesystem::remove(baseName + "-Graph.bin");
+            for(const string extension: {".gfa", ".fasta", ".csv"}) {
+                compareTestOutput(baseName + extension, referenceBaseName + extension,
+                    "writePhased " + extension + threadsString);
+            }
+            SHASTA_ASSERT(statistics.totalDiploidLengthBothHaplotypes ==
+                referenceStatistics.totalDiploidLengthBothHaplotypes);
+            SHASTA_ASSERT(statistics.diploidN50 == referenceStatistics.diploidN50);
+            SHASTA_ASSERT(statistics.totalHaploidLength == referenceStatistics.totalHaploidLength);
+            SHASTA_ASSERT(statistics.haploidN50 == referenceStatistics.haploidN50);
+        }
+    }
+}
+
+
+
+// The serial writers used before the output was parallelized.
+// These are unmodified copies of the original writeDetailed, writeHaploid,
+// and writePhased, except for the function names, the
+// removal of performanceLog messages, and the use of
+// GfaAssemblyGraph::writeSerial, which contains the original GFA writer.
+// Do not change them: they are the reference for testWriteOutput.
+
+void AssemblyGraph2::writeDetailedBaseline(
+    const string& baseName,
+    bool writeSequence,
+    bool writeSequenceLengthInMarkers,
+    bool writeCsv,
+    bool writeGfa,
+    bool writeFasta) const
+{
+    // Check that we are not called with the forbidden combination
+    // (see above comments).
+    SHASTA_ASSERT(not(writeSequence and writeSequenceLengthInMarkers));
+
+    const G& g = *this;
+
+
+    // Open the accompanying csv file and write the header.
+    ofstream csv;
+    if(writeCsv) {
+        csv.open(baseName + ".csv");
+        csv << "Name,Component,Phase,Unphased strength,Color,"
+            "First marker graph vertex,Last marker graph vertex,"
+            "First marker graph edge,Last marker graph edge,"
+            "Length in markers,"
+            "Length in bases,"
+            "Secondary,Period,"
+            "Minimum marker graph edge coverage,Average marker graph edge coverage,Number of distinct oriented reads,";
+        if(writeSequence) {
+            csv << "Sequence,";
+        }
+        csv << "\n";
+    }
+
+
+    // Open the fasta file.
+    ofstream fasta;
+    if(writeFasta) {
+        fasta.open(baseName + ".fasta");
+    }
+
+    // Create a GFA with a segment for each branch, then write it out.
+    GfaAssemblyGraph<vertex_descriptor> gfa;
+    BGL_FORALL_EDGES(e, g, G) {
+        const E& edge = g[e];
+        const vertex_descriptor v0 = source(e, g);
+        const vertex_descriptor v1 = target(e, g);
+
+        for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
+            const E::Branch& branch = edge.branches[branchId];
+
+            if(writeGfa) {
+                if(writeSequence) {
+                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence);
+                } else {
+                    if(writeSequenceLengthInMarkers) {
+                        gfa.addSegment(edge.pathId(branchId), v0, v1, branch.path.size());
+                    } else {
+                        gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence.size());
+                    }
+                }
+            }
+
+            if(writeFasta) {
+                fasta << ">" << edge.pathId(branchId) << " " << branch.gfaSequence.size() << "\n";
+                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
+                fasta << "\n";
+            }
+
+
+
+            // Write a line for this segment to the csv file.
+            if(writeCsv) {
+
+                // Get some information we need below.
+                const uint64_t lengthInMarkers = branch.path.size();
+                SHASTA_ASSERT(lengthInMarkers > 0);
+                const MarkerGraphEdgeId firstMarkerGraphEdgeId = branch.path.front();
+                const MarkerGraphEdgeId lastMarkerGraphEdgeId = branch.path.back();
+                const MarkerGraphVertexId firstMarkerGraphVertexId = markerGraph.edges[firstMarkerGraphEdgeId].source;
+                const MarkerGraphVertexId lastMarkerGraphVertexId = markerGraph.edges[lastMarkerGraphEdgeId].target;
+                const string color = edge.color(branchId);
+
+                csv <<
+                    edge.pathId(branchId) << ",";
+                if(edge.componentId != std::numeric_limits<uint64_t>::max()) {
+                    csv << edge.componentId;
+                }
+                csv << ",";
+
+                if(edge.phase != std::numeric_limits<uint64_t>::max()) {
+                    csv << (branchId == edge.phase ? 0 : 1);
+                }
+                csv << ",";
+
+                if(edge.isBubble() and (edge.isBad or edge.phase == std::numeric_limits<uint64_t>::max())) {
+                    if(branchId == edge.getStrongestBranchId()) {
+                        csv << "Strong";
+                    } else {
+                        csv << "Weak";
+                    }
+                }
+                csv << ",";
+
+                csv <<
+                    color << "," <<
+                    firstMarkerGraphVertexId << "," <<
+                    lastMarkerGraphVertexId << "," <<
+                    firstMarkerGraphEdgeId << "," <<
+                    lastMarkerGraphEdgeId << "," <<
+                    lengthInMarkers << ",";
+
+                if(writeSequence or (not writeSequenceLengthInMarkers)) {
+                    csv << branch.gfaSequence.size();
+                }
+                csv << ",";
+
+                csv <<
+                    (branch.containsSecondaryEdges ? "S" : "") << "," <<
+                    (edge.period ? to_string(edge.period) : string()) << "," <<
+                    branch.minimumCoverage << "," <<
+                    branch.averageCoverage() << "," <<
+                    branch.orientedReadIds.size() << ",";
+                if(writeSequence) {
+                    if(branch.gfaSequence.size() == 0) {
+                        csv << "-";
+                    } else if(branch.gfaSequence.size() <= 6) {
+                        copy(branch.gfaSequence.begin(), branch.gfaSequence.end(),
+                            ostream_iterator<Base>(csv));
+                    } else {
+                        csv << "...";
+                    }
+                    csv << ",";
+                }
+                csv << "\n";
+            }
+        }
+    }
+
+
+
+    // Add paths.
+    if(writeGfa) {
+        for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+            const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
+            for(uint64_t phasingRegionId=0;
+                phasingRegionId<uint64_t(bubbleChain.phasingRegions.size()); phasingRegionId++) {
+                const auto& phasingRegion = bubbleChain.phasingRegions[phasingRegionId];
+
+                vector<string> path0;
+                vector<string> path1;
+
+                for(uint64_t position=phasingRegion.firstPosition;
+                    position<=phasingRegion.lastPosition; position++) {
+                    const edge_descriptor e = bubbleChain.edges[position];
+                    const E& edge = g[e];
+
+                    if(edge.componentId == std::numeric_limits<uint64_t>::max()) {
+
+                        // This edge is homozygous or unphased.
+                        const string segmentName = edge.pathId(edge.getStrongestBranchId());
+                        path0.push_back(segmentName);
+                        path1.push_back(segmentName);
+
+                    } else {
+
+                        // This edge is diploid and phased.
+                        SHASTA_ASSERT(edge.ploidy() == 2);
+                        SHASTA_ASSERT(edge.componentId == phasingRegion.componentId);
+
+                        string segmentName0 = edge.pathId(0);
+                        string segmentName1 = edge.pathId(1);
+
+                        if(edge.phase == 0) {
+                            path0.push_back(segmentName0);
+                            path1.push_back(segmentName1);
+                        } else {
+                            path0.push_back(segmentName1);
+                            path1.push_back(segmentName0);
+                        }
+
+                    }
+                }
+
+                // Each phased (diploid) region generates two paths.
+                // Each unphased (haploid) region generates one path.
+                if(phasingRegion.isPhased) {
+                    const string idPrefix =
+                        "PR." +
+                        to_string(bubbleChainId) + "." +
+                        to_string(phasingRegionId) + "." +
+                        to_string(phasingRegion.componentId) + ".";
+                    gfa.addPath(idPrefix + "0", path0);
+                    gfa.addPath(idPrefix + "1", path1);
+                } else {
+                    SHASTA_ASSERT(path0 == path1);
+                    const string idString =
+                        "UR." +
+                        to_string(bubbleChainId) + "." +
+                        to_string(phasingRegionId);
+                    gfa.addPath(idString, path0);
+                }
+            }
+        }
+    }
+
+
+
+    // Write out the GFA.
+    if(writeGfa) {
+        gfa.writeSerial(baseName + ".gfa");
+    }
+}
+
+
+
+void AssemblyGraph2::writeHaploidBaseline(
+    const string& baseName,
+    bool writeSequence,
+    bool writeCsv,
+    bool writeGfa,
+    bool writeFasta,
+    AssemblyGraph2Statistics* statistics) const
+{
+    const G& g = *this;
+
+    vector<uint64_t> bubbleChainLengths;
+    uint64_t totalNonBubbleChainLength = 0;
+
+    // Open the fasta file.
+    ofstream fasta;
+    if(writeFasta) {
+        fasta.open(baseName + ".fasta");
+    }
+
+    // Create a GFA and add a segment for each edge that is not part
+    // of a bubble chain.
+    GfaAssemblyGraph<vertex_descriptor> gfa;
+    BGL_FORALL_EDGES(e, g, G) {
+        const E& edge = g[e];
+        if(edge.bubbleChain.first) {
+            continue;
+        }
+
+        const vertex_descriptor v0 = source(e, g);
+        const vertex_descriptor v1 = target(e, g);
+
+        for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
+            const E::Branch& branch = edge.branches[branchId];
+            totalNonBubbleChainLength += branch.gfaSequence.size();
+
+            if(writeGfa) {
+                if(writeSequence) {
+                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence);
+                } else {
+                    gfa.addSegment(edge.pathId(branchId), v0, v1, branch.gfaSequence.size());
+                }
+            }
+
+            if(writeFasta) {
+                fasta << ">" << edge.pathId(branchId) << " " << branch.gfaSequence.size() << "\n";
+                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
+                fasta << "\n";
+            }
+        }
+    }
+
+
+
+    // Add a segment for each bubble chain.
+    for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+        const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
+        const vertex_descriptor v0 = source(bubbleChain.edges.front(), g);
+        const vertex_descriptor v1 = target(bubbleChain.edges.back(), g);
+
+        vector<Base> sequence;
+        computeBubbleChainGfaSequence(bubbleChain, sequence);
+        bubbleChainLengths.push_back(uint64_t(sequence.size()));
+
+        const string idString = "BC." + to_string(bubbleChainId);
+
+        if(writeGfa) {
+            if(writeSequence) {
+                gfa.addSegment(idString, v0, v1, sequence);
+            } else {
+                gfa.addSegment(idString, v0, v1, sequence.size());
+            }
+        }
+
+        if(writeFasta) {
+            fasta << ">" << idString << " " << sequence.size() << "\n";
+            copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
+            fasta << "\n";
+        }
+    }
+
+
+
+    // Write the GFA.
+    if(writeGfa) {
+        gfa.writeSerial(baseName + ".gfa");
+    }
+
+
+
+    // Also write a csv file that can be used in Bandage.
+    if(writeCsv) {
+        ofstream csv(baseName + ".csv");
+        csv << "Name,ComponentId,Phase,Color,First marker graph edge,Last marker graph edge,"
+            "Secondary,Period,"
+            "Minimum edge coverage,Average edge coverage,Number of distinct oriented reads,\n";
+
+
+
+        // Write a line to csv for each edge that is not part of a bubble chain.
+        BGL_FORALL_EDGES(e, g, G) {
+            const E& edge = g[e];
+            if(edge.bubbleChain.first) {
+                continue;
+            }
+
+            for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
+                const E::Branch& branch = edge.branches[branchId];
+
+                const string color = edge.color(branchId);
+                csv <<
+                    edge.pathId(branchId) << ",";
+                if(edge.componentId != std::numeric_limits<uint64_t>::max()) {
+                    csv << edge.componentId;
+                }
+                csv << ",";
+                if(edge.phase != std::numeric_limits<uint64_t>::max()) {
+                    csv << (branchId == edge.phase ? 0 : 1);
+                }
+                csv <<
+                    "," <<
+                    color << "," <<
+                    branch.path.front() << "," << branch.path.back() << "," <<
+                    (branch.containsSecondaryEdges ? "S" : "") << "," <<
+                    (edge.period ? to_string(edge.period) : string()) << "," <<
+                    branch.minimumCoverage << "," <<
+                    branch.averageCoverage() << "," <<
+                    branch.orientedReadIds.size() << "\n";
+            }
+        }
+
+
+
+        // Write a line to csv for each bubble chain.
+        for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+            const string idString = "BC." + to_string(bubbleChainId);
+            csv << idString << ",,,Cyan\n";
+        }
+
+
+
+        // Statistics.
+        const uint64_t totalLength =
+            accumulate(bubbleChainLengths.begin(), bubbleChainLengths.end(), 0ULL);
+        sort(bubbleChainLengths.begin(), bubbleChainLengths.end(), std::greater<uint64_t>());
+        uint64_t n50 = 0;
+        uint64_t cumulativeLength = 0;
+        for(const uint64_t length: bubbleChainLengths) {
+            cumulativeLength += length;
+            if(cumulativeLength >= totalLength/2) {
+                n50 = length;
+                break;
+            }
+        }
+        cout << "Total length of bubble chains " << totalLength <<
+            ", N50 " << n50 << endl;
+        // cout << "Total length assembled outside of bubble chains " << totalNonBubbleChainLength << endl;
+        if(statistics) {
+            statistics->totalBubbleChainLength = totalLength;
+            statistics->bubbleChainN50 = n50;
+        }
+    }
+}
+
+
+
+void AssemblyGraph2::writePhasedBaseline(
+    const string& baseName,
+    bool writeSequence,
+    bool writeCsv,
+    bool writeGfa,
+    bool writeFasta,
+    AssemblyGraph2Statistics* statistics) const
+{
+    const G& g = *this;
+
+    // Length statistics.
+    uint64_t totalHaploidBases = 0;
+    uint64_t totalDiploidBases = 0;
+    uint64_t totalNonBubbleChainBases = 0;
+
+    // Tables used to compute N50 for diploid and haploid segments
+    // that are part of bubble chains.
+    vector<uint64_t> haploidLengths;
+    vector<uint64_t> diploidLengths;
+
+    // Also write a csv file that can be used in Bandage.
+    ofstream csv;
+    if(writeCsv) {
+        csv.open(baseName + ".csv");
+        csv << "Name,Position in bubble chain,Ploidy,Bubble chain,Component,Haplotype,Length,Color\n";
+    }
+
+    // Open the fasta file.
+    ofstream fasta;
+    if(writeFasta) {
+        fasta.open(baseName + ".fasta");
+    }
+
+    // Create a GFA and add a segment for each edge that is not part
+    // of a bubble chain.
+    GfaAssemblyGraph<vertex_descriptor> gfa;
+    BGL_FORALL_EDGES(e, g, G) {
+        const E& edge = g[e];
+        if(edge.bubbleChain.first) {
+            continue;
+        }
+
+        const vertex_descriptor v0 = source(e, g);
+        const vertex_descriptor v1 = target(e, g);
+
+        for(uint64_t branchId=0; branchId<edge.ploidy(); branchId++) {
+            const E::Branch& branch = edge.branches[branchId];
+            const string segmentId = edge.pathId(branchId);
+
+            if(writeGfa) {
+                if(writeSequence) {
+                    gfa.addSegment(segmentId, v0, v1, branch.gfaSequence);
+                } else {
+                    gfa.addSegment(segmentId, v0, v1, branch.gfaSequence.size());
+                }
+            }
+
+            if(writeFasta) {
+                fasta << ">" << segmentId << " " << branch.gfaSequence.size() << "\n";
+                copy(branch.gfaSequence.begin(), branch.gfaSequence.end(), ostream_iterator<Base>(fasta));
+                fasta << "\n";
+            }
+
+            if(writeCsv) {
+                csv << segmentId << ",,,,,,,#808080\n";
+            }
+            totalNonBubbleChainBases += uint64_t(branch.gfaSequence.size());
+        }
+    }
+
+
+
+    // Add one or two segments, depending on ploidy, for each phasing region
+    // of each bubble chain.
+    vector<Base> sequence;
+    for(uint64_t bubbleChainId=0; bubbleChainId<uint64_t(bubbleChains.size()); bubbleChainId++) {
+        const BubbleChain& bubbleChain = bubbleChains[bubbleChainId];
+        for(uint64_t phasingRegionId=0;
+            phasingRegionId<uint64_t(bubbleChain.phasingRegions.size()); phasingRegionId++) {
+            const auto& phasingRegion = bubbleChain.phasingRegions[phasingRegionId];
+
+            const vertex_descriptor v0 = source(bubbleChain.edges[phasingRegion.firstPosition], g);
+            const vertex_descriptor v1 = target(bubbleChain.edges[phasingRegion.lastPosition], g);
+
+            if(phasingRegion.isPhased) {
+
+                const string namePrefix =
+                    "PR." +
+                    to_string(bubbleChainId) + "." +
+                    to_string(phasingRegionId) + "." +
+                    to_string(phasingRegion.componentId) + ".";
+
+                const string name0 = namePrefix + "0";
+                computePhasedRegionGfaSequence(bubbleChain, phasingRegion, 0, sequence);
+
+                if(writeGfa) {
+                    if(writeSequence) {
+                        gfa.addSegment(name0, v0, v1, sequence);
+                    } else {
+                        gfa.addSegment(name0, v0, v1, sequence.size());
+                    }
+                }
+
+                if(writeFasta) {
+                    fasta << ">" << name0 << " " << sequence.size() << "\n";
+                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
+                    fasta << "\n";
+                }
+
+                totalDiploidBases += uint64_t(sequence.size());
+                diploidLengths.push_back(uint64_t(sequence.size()));
+
+                if(writeCsv) {
+                    csv <<
+                        name0 << "," <<
+                        phasingRegionId << "," <<
+                        "2," <<
+                        bubbleChainId << "," <<
+                        phasingRegion.componentId << "," <<
+                        "0," <<
+                        sequence.size() << ","
+                        "Green\n";
+                }
+
+                const string name1 = namePrefix + "1";
+                computePhasedRegionGfaSequence(bubbleChain, phasingRegion, 1, sequence);
+
+                if(writeGfa) {
+                    if(writeSequence) {
+                        gfa.addSegment(name1, v0, v1, sequence);
+                    } else {
+                        gfa.addSegment(name1, v0, v1, sequence.size());
+                    }
+                }
+
+                if(writeFasta) {
+                    fasta << ">" << name1 << " " << sequence.size() << "\n";
+                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
+                    fasta << "\n";
+                }
+
+                totalDiploidBases += uint64_t(sequence.size());
+                diploidLengths.push_back(uint64_t(sequence.size()));
+
+                if(writeCsv) {
+                    csv <<
+                        name1 << "," <<
+                        phasingRegionId << "," <<
+                        "2," <<
+                        bubbleChainId << "," <<
+                        phasingRegion.componentId << "," <<
+                        "1," <<
+                        sequence.size() << ","
+                        "Green\n";
+                }
+
+            } else {
+
+                computeUnphasedRegionGfaSequence(bubbleChain, phasingRegion, sequence);
+                const string name = "UR." + to_string(bubbleChainId) + "." + to_string(phasingRegionId);
+
+                if(writeGfa) {
+                    if(writeSequence) {
+                        gfa.addSegment(name, v0, v1, sequence);
+                    } else {
+                        gfa.addSegment(name, v0, v1, sequence.size());
+                    }
+                }
+
+                totalHaploidBases += uint64_t(sequence.size());
+                haploidLengths.push_back(uint64_t(sequence.size()));
+
+                if(writeFasta) {
+                    fasta << ">" << name << " " << sequence.size() << "\n";
+                    copy(sequence.begin(), sequence.end(), ostream_iterator<Base>(fasta));
+                    fasta << "\n";
+                }
+
+                if(writeCsv) {
+                    csv <<
+                        name << "," <<
+                        phasingRegionId << "," <<
+                        "1," <<
+                        bubbleChainId << "," <<
+                        "," <<
+                        "," <<
+                        sequence.size() << ","
+                        "#eb4034\n";   // Near red.
+                }
+
+            }
+
+        }
+    }
+
+
+
+    // Write the GFA.
+    if(writeGfa) {
+        gfa.writeSerial(baseName + ".gfa");
+    }
+
+
+
+    if(writeCsv) {
+        // Compute N50 for regions assembled diploid and phased.
+        sort(diploidLengths.begin(), diploidLengths.end(), std::greater<uint64_t>());
+        /*
+        cout << "Diploid lengths: ";
+        copy(diploidLengths.begin(), diploidLengths.end(), ostream_iterator<uint64_t>(cout, " "));
+        cout << endl;
+        */
+        uint64_t diploidN50 = 0;
+        uint64_t cumulativeDiploidLength = 0;
+        for(const uint64_t length: diploidLengths) {
+            cumulativeDiploidLength += length;
+            if(cumulativeDiploidLength >= totalDiploidBases/2) {
+                diploidN50 = length;
+                break;
+            }
+        }
+
+        // Compute N50 for regions assembled haploid in bubble chains
+        sort(haploidLengths.begin(), haploidLengths.end(), std::greater<uint64_t>());
+        /*
+        cout << "Haploid lengths: ";
+        copy(haploidLengths.begin(), haploidLengths.end(), ostream_iterator<uint64_t>(cout, " "));
+        cout << endl;
+        */
+        uint64_t haploidN50 = 0;
+        uint64_t cumulativeHaploidLength = 0;
+        for(const uint64_t length: haploidLengths) {
+            cumulativeHaploidLength += length;
+            if(cumulativeHaploidLength >= totalHaploidBases/2) {
+                haploidN50 = length;
+                break;
+            }
+        }
+
+        cout << "Assembled diploid in bubble chains and phased: total " << totalDiploidBases <<
+            " (" << totalDiploidBases/2 << " per haplotype), N50 " << diploidN50 << "."  << endl;
+        cout << "Total length assembled haploid in bubble chains: " << totalHaploidBases <<
+            ", N50 " << haploidN50 << "." << endl;
+        cout << "Total genome length assembled in bubble chains, averaged over haplotypes: " <<
+            totalDiploidBases/2 + totalHaploidBases << endl;
+        cout << "Total length assembled outside bubble chains: " <<
+            totalNonBubbleChainBases << endl;
+
+        if(statistics) {
+            statistics->totalDiploidLengthBothHaplotypes = totalDiploidBases;
+            statistics->diploidN50 = diploidN50;
+            statistics->totalHaploidLength = totalHaploidBases;
+            statistics->haploidN50 = haploidN50;
+            statistics->outsideBubbleChainsLength = totalNonBubbleChainBases;
+        }
+    }
+}
@@ -11,10 +11,12 @@ using namespace shasta;
 // Standard library.
 #include "fstream.hpp"
 #include <set>
+#include <thread>
 
 
 
-AssemblyPathGraph::AssemblyPathGraph(const AssemblyGraph& assemblyGraph)
+AssemblyPathGraph::AssemblyPathGraph(const AssemblyGraph& assemblyGraph) :
+    MultithreadedObject<AssemblyPathGraph>(*this)
 {
     AssemblyPathGraph& graph = *this;
 
@@ -187,7 +189,7 @@ void AssemblyPathGraph::writeGraphviz(ostream& s) const
 
 
 // Initial creation of all tangles.
-void AssemblyPathGraph::createTangles()
+void AssemblyPathGraph::createTangles(size_t threadCount)
 {
     AssemblyPathGraph& graph = *this;
 
@@ -198,11 +200,39 @@ void AssemblyPathGraph::createTangles()
     tangles.clear();
     nextTangleId = 0;
 
-    // Create the tangles.
+    // Create the tangles, without computing their tangle matrices.
+    // This modifies the graph and so must be done sequentially.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, false);
     }
     cout << "Found " << tangles.size() << " tangles." << endl;
+
+    // Compute the tangle matrices in parallel.
+    // Each thread only modifies the tangles it works on.
+    createTanglesData.clear();
+    createTanglesData.reserve(tangles.size());
+    for(auto& p: tangles) {
+        createTanglesData.push_back(&p.second);
+    }
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    setupLoadBalancing(createTanglesData.size(), 100);
+    runThreads(&AssemblyPathGraph::createTanglesThreadFunction, threadCount);
+    createTanglesData.clear();
+    createTanglesData.shrink_to_fit();
+}
+
+
+
+void AssemblyPathGraph::createTanglesThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            computeTangleMatrix(*createTanglesData[i]);
+        }
+    }
 }
 
 
@@ -211,7 +241,7 @@ void AssemblyPathGraph::createTangles()
 // as the tangle edge, if such a tangle is valid
 // and does not already exist.
 // Return true if the new tangle was created.
-bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
+bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01, bool computeMatrix)
 {
     AssemblyPathGraph& graph = *this;
 
@@ -244,9 +274,6 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
         return false;
     }
 
-    const auto inDegree = in_degree(v0, graph);
-    const auto outDegree = out_degree(v1, graph);
-
     Tangle tangle;
     tangle.edge = e01;
     SHASTA_ASSERT(graph[e01].tangle == invalidTangleId);
@@ -266,8 +293,30 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
 
 
 
-    // Compute the tangle matrix, which contains the number of common oriented reads
-    // for each pair of in-edges and out-edges.
+    // Compute the tangle matrix, find out if this tangle
+    // is solvable, and if it is compute its priority.
+    if(computeMatrix) {
+        computeTangleMatrix(tangle);
+    }
+
+    tangle.tangleId = nextTangleId;
+    tangles.insert(make_pair(nextTangleId++, tangle));
+    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
+
+    return true;
+}
+
+
+
+// Compute the tangle matrix, which contains the number of common oriented reads
+// for each pair of in-edges and out-edges, then find out if
+// the tangle is solvable and compute its priority.
+void AssemblyPathGraph::computeTangleMatrix(Tangle& tangle) const
+{
+    const AssemblyPathGraph& graph = *this;
+    const uint64_t inDegree = tangle.inEdges.size();
+    const uint64_t outDegree = tangle.outEdges.size();
+
     vector<OrientedReadId> commonOrientedReadIds;
     tangle.matrix.resize(inDegree, vector<uint64_t>(outDegree));
     for(uint64_t inEdgeIndex=0; inEdgeIndex<inDegree; inEdgeIndex++) {
@@ -287,12 +336,6 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
     // is solvable, and if it is we can compute its priority.
     tangle.findIfSolvable();
     tangle.computePriority();
-
-    tangle.tangleId = nextTangleId;
-    tangles.insert(make_pair(nextTangleId++, tangle));
-    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
-
-    return true;
 }
 
 
@@ -302,19 +345,19 @@ bool AssemblyPathGraph::createTangleAtEdge(edge_descriptor e01)
 // the given edge as an in-edge, out-edge, or tangle edge.
 // This is used for incrementally create new tangles as
 // edges are created during detangling.
-void AssemblyPathGraph::createTanglesInvolvingEdge(edge_descriptor e)
+void AssemblyPathGraph::createTanglesInvolvingEdge(edge_descriptor e, bool computeMatrix)
 {
     AssemblyPathGraph& graph = *this;
     const vertex_descriptor v0 = source(e, graph);
     const vertex_descriptor v1 = target(e, graph);
 
-    createTangleAtEdge(e);
+    createTangleAtEdge(e, computeMatrix);
 
     BGL_FORALL_INEDGES(v0, e, graph, AssemblyPathGraph) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, computeMatrix);
     }
     BGL_FORALL_OUTEDGES(v1, e, graph, AssemblyPathGraph) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, computeMatrix);
     }
 }
 
@@ -367,13 +410,30 @@ TangleId AssemblyPathGraph::getReverseComplementTangle(
 // for GFA output.
 void AssemblyPathGraph::detangle(
     double basesPerMarker,
-    const AssemblyGraph& assemblyGraph)
+    const AssemblyGraph& assemblyGraph,
+    bool useRounds,
+    size_t threadCount)
 {
     AssemblyPathGraph& graph = *this;
     const bool debug = false;
 
+    // Detangle in rounds, if requested.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    for(uint64_t round=0; useRounds; ++round) {
+        const uint64_t detangledCount = detangleRound(assemblyGraph, threadCount);
+        if(detangledCount == 0) {
+            break;
+        }
+        if(debug) {
+            cout << "Detangle round " << round << " detangled " <<
+                detangledCount << " tangle pairs." << endl;
+        }
+    }
+
     // Detangle iteration.
-    for(int iteration=0; ; ++iteration) {
+    for(int iteration=0; not useRounds; ++iteration) {
 
         const TangleId tangleId = findNextTangle();
         if(tangleId == invalidTangleId) {
@@ -415,6 +475,113 @@ void AssemblyPathGraph::detangle(
 }
 
 
+
+// Detangle a round of tangle pairs that don't share vertices.
+// See the comments in AssemblyPathGraph.hpp.
+uint64_t AssemblyPathGraph::detangleRound(
+    const AssemblyGraph& assemblyGraph,
+    size_t threadCount)
+{
+    AssemblyPathGraph& graph = *this;
+
+    // Gather the solvable tangles in the order in which
+    // findNextTangle would return them.
+    vector< pair<uint64_t, TangleId> > candidates;
+    for(const auto& p: tangles) {
+        const auto& tangle = p.second;
+        if(tangle.isSolvable) {
+            candidates.push_back(make_pair(tangle.priority, tangle.tangleId));
+        }
+    }
+    sort(candidates.begin(), candidates.end(),
+        [](const pair<uint64_t, TangleId>& x, const pair<uint64_t, TangleId>& y)
+        {
+            return (x.first > y.first) or (x.first == y.first and x.second < y.second);
+        });
+
+    // Choose tangle pairs that don't share vertices.
+    // The vertices of a tangle are the source and target of its tangle edge,
+    // the sources of its in-edges, and the targets of its out-edges.
+    std::set<vertex_descriptor> usedVertices;
+    std::set<TangleId> usedTangles;
+    vector<TangleId> round;
+    vector<vertex_descriptor> pairVertices;
+    for(const auto& candidate: candidates) {
+        const TangleId tangleId = candidate.second;
+        if(usedTangles.find(tangleId) != usedTangles.end()) {
+            continue;
+        }
+        const TangleId reverseComplementTangleId = getReverseComplementTangle(tangleId);
+
+        pairVertices.clear();
+        for(const TangleId id: {tangleId, reverseComplementTangleId}) {
+            const auto& tangle = getTangle(id);
+            pairVertices.push_back(source(tangle.edge, graph));
+            pairVertices.push_back(target(tangle.edge, graph));
+            for(const edge_descriptor e: tangle.inEdges) {
+                pairVertices.push_back(source(e, graph));
+            }
+            for(const edge_descriptor e: tangle.outEdges) {
+                pairVertices.push_back(target(e, graph));
+            }
+        }
+        bool conflicts = false;
+        for(const vertex_descriptor v: pairVertices) {
+            if(usedVertices.find(v) != usedVertices.end()) {
+                conflicts = true;
+                break;
+            }
+        }
+        if(conflicts) {
+            continue;
+        }
+
+        usedVertices.insert(pairVertices.begin(), pairVertices.end());
+        usedTangles.insert(tangleId);
+        usedTangles.insert(reverseComplementTangleId);
+        round.push_back(tangleId);
+    }
+    if(round.empty()) {
+        return 0;
+    }
+
+    // Detangle the pairs we chose.
+    // Tangles involving the new edges are created later.
+    vector<edge_descriptor> allNewEdges;
+    vector<edge_descriptor> newEdges;
+    for(const TangleId tangleId: round) {
+        newEdges.clear();
+        detangleComplementaryPair(tangleId, newEdges);
+        fillReverseComplementNewEdges(newEdges, assemblyGraph);
+        copy(newEdges.begin(), newEdges.end(), back_inserter(allNewEdges));
+    }
+
+    // Create tangles involving the new edges, without computing their matrices.
+    // This modifies the graph and so must be done sequentially.
+    // Tangle ids are assigned in increasing order, so the tangles
+    // created here are the ones with id at least firstNewTangleId.
+    const TangleId firstNewTangleId = nextTangleId;
+    for(const edge_descriptor e: allNewEdges) {
+        createTanglesInvolvingEdge(e, false);
+    }
+
+    // Compute the tangle matrices of the new tangles in parallel.
+    createTanglesData.clear();
+    for(auto it=tangles.lower_bound(firstNewTangleId); it!=tangles.end(); ++it) {
+        createTanglesData.push_back(&it->second);
+    }
+    setupLoadBalancing(createTanglesData.size(), 100);
+    runThreads(&AssemblyPathGraph::createTanglesThreadFunction, threadCount);
+    createTanglesData.clear();
+
+    // Remove any vertices that were left isolated.
+    removeIsolatedVertices();
+
+    return round.size();
+}
+
+
+
 void AssemblyPathGraph::fillReverseComplementNewEdges(
     const vector<edge_descriptor>& newEdges,
     const AssemblyGraph& assemblyGraph)
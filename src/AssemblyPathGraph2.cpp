@@ -11,6 +11,7 @@ using namespace shasta;
 // Standard library.
 #include "fstream.hpp"
 #include <set>
+#include <thread>
 
 
 
@@ -19,6 +20,7 @@ AssemblyPathGraph2::AssemblyPathGraph2(
     uint64_t diagonalReadCountMin,
     uint64_t offDiagonalReadCountMax,
     double detangleOffDiagonalRatio) :
+    MultithreadedObject<AssemblyPathGraph2>(*this),
     diagonalReadCountMin(diagonalReadCountMin),
     offDiagonalReadCountMax(offDiagonalReadCountMax),
     detangleOffDiagonalRatio(detangleOffDiagonalRatio)
@@ -194,7 +196,7 @@ void AssemblyPathGraph2::writeGraphviz(ostream& s) const
 
 
 // Initial creation of all tangles.
-void AssemblyPathGraph2::createTangles()
+void AssemblyPathGraph2::createTangles(size_t threadCount)
 {
     AssemblyPathGraph2& graph = *this;
 
@@ -205,11 +207,39 @@ void AssemblyPathGraph2::createTangles()
     tangles.clear();
     nextTangleId = 0;
 
-    // Create the tangles.
+    // Create the tangles, without computing their tangle matrices.
+    // This modifies the graph and so must be done sequentially.
     BGL_FORALL_EDGES(e, graph, AssemblyPathGraph2) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, false);
     }
     cout << "Found " << tangles.size() << " tangles." << endl;
+
+    // Compute the tangle matrices in parallel.
+    // Each thread only modifies the tangles it works on.
+    createTanglesData.clear();
+    createTanglesData.reserve(tangles.size());
+    for(auto& p: tangles) {
+        createTanglesData.push_back(&p.second);
+    }
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    setupLoadBalancing(createTanglesData.size(), 100);
+    runThreads(&AssemblyPathGraph2::createTanglesThreadFunction, threadCount);
+    createTanglesData.clear();
+    createTanglesData.shrink_to_fit();
+}
+
+
+
+void AssemblyPathGraph2::createTanglesThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            computeTangleMatrix(*createTanglesData[i]);
+        }
+    }
 }
 
 
@@ -218,7 +248,7 @@ void AssemblyPathGraph2::createTangles()
 // as the tangle edge, if such a tangle is valid
 // and does not already exist.
 // Return true if the new tangle was created.
-bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
+bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01, bool computeMatrix)
 {
     AssemblyPathGraph2& graph = *this;
 
@@ -251,9 +281,6 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
         return false;
     }
 
-    const auto inDegree = in_degree(v0, graph);
-    const auto outDegree = out_degree(v1, graph);
-
     Tangle2 tangle;
     tangle.edge = e01;
     SHASTA_ASSERT(graph[e01].tangle == invalidTangle2Id);
@@ -273,8 +300,30 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
 
 
 
-    // Compute the tangle matrix, which contains the number of common oriented reads
-    // for each pair of in-edges and out-edges.
+    // Compute the tangle matrix, find out if this tangle
+    // is solvable, and if it is compute its priority.
+    if(computeMatrix) {
+        computeTangleMatrix(tangle);
+    }
+
+    tangle.tangleId = nextTangleId;
+    tangles.insert(make_pair(nextTangleId++, tangle));
+    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
+
+    return true;
+}
+
+
+
+// Compute the tangle matrix, which contains the number of common oriented reads
+// for each pair of in-edges and out-edges, then find out if
+// the tangle is solvable and compute its priority.
+void AssemblyPathGraph2::computeTangleMatrix(Tangle2& tangle) const
+{
+    const AssemblyPathGraph2& graph = *this;
+    const uint64_t inDegree = tangle.inEdges.size();
+    const uint64_t outDegree = tangle.outEdges.size();
+
     vector<OrientedReadId> commonOrientedReadIds;
     tangle.matrix.resize(inDegree, vector<uint64_t>(outDegree));
     for(uint64_t inEdgeIndex=0; inEdgeIndex<inDegree; inEdgeIndex++) {
@@ -297,12 +346,6 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
         offDiagonalReadCountMax,
         detangleOffDiagonalRatio);
     tangle.computePriority();
-
-    tangle.tangleId = nextTangleId;
-    tangles.insert(make_pair(nextTangleId++, tangle));
-    // cout << "Created tangle " << tangle.tangleId << " at " << graph[e01] << endl;
-
-    return true;
 }
 
 
@@ -312,19 +355,19 @@ bool AssemblyPathGraph2::createTangleAtEdge(edge_descriptor e01)
 // the given edge as an in-edge, out-edge, or tangle edge.
 // This is used for incrementally create new tangles as
 // edges are created during detangling.
-void AssemblyPathGraph2::createTanglesInvolvingEdge(edge_descriptor e)
+void AssemblyPathGraph2::createTanglesInvolvingEdge(edge_descriptor e, bool computeMatrix)
 {
     AssemblyPathGraph2& graph = *this;
     const vertex_descriptor v0 = source(e, graph);
     const vertex_descriptor v1 = target(e, graph);
 
-    createTangleAtEdge(e);
+    createTangleAtEdge(e, computeMatrix);
 
     BGL_FORALL_INEDGES(v0, e, graph, AssemblyPathGraph2) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, computeMatrix);
     }
     BGL_FORALL_OUTEDGES(v1, e, graph, AssemblyPathGraph2) {
-        createTangleAtEdge(e);
+        createTangleAtEdge(e, computeMatrix);
     }
 }
 
@@ -377,13 +420,30 @@ Tangle2Id AssemblyPathGraph2::getReverseComplementTangle(
 // for GFA output.
 void AssemblyPathGraph2::detangle(
     double basesPerMarker,
-    const AssemblyGraph& assemblyGraph)
+    const AssemblyGraph& assemblyGraph,
+    bool useRounds,
+    size_t threadCount)
 {
     AssemblyPathGraph2& graph = *this;
     const bool debug = false;
 
+    // Detangle in rounds, if requested.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    for(uint64_t round=0; useRounds; ++round) {
+        const uint64_t detangledCount = detangleRound(assemblyGraph, threadCount);
+        if(detangledCount == 0) {
+            break;
+        }
+        if(debug) {
+            cout << "Detangle round " << round << " detangled " <<
+                detangledCount << " tangle pairs." << endl;
+        }
+    }
+
     // Detangle iteration.
-    for(int iteration=0; ; ++iteration) {
+    for(int iteration=0; not useRounds; ++iteration) {
 
         const Tangle2Id tangleId = findNextTangle();
         if(tangleId == invalidTangle2Id) {
@@ -425,6 +485,113 @@ void AssemblyPathGraph2::detangle(
 }
 
 
+
+// Detangle a round of tangle pairs that don't share vertices.
+// See the comments in AssemblyPathGraph2.hpp.
+uint64_t AssemblyPathGraph2::detangleRound(
+    const AssemblyGraph& assemblyGraph,
+    size_t threadCount)
+{
+    AssemblyPathGraph2& graph = *this;
+
+    // Gather the solvable tangles in the order in which
+    // findNextTangle would return them.
+    vector< pair<uint64_t, Tangle2Id> > candidates;
+    for(const auto& p: tangles) {
+        const auto& tangle = p.second;
+        if(tangle.isSolvable) {
+            candidates.push_back(make_pair(tangle.priority, tangle.tangleId));
+        }
+    }
+    sort(candidates.begin(), candidates.end(),
+        [](const pair<uint64_t, Tangle2Id>& x, const pair<uint64_t, Tangle2Id>& y)
+        {
+            return (x.first > y.first) or (x.first == y.first and x.second < y.second);
+        });
+
+    // Choose tangle pairs that don't share vertices.
+    // The vertices of a tangle are the source and target of its tangle edge,
+    // the sources of its in-edges, and the targets of its out-edges.
+    std::set<vertex_descriptor> usedVertices;
+    std::set<Tangle2Id> usedTangles;
+    vector<Tangle2Id> round;
+    vector<vertex_descriptor> pairVertices;
+    for(const auto& candidate: candidates) {
+        const Tangle2Id tangleId = candidate.second;
+        if(usedTangles.find(tangleId) != usedTangles.end()) {
+            continue;
+        }
+        const Tangle2Id reverseComplementTangleId = getReverseComplementTangle(tangleId);
+
+        pairVertices.clear();
+        for(const Tangle2Id id: {tangleId, reverseComplementTangleId}) {
+            const auto& tangle = getTangle(id);
+            pairVertices.push_back(source(tangle.edge, graph));
+            pairVertices.push_back(target(tangle.edge, graph));
+            for(const edge_descriptor e: tangle.inEdges) {
+                pairVertices.push_back(source(e, graph));
+            }
+            for(const edge_descriptor e: tangle.outEdges) {
+                pairVertices.push_back(target(e, graph));
+            }
+        }
+        bool conflicts = false;
+        for(const vertex_descriptor v: pairVertices) {
+            if(usedVertices.find(v) != usedVertices.end()) {
+                conflicts = true;
+                break;
+            }
+        }
+        if(conflicts) {
+            continue;
+        }
+
+        usedVertices.insert(pairVertices.begin(), pairVertices.end());
+        usedTangles.insert(tangleId);
+        usedTangles.insert(reverseComplementTangleId);
+        round.push_back(tangleId);
+    }
+    if(round.empty()) {
+        return 0;
+    }
+
+    // Detangle the pairs we chose.
+    // Tangles involving the new edges are created later.
+    vector<edge_descriptor> allNewEdges;
+    vector<edge_descriptor> newEdges;
+    for(const Tangle2Id tangleId: round) {
+        newEdges.clear();
+        detangleComplementaryPair(tangleId, newEdges);
+        fillReverseComplementNewEdges(newEdges, assemblyGraph);
+        copy(newEdges.begin(), newEdges.end(), back_inserter(allNewEdges));
+    }
+
+    // Create tangles involving the new edges, without computing their matrices.
+    // This modifies the graph and so must be done sequentially.
+    // Tangle ids are assigned in increasing order, so the tangles
+    // created here are the ones with id at least firstNewTangleId.
+    const Tangle2Id firstNewTangleId = nextTangleId;
+    for(const edge_descriptor e: allNewEdges) {
+        createTanglesInvolvingEdge(e, false);
+    }
+
+    // Compute the tangle matrices of the new tangles in parallel.
+    createTanglesData.clear();
+    for(auto it=tangles.lower_bound(firstNewTangleId); it!=tangles.end(); ++it) {
+        createTanglesData.push_back(&it->second);
+    }
+    setupLoadBalancing(createTanglesData.size(), 100);
+    runThreads(&AssemblyPathGraph2::createTanglesThreadFunction, threadCount);
+    createTanglesData.clear();
+
+    // Remove any vertices that were left isolated.
+    removeIsolatedVertices();
+
+    return round.size();
+}
+
+
+
 void AssemblyPathGraph2::fillReverseComplementNewEdges(
     const vector<edge_descriptor>& newEdges,
     const AssemblyGraph& assemblyGraph)
@@ -99,6 +99,7 @@ there is no such tangle.
 
 // Shasta.
 #include "AssemblyGraph.hpp"
+#include "MultithreadedObject.hpp"
 #include "ReadId.hpp"
 
 // Boost libraries.
@@ -276,7 +277,9 @@ public:
 
 
 
-class shasta::AssemblyPathGraph2 : public AssemblyPathGraph2BaseClass {
+class shasta::AssemblyPathGraph2 :
+    public AssemblyPathGraph2BaseClass,
+    public MultithreadedObject<AssemblyPathGraph2> {
 public:
 
     // The constructor does not fill in the oriented read ids for each edge.
@@ -305,20 +308,34 @@ public:
         const AssemblyGraph&);
 
     // Initial creation of all tangles.
-    void createTangles();
+    // The tangle matrices are computed in parallel
+    // after all tangles have been created.
+    void createTangles(size_t threadCount = 0);
 
     // Create tangles involving a given edge.
     // This can create up to two tangles involving
     // the given edge as an in-edge, out-edge, or tangle edge.
     // This is used for incrementally create new tangles as
     // edges are created during detangling.
-    void createTanglesInvolvingEdge(edge_descriptor e);
+    // If computeMatrix is false, the tangle matrices of the new tangles
+    // are not computed (see createTangleAtEdge).
+    void createTanglesInvolvingEdge(edge_descriptor e, bool computeMatrix = true);
 
     // Create a new tangle that has the specified edge
     // as the tangle edge, if such a tangle is valid
     // and does not already exist.
     // Return true if the new tangle was created.
-    bool createTangleAtEdge(edge_descriptor e);
+    // If computeMatrix is false, the tangle matrix is not computed
+    // and findIfSolvable and computePriority are not called.
+    // In that case the caller is responsible for calling computeTangleMatrix.
+    bool createTangleAtEdge(edge_descriptor e, bool computeMatrix = true);
+
+    // Compute the tangle matrix, which contains the number of common oriented reads
+    // for each pair of in-edges and out-edges, then find out if
+    // the tangle is solvable and compute its priority.
+    // This only modifies the tangle, so it can be called
+    // for different tangles in parallel.
+    void computeTangleMatrix(Tangle2&) const;
 
     // Return the next tangle to work on.
     Tangle2Id findNextTangle() const;
@@ -329,9 +346,32 @@ public:
     // Detangle all we can.
     // The average number of bases per marker is only used
     // for GFA output.
+    // If useRounds is false, tangles are detangled one pair at a time,
+    // always choosing the solvable tangle with highest priority.
+    // If useRounds is true, each round detangles a set of
+    // tangle pairs that don't conflict with each other
+    // (see detangleRound), then computes in parallel the tangle matrices
+    // of the tangles created by the round. The result does not depend
+    // on the number of threads, but it can differ from the result
+    // obtained with useRounds false, because the tangles created
+    // while detangling a round are only considered in the next round.
     void detangle(
         double basesPerMarker,
-        const AssemblyGraph&);
+        const AssemblyGraph&,
+        bool useRounds = false,
+        size_t threadCount = 0);
+
+    // Detangle a round of tangle pairs that don't conflict with each other.
+    // The pairs are chosen greedily in order of decreasing priority,
+    // then increasing tangle id, skipping pairs that share a vertex with
+    // a pair already chosen. Detangling a pair only removes
+    // its own vertices and edges and the tangles that contain
+    // its edges, so pairs that don't share vertices can be detangled
+    // in any order. Tangles involving the new edges are created
+    // after all pairs of the round are detangled, and their matrices
+    // are computed in parallel.
+    // Returns the number of tangle pairs that were detangled.
+    uint64_t detangleRound(const AssemblyGraph&, size_t threadCount);
 
     // Detangle a single tangle.
     // This does not fill in the reverseComplementEdge of newly created edges,
@@ -370,6 +410,10 @@ public:
 
 private:
     void removeIsolatedVertices();
+
+    // Data and thread function used by createTangles.
+    vector<Tangle2*> createTanglesData;
+    void createTanglesThreadFunction(size_t threadId);
 };
 
 
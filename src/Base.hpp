@@ -14,6 +14,7 @@
 #include "iostream.hpp"
 #include "stdexcept.hpp"
 #include "string.hpp"
+#include "vector.hpp"
 
 namespace shasta {
     class Base;
@@ -22,6 +23,7 @@ namespace shasta {
     class AlignedBase;
     class AlignedBaseInitializer;
     inline ostream& operator<<(ostream&, AlignedBase);
+    inline void writeBases(ostream&, const vector<Base>&);
     void testBase();
 }
 
@@ -168,6 +170,22 @@ inline std::ostream& shasta::operator<<(
 
 
 
+// Write a sequence of bases with a single write call.
+// This is much faster than writing one base at a time
+// for long sequences.
+inline void shasta::writeBases(
+    std::ostream& s,
+    const vector<Base>& bases)
+{
+    string buffer(bases.size(), ' ');
+    for(size_t i=0; i<bases.size(); i++) {
+        buffer[i] = bases[i].character();
+    }
+    s.write(buffer.data(), std::streamsize(buffer.size()));
+}
+
+
+
 // Class used only to store a static look up table
 // use by the AlignedBase::fromCharacter to convert
 // characters to bases.
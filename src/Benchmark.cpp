@@ -0,0 +1,146 @@
+// Shasta.
+#include "Benchmark.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <iomanip>
+
+
+
+Benchmark::Benchmark(uint64_t repetitionCount) :
+    repetitionCount(repetitionCount)
+{
+    SHASTA_ASSERT(repetitionCount > 0);
+}
+
+
+
+void Benchmark::skip(const string& name, const string& reason)
+{
+    Result result;
+    result.name = name;
+    result.wasSkipped = true;
+    result.reason = reason;
+    cout << name << " skipped: " << reason << endl;
+    results.push_back(result);
+}
+
+
+
+double Benchmark::Result::minSeconds() const
+{
+    SHASTA_ASSERT(not seconds.empty());
+    return *min_element(seconds.begin(), seconds.end());
+}
+
+
+
+double Benchmark::Result::averageSeconds() const
+{
+    SHASTA_ASSERT(not seconds.empty());
+    double sum = 0.;
+    for(const double t: seconds) {
+        sum += t;
+    }
+    return sum / double(seconds.size());
+}
+
+
+
+void Benchmark::writeJson(ostream& json) const
+{
+    json << std::setprecision(6);
+    json << "{\n";
+
+    json << "  \"Context\":\n  {\n";
+    for(uint64_t i=0; i<context.size(); i++) {
+        json << "    ";
+        writeJsonString(json, context[i].first);
+        json << ": ";
+        writeJsonString(json, context[i].second);
+        json << (i == context.size() - 1 ? "\n" : ",\n");
+    }
+    json << "  },\n";
+
+    json << "  \"Benchmarks\":\n  [\n";
+    for(uint64_t i=0; i<results.size(); i++) {
+        const Result& result = results[i];
+        json << "    {\n      \"Name\": ";
+        writeJsonString(json, result.name);
+        json << ",\n";
+
+        if(result.wasSkipped) {
+            json << "      \"Skipped\": true,\n      \"Reason\": ";
+            writeJsonString(json, result.reason);
+            json << "\n";
+        } else {
+            const double minSeconds = result.minSeconds();
+            json <<
+                "      \"Skipped\": false,\n"
+                "      \"Item\": ";
+            writeJsonString(json, result.itemName);
+            json << ",\n"
+                "      \"Items\": " << result.itemCount << ",\n"
+                "      \"Repetitions\": " << result.seconds.size() << ",\n"
+                "      \"Minimum seconds\": " << minSeconds << ",\n"
+                "      \"Average seconds\": " << result.averageSeconds() << ",\n"
+                "      \"Nanoseconds per item\": " <<
+                (result.itemCount ? 1.e9 * minSeconds / double(result.itemCount) : 0.) << ",\n"
+                "      \"Items per second\": " <<
+                (minSeconds > 0. ? double(result.itemCount) / minSeconds : 0.) << ",\n"
+                "      \"Checksum\": " << result.checksum << ",\n"
+                "      \"Parameters\":\n      {\n";
+            for(uint64_t j=0; j<result.parameters.size(); j++) {
+                json << "        ";
+                writeJsonString(json, result.parameters[j].first);
+                json << ": ";
+                writeJsonString(json, result.parameters[j].second);
+                json << (j == result.parameters.size() - 1 ? "\n" : ",\n");
+            }
+            json << "      }\n";
+        }
+        json << (i == results.size() - 1 ? "    }\n" : "    },\n");
+    }
+    json << "  ]\n}\n";
+}
+
+
+
+void Benchmark::writeSummary(ostream& s) const
+{
+    s << "Benchmark summary (minimum over " << repetitionCount << " repetitions):" << endl;
+    for(const Result& result: results) {
+        s << std::setw(40) << std::left << result.name << " ";
+        if(result.wasSkipped) {
+            s << "skipped" << endl;
+        } else {
+            const double minSeconds = result.minSeconds();
+            s << std::setw(12) << std::right << minSeconds << " s " <<
+                std::setw(12) << (result.itemCount ? 1.e9 * minSeconds / double(result.itemCount) : 0.) <<
+                " ns per " << result.itemName << endl;
+        }
+    }
+}
+
+
+
+void Benchmark::writeJsonString(ostream& json, const string& s)
+{
+    json << '"';
+    for(const char c: s) {
+        if(c == '"' or c == '\\') {
+            json << '\\' << c;
+        } else if(c == '\n') {
+            json << "\\n";
+        } else if(c == '\t') {
+            json << "\\t";
+        } else if(static_cast<unsigned char>(c) < 0x20) {
+            json << ' ';
+        } else {
+            json << c;
+        }
+    }
+    json << '"';
+}
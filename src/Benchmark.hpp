@@ -0,0 +1,112 @@
+#ifndef SHASTA_BENCHMARK_HPP
+#define SHASTA_BENCHMARK_HPP
+
+/*******************************************************************************
+
+Class Benchmark collects timings of micro-benchmarks of computational
+kernels and writes them in json format. It is used by the
+shastaBenchmark executable (see shasta/srcBenchmark),
+so results can be compared across releases on the same hardware.
+
+Each benchmark runs a kernel repetitionCount times. The kernel
+processes the same itemCount items each time and returns a checksum
+of its results. The checksum prevents the compiler from optimizing
+away the computation, and can also be used to check that the results
+of a kernel did not change between releases.
+For each benchmark, the minimum and average time over all repetitions
+are recorded. The minimum time is the most reproducible.
+
+*******************************************************************************/
+
+// Shasta.
+#include "chrono.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "iostream.hpp"
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class Benchmark;
+}
+
+
+
+class shasta::Benchmark {
+public:
+
+    Benchmark(uint64_t repetitionCount);
+
+    // Information about the benchmark environment
+    // (build id, thread count, input data, ...),
+    // written at the beginning of the json output.
+    vector< pair<string, string> > context;
+
+    // Run a benchmark.
+    template<class F> void run(
+        const string& name,
+        const string& itemName,
+        uint64_t itemCount,
+        F kernel,
+        const vector< pair<string, string> >& parameters = {});
+
+    // Record a benchmark that could not be run.
+    void skip(const string& name, const string& reason);
+
+    // Write all results in json format.
+    void writeJson(ostream&) const;
+
+    // Write a human readable summary.
+    void writeSummary(ostream&) const;
+
+private:
+    uint64_t repetitionCount;
+
+    class Result {
+    public:
+        string name;
+        string itemName;
+        uint64_t itemCount = 0;
+        vector< pair<string, string> > parameters;
+        vector<double> seconds;
+        uint64_t checksum = 0;
+        bool wasSkipped = false;
+        string reason;
+        double minSeconds() const;
+        double averageSeconds() const;
+    };
+    vector<Result> results;
+
+    static void writeJsonString(ostream&, const string&);
+};
+
+
+
+template<class F> inline void shasta::Benchmark::run(
+    const string& name,
+    const string& itemName,
+    uint64_t itemCount,
+    F kernel,
+    const vector< pair<string, string> >& parameters)
+{
+    Result result;
+    result.name = name;
+    result.itemName = itemName;
+    result.itemCount = itemCount;
+    result.parameters = parameters;
+
+    for(uint64_t repetition=0; repetition<repetitionCount; repetition++) {
+        const auto t0 = steady_clock::now();
+        result.checksum = kernel();
+        const auto t1 = steady_clock::now();
+        result.seconds.push_back(shasta::seconds(t1 - t0));
+    }
+
+    cout << name << ": " << itemCount << " " << itemName << " in " <<
+        result.minSeconds() << " s." << endl;
+    results.push_back(result);
+}
+
+#endif
@@ -0,0 +1,369 @@
+// Shasta.
+#include "BinaryAssemblyGraph.hpp"
+#include "filesystem.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <cstddef>
+#include "fstream.hpp"
+#include "iostream.hpp"
+#include "iterator.hpp"
+#include <limits>
+#include "stdexcept.hpp"
+#include <string.h>
+#include "utility.hpp"
+
+// Linux.
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+
+uint64_t BinaryAssemblyGraphWriter::beginSegment(
+    const string& name,
+    uint64_t length,
+    double coverage)
+{
+    SHASTA_ASSERT(sequenceBaseCount % 4 == 0);
+    SHASTA_ASSERT(name.size() <= std::numeric_limits<uint32_t>::max());
+
+    BinaryAssemblyGraphSegment segment;
+    segment.sequenceBegin = sequenceBaseCount;
+    segment.sequenceLength = length;
+    segment.nameBegin = names.size();
+    segment.nameLength = uint32_t(name.size());
+    segment.coverage = float(coverage);
+    segments.push_back(segment);
+    names.append(name);
+
+    return segments.size() - 1;
+}
+
+
+
+uint64_t BinaryAssemblyGraphWriter::addSegment(
+    const string& name,
+    const string& sequence,
+    double coverage)
+{
+    const uint64_t segmentId = beginSegment(name, sequence.size(), coverage);
+    for(const char c: sequence) {
+        const Base base = Base::fromCharacter(c);
+        appendBase(base.value);
+    }
+
+    // Pad to a multiple of 4 bases.
+    sequenceBaseCount = 4 * sequences.size();
+    return segmentId;
+}
+
+
+
+uint64_t BinaryAssemblyGraphWriter::addSegment(
+    const string& name,
+    const vector<Base>& sequence,
+    double coverage)
+{
+    const uint64_t segmentId = beginSegment(name, sequence.size(), coverage);
+    for(const Base base: sequence) {
+        appendBase(base.value);
+    }
+
+    // Pad to a multiple of 4 bases.
+    sequenceBaseCount = 4 * sequences.size();
+    return segmentId;
+}
+
+
+
+void BinaryAssemblyGraphWriter::addLink(
+    uint64_t segment0, bool reverse0,
+    uint64_t segment1, bool reverse1,
+    uint64_t overlap)
+{
+    SHASTA_ASSERT(segment0 < segments.size());
+    SHASTA_ASSERT(segment1 < segments.size());
+    SHASTA_ASSERT(overlap <= std::numeric_limits<uint32_t>::max());
+
+    BinaryAssemblyGraphLink link;
+    link.segment0 = segment0;
+    link.segment1 = segment1;
+    link.overlap = uint32_t(overlap);
+    link.reverse0 = reverse0 ? 1 : 0;
+    link.reverse1 = reverse1 ? 1 : 0;
+    links.push_back(link);
+}
+
+
+
+void BinaryAssemblyGraphWriter::write(const string& fileName) const
+{
+    // Round up to a multiple of 8 bytes.
+    auto align = [](uint64_t n) {return ((n + 7) / 8) * 8;};
+
+    // Fill in the header.
+    BinaryAssemblyGraphHeader header;
+    ::memcpy(header.magic, "SHASTAAG", 8);
+    header.version = BinaryAssemblyGraphHeader::currentVersion;
+    header.segmentCount = segments.size();
+    header.linkCount = links.size();
+    header.segmentTableOffset = sizeof(BinaryAssemblyGraphHeader);
+    header.linkTableOffset = header.segmentTableOffset +
+        segments.size() * sizeof(BinaryAssemblyGraphSegment);
+    header.sequenceOffset = header.linkTableOffset +
+        links.size() * sizeof(BinaryAssemblyGraphLink);
+    header.nameOffset = align(header.sequenceOffset + sequences.size());
+
+    // Write it out.
+    ofstream file(fileName, std::ios::binary);
+    if(not file) {
+        throw runtime_error("Error opening " + fileName);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(segments.data()),
+        std::streamsize(segments.size() * sizeof(BinaryAssemblyGraphSegment)));
+    file.write(reinterpret_cast<const char*>(links.data()),
+        std::streamsize(links.size() * sizeof(BinaryAssemblyGraphLink)));
+    file.write(reinterpret_cast<const char*>(sequences.data()),
+        std::streamsize(sequences.size()));
+    const uint64_t paddingSize = header.nameOffset - header.sequenceOffset - sequences.size();
+    const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    file.write(padding, std::streamsize(paddingSize));
+    file.write(names.data(), std::streamsize(names.size()));
+    if(not file) {
+        throw runtime_error("Error writing " + fileName);
+    }
+}
+
+
+
+BinaryAssemblyGraph::BinaryAssemblyGraph(const string& fileName) :
+    fileName(fileName)
+{
+    const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + ": " + ::strerror(errno));
+    }
+
+    struct stat fileInformation;
+    if(::fstat(fileDescriptor, &fileInformation) == -1) {
+        ::close(fileDescriptor);
+        throw runtime_error("Error during fstat for " + fileName);
+    }
+    fileSize = uint64_t(fileInformation.st_size);
+    if(fileSize < sizeof(BinaryAssemblyGraphHeader)) {
+        ::close(fileDescriptor);
+        throw runtime_error(fileName + " is not a binary assembly graph file.");
+    }
+
+    void* pointer = ::mmap(0, fileSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if(pointer == reinterpret_cast<void*>(-1LL)) {
+        throw runtime_error("Error mapping " + fileName + " to memory: " + ::strerror(errno));
+    }
+    data = static_cast<const char*>(pointer);
+
+    try {
+        check();
+    } catch(...) {
+        ::munmap(const_cast<char*>(data), fileSize);
+        data = 0;
+        throw;
+    }
+}
+
+
+
+// All sizes read from the file are checked before they are used
+// in any arithmetic that could overflow.
+void BinaryAssemblyGraph::check() const
+{
+    const BinaryAssemblyGraphHeader& h = header();
+    if(::memcmp(h.magic, "SHASTAAG", 8) != 0) {
+        throw runtime_error(fileName + " is not a binary assembly graph file.");
+    }
+    if(h.version != BinaryAssemblyGraphHeader::currentVersion) {
+        throw runtime_error(fileName + " has unsupported binary assembly graph version " +
+            to_string(h.version));
+    }
+
+    // The sections must follow each other as written by BinaryAssemblyGraphWriter,
+    // and they must all be inside the file.
+    const string corrupted = fileName + " is truncated or corrupted: ";
+    if(h.segmentTableOffset != sizeof(BinaryAssemblyGraphHeader)) {
+        throw runtime_error(corrupted + "invalid segment table offset.");
+    }
+    if(h.segmentCount > (fileSize - h.segmentTableOffset) / sizeof(BinaryAssemblyGraphSegment)) {
+        throw runtime_error(corrupted + "segment table extends beyond the end of the file.");
+    }
+    if(h.linkTableOffset != h.segmentTableOffset + h.segmentCount * sizeof(BinaryAssemblyGraphSegment)) {
+        throw runtime_error(corrupted + "invalid link table offset.");
+    }
+    if(h.linkCount > (fileSize - h.linkTableOffset) / sizeof(BinaryAssemblyGraphLink)) {
+        throw runtime_error(corrupted + "link table extends beyond the end of the file.");
+    }
+    if(h.sequenceOffset != h.linkTableOffset + h.linkCount * sizeof(BinaryAssemblyGraphLink)) {
+        throw runtime_error(corrupted + "invalid sequence section offset.");
+    }
+    if(h.nameOffset < h.sequenceOffset or h.nameOffset > fileSize) {
+        throw runtime_error(corrupted + "invalid name section offset.");
+    }
+
+    // The name and sequence of each segment must be inside their sections.
+    const uint64_t sequenceBaseCount = 4 * sequenceByteCount();
+    const uint64_t nameSize = nameByteCount();
+    for(uint64_t segmentId=0; segmentId<segmentCount(); segmentId++) {
+        const BinaryAssemblyGraphSegment& segment = segments()[segmentId];
+        if( segment.sequenceLength > sequenceBaseCount or
+            segment.sequenceBegin > sequenceBaseCount - segment.sequenceLength) {
+            throw runtime_error(corrupted + "sequence of segment " + to_string(segmentId) +
+                " extends beyond the sequence section.");
+        }
+        if( segment.nameLength > nameSize or
+            segment.nameBegin > nameSize - segment.nameLength) {
+            throw runtime_error(corrupted + "name of segment " + to_string(segmentId) +
+                " extends beyond the name section.");
+        }
+    }
+
+    // Links must refer to existing segments.
+    for(uint64_t linkId=0; linkId<linkCount(); linkId++) {
+        const BinaryAssemblyGraphLink& link = links()[linkId];
+        if(link.segment0 >= segmentCount() or link.segment1 >= segmentCount()) {
+            throw runtime_error(corrupted + "link " + to_string(linkId) +
+                " refers to a segment that does not exist.");
+        }
+    }
+}
+
+
+
+BinaryAssemblyGraph::~BinaryAssemblyGraph()
+{
+    if(data) {
+        ::munmap(const_cast<char*>(data), fileSize);
+    }
+}
+
+
+
+string BinaryAssemblyGraph::getName(uint64_t segmentId) const
+{
+    SHASTA_ASSERT(segmentId < segmentCount());
+    const BinaryAssemblyGraphSegment& segment = segments()[segmentId];
+    return string(names() + segment.nameBegin, segment.nameLength);
+}
+
+
+
+string BinaryAssemblyGraph::getSequence(uint64_t segmentId) const
+{
+    SHASTA_ASSERT(segmentId < segmentCount());
+    const BinaryAssemblyGraphSegment& segment = segments()[segmentId];
+    const uint8_t* s = sequences();
+
+    string sequence(segment.sequenceLength, ' ');
+    for(uint64_t i=0; i<segment.sequenceLength; i++) {
+        const uint64_t j = segment.sequenceBegin + i;
+        const uint8_t baseValue = uint8_t((s[j / 4] >> (2 * (j % 4))) & 3);
+        sequence[i] = Base::fromInteger(baseValue).character();
+    }
+    return sequence;
+}
+
+
+
+// Write a small binary assembly graph, read it back, and check that
+// truncated or corrupted copies of it are rejected.
+void shasta::testBinaryAssemblyGraph()
+{
+    const string fileName = "TestBinaryAssemblyGraph.shasta";
+    const string badFileName = "TestBinaryAssemblyGraph-Bad.shasta";
+
+    // Segments with lengths that are and are not multiples of 4.
+    const vector< pair<string, string> > segments = {
+        {"0", "ACGTACGTA"},
+        {"1", "T"},
+        {"segment2", ""},
+        {"3", "GGCCAATT"},
+        {"4", "CATCATCATCATCATCATCATCATCATCATCATCATCATCATCAT"}};
+    BinaryAssemblyGraphWriter writer;
+    for(uint64_t i=0; i<segments.size(); i++) {
+        const uint64_t segmentId = writer.addSegment(segments[i].first, segments[i].second, double(i) + 0.5);
+        SHASTA_ASSERT(segmentId == i);
+    }
+    writer.addLink(0, false, 1, true, 0);
+    writer.addLink(3, true, 4, false, 3);
+    writer.addLink(4, false, 0, false, 1);
+    writer.write(fileName);
+
+    // Read it back.
+    {
+        const BinaryAssemblyGraph graph(fileName);
+        SHASTA_ASSERT(graph.segmentCount() == segments.size());
+        SHASTA_ASSERT(graph.linkCount() == 3);
+        for(uint64_t i=0; i<segments.size(); i++) {
+            SHASTA_ASSERT(graph.getName(i) == segments[i].first);
+            SHASTA_ASSERT(graph.getSequence(i) == segments[i].second);
+            SHASTA_ASSERT(graph.segments()[i].coverage == float(double(i) + 0.5));
+        }
+        const BinaryAssemblyGraphLink& link = graph.links()[1];
+        SHASTA_ASSERT(link.segment0 == 3 and link.reverse0 == 1);
+        SHASTA_ASSERT(link.segment1 == 4 and link.reverse1 == 0);
+        SHASTA_ASSERT(link.overlap == 3);
+    }
+
+    // Read the file contents.
+    string contents;
+    {
+        ifstream file(fileName, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Return true if a modified copy of the file is rejected.
+    const auto isRejected = [&](const string& badContents)
+    {
+        {
+            ofstream file(badFileName, std::ios::binary);
+            file.write(badContents.data(), std::streamsize(badContents.size()));
+        }
+        try {
+            const BinaryAssemblyGraph graph(badFileName);
+        } catch(const runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+
+    // Every truncated copy is rejected. The name of the last segment
+    // ends at the end of the file, so even removing one byte is detected.
+    for(uint64_t size=0; size<contents.size(); size++) {
+        SHASTA_ASSERT(isRejected(contents.substr(0, size)));
+    }
+
+    // Corrupt individual fields.
+    const auto corrupt = [&](uint64_t offset, uint64_t value)
+    {
+        string badContents = contents;
+        ::memcpy(&badContents[offset], &value, sizeof(value));
+        return isRejected(badContents);
+    };
+    const uint64_t segmentTableOffset = sizeof(BinaryAssemblyGraphHeader);
+    const uint64_t linkTableOffset = segmentTableOffset + segments.size() * sizeof(BinaryAssemblyGraphSegment);
+    SHASTA_ASSERT(corrupt(offsetof(BinaryAssemblyGraphHeader, segmentCount), 1ULL << 60));
+    SHASTA_ASSERT(corrupt(offsetof(BinaryAssemblyGraphHeader, linkCount), 1ULL << 60));
+    SHASTA_ASSERT(corrupt(offsetof(BinaryAssemblyGraphHeader, nameOffset), contents.size() + 8));
+    SHASTA_ASSERT(corrupt(segmentTableOffset + offsetof(BinaryAssemblyGraphSegment, sequenceBegin), 1ULL << 62));
+    SHASTA_ASSERT(corrupt(segmentTableOffset + offsetof(BinaryAssemblyGraphSegment, sequenceLength), 1000));
+    SHASTA_ASSERT(corrupt(segmentTableOffset + offsetof(BinaryAssemblyGraphSegment, nameBegin), ~0ULL));
+    SHASTA_ASSERT(corrupt(linkTableOffset + offsetof(BinaryAssemblyGraphLink, segment1), segments.size()));
+
+    filesystem::remove(fileName);
+    filesystem::remove(badFileName);
+    cout << "testBinaryAssemblyGraph passed." << endl;
+}
@@ -0,0 +1,219 @@
+#ifndef SHASTA_BINARY_ASSEMBLY_GRAPH_HPP
+#define SHASTA_BINARY_ASSEMBLY_GRAPH_HPP
+
+/*******************************************************************************
+
+Binary, memory-mappable representation of an assembly graph,
+written alongside the GFA output to allow downstream tools
+to access segment sequences and links without parsing GFA.
+
+File layout. All integers are little endian and all sections
+begin at an offset that is a multiple of 8 bytes.
+
+- Header (class BinaryAssemblyGraphHeader, 64 bytes):
+  magic "SHASTAAG", format version, segment count, link count,
+  and offset of each of the following sections.
+
+- Segment table: one BinaryAssemblyGraphSegment (32 bytes) per segment.
+  Each segment stores the position of its sequence
+  in the sequence section (in bases), its length in bases,
+  the position and length of its name in the name section,
+  and its average coverage (0 if not available).
+
+- Link table: one BinaryAssemblyGraphLink (24 bytes) per link.
+  Segments are identified by their index in the segment table.
+  The overlap is the number of bases shared by the two segments
+  (the same number used in the CIGAR string of the GFA link,
+  computed on the first segment). It is 0 if there is no overlap.
+
+- Sequence section: sequences of all segments, 2 bits per base
+  (A=0, C=1, G=2, T=3), 4 bases per byte, with base i of the
+  section stored in bits 2*(i%4) and 2*(i%4)+1 of byte i/4.
+  The sequence of each segment begins at a multiple of 4 bases,
+  so each segment begins at a byte boundary.
+
+- Name section: the names of all segments (same as the GFA segment names),
+  concatenated without separators.
+
+The file can be memory mapped and used in place.
+Class BinaryAssemblyGraph does that and is also exposed to Python,
+where the segment and link tables and the sequence and name
+sections are available as zero-copy numpy arrays.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Base.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class BinaryAssemblyGraphHeader;
+    class BinaryAssemblyGraphSegment;
+    class BinaryAssemblyGraphLink;
+    class BinaryAssemblyGraphWriter;
+    class BinaryAssemblyGraph;
+    void testBinaryAssemblyGraph();
+}
+
+
+
+class shasta::BinaryAssemblyGraphHeader {
+public:
+    char magic[8];
+    uint64_t version;
+    uint64_t segmentCount;
+    uint64_t linkCount;
+    uint64_t segmentTableOffset;
+    uint64_t linkTableOffset;
+    uint64_t sequenceOffset;
+    uint64_t nameOffset;
+
+    static const uint64_t currentVersion = 1;
+};
+static_assert(sizeof(shasta::BinaryAssemblyGraphHeader) == 64,
+    "Unexpected size of BinaryAssemblyGraphHeader");
+
+
+
+class shasta::BinaryAssemblyGraphSegment {
+public:
+    uint64_t sequenceBegin;     // In bases, always a multiple of 4.
+    uint64_t sequenceLength;    // In bases.
+    uint64_t nameBegin;         // In bytes.
+    uint32_t nameLength;        // In bytes.
+    float coverage;
+};
+static_assert(sizeof(shasta::BinaryAssemblyGraphSegment) == 32,
+    "Unexpected size of BinaryAssemblyGraphSegment");
+
+
+
+class shasta::BinaryAssemblyGraphLink {
+public:
+    uint64_t segment0;
+    uint64_t segment1;
+    uint32_t overlap;
+    uint8_t reverse0;           // 1 if segment0 is used reverse complemented.
+    uint8_t reverse1;           // 1 if segment1 is used reverse complemented.
+    uint16_t unused = 0;
+};
+static_assert(sizeof(shasta::BinaryAssemblyGraphLink) == 24,
+    "Unexpected size of BinaryAssemblyGraphLink");
+
+
+
+// Class used to accumulate segments and links and write them out.
+class shasta::BinaryAssemblyGraphWriter {
+public:
+
+    // Add a segment and return its index in the segment table.
+    // The sequence can be given as a string of ACGT characters
+    // or as a vector of Base objects.
+    uint64_t addSegment(const string& name, const string& sequence, double coverage);
+    uint64_t addSegment(const string& name, const vector<Base>& sequence, double coverage);
+
+    void addLink(
+        uint64_t segment0, bool reverse0,
+        uint64_t segment1, bool reverse1,
+        uint64_t overlap);
+
+    uint64_t segmentCount() const
+    {
+        return segments.size();
+    }
+
+    void write(const string& fileName) const;
+
+private:
+    vector<BinaryAssemblyGraphSegment> segments;
+    vector<BinaryAssemblyGraphLink> links;
+    vector<uint8_t> sequences;
+    uint64_t sequenceBaseCount = 0;
+    string names;
+
+    uint64_t beginSegment(const string& name, uint64_t length, double coverage);
+    void appendBase(uint8_t baseValue)
+    {
+        const uint64_t shift = 2 * (sequenceBaseCount % 4);
+        if(shift == 0) {
+            sequences.push_back(0);
+        }
+        sequences.back() = uint8_t(sequences.back() | (baseValue << shift));
+        ++sequenceBaseCount;
+    }
+};
+
+
+
+// Read-only access to a binary assembly graph file via memory mapping.
+// The constructor checks that all sections, and the name and sequence
+// of every segment, are inside the file, and that links refer
+// to existing segments. It throws runtime_error if the file
+// is truncated or corrupted.
+class shasta::BinaryAssemblyGraph {
+public:
+    BinaryAssemblyGraph(const string& fileName);
+    ~BinaryAssemblyGraph();
+
+    const BinaryAssemblyGraphHeader& header() const
+    {
+        return *reinterpret_cast<const BinaryAssemblyGraphHeader*>(data);
+    }
+    uint64_t segmentCount() const
+    {
+        return header().segmentCount;
+    }
+    uint64_t linkCount() const
+    {
+        return header().linkCount;
+    }
+    const BinaryAssemblyGraphSegment* segments() const
+    {
+        return reinterpret_cast<const BinaryAssemblyGraphSegment*>(data + header().segmentTableOffset);
+    }
+    const BinaryAssemblyGraphLink* links() const
+    {
+        return reinterpret_cast<const BinaryAssemblyGraphLink*>(data + header().linkTableOffset);
+    }
+    const uint8_t* sequences() const
+    {
+        return reinterpret_cast<const uint8_t*>(data + header().sequenceOffset);
+    }
+    uint64_t sequenceByteCount() const
+    {
+        return header().nameOffset - header().sequenceOffset;
+    }
+    const char* names() const
+    {
+        return data + header().nameOffset;
+    }
+    uint64_t nameByteCount() const
+    {
+        return fileSize - header().nameOffset;
+    }
+
+    // Get the name and sequence of a segment.
+    string getName(uint64_t segmentId) const;
+    string getSequence(uint64_t segmentId) const;
+
+    // BinaryAssemblyGraph is not copyable.
+    BinaryAssemblyGraph(const BinaryAssemblyGraph&) = delete;
+    BinaryAssemblyGraph& operator=(const BinaryAssemblyGraph&) = delete;
+
+private:
+    string fileName;
+    const char* data = 0;
+    uint64_t fileSize = 0;
+
+    // Check the header, segments, and links against the file size.
+    // Throws runtime_error if the file is truncated or corrupted.
+    void check() const;
+};
+
+
+
+#endif
@@ -0,0 +1,404 @@
+// Shasta.
+#include "BinaryDataSnapshot.hpp"
+#include "chrono.hpp"
+#include "filesystem.hpp"
+#include "performanceLog.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include <string.h>
+
+// Linux.
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// zlib.
+#include <zlib.h>
+
+
+
+BinaryDataSnapshot::BinaryDataSnapshot(size_t threadCount) :
+    MultithreadedObject<BinaryDataSnapshot>(*this),
+    threadCount(threadCount)
+{
+    if(this->threadCount == 0) {
+        this->threadCount = std::thread::hardware_concurrency();
+    }
+}
+
+
+
+void BinaryDataSnapshot::save(
+    const string& directoryName,
+    const string& snapshotFileName,
+    uint64_t pageSize)
+{
+    const auto t0 = steady_clock::now();
+    performanceLog << timestamp << "Saving binary data snapshot of " <<
+        directoryName << " to " << snapshotFileName << endl;
+
+    // Gather the regular files in the directory.
+    // Sort them by name so the index is deterministic.
+    vector<string> fileNames = filesystem::directoryContents(directoryName);
+    sort(fileNames.begin(), fileNames.end());
+    files.clear();
+    chunks.clear();
+    names.clear();
+    vector<string> filePaths;
+    for(const string& path: fileNames) {
+        struct stat fileInformation;
+        if(::stat(path.c_str(), &fileInformation) != 0) {
+            throw runtime_error("Error during stat for " + path + ": " + ::strerror(errno));
+        }
+        if(not S_ISREG(fileInformation.st_mode)) {
+            cout << "Skipping " << path << " because it is not a regular file." << endl;
+            continue;
+        }
+        const string name = path.substr(path.find_last_of('/') + 1);
+
+        FileEntry file;
+        file.fileSize = uint64_t(fileInformation.st_size);
+        file.firstChunk = chunks.size();
+        file.chunkCount = (file.fileSize + chunkSize - 1) / chunkSize;
+        file.nameBegin = names.size();
+        file.nameLength = name.size();
+        names.append(name);
+        const uint64_t fileId = files.size();
+        files.push_back(file);
+        filePaths.push_back(path);
+
+        for(uint64_t offset=0; offset<file.fileSize; offset+=chunkSize) {
+            ChunkEntry chunk;
+            ::memset(&chunk, 0, sizeof(chunk));
+            chunk.fileId = fileId;
+            chunk.offsetInFile = offset;
+            chunk.uncompressedSize = min(chunkSize, file.fileSize - offset);
+            chunks.push_back(chunk);
+        }
+    }
+
+    // Map the files.
+    fileData.clear();
+    for(uint64_t fileId=0; fileId<files.size(); fileId++) {
+        fileData.push_back(mapFile(filePaths[fileId], files[fileId].fileSize, false));
+    }
+
+    // Create the snapshot file.
+    snapshotFileDescriptor = ::open(snapshotFileName.c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(snapshotFileDescriptor == -1) {
+        unmapFiles(fileData, files);
+        throw runtime_error("Error opening " + snapshotFileName + ": " + ::strerror(errno));
+    }
+
+    // Compress and write the chunks in parallel.
+    nextOffset = sizeof(Header);
+    setupLoadBalancing(chunks.size(), 1);
+    runThreads(&BinaryDataSnapshot::saveThreadFunction, threadCount);
+    unmapFiles(fileData, files);
+
+    // Write the index.
+    Header header;
+    ::memset(&header, 0, sizeof(header));
+    ::memcpy(header.magic, "SHASTASN", 8);
+    header.version = Header::currentVersion;
+    header.fileCount = files.size();
+    header.chunkCount = chunks.size();
+    header.chunkSize = chunkSize;
+    header.indexOffset = nextOffset;
+    header.namesSize = names.size();
+    header.pageSize = pageSize;
+    uint64_t offset = header.indexOffset;
+    writeAt(snapshotFileDescriptor, files.data(), files.size() * sizeof(FileEntry), offset);
+    offset += files.size() * sizeof(FileEntry);
+    writeAt(snapshotFileDescriptor, chunks.data(), chunks.size() * sizeof(ChunkEntry), offset);
+    offset += chunks.size() * sizeof(ChunkEntry);
+    writeAt(snapshotFileDescriptor, names.data(), names.size(), offset);
+
+    // Write the header last, so an incomplete snapshot is not recognized.
+    writeAt(snapshotFileDescriptor, &header, sizeof(header), 0);
+    ::close(snapshotFileDescriptor);
+    snapshotFileDescriptor = -1;
+
+    uint64_t totalSize = 0;
+    for(const FileEntry& file: files) {
+        totalSize += file.fileSize;
+    }
+    const auto t1 = steady_clock::now();
+    performanceLog << timestamp << "Saved " << files.size() << " files, " <<
+        totalSize << " bytes, in " << chunks.size() << " chunks. Snapshot size " <<
+        offset + names.size() << " bytes. Elapsed time " << seconds(t1 - t0) << " s." << endl;
+    cout << "Saved " << files.size() << " files, " << totalSize << " bytes, to " <<
+        snapshotFileName << " (" << offset + names.size() << " bytes)." << endl;
+}
+
+
+
+void BinaryDataSnapshot::saveThreadFunction(size_t)
+{
+    vector<Bytef> buffer(compressBound(uLong(chunkSize)));
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t chunkId=begin; chunkId!=end; chunkId++) {
+            ChunkEntry& chunk = chunks[chunkId];
+            const Bytef* chunkData = reinterpret_cast<const Bytef*>(
+                fileData[chunk.fileId] + chunk.offsetInFile);
+            chunk.crc = uint32_t(crc32(0L, chunkData, uInt(chunk.uncompressedSize)));
+
+            // Compress it. If it does not get smaller, store it uncompressed.
+            uLongf compressedSize = uLongf(buffer.size());
+            const int returnCode = compress2(buffer.data(), &compressedSize,
+                chunkData, uLong(chunk.uncompressedSize), compressionLevel);
+            const Bytef* storedData = chunkData;
+            chunk.storedSize = chunk.uncompressedSize;
+            chunk.isCompressed = 0;
+            if(returnCode == Z_OK and compressedSize < chunk.uncompressedSize) {
+                storedData = buffer.data();
+                chunk.storedSize = compressedSize;
+                chunk.isCompressed = 1;
+            }
+
+            // Reserve space in the snapshot file, then write it.
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunk.offsetInSnapshot = nextOffset;
+                nextOffset += chunk.storedSize;
+            }
+            writeAt(snapshotFileDescriptor, storedData, chunk.storedSize, chunk.offsetInSnapshot);
+        }
+    }
+}
+
+
+
+void BinaryDataSnapshot::restore(
+    const string& snapshotFileName,
+    const string& directoryName,
+    uint64_t pageSize)
+{
+    const auto t0 = steady_clock::now();
+    performanceLog << timestamp << "Restoring binary data snapshot " <<
+        snapshotFileName << " to " << directoryName << endl;
+
+    snapshotFileDescriptor = ::open(snapshotFileName.c_str(), O_RDONLY);
+    if(snapshotFileDescriptor == -1) {
+        throw runtime_error("Error opening " + snapshotFileName + ": " + ::strerror(errno));
+    }
+
+    // Read the header and check the page size before creating any files.
+    Header header;
+    readHeader(snapshotFileDescriptor, snapshotFileName, header);
+    if(header.pageSize != pageSize) {
+        ::close(snapshotFileDescriptor);
+        snapshotFileDescriptor = -1;
+        throw runtime_error(snapshotFileName + " contains binary data with page size " +
+            to_string(header.pageSize) + " and cannot be restored to a directory with page size " +
+            to_string(pageSize) + ".");
+    }
+
+    // Read the index.
+    files.resize(header.fileCount);
+    chunks.resize(header.chunkCount);
+    names.resize(header.namesSize);
+    uint64_t offset = header.indexOffset;
+    readAt(snapshotFileDescriptor, files.data(), files.size() * sizeof(FileEntry), offset);
+    offset += files.size() * sizeof(FileEntry);
+    readAt(snapshotFileDescriptor, chunks.data(), chunks.size() * sizeof(ChunkEntry), offset);
+    offset += chunks.size() * sizeof(ChunkEntry);
+    readAt(snapshotFileDescriptor, &names[0], names.size(), offset);
+
+    // Create and map the output files.
+    fileData.clear();
+    for(const FileEntry& file: files) {
+        const string path = directoryName + "/" + names.substr(file.nameBegin, file.nameLength);
+        fileData.push_back(mapFile(path, file.fileSize, true));
+    }
+
+    // Decompress the chunks in parallel, directly into the mapped files.
+    setupLoadBalancing(chunks.size(), 1);
+    runThreads(&BinaryDataSnapshot::restoreThreadFunction, threadCount);
+    unmapFiles(fileData, files);
+    ::close(snapshotFileDescriptor);
+    snapshotFileDescriptor = -1;
+
+    uint64_t totalSize = 0;
+    for(const FileEntry& file: files) {
+        totalSize += file.fileSize;
+    }
+    const auto t1 = steady_clock::now();
+    performanceLog << timestamp << "Restored " << files.size() << " files, " <<
+        totalSize << " bytes. Elapsed time " << seconds(t1 - t0) << " s." << endl;
+    cout << "Restored " << files.size() << " files, " << totalSize << " bytes, to " <<
+        directoryName << "." << endl;
+}
+
+
+
+void BinaryDataSnapshot::restoreThreadFunction(size_t)
+{
+    vector<Bytef> buffer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t chunkId=begin; chunkId!=end; chunkId++) {
+            const ChunkEntry& chunk = chunks[chunkId];
+            SHASTA_ASSERT(chunk.fileId < files.size());
+            SHASTA_ASSERT(chunk.offsetInFile + chunk.uncompressedSize <= files[chunk.fileId].fileSize);
+            Bytef* chunkData = reinterpret_cast<Bytef*>(fileData[chunk.fileId] + chunk.offsetInFile);
+
+            if(chunk.isCompressed) {
+                buffer.resize(chunk.storedSize);
+                readAt(snapshotFileDescriptor, buffer.data(), chunk.storedSize, chunk.offsetInSnapshot);
+                uLongf uncompressedSize = uLongf(chunk.uncompressedSize);
+                const int returnCode = uncompress(chunkData, &uncompressedSize,
+                    buffer.data(), uLong(chunk.storedSize));
+                if(returnCode != Z_OK or uncompressedSize != chunk.uncompressedSize) {
+                    throw runtime_error("Error " + to_string(returnCode) +
+                        " decompressing chunk " + to_string(chunkId) + " of binary data snapshot.");
+                }
+            } else {
+                readAt(snapshotFileDescriptor, chunkData, chunk.storedSize, chunk.offsetInSnapshot);
+            }
+
+            if(uint32_t(crc32(0L, chunkData, uInt(chunk.uncompressedSize))) != chunk.crc) {
+                throw runtime_error("Checksum error for chunk " + to_string(chunkId) +
+                    " of binary data snapshot.");
+            }
+        }
+    }
+}
+
+
+
+uint64_t BinaryDataSnapshot::getPageSize(const string& snapshotFileName)
+{
+    const int fileDescriptor = ::open(snapshotFileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + snapshotFileName + ": " + ::strerror(errno));
+    }
+    Header header;
+    readHeader(fileDescriptor, snapshotFileName, header);
+    ::close(fileDescriptor);
+    return header.pageSize;
+}
+
+
+
+void BinaryDataSnapshot::readHeader(
+    int fileDescriptor,
+    const string& snapshotFileName,
+    Header& header)
+{
+    try {
+        readAt(fileDescriptor, &header, sizeof(header), 0);
+    } catch(...) {
+        ::close(fileDescriptor);
+        throw;
+    }
+    if(::memcmp(header.magic, "SHASTASN", 8) != 0) {
+        ::close(fileDescriptor);
+        throw runtime_error(snapshotFileName + " is not a Shasta binary data snapshot "
+            "or is incomplete.");
+    }
+    if(header.version != Header::currentVersion) {
+        ::close(fileDescriptor);
+        throw runtime_error(snapshotFileName + " has unsupported snapshot version " +
+            to_string(header.version));
+    }
+}
+
+
+
+// Map a file to memory. Also works on hugetlbfs.
+// If writeAccess is true, the file is created with the specified size.
+char* BinaryDataSnapshot::mapFile(const string& fileName, uint64_t fileSize, bool writeAccess)
+{
+    const int fileDescriptor = writeAccess ?
+        ::open(fileName.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) :
+        ::open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + ": " + ::strerror(errno));
+    }
+    if(writeAccess) {
+        if(::ftruncate(fileDescriptor, off_t(fileSize)) == -1) {
+            ::close(fileDescriptor);
+            throw runtime_error("Error during ftruncate for " + fileName + ": " + ::strerror(errno));
+        }
+    }
+    if(fileSize == 0) {
+        ::close(fileDescriptor);
+        return 0;
+    }
+
+    void* pointer = ::mmap(0, fileSize,
+        writeAccess ? (PROT_READ | PROT_WRITE) : PROT_READ,
+        MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if(pointer == reinterpret_cast<void*>(-1LL)) {
+        throw runtime_error("Error mapping " + fileName + " to memory: " + ::strerror(errno));
+    }
+    return static_cast<char*>(pointer);
+}
+
+
+
+void BinaryDataSnapshot::unmapFiles(vector<char*>& fileData, const vector<FileEntry>& files)
+{
+    for(uint64_t fileId=0; fileId<fileData.size(); fileId++) {
+        if(fileData[fileId]) {
+            ::munmap(fileData[fileId], files[fileId].fileSize);
+        }
+    }
+    fileData.clear();
+}
+
+
+
+void BinaryDataSnapshot::writeAt(int fileDescriptor, const void* p, uint64_t size, uint64_t offset)
+{
+    const char* q = static_cast<const char*>(p);
+    while(size > 0) {
+        const ssize_t n = ::pwrite(fileDescriptor, q, size, off_t(offset));
+        if(n <= 0) {
+            if(n == -1 and errno == EINTR) {
+                continue;
+            }
+            throw runtime_error(string("Error writing binary data snapshot: ") + ::strerror(errno));
+        }
+        q += n;
+        size -= uint64_t(n);
+        offset += uint64_t(n);
+    }
+}
+
+
+
+void BinaryDataSnapshot::readAt(int fileDescriptor, void* p, uint64_t size, uint64_t offset)
+{
+    char* q = static_cast<char*>(p);
+    while(size > 0) {
+        const ssize_t n = ::pread(fileDescriptor, q, size, off_t(offset));
+        if(n == 0) {
+            throw runtime_error("Unexpected end of file reading binary data snapshot.");
+        }
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw runtime_error(string("Error reading binary data snapshot: ") + ::strerror(errno));
+        }
+        q += n;
+        size -= uint64_t(n);
+        offset += uint64_t(n);
+    }
+}
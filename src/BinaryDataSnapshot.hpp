@@ -0,0 +1,143 @@
+#ifndef SHASTA_BINARY_DATA_SNAPSHOT_HPP
+#define SHASTA_BINARY_DATA_SNAPSHOT_HPP
+
+/*******************************************************************************
+
+Class BinaryDataSnapshot saves the binary data of an assembly
+(all files in the Data directory) to a single compressed snapshot file,
+and restores them from it. It is used by
+--command saveBinaryDataSnapshot and --command restoreBinaryDataSnapshot.
+
+Each file is divided into chunks of chunkSize bytes and each chunk
+is compressed independently using zlib, so both saving and restoring
+use all threads. Files are accessed via memory mapping, which also works
+when Data is on a hugetlbfs filesystem (--memoryBacking 2M),
+where read and write are not supported.
+During restore, each chunk is decompressed directly into
+the memory mapped output file.
+
+A snapshot file contains:
+- A Header.
+- The compressed chunks, in no particular order.
+- An index, beginning at Header::indexOffset, containing:
+  * A FileEntry for each file.
+  * A ChunkEntry for each chunk, grouped by file.
+  * The file names, concatenated.
+
+Chunks are stored uncompressed if compression does not make them smaller.
+Each chunk stores a crc32 checksum of its uncompressed data,
+which is checked during restore.
+
+The Header also stores the page size of the binary data
+(AssemblerInfo::largeDataPageSize). Files are restored with their
+original sizes, which are multiples of that page size, so a snapshot
+can only be restored to a Data directory with the same page size:
+a snapshot of 4K binary data cannot be restored to hugetlbfs
+(--memoryBacking 2M), and vice versa.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class BinaryDataSnapshot;
+}
+
+
+
+class shasta::BinaryDataSnapshot :
+    public MultithreadedObject<BinaryDataSnapshot> {
+public:
+
+    BinaryDataSnapshot(size_t threadCount);
+
+    // Save all regular files in a directory to a snapshot file.
+    // The page size of the binary data is stored in the snapshot.
+    void save(const string& directoryName, const string& snapshotFileName, uint64_t pageSize);
+
+    // Restore all files in a snapshot file to a directory, which must exist.
+    // Throws, without creating any files, if the page size stored
+    // in the snapshot is not the specified page size.
+    void restore(const string& snapshotFileName, const string& directoryName, uint64_t pageSize);
+
+    // Return the page size stored in a snapshot file.
+    static uint64_t getPageSize(const string& snapshotFileName);
+
+    // Uncompressed size of each chunk.
+    static const uint64_t chunkSize = 64ULL * 1024ULL * 1024ULL;
+
+    // zlib compression level. Favor speed, because
+    // binary data contain mostly integers that compress well
+    // even at the fastest level.
+    static const int compressionLevel = 1;
+
+private:
+    size_t threadCount;
+
+    class Header {
+    public:
+        char magic[8];
+        uint64_t version;
+        uint64_t fileCount;
+        uint64_t chunkCount;
+        uint64_t chunkSize;
+        uint64_t indexOffset;
+        uint64_t namesSize;
+        uint64_t pageSize;
+        static const uint64_t currentVersion = 2;
+    };
+
+    // Read and check the header of an open snapshot file.
+    // In case of failure, close the file and throw.
+    static void readHeader(int fileDescriptor, const string& snapshotFileName, Header&);
+
+    class FileEntry {
+    public:
+        uint64_t fileSize;
+        uint64_t firstChunk;
+        uint64_t chunkCount;
+        uint64_t nameBegin;
+        uint64_t nameLength;
+    };
+
+    class ChunkEntry {
+    public:
+        uint64_t fileId;
+        uint64_t offsetInFile;
+        uint64_t uncompressedSize;
+        uint64_t offsetInSnapshot;
+        uint64_t storedSize;
+        uint32_t crc;
+        uint32_t isCompressed;
+    };
+
+    // Data used by both save and restore.
+    vector<FileEntry> files;
+    vector<ChunkEntry> chunks;
+    string names;
+    vector<char*> fileData;
+    int snapshotFileDescriptor = -1;
+
+    // The next available offset in the snapshot file,
+    // protected by the mutex of MultithreadedObject.
+    uint64_t nextOffset = 0;
+
+    void saveThreadFunction(size_t threadId);
+    void restoreThreadFunction(size_t threadId);
+
+    // Map a file to memory. Also works on hugetlbfs.
+    static char* mapFile(const string& fileName, uint64_t fileSize, bool writeAccess);
+    static void unmapFiles(vector<char*>&, const vector<FileEntry>&);
+
+    // Read or write the entire range, or throw.
+    static void writeAt(int fileDescriptor, const void*, uint64_t size, uint64_t offset);
+    static void readAt(int fileDescriptor, void*, uint64_t size, uint64_t offset);
+};
+
+#endif
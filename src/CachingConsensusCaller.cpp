@@ -0,0 +1,149 @@
+// Shasta.
+#include "CachingConsensusCaller.hpp"
+#include "Coverage.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <functional>
+#include "iostream.hpp"
+
+
+
+CachingConsensusCaller::CachingConsensusCaller(
+    shared_ptr<ConsensusCaller> consensusCaller,
+    uint64_t capacity) :
+    consensusCaller(consensusCaller),
+    shardCapacity((capacity + shardCount - 1) / shardCount),
+    hitCount(0),
+    missCount(0),
+    bypassCount(0)
+{
+    SHASTA_ASSERT(consensusCaller);
+}
+
+
+
+Consensus CachingConsensusCaller::operator()(const Coverage& coverage) const
+{
+    // Compute the key. If this fails, just call the
+    // underlying ConsensusCaller.
+    string key;
+    if(not computeKey(coverage, key)) {
+        ++bypassCount;
+        return (*consensusCaller)(coverage);
+    }
+
+    // Look it up in its shard.
+    Shard& shard = shards[std::hash<string>()(key) % shardCount];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto it = shard.results.find(key);
+        if(it != shard.results.end()) {
+            ++hitCount;
+            return it->second;
+        }
+    }
+
+    // It is not in the cache. Compute it without holding the lock.
+    ++missCount;
+    const Consensus consensus = (*consensusCaller)(coverage);
+
+    // Store it, unless the shard is full.
+    // If another thread stored the same key in the meantime
+    // this does nothing.
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if(shard.results.size() < shardCapacity) {
+            shard.results.insert(make_pair(key, consensus));
+        }
+    }
+
+    return consensus;
+}
+
+
+
+// The canonical key is obtained by encoding each observation
+// (base, strand, repeatCount) in 16 bits, sorting the codes,
+// and then storing each distinct code followed by its
+// number of occurrences, also in 16 bits.
+// Coverage objects with repeat counts >= 4096 or with
+// an observation repeated 65536 times or more cannot be encoded.
+bool CachingConsensusCaller::computeKey(const Coverage& coverage, string& key)
+{
+    const vector<CoverageData>& coverageData = coverage.getReadCoverageData();
+
+    vector<uint16_t> codes;
+    codes.reserve(coverageData.size());
+    for(const CoverageData& c: coverageData) {
+        if(c.repeatCount >= 4096) {
+            return false;
+        }
+        codes.push_back(uint16_t((c.repeatCount << 4) | (c.base.value << 1) | c.strand));
+    }
+    sort(codes.begin(), codes.end());
+
+    key.clear();
+    key.reserve(4 * codes.size());
+    for(auto it=codes.begin(); it!=codes.end(); /* Increment later */) {
+        const uint16_t code = *it;
+        auto jt = it;
+        while(jt!=codes.end() and *jt==code) {
+            ++jt;
+        }
+        const uint64_t frequency = jt - it;
+        if(frequency >= 65536) {
+            return false;
+        }
+        key.push_back(char(code & 0xff));
+        key.push_back(char(code >> 8));
+        key.push_back(char(frequency & 0xff));
+        key.push_back(char(frequency >> 8));
+        it = jt;
+    }
+    return true;
+}
+
+
+
+uint64_t CachingConsensusCaller::size() const
+{
+    uint64_t n = 0;
+    for(Shard& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        n += shard.results.size();
+    }
+    return n;
+}
+
+
+
+void CachingConsensusCaller::writeStatistics(ostream& s) const
+{
+    const uint64_t hits = hitCount;
+    const uint64_t misses = missCount;
+    const uint64_t bypasses = bypassCount;
+    const uint64_t total = hits + misses + bypasses;
+
+    s << "Consensus caller cache: " <<
+        total << " calls, " <<
+        hits << " hits, " <<
+        misses << " misses, " <<
+        bypasses << " bypassed, " <<
+        size() << " cached results.";
+    if(total > 0) {
+        s << " Hit rate " << double(hits) / double(total) << ".";
+    }
+    s << endl;
+}
+
+
+
+void CachingConsensusCaller::clearStatistics()
+{
+    hitCount = 0;
+    missCount = 0;
+    bypassCount = 0;
+}
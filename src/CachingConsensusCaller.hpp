@@ -0,0 +1,107 @@
+#ifndef SHASTA_CACHING_CONSENSUS_CALLER_HPP
+#define SHASTA_CACHING_CONSENSUS_CALLER_HPP
+
+/*******************************************************************************
+
+A CachingConsensusCaller is a ConsensusCaller that memoizes
+the results of another ConsensusCaller.
+
+Many marker graph vertices and edge positions have identical
+coverage, that is, the same multiset of (base, strand, repeatCount)
+observations. All consensus callers in Shasta only depend on that
+multiset and not on the order of the reads, so the result
+can be cached using a canonical encoding of the multiset as the key.
+
+The cache is safe to use from multiple threads.
+It is split into a fixed number of shards, each protected by
+its own mutex, to reduce contention.
+The cache is bounded: when a shard is full, new results
+are still computed and returned but no longer stored.
+
+Hit/miss statistics are kept and can be written out
+(normally to performance.log) using writeStatistics.
+
+*******************************************************************************/
+
+// Shasta.
+#include "ConsensusCaller.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include <atomic>
+#include "iosfwd.hpp"
+#include "memory.hpp"
+#include <mutex>
+#include "string.hpp"
+#include <unordered_map>
+
+namespace shasta {
+    class CachingConsensusCaller;
+}
+
+
+
+class shasta::CachingConsensusCaller :
+    public shasta::ConsensusCaller {
+public:
+
+    // The capacity is the maximum total number of cached results.
+    CachingConsensusCaller(
+        shared_ptr<ConsensusCaller>,
+        uint64_t capacity = defaultCapacity);
+
+    virtual Consensus operator()(const Coverage&) const;
+
+    // Access the ConsensusCaller that does the actual work.
+    const ConsensusCaller& getConsensusCaller() const
+    {
+        return *consensusCaller;
+    }
+
+    // Statistics.
+    uint64_t getHitCount() const
+    {
+        return hitCount;
+    }
+    uint64_t getMissCount() const
+    {
+        return missCount;
+    }
+    uint64_t getBypassCount() const
+    {
+        return bypassCount;
+    }
+    uint64_t size() const;
+    void writeStatistics(ostream&) const;
+
+    // Reset the statistics but keep the cached results.
+    void clearStatistics();
+
+    static const uint64_t defaultCapacity = 4 * 1024 * 1024;
+
+private:
+
+    shared_ptr<ConsensusCaller> consensusCaller;
+
+    // Compute the canonical key for a Coverage object.
+    // This returns false if the coverage cannot be encoded,
+    // in which case the cache is bypassed.
+    static bool computeKey(const Coverage&, string& key);
+
+    static const uint64_t shardCount = 64;
+    uint64_t shardCapacity;
+    class Shard {
+    public:
+        std::mutex mutex;
+        std::unordered_map<string, Consensus> results;
+    };
+    mutable array<Shard, shardCount> shards;
+
+    mutable std::atomic<uint64_t> hitCount;
+    mutable std::atomic<uint64_t> missCount;
+    mutable std::atomic<uint64_t> bypassCount;
+};
+
+
+
+#endif
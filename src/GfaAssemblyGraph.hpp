@@ -12,6 +12,8 @@
 
 // Shasta.
 #include "Base.hpp"
+#include "BinaryAssemblyGraph.hpp"
+#include "OrderedFileWriter.hpp"
 #include "SHASTA_ASSERT.hpp"
 
 // Boost libraries.
@@ -19,10 +21,18 @@
 #include <boost/graph/iteration_macros.hpp>
 
 // Standard library.
+#include "algorithm.hpp"
+#include <atomic>
 #include "cstdint.hpp"
+#include <exception>
 #include "fstream.hpp"
+#include "iterator.hpp"
 #include <map>
+#include <mutex>
+#include <sstream>
 #include "string.hpp"
+#include <thread>
+#include "utility.hpp"
 #include "vector.hpp"
 
 
@@ -52,6 +62,9 @@ public:
     bool sequenceLengthIsAvailable = false;;
     uint64_t sequenceLength = 0;    // Only valid if the above is true.
 
+    // Average coverage, only used by writeBinary.
+    double coverage = 0.;
+
     GfaAssemblyGraphEdge(
         const string& name
         ) :
@@ -69,13 +82,15 @@ public:
 
     GfaAssemblyGraphEdge(
         const string& name,
-        const vector<Base>& sequence
+        const vector<Base>& sequence,
+        double coverage = 0.
         ) :
         name(name),
         sequenceIsAvailable(true),
         sequence(sequence),
         sequenceLengthIsAvailable(true),
-        sequenceLength(uint64_t(sequence.size()))
+        sequenceLength(uint64_t(sequence.size())),
+        coverage(coverage)
     {}
 };
 
@@ -86,16 +101,18 @@ template <class Vertex> class shasta::GfaAssemblyGraph :
 public:
 
     // Add a segment with known sequence.
+    // The coverage is optional and only used by writeBinary.
     void addSegment(
         const string& name,
         Vertex vertex0,
         Vertex vertex1,
-        const vector<Base>& sequence
+        const vector<Base>& sequence,
+        double coverage = 0.
     )
     {
         const vertex_descriptor v0 = getVertex(vertex0);
         const vertex_descriptor v1 = getVertex(vertex1);
-        boost::add_edge(v0, v1, GfaAssemblyGraphEdge(name, sequence), *this);
+        boost::add_edge(v0, v1, GfaAssemblyGraphEdge(name, sequence, coverage), *this);
     }
 
     // Add a segment with unknown sequence,
@@ -132,12 +149,92 @@ public:
     }
 
     // Write out in GFA format.
-    void write(const string& fileName) const
+    // Segment records are formatted in parallel, in batches,
+    // and all records are written out in order using an OrderedFileWriter.
+    // The output is the same as the output of writeSerial.
+    void write(const string& fileName, uint64_t threadCount = 0) const
+    {
+        const G& g = *this;
+        if(threadCount == 0) {
+            threadCount = std::thread::hardware_concurrency();
+        }
+
+        // Gather the edges, in the order used by writeSegments.
+        vector<const GfaAssemblyGraphEdge*> segmentEdges;
+        BGL_FORALL_EDGES_T(e, g, G) {
+            segmentEdges.push_back(&g[e]);
+        }
+
+        OrderedFileWriter writer(fileName);
+        uint64_t sequenceNumber = 0;
+        {
+            std::ostringstream s;
+            writeHeader(s);
+            writer.write(sequenceNumber++, s.str());
+        }
+
+        // Write the segments.
+        // Batch i gets sequence number firstSequenceNumber + i.
+        const uint64_t firstSequenceNumber = sequenceNumber;
+        const uint64_t batchSize = 100;
+        const uint64_t batchCount = (segmentEdges.size() + batchSize - 1) / batchSize;
+        std::atomic<uint64_t> nextBatch(0);
+        std::mutex exceptionMutex;
+        std::exception_ptr exception;
+        vector<std::thread> threads;
+        for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+            threads.push_back(std::thread([&]()
+            {
+                try {
+                    string buffer;
+                    while(true) {
+                        const uint64_t batch = nextBatch++;
+                        if(batch >= batchCount) {
+                            break;
+                        }
+                        const uint64_t begin = batch * batchSize;
+                        const uint64_t end = std::min(begin + batchSize, uint64_t(segmentEdges.size()));
+                        buffer.clear();
+                        for(uint64_t i=begin; i!=end; i++) {
+                            appendSegment(*segmentEdges[i], buffer);
+                        }
+                        writer.write(firstSequenceNumber + batch, buffer);
+                    }
+                } catch(...) {
+                    {
+                        std::lock_guard<std::mutex> lock(exceptionMutex);
+                        if(not exception) {
+                            exception = std::current_exception();
+                        }
+                    }
+                    writer.abort();
+                }
+            }));
+        }
+        for(std::thread& thread: threads) {
+            thread.join();
+        }
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+        sequenceNumber += batchCount;
+
+        // Write the links and paths.
+        {
+            std::ostringstream s;
+            writeLinks(s);
+            writePaths(s);
+            writer.write(sequenceNumber++, s.str());
+        }
+    }
+
+    // Serial version of write. Only used to test write.
+    void writeSerial(const string& fileName) const
     {
         ofstream gfa(fileName);
-        write(gfa);
+        writeSerial(gfa);
     }
-    void write(ostream& gfa) const
+    void writeSerial(ostream& gfa) const
     {
         writeHeader(gfa);
         writeSegments(gfa);
@@ -145,6 +242,37 @@ public:
         writePaths(gfa);
     }
 
+    // Write out in the binary format described in BinaryAssemblyGraph.hpp.
+    // This should only be called if all segments have known sequence.
+    // Paths are not written.
+    void writeBinary(const string& fileName) const
+    {
+        const G& g = *this;
+        BinaryAssemblyGraphWriter writer;
+
+        // Add the segments.
+        std::map<const GfaAssemblyGraphEdge*, uint64_t> segmentMap;
+        BGL_FORALL_EDGES_T(e, g, G) {
+            const GfaAssemblyGraphEdge& edge = g[e];
+            SHASTA_ASSERT(edge.sequenceIsAvailable);
+            segmentMap.insert(make_pair(&edge,
+                writer.addSegment(edge.name, edge.sequence, edge.coverage)));
+        }
+
+        // Add the links, in the same order used by writeLinks.
+        BGL_FORALL_VERTICES_T(v, g, G) {
+            BGL_FORALL_INEDGES_T(v, e0, g, G) {
+                const uint64_t segment0 = segmentMap[&g[e0]];
+                BGL_FORALL_OUTEDGES_T(v, e1, g, G) {
+                    const uint64_t segment1 = segmentMap[&g[e1]];
+                    writer.addLink(segment0, false, segment1, false, 0);
+                }
+            }
+        }
+
+        writer.write(fileName);
+    }
+
     using BaseClass = GfaAssemblyGraphBaseClass<Vertex>;
     using vertex_descriptor = typename BaseClass::vertex_descriptor;
     using G = GfaAssemblyGraph<Vertex>;
@@ -190,6 +318,30 @@ private:
     }
 
 
+    // Append to a string the segment record for an edge.
+    // This formats the record in the same way as writeSegments.
+    static void appendSegment(const GfaAssemblyGraphEdge& edge, string& s)
+    {
+        s.append("S\t");
+        s.append(edge.name);
+        s.append("\t");
+        if(edge.sequenceIsAvailable) {
+            for(const Base b: edge.sequence) {
+                s.push_back(b.character());
+            }
+            s.append("\tLN:i:");
+            s.append(to_string(edge.sequenceLength));
+            s.append("\n");
+        } else if (edge.sequenceLengthIsAvailable) {
+            s.append("*\tLN:i:");
+            s.append(to_string(edge.sequenceLength));
+            s.append("\n");
+        } else {
+            s.append("*\n");
+        }
+    }
+
+
     // Write the GFA links.
     // For each vertex, we write a link for each pair of
     // incoming/outgoing edges.
@@ -7,11 +7,14 @@ using namespace shasta;
 
 void LongBaseSequences::createNew(
     const string& name,
-    size_t pageSize)
+    size_t pageSize,
+    const string& anonymousName)
 {
     if(name.empty()) {
-        baseCount.createNew("", pageSize);
-        data.createNew("", pageSize);
+        baseCount.createNew("", pageSize,
+            anonymousName.empty() ? "" : (anonymousName + "-BaseCount"));
+        data.createNew("", pageSize,
+            anonymousName.empty() ? "" : (anonymousName + "-Bases"));
     } else {
         baseCount.createNew(name + "-BaseCount", pageSize);
         data.createNew(name + "-Bases", pageSize);
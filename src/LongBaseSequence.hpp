@@ -246,7 +246,9 @@ private:
 class shasta::LongBaseSequences {
 public:
 
-    void createNew(const string& name, size_t pageSize);
+    // If the name is empty, anonymousName is used to identify
+    // the anonymous vectors in MemoryMapped::vectorStatistics.
+    void createNew(const string& name, size_t pageSize, const string& anonymousName = "");
     void accessExistingReadOnly(const string& name);
     void accessExistingReadWrite(const string& name);
     void accessExistingReadWriteOrCreateNew(const string& name, size_t pageSize);
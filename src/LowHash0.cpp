@@ -114,6 +114,10 @@ LowHash0::LowHash0(
     buckets.createNew(
         largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-Buckets"),
         largeDataPageSize);
+    bucketsBuilder = make_shared< MemoryMapped::VectorOfVectorsBuilder<BucketEntry, uint64_t> >(
+        threadCount,
+        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-BucketsBuilder"),
+        largeDataPageSize);
     lowHashes.resize(orientedReadCount);
     candidates.resize(readCount);
     threadStatistics.resize(threadCount);
@@ -158,19 +162,24 @@ LowHash0::LowHash0(
         performanceLog << timestamp << "LowHash0 iteration " << iteration << " begins." << endl;
 
         // Pass1: compute the low hashes for each oriented read
-        // and prepare the buckets for filling.
-        buckets.clear();
-        buckets.beginPass1(bucketCount);
+        // and emit the corresponding bucket entries.
+        const auto t0 = steady_clock::now();
         size_t batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash0::pass1ThreadFunction, threadCount);
 
-        // Pass 2: fill the buckets.
-        buckets.beginPass2();
+        // Fill the buckets.
+        const auto t1 = steady_clock::now();
+        bucketsBuilder->build(bucketCount, buckets, threadCount);
+        const auto t2 = steady_clock::now();
+        performanceLog << "LowHash0 iteration " << iteration <<
+            ": computing low hashes took " << seconds(t1 - t0) <<
+            " s, filling buckets took " << seconds(t2 - t1) << " s." << endl;
+
+        // Pass 2: update low hash statistics for each read.
         batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash0::pass2ThreadFunction, threadCount);
-        buckets.endPass2(false, false);
         computeBucketHistogram();
 
         // Pass 3: inspect the buckets to find candidates.
@@ -243,6 +252,7 @@ LowHash0::LowHash0(
 
     // Clean up work areas.
     buckets.remove();
+    bucketsBuilder = 0;
     kmerIds.remove();
 
 
@@ -307,7 +317,7 @@ void LowHash0::createKmerIds(size_t threadId)
 
 
 // Pass1: compute the low hashes for each oriented read
-// and prepare the buckets for filling.
+// and emit the corresponding bucket entries.
 void LowHash0::pass1ThreadFunction(size_t threadId)
 {
     const int featureByteCount = int(m * sizeof(KmerId));
@@ -347,7 +357,7 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
                     if(hash < hashThreshold) {
                         orientedReadLowHashes.push_back(hash);
                         const uint64_t bucketId = hash & mask;
-                        buckets.incrementCountMultithreaded(bucketId);
+                        bucketsBuilder->emit(threadId, bucketId, BucketEntry(orientedReadId, hash));
                     }
                 }
             }
@@ -358,7 +368,7 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
 
 
 
-// Pass 2: fill the buckets.
+// Pass 2: update low hash statistics for each read.
 void LowHash0::pass2ThreadFunction(size_t threadId)
 {
 
@@ -377,7 +387,6 @@ void LowHash0::pass2ThreadFunction(size_t threadId)
 
                 for(const uint64_t hash: orientedReadLowHashes) {
                     const uint64_t bucketId = hash & mask;
-                    buckets.storeMultithreaded(bucketId, BucketEntry(orientedReadId, hash));
 
                     // Update statistics for this read.
                     const uint64_t bucketSize = buckets.size(bucketId);
@@ -4,6 +4,7 @@
 // Shasta
 #include "Marker.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
+#include "MemoryMappedVectorOfVectorsBuilder.hpp"
 #include "MultithreadedObject.hpp"
 #include "OrientedReadPair.hpp"
 #include "Reads.hpp"
@@ -103,6 +104,10 @@ private:
     };
     MemoryMapped::VectorOfVectors<BucketEntry, uint64_t> buckets;
 
+    // Used to fill the buckets at each iteration.
+    // Each thread emits the bucket entries it finds into its own stream.
+    shared_ptr< MemoryMapped::VectorOfVectorsBuilder<BucketEntry, uint64_t> > bucketsBuilder;
+
 
 
     // Class used to store candidate pairs.
@@ -188,10 +193,10 @@ private:
     // Thread functions.
 
     // Pass1: compute the low hashes for each oriented read
-    // and prepare the buckets for filling.
+    // and emit the corresponding bucket entries.
     void pass1ThreadFunction(size_t threadId);
 
-    // Pass 2: fill the buckets.
+    // Pass 2: after the buckets are filled, update low hash statistics for each read.
     void pass2ThreadFunction(size_t threadId);
 
     // Pass 3: inspect the buckets to find candidates.
@@ -2,6 +2,7 @@
 #include "LowHash1.hpp"
 #include "AlignmentCandidates.hpp"
 #include "Marker.hpp"
+#include "performanceLog.hpp"
 using namespace shasta;
 
 // Standad library.
@@ -95,7 +96,10 @@ LowHash1::LowHash1(
     buckets.createNew(
             largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-Buckets"),
             largeDataPageSize);
-    lowHashes.resize(orientedReadCount);
+    bucketsBuilder = make_shared< MemoryMapped::VectorOfVectorsBuilder<BucketEntry, uint64_t> >(
+        threadCount,
+        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-BucketsBuilder"),
+        largeDataPageSize);
     threadCommonFeatures.resize(threadCount);
     for(size_t threadId=0; threadId!=threadCount; threadId++) {
         threadCommonFeatures[threadId] = make_shared<MemoryMapped::Vector<CommonFeature> >();
@@ -113,18 +117,19 @@ LowHash1::LowHash1(
         cout << timestamp << "LowHash iteration " << iteration << " begins." << endl;
 
         // Compute the low hashes for each oriented read
-        // and count the number of low hash features in each bucket.
-        buckets.clear();
-        buckets.beginPass1(bucketCount);
+        // and emit the corresponding bucket entries.
+        const auto t0 = steady_clock::now();
         size_t batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash1::computeHashesThreadFunction, threadCount);
 
         // Fill the buckets.
-        buckets.beginPass2();
-        setupLoadBalancing(readCount, batchSize);
-        runThreads(&LowHash1::fillBucketsThreadFunction, threadCount);
-        buckets.endPass2(false, false);
+        const auto t1 = steady_clock::now();
+        bucketsBuilder->build(bucketCount, buckets, threadCount);
+        const auto t2 = steady_clock::now();
+        performanceLog << "LowHash1 iteration " << iteration <<
+            ": computing low hashes took " << seconds(t1 - t0) <<
+            " s, filling buckets took " << seconds(t2 - t1) << " s." << endl;
         cout << "Load factor at this iteration " <<
             double(buckets.totalSize()) / double(buckets.size()) << endl;
         computeBucketHistogram();
@@ -163,8 +168,8 @@ LowHash1::LowHash1(
 
     // Clean up.
     buckets.remove();
+    bucketsBuilder = 0;
     kmerIds.remove();
-    lowHashes.clear();
     commonFeatures.remove();
 
     // Done.
@@ -245,8 +250,6 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
             for(Strand strand=0; strand<2; strand++) {
                 const OrientedReadId orientedReadId(readId, strand);
 
-                vector< pair<uint64_t, uint32_t> >& orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
-                orientedReadLowHashes.clear();
                 const size_t markerCount = kmerIds.size(orientedReadId.getValue());
 
                 // Handle the pathological case where there are fewer than m markers.
@@ -264,9 +267,8 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
                 for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
                     const uint64_t hash = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
                     if(hash < hashThreshold) {
-                        orientedReadLowHashes.push_back(make_pair(hash, j));
                         const uint64_t bucketId = hash & mask;
-                        buckets.incrementCountMultithreaded(bucketId);
+                        bucketsBuilder->emit(threadId, bucketId, BucketEntry(orientedReadId, uint32_t(j)));
                     }
                 }
             }
@@ -277,36 +279,6 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
 
 
 
-// Thread function to fill the buckets.
-void LowHash1::fillBucketsThreadFunction(size_t threadId)
-{
-
-    // Loop over batches assigned to this thread.
-    uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
-
-        // Loop over oriented reads assigned to this batch.
-        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
-            if(reads.getFlags(readId).isPalindromic) {
-                continue;
-            }
-            for(Strand strand=0; strand<2; strand++) {
-                const OrientedReadId orientedReadId(readId, strand);
-                const vector< pair<uint64_t, uint32_t> > & orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
-
-                for(const auto& p: orientedReadLowHashes) {
-                    const uint64_t hash = p.first;
-                    const uint64_t bucketId = hash & mask;
-                    const uint32_t ordinal = p.second;
-                    buckets.storeMultithreaded(bucketId, BucketEntry(orientedReadId, ordinal));
-                }
-            }
-        }
-    }
-}
-
-
-
 void LowHash1::computeBucketHistogram()
 {
     threadBucketHistogram.clear();
@@ -6,6 +6,7 @@
 // Shasta.
 #include "SHASTA_ASSERT.hpp"
 #include "filesystem.hpp"
+#include "MemoryMappedVectorPolicy.hpp"
 #include "touchMemory.hpp"
 
 // Standard libraries.
@@ -286,6 +287,13 @@ template<class T> inline void shasta::MemoryMapped::Object<T>::createNew(
         return;
     }
 
+    // Binary data published for sharing between processes
+    // (see class SharedAssemblyData) are never overwritten.
+    if(vectorPolicy.isSharedReadOnly(name)) {
+        throw runtime_error("Cannot create " + name +
+            " because it is in a shared read-only directory.");
+    }
+
     try {
         // If already open, should have called close first.
         SHASTA_ASSERT(!isOpen);
@@ -499,6 +507,10 @@ template<class T> inline void shasta::MemoryMapped::Object<T>::close()
 // Close it and remove the supporting file.
 template<class T> inline void shasta::MemoryMapped::Object<T>::remove()
 {
+    if(vectorPolicy.isSharedReadOnly(fileName)) {
+        throw runtime_error("Cannot remove " + fileName +
+            " because it is in a shared read-only directory.");
+    }
     const string savedFileName = fileName;
     close();    // This forgets the fileName.
     filesystem::remove(savedFileName);
@@ -1,5 +1,10 @@
 #include "MemoryMappedObject.hpp"
 #include "MemoryMappedVector.hpp"
+#include "MemoryMappedVectorOfVectorsBuilder.hpp"
+
+#include "algorithm.hpp"
+#include "iostream.hpp"
+#include <thread>
 
 namespace shasta {
     class MemoryMappedObjectTest {
@@ -33,3 +38,99 @@ void shasta::testMemoryMappedVector()
     SHASTA_ASSERT(x->b == 3);
 #endif
 }
+
+
+
+// Check that VectorOfVectorsBuilder gives the same result as the
+// two pass construction (incrementCountMultithreaded, storeMultithreaded)
+// on strongly skewed indexes, where most values go to a few vectors.
+// The two pass construction stores values in nondeterministic order,
+// so the values of each vector are compared after sorting.
+void shasta::testVectorOfVectorsBuilder()
+{
+    const uint64_t n = 100000;
+    const uint64_t valueCount = 4000000;
+    const size_t threadCount = 8;
+
+    // Index for each value. Half of the values go to index 0,
+    // a quarter to index 1, and so on, and the rest are spread
+    // over all indexes by a linear congruential generator.
+    const auto getIndex = [n](uint64_t i)
+    {
+        const uint64_t x = 6364136223846793005ULL * i + 1442695040888963407ULL;
+        const uint64_t level = __builtin_ctzll(x | (1ULL << 20));
+        return (level < 20) ? level : ((x >> 24) % n);
+    };
+
+    // Build using the builder. Each thread emits a contiguous range of values.
+    MemoryMapped::VectorOfVectors<uint64_t, uint64_t> v0;
+    v0.createNew("", 4096);
+    {
+        MemoryMapped::VectorOfVectorsBuilder<uint64_t, uint64_t> builder(threadCount, "", 4096);
+        vector<std::thread> threads;
+        for(size_t streamId=0; streamId<threadCount; streamId++) {
+            threads.push_back(std::thread([&, streamId]()
+            {
+                const uint64_t begin = (valueCount * streamId) / threadCount;
+                const uint64_t end = (valueCount * (streamId + 1)) / threadCount;
+                for(uint64_t i=begin; i!=end; i++) {
+                    builder.emit(streamId, getIndex(i), i);
+                }
+            }));
+        }
+        for(std::thread& t: threads) {
+            t.join();
+        }
+        SHASTA_ASSERT(builder.totalSize() == valueCount);
+        builder.build(n, v0, threadCount);
+        SHASTA_ASSERT(builder.totalSize() == 0);
+    }
+
+    // Build using the two pass construction.
+    MemoryMapped::VectorOfVectors<uint64_t, uint64_t> v1;
+    v1.createNew("", 4096);
+    for(uint64_t pass=1; pass<=2; pass++) {
+        if(pass == 1) {
+            v1.beginPass1(n);
+        } else {
+            v1.beginPass2();
+        }
+        vector<std::thread> threads;
+        for(size_t threadId=0; threadId<threadCount; threadId++) {
+            threads.push_back(std::thread([&, threadId, pass]()
+            {
+                for(uint64_t i=threadId; i<valueCount; i+=threadCount) {
+                    if(pass == 1) {
+                        v1.incrementCountMultithreaded(getIndex(i));
+                    } else {
+                        v1.storeMultithreaded(getIndex(i), i);
+                    }
+                }
+            }));
+        }
+        for(std::thread& t: threads) {
+            t.join();
+        }
+    }
+    v1.endPass2();
+
+    // Compare.
+    SHASTA_ASSERT(v0.size() == n);
+    SHASTA_ASSERT(v1.size() == n);
+    SHASTA_ASSERT(v0.totalSize() == valueCount);
+    SHASTA_ASSERT(v1.totalSize() == valueCount);
+    for(uint64_t index=0; index<n; index++) {
+        SHASTA_ASSERT(v0.size(index) == v1.size(index));
+
+        // The builder stores the values of each vector in the order
+        // they were emitted, which here is increasing.
+        SHASTA_ASSERT(std::is_sorted(v0.begin(index), v0.end(index)));
+        std::sort(v1.begin(index), v1.end(index));
+        SHASTA_ASSERT(std::equal(v0.begin(index), v0.end(index), v1.begin(index)));
+    }
+    cout << "testVectorOfVectorsBuilder: " << valueCount << " values in " << n <<
+        " vectors, largest vector has " << v0.size(0) << " values. Success." << endl;
+
+    v0.remove();
+    v1.remove();
+}
@@ -5,7 +5,9 @@
 
 // Shasta.
 #include "SHASTA_ASSERT.hpp"
+#include "chrono.hpp"
 #include "filesystem.hpp"
+#include "MemoryMappedVectorPolicy.hpp"
 #include "MurmurHash2.hpp"
 #include "touchMemory.hpp"
 
@@ -36,6 +38,7 @@ namespace shasta {
         template<class T> class Vector;
     }
     void testMemoryMappedVector();
+    void testVectorOfVectorsBuilder();
 }
 
 
@@ -72,7 +75,14 @@ public:
     // The last argument specifies the required capacity.
     // Actual capacity will be a bit larger due to rounding up to the next page boundary.
     // The vector is stored in a memory mapped file with the specified name.
-    void createNew(const string& name, size_t pageSize, size_t n=0, size_t requiredCapacity=0);
+    // If the name is empty, the vector is anonymous and anonymousName,
+    // if not empty, is used to identify it in vectorStatistics.
+    void createNew(const string& name, size_t pageSize, size_t n=0, size_t requiredCapacity=0,
+        const string& anonymousName = "");
+    void createNew(const string& name, size_t pageSize, const string& anonymousName)
+    {
+        createNew(name, pageSize, 0, 0, anonymousName);
+    }
 
     // Open a previously created vector with read-only or read-write access.
     // If accessExistingReadWrite is called with allowReadOnly=true,
@@ -122,8 +132,8 @@ public:
 
     // Use this instead of resize when it is known that the size
     // will not further increase. This results in reduce
-    // memory requirement, because resize increases capacity to 1.5
-    // times the new size.
+    // memory requirement, because resize increases capacity
+    // as specified by vectorPolicy (by default to 1.5 times the new size).
     void reserveAndResize(size_t n)
     {
         reserve(n);
@@ -248,6 +258,16 @@ public:
     string fileName;
 
 private:
+
+    // For an anonymous vector, the name passed to createNew
+    // to identify it in vectorStatistics. Can be empty.
+    string anonymousName;
+
+    // Set if this is an anonymous vector that uses transparent huge pages.
+    // This is decided once by createNewAnonymous, so later changes
+    // of vectorPolicy don't affect existing mappings.
+    bool usesTransparentHugePages;
+
     // Unmap the memory.
     void unmap();
 
@@ -266,16 +286,22 @@ private:
     static void truncate(int fileDescriptor, size_t fileSize);
 
     // Map to memory the given file descriptor for the specified size.
-    static void* map(int fileDescriptor, size_t fileSize, bool writeAccess);
+    // A private mapping with write access is copy-on-write:
+    // changes are never written to the file.
+    static void* map(int fileDescriptor, size_t fileSize, bool writeAccess, bool isPrivate = false);
 
     // Find the size of the file corresponding to an open file descriptor.
     size_t getFileSize(int fileDescriptor);
 
 
-    void createNewAnonymous(size_t pageSize, size_t n=0, size_t requiredCapacity=0);
+    void createNewAnonymous(const string& anonymousName,
+        size_t pageSize, size_t n=0, size_t requiredCapacity=0);
     void resizeAnonymous(size_t newSize);
     void reserveAnonymous(size_t newSize);
     void unmapAnonymous();
+
+    // The name used to identify this vector in vectorStatistics.
+    string statisticsName() const;
 };
 
 
@@ -387,7 +413,8 @@ template<class T> inline shasta::MemoryMapped::Vector<T>::Vector() :
     header(0),
     data(0),
     isOpen(false),
-    isOpenWithWriteAccess(false)
+    isOpenWithWriteAccess(false),
+    usesTransparentHugePages(false)
 {
 }
 
@@ -441,9 +468,11 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::truncate(int file
 }
 
 // Map to memory the given file descriptor for the specified size.
-template<class T> inline void* shasta::MemoryMapped::Vector<T>::map(int fileDescriptor, size_t fileSize, bool writeAccess)
+template<class T> inline void* shasta::MemoryMapped::Vector<T>::map(
+    int fileDescriptor, size_t fileSize, bool writeAccess, bool isPrivate)
 {
-    void* pointer = ::mmap(0, fileSize, PROT_READ | (writeAccess ? PROT_WRITE : 0), MAP_SHARED, fileDescriptor, 0);
+    void* pointer = ::mmap(0, fileSize, PROT_READ | (writeAccess ? PROT_WRITE : 0),
+        isPrivate ? MAP_PRIVATE : MAP_SHARED, fileDescriptor, 0);
     if(pointer == reinterpret_cast<void*>(-1LL)) {
         ::close(fileDescriptor);
         if(errno == ENOMEM) {
@@ -481,15 +510,23 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNew(
     const string& name,
     size_t pageSize,
     size_t n,
-    size_t requiredCapacity)
+    size_t requiredCapacity,
+    const string& anonymousName)
 {
     SHASTA_ASSERT(pageSize==4096 || pageSize==2*1024*1024);
 
     if(name.empty()) {
-        createNewAnonymous(pageSize, n, requiredCapacity);
+        createNewAnonymous(anonymousName, pageSize, n, requiredCapacity);
         return;
     }
 
+    // Binary data published for sharing between processes
+    // (see class SharedAssemblyData) are never overwritten.
+    if(vectorPolicy.isSharedReadOnly(name)) {
+        throw runtime_error("Cannot create " + name +
+            " because it is in a shared read-only directory.");
+    }
+
     try {
         // If already open, should have called close first.
         SHASTA_ASSERT(!isOpen);
@@ -531,6 +568,8 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNew(
         isOpenWithWriteAccess = true;
         fileName = name;
 
+        prefault(statisticsName(), pointer, fileSize);
+
     } catch(std::exception& e) {
         cout << e.what() << endl;
         throw runtime_error("Error creating " + name);
@@ -541,6 +580,7 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNew(
 
 
 template<class T> inline void shasta::MemoryMapped::Vector<T>::createNewAnonymous(
+    const string& anonymousNameArgument,
     size_t pageSize,
     size_t n,
     size_t requiredCapacity)
@@ -555,11 +595,17 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNewAnonymou
         const size_t fileSize = headerOnStack.fileSize;
 
         // Map it in memory.
+        // If requested, anonymous vectors with 4K page size
+        // use transparent huge pages.
+        const bool useTransparentHugePages =
+            (pageSize == 4096) and vectorPolicy.transparentHugePages;
         int flags = MAP_PRIVATE | MAP_ANONYMOUS;
         if(pageSize == 2*1024*1024) {
             flags |= MAP_HUGETLB | MAP_HUGE_2MB;
         }
-        void* pointer = ::mmap(0, fileSize,
+        void* pointer = useTransparentHugePages ?
+            mapAnonymousTransparentHugePages(fileSize) :
+            ::mmap(0, fileSize,
             PROT_READ | PROT_WRITE, flags,
             -1, 0);
         if(pointer == reinterpret_cast<void*>(-1LL)) {
@@ -590,6 +636,13 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::createNewAnonymou
         isOpen = true;
         isOpenWithWriteAccess = true;
         fileName = "";
+        anonymousName = anonymousNameArgument;
+        usesTransparentHugePages = useTransparentHugePages;
+
+        if(useTransparentHugePages) {
+            vectorStatistics.registerMapping(statisticsName(), pointer, fileSize);
+        }
+        prefault(statisticsName(), pointer, fileSize);
 
     } catch(std::exception& e) {
         throw; // Nothing to contribute here.
@@ -604,14 +657,21 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::accessExisting(co
         // If already open, should have called close first.
         SHASTA_ASSERT(!isOpen);
 
+        // Vectors published for sharing between processes
+        // (see class SharedAssemblyData) are never opened for write.
+        // If write access was requested, use a private copy-on-write mapping,
+        // so pages that are modified are no longer shared,
+        // but the published data are not changed.
+        const bool isSharedReadOnly = vectorPolicy.isSharedReadOnly(name);
+
         // Create the file.
-        const int fileDescriptor = openExisting(name, readWriteAccess);
+        const int fileDescriptor = openExisting(name, readWriteAccess and not isSharedReadOnly);
 
         // Find the size of the file.
         const size_t fileSize = getFileSize(fileDescriptor);
 
         // Now map it in memory.
-        void* pointer = map(fileDescriptor, fileSize, readWriteAccess);
+        void* pointer = map(fileDescriptor, fileSize, readWriteAccess, isSharedReadOnly);
 
         // There is no need to keep the file descriptor open.
         // Closing the file descriptor as early as possible will make it possible to use large
@@ -647,7 +707,7 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::accessExisting(co
 
         // Indicate that the mapped vector is open.
         isOpen = true;
-        isOpenWithWriteAccess = readWriteAccess;
+        isOpenWithWriteAccess = readWriteAccess and not isSharedReadOnly;
         fileName = name;
 
     } catch(std::exception& e) {
@@ -697,6 +757,9 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::unmap()
 {
     SHASTA_ASSERT(isOpen);
 
+    // Make sure no background prefault touches the memory after it is unmapped.
+    prefaultQueue.cancel(header, header->fileSize);
+
     const int munmapReturnCode = ::munmap(header, header->fileSize);
     if(munmapReturnCode == -1) {
         throw runtime_error("Error unmapping " + fileName);
@@ -717,6 +780,13 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::unmapAnonymous()
 {
     SHASTA_ASSERT(isOpen);
 
+    if(usesTransparentHugePages) {
+        vectorStatistics.unregisterMapping(header, true);
+    }
+
+    // Make sure no background prefault touches the memory after it is unmapped.
+    prefaultQueue.cancel(header, header->fileSize);
+
     const int munmapReturnCode = ::munmap(header, header->fileSize);
     if(munmapReturnCode == -1) {
         throw runtime_error("Error " + boost::lexical_cast<string>(errno)
@@ -729,6 +799,8 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::unmapAnonymous()
     header = 0;
     data = 0;
     fileName = "";
+    anonymousName = "";
+    usesTransparentHugePages = false;
 
 }
 
@@ -747,6 +819,10 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::remove()
     if(fileName.empty()) {
         unmapAnonymous();
     } else {
+        if(vectorPolicy.isSharedReadOnly(fileName)) {
+            throw runtime_error("Cannot remove " + fileName +
+                " because it is in a shared read-only directory.");
+        }
         const string savedFileName = fileName;
         close();    // This forgets the fileName.
         filesystem::remove(savedFileName);
@@ -799,16 +875,20 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::resize(size_t new
             // The vector is growing beyond the current capacity.
             // We need to resize the mapped file.
             // Note that we don't have to copy the existing vector elements.
+            const auto t0 = steady_clock::now();
 
-            // Save the page size.
+            // Save the page size and file size.
             const size_t pageSize = header->pageSize;
+            const size_t oldFileSize = header->fileSize;
 
-            // Save the file name and close it.
+            // Save the file name and unmap it.
+            // There is no need to sync to disk here: the pages
+            // stay in the page cache and are visible to the new mapping.
             const string name = fileName;
-            close();
+            unmap();
 
             // Create a header corresponding to increased capacity.
-            const Header headerOnStack(newSize, size_t(1.5*double(newSize)), pageSize);
+            const Header headerOnStack(newSize, vectorPolicy.growthCapacity(newSize, sizeof(T)), pageSize);
 
 
             // Resize the file as necessary.
@@ -839,6 +919,12 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::resize(size_t new
             isOpenWithWriteAccess = true;
             fileName = name;
 
+            const auto t1 = steady_clock::now();
+            vectorStatistics.recordRemap(statisticsName(), headerOnStack.fileSize, seconds(t1 - t0));
+            prefault(statisticsName(),
+                reinterpret_cast<char*>(header) + oldFileSize,
+                headerOnStack.fileSize - oldFileSize);
+
             // Call the constructor on the elements we added.
             for(size_t i=oldSize; i<newSize; i++) {
                 new(data+i) T();
@@ -888,21 +974,30 @@ template<class T> inline void
             // The vector is growing beyond the current capacity.
             // We need to resize the mapped file.
             // Note that we don't have to copy the existing vector elements.
+            const auto t0 = steady_clock::now();
 
-            // Save the page size.
+            // Save the page size and file size.
             const size_t pageSize = header->pageSize;
+            const size_t oldFileSize = header->fileSize;
 
             // Create a header corresponding to increased capacity.
-            const Header headerOnStack(newSize, size_t(1.5*double(newSize)), pageSize);
+            const Header headerOnStack(newSize, vectorPolicy.growthCapacity(newSize, sizeof(T)), pageSize);
 
 
 
             // Remap it.
+            // Make sure no background prefault touches the old mapping first.
             // We can only use remap for Linux, and for 4K pages.
+            prefaultQueue.cancel(header, header->fileSize);
             bool useMremap = false;
             void* pointer = 0;
             useMremap = (pageSize == 4096);
-            if(useMremap) {
+            if(useMremap and usesTransparentHugePages) {
+                void* oldPointer = header;
+                pointer = remapAnonymousTransparentHugePages(header, header->fileSize, headerOnStack.fileSize);
+                vectorStatistics.unregisterMapping(oldPointer, false);
+                vectorStatistics.registerMapping(statisticsName(), pointer, headerOnStack.fileSize);
+            } else if(useMremap) {
                 pointer = ::mremap(header, header->fileSize, headerOnStack.fileSize, MREMAP_MAYMOVE);
                 if(pointer == reinterpret_cast<void*>(-1LL)) {
                     if(errno == ENOMEM) {
@@ -960,6 +1055,12 @@ template<class T> inline void
             isOpenWithWriteAccess = true;
             fileName = "";
 
+            const auto t1 = steady_clock::now();
+            vectorStatistics.recordRemap(statisticsName(), headerOnStack.fileSize, seconds(t1 - t0));
+            prefault(statisticsName(),
+                reinterpret_cast<char*>(header) + oldFileSize,
+                headerOnStack.fileSize - oldFileSize);
+
             // Call the constructor on the elements we added.
             for(size_t i=oldSize; i<newSize; i++) {
                 new(data+i) T();
@@ -990,11 +1091,15 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::reserve(size_t ca
         return;
     }
 
-    // Save what we need and close it.
+    // Save what we need and unmap it.
+    // There is no need to sync to disk here: the pages
+    // stay in the page cache and are visible to the new mapping.
+    const auto t0 = steady_clock::now();
     const size_t currentSize = size();
     const string name = fileName;
     const size_t pageSize = header->pageSize;
-    close();
+    const size_t oldFileSize = header->fileSize;
+    unmap();
 
     // Create a header corresponding to increased capacity.
     const Header headerOnStack(currentSize, capacity, pageSize);
@@ -1018,6 +1123,14 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::reserve(size_t ca
     isOpen = true;
     isOpenWithWriteAccess = true;
     fileName = name;
+
+    const auto t1 = steady_clock::now();
+    vectorStatistics.recordRemap(statisticsName(), headerOnStack.fileSize, seconds(t1 - t0));
+    if(headerOnStack.fileSize > oldFileSize) {
+        prefault(statisticsName(),
+            reinterpret_cast<char*>(header) + oldFileSize,
+            headerOnStack.fileSize - oldFileSize);
+    }
 }
 
 
@@ -1027,21 +1140,29 @@ template<class T> inline
     size_t capacity)
 {
 
-    // Save what we need and close it.
+    // Save what we need.
+    const auto t0 = steady_clock::now();
     const size_t currentSize = size();
-    const string name = fileName;
     const size_t pageSize = header->pageSize;
+    const size_t oldFileSize = header->fileSize;
 
     // Create a header corresponding to increased capacity.
     const Header headerOnStack(currentSize, capacity, pageSize);
 
 
     // Remap it.
+    // Make sure no background prefault touches the old mapping first.
     // We can only use remap for Linux, and for 4K pages.
+    prefaultQueue.cancel(header, header->fileSize);
     bool useMremap = false;
     useMremap = (pageSize == 4096);
     void* pointer = 0;
-    if(useMremap) {
+    if(useMremap and usesTransparentHugePages) {
+        void* oldPointer = header;
+        pointer = remapAnonymousTransparentHugePages(header, header->fileSize, headerOnStack.fileSize);
+        vectorStatistics.unregisterMapping(oldPointer, false);
+        vectorStatistics.registerMapping(statisticsName(), pointer, headerOnStack.fileSize);
+    } else if(useMremap) {
         pointer = ::mremap(header, header->fileSize, headerOnStack.fileSize, MREMAP_MAYMOVE);
         if(pointer == reinterpret_cast<void*>(-1LL)) {
             if(errno == ENOMEM) {
@@ -1097,6 +1218,14 @@ template<class T> inline
     isOpen = true;
     isOpenWithWriteAccess = true;
     fileName = "";
+
+    const auto t1 = steady_clock::now();
+    vectorStatistics.recordRemap(statisticsName(), headerOnStack.fileSize, seconds(t1 - t0));
+    if(headerOnStack.fileSize > oldFileSize) {
+        prefault(statisticsName(),
+            reinterpret_cast<char*>(header) + oldFileSize,
+            headerOnStack.fileSize - oldFileSize);
+    }
 }
 
 
@@ -1135,6 +1264,10 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::rename(const stri
     if(fileName.empty()) {
         SHASTA_ASSERT(newFileName.empty());
     } else {
+        if(vectorPolicy.isSharedReadOnly(fileName) or vectorPolicy.isSharedReadOnly(newFileName)) {
+            throw runtime_error("Cannot rename " + fileName + " to " + newFileName +
+                " because one of them is in a shared read-only directory.");
+        }
         const string oldFileName = fileName;
         const bool writeAccess = isOpenWithWriteAccess;
         close();
@@ -1144,4 +1277,26 @@ template<class T> inline void shasta::MemoryMapped::Vector<T>::rename(const stri
 }
 
 
+// The name used to identify this vector in vectorStatistics.
+// This is the name of the supporting file, without the directory.
+// Anonymous vectors use the name passed to createNew, if any,
+// and are otherwise identified by their object size.
+template<class T> inline shasta::string shasta::MemoryMapped::Vector<T>::statisticsName() const
+{
+    if(fileName.empty()) {
+        if(not anonymousName.empty()) {
+            return "Anonymous-" + anonymousName;
+        }
+        return "Anonymous-" + to_string(sizeof(T)) + "-byte-objects";
+    }
+    const size_t slashPosition = fileName.find_last_of('/');
+    if(slashPosition == string::npos) {
+        return fileName;
+    } else {
+        return fileName.substr(slashPosition + 1);
+    }
+}
+
+
+
 #endif
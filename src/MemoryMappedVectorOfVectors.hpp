@@ -17,6 +17,7 @@
 namespace shasta {
     namespace MemoryMapped {
         template<class T, class Int> class VectorOfVectors;
+        template<class T, class Int> class VectorOfVectorsBuilder;
     }
 }
 
@@ -25,14 +26,21 @@ namespace shasta {
 template<class T, class Int> class shasta::MemoryMapped::VectorOfVectors {
 public:
 
-    void createNew(const string& nameArgument, size_t pageSizeArgument)
+    // If the name is empty, the VectorOfVectors is anonymous
+    // and anonymousName, if not empty, is used to identify it
+    // in vectorStatistics.
+    void createNew(
+        const string& nameArgument,
+        size_t pageSizeArgument,
+        const string& anonymousNameArgument = "")
     {
         name = nameArgument;
+        anonymousName = anonymousNameArgument;
         pageSize = pageSizeArgument;
 
         if(nameArgument.empty()) {
-            toc.createNew("", pageSize);
-            data.createNew("", pageSize);
+            toc.createNew("", pageSize, anonymousSuffixedName(".toc"));
+            data.createNew("", pageSize, anonymousSuffixedName(".data"));
         } else {
             toc.createNew(name + ".toc", pageSize);
             data.createNew(name + ".data", pageSize);
@@ -46,6 +54,7 @@ public:
     void accessExisting(const string& nameArgument, bool readWriteAccess)
     {
         name = nameArgument;
+        anonymousName = "";
         pageSize = 0;   // We cannot use count.
         toc.accessExisting(name + ".toc", readWriteAccess);
         data.accessExisting(name + ".data", readWriteAccess);
@@ -129,6 +138,14 @@ public:
     }
 
 
+    // Direct access to the table of contents, which has size()+1 entries.
+    // Entry i is the index in the data of the first element of the i-th vector.
+    const Int* tocBegin() const
+    {
+        return toc.begin();
+    }
+
+
     // Return size/begin/end of the i-th vector.
     size_t size(size_t i) const
     {
@@ -246,6 +263,8 @@ public:
     // In pass 2 we store the entries.
     // This can be easily turned into multithreaded code
     // if atomic memory access primitives are used.
+    // For large multithreaded constructions, VectorOfVectorsBuilder
+    // avoids the atomic operations.
     void beginPass1(Int n);
     void incrementCount(Int index, Int m=1);  // Called during pass 1.
     void incrementCountMultithreaded(Int index, Int m=1);  // Called during pass 1.
@@ -304,9 +323,18 @@ public:
 private:
     Vector<Int> toc;
     Vector<Int> count;
+    friend class VectorOfVectorsBuilder<T, Int>;
     Vector<T> data;
     string name;
+    string anonymousName;
     size_t pageSize;
+
+    // The name used in vectorStatistics for one of the
+    // anonymous vectors that implement an anonymous VectorOfVectors.
+    string anonymousSuffixedName(const string& suffix) const
+    {
+        return anonymousName.empty() ? "" : (anonymousName + suffix);
+    }
 };
 
 
@@ -317,7 +345,7 @@ template<class T, class Int>
 
     if(!count.isOpen) {
         if(name.empty()) {
-            count.createNew("", pageSize);
+            count.createNew("", pageSize, anonymousSuffixedName(".count"));
         } else {
             count.createNew(name + ".count", pageSize);
         }
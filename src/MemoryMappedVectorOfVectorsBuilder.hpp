@@ -0,0 +1,323 @@
+#ifndef SHASTA_MEMORY_MAPPED_VECTOR_OF_VECTORS_BUILDER_HPP
+#define SHASTA_MEMORY_MAPPED_VECTOR_OF_VECTORS_BUILDER_HPP
+
+/*******************************************************************************
+
+Class VectorOfVectorsBuilder constructs a MemoryMapped::VectorOfVectors
+in parallel without using atomic operations.
+
+The two pass construction in VectorOfVectors (beginPass1, incrementCountMultithreaded,
+beginPass2, storeMultithreaded, endPass2) uses one atomic operation
+for each element on a shared count vector. This serializes
+on vectors that receive many elements (high frequency k-mers,
+large LowHash buckets, high coverage marker graph vertices)
+and moves cache lines between cores.
+
+Instead, VectorOfVectorsBuilder works as follows:
+
+- Each thread emits (index, value) pairs into its own stream.
+  Streams are memory mapped vectors and each stream must only be used
+  by one thread at a time. No synchronization is needed.
+
+- The index range [0, n) is divided into blocks of consecutive indexes.
+  Each stream counts its pairs in each block.
+  This uses a small histogram (one entry per block) for each stream.
+
+- A prefix sum over (block, stream) assigns to each stream
+  a private range in a temporary buffer for each block.
+  Each stream then copies its pairs to the temporary buffer,
+  which ends up grouped by block. Each stream is freed
+  as soon as it has been copied.
+
+- Blocks are processed in parallel. For each block, a local histogram
+  over the indexes of the block is used to fill the corresponding
+  portion of the toc and to store the values. The data for each block
+  begins at the same position in the temporary buffer and in the final data,
+  so blocks are independent.
+
+Memory usage is proportional to the number of elements,
+and not to the number of indexes times the number of threads.
+However, each element is stored as an (index, value) pair in a stream,
+then in the temporary buffer, so temporary memory is about
+2 * sizeof(pair<Int, T>) bytes per element at the peak, in addition
+to the final VectorOfVectors. For vectors with low contention
+(for example marker graph edgesBySource and edgesByTarget)
+the two pass construction, which needs no temporary memory, is preferable.
+Values for each index are stored in order of increasing stream id
+and, for each stream, in the order in which they were emitted.
+So the result is deterministic if the streams are.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "memory.hpp"
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    namespace MemoryMapped {
+        template<class T, class Int> class VectorOfVectorsBuilder;
+    }
+}
+
+
+
+template<class T, class Int> class shasta::MemoryMapped::VectorOfVectorsBuilder :
+    public MultithreadedObject< VectorOfVectorsBuilder<T, Int> > {
+public:
+
+    // The name is used to create names for the streams and
+    // temporary buffer. If empty, anonymous memory is used.
+    VectorOfVectorsBuilder(
+        size_t streamCount,
+        const string& name,
+        size_t pageSize) :
+        MultithreadedObject< VectorOfVectorsBuilder<T, Int> >(*this),
+        name(name),
+        pageSize(pageSize)
+    {
+        streams.resize(streamCount);
+        for(size_t streamId=0; streamId<streamCount; streamId++) {
+            streams[streamId] = std::make_shared< Vector< pair<Int, T> > >();
+            createStream(streamId);
+        }
+    }
+
+    ~VectorOfVectorsBuilder()
+    {
+        for(const auto& stream: streams) {
+            if(stream->isOpen) {
+                stream->remove();
+            }
+        }
+    }
+
+    size_t streamCount() const
+    {
+        return streams.size();
+    }
+
+    // Add a value to the vector with the given index.
+    // Each stream must only be used by one thread at a time.
+    void emit(size_t streamId, Int index, const T& t)
+    {
+        streams[streamId]->push_back(make_pair(index, t));
+    }
+
+    // Total number of values emitted so far.
+    uint64_t totalSize() const
+    {
+        uint64_t n = 0;
+        for(const auto& stream: streams) {
+            n += stream->size();
+        }
+        return n;
+    }
+
+    // Store all the values emitted so far in a VectorOfVectors
+    // with n vectors. The VectorOfVectors must be open with write access.
+    // Its previous content is discarded. All streams are emptied
+    // and can be reused to build another VectorOfVectors.
+    void build(Int n, VectorOfVectors<T, Int>&, size_t threadCount);
+
+    VectorOfVectorsBuilder(const VectorOfVectorsBuilder&) = delete;
+    VectorOfVectorsBuilder& operator=(const VectorOfVectorsBuilder&) = delete;
+
+private:
+    string name;
+    size_t pageSize;
+    vector< std::shared_ptr< Vector< pair<Int, T> > > > streams;
+    void createStream(size_t streamId)
+    {
+        streams[streamId]->createNew(
+            name.empty() ? "" : (name + "-Stream-" + to_string(streamId)), pageSize);
+    }
+
+    // Data used by build.
+    class BuildData {
+    public:
+        VectorOfVectors<T, Int>* v = 0;
+        Int n = 0;
+        uint64_t blockSize = 0;
+        uint64_t blockCount = 0;
+
+        // The number of pairs in each block for each stream.
+        // Indexed by [streamId][blockId].
+        // After the prefix sum, this contains the position in the buffer
+        // where each stream stores its pairs for each block.
+        vector< vector<uint64_t> > streamBlockCounts;
+
+        // The position in the buffer (and in the final data) where each block begins.
+        // Has blockCount+1 entries.
+        vector<uint64_t> blockBegin;
+
+        // The pairs grouped by block.
+        Vector< pair<Int, T> > buffer;
+    };
+    BuildData buildData;
+    void buildThreadFunction1(size_t threadId);
+    void buildThreadFunction2(size_t threadId);
+    void buildThreadFunction3(size_t threadId);
+};
+
+
+
+template<class T, class Int>
+    void shasta::MemoryMapped::VectorOfVectorsBuilder<T, Int>::build(
+    Int n,
+    VectorOfVectors<T, Int>& v,
+    size_t threadCount)
+{
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    BuildData& data = buildData;
+    data.v = &v;
+    data.n = n;
+
+    // Use enough blocks to balance the load, but keep
+    // the per-stream histograms small.
+    const uint64_t maxBlockCount = 64 * uint64_t(threadCount);
+    data.blockSize = std::max(uint64_t(1), (uint64_t(n) + maxBlockCount - 1) / maxBlockCount);
+    data.blockCount = (uint64_t(n) + data.blockSize - 1) / data.blockSize;
+
+    // Count the pairs in each block for each stream.
+    data.streamBlockCounts.resize(streams.size());
+    this->setupLoadBalancing(streams.size(), 1);
+    this->runThreads(&VectorOfVectorsBuilder::buildThreadFunction1, threadCount);
+
+    // Prefix sum over (block, stream).
+    data.blockBegin.resize(data.blockCount + 1);
+    uint64_t position = 0;
+    for(uint64_t blockId=0; blockId<data.blockCount; blockId++) {
+        data.blockBegin[blockId] = position;
+        for(size_t streamId=0; streamId<streams.size(); streamId++) {
+            uint64_t& count = data.streamBlockCounts[streamId][blockId];
+            const uint64_t streamBlockSize = count;
+            count = position;
+            position += streamBlockSize;
+        }
+    }
+    data.blockBegin[data.blockCount] = position;
+    const uint64_t totalSize = position;
+
+    // Copy the pairs to the buffer, grouped by block.
+    // Each stream is removed as soon as it has been copied.
+    data.buffer.createNew(name.empty() ? "" : (name + "-Buffer"), pageSize);
+    data.buffer.resize(totalSize);
+    this->setupLoadBalancing(streams.size(), 1);
+    this->runThreads(&VectorOfVectorsBuilder::buildThreadFunction2, threadCount);
+
+    // Fill the toc and data one block at a time.
+    v.toc.reserveAndResize(uint64_t(n) + 1);
+    v.data.reserveAndResize(totalSize);
+    v.toc[n] = Int(totalSize);
+    this->setupLoadBalancing(data.blockCount, 1);
+    this->runThreads(&VectorOfVectorsBuilder::buildThreadFunction3, threadCount);
+
+    // Clean up, and recreate the streams so they can be reused.
+    data.buffer.remove();
+    for(size_t streamId=0; streamId<streams.size(); streamId++) {
+        createStream(streamId);
+    }
+    data.streamBlockCounts.clear();
+    data.blockBegin.clear();
+    data.v = 0;
+}
+
+
+
+// Count the pairs in each block for each stream.
+template<class T, class Int>
+    void shasta::MemoryMapped::VectorOfVectorsBuilder<T, Int>::buildThreadFunction1(size_t)
+{
+    BuildData& data = buildData;
+
+    uint64_t begin, end;
+    while(this->getNextBatch(begin, end)) {
+        for(uint64_t streamId=begin; streamId!=end; streamId++) {
+            vector<uint64_t>& counts = data.streamBlockCounts[streamId];
+            counts.assign(data.blockCount, 0);
+            for(const pair<Int, T>& p: *streams[streamId]) {
+                SHASTA_ASSERT(p.first < data.n);
+                ++counts[uint64_t(p.first) / data.blockSize];
+            }
+        }
+    }
+}
+
+
+
+// Copy the pairs to the buffer, grouped by block.
+template<class T, class Int>
+    void shasta::MemoryMapped::VectorOfVectorsBuilder<T, Int>::buildThreadFunction2(size_t)
+{
+    BuildData& data = buildData;
+    pair<Int, T>* buffer = data.buffer.begin();
+
+    uint64_t begin, end;
+    while(this->getNextBatch(begin, end)) {
+        for(uint64_t streamId=begin; streamId!=end; streamId++) {
+            vector<uint64_t>& positions = data.streamBlockCounts[streamId];
+            for(const pair<Int, T>& p: *streams[streamId]) {
+                buffer[positions[uint64_t(p.first) / data.blockSize]++] = p;
+            }
+            streams[streamId]->remove();
+        }
+    }
+}
+
+
+
+// Fill the toc and data for each block.
+template<class T, class Int>
+    void shasta::MemoryMapped::VectorOfVectorsBuilder<T, Int>::buildThreadFunction3(size_t)
+{
+    BuildData& data = buildData;
+    VectorOfVectors<T, Int>& v = *data.v;
+    const pair<Int, T>* buffer = data.buffer.begin();
+
+    // Local histogram over the indexes of a block.
+    vector<uint64_t> positions;
+
+    uint64_t begin, end;
+    while(this->getNextBatch(begin, end)) {
+        for(uint64_t blockId=begin; blockId!=end; blockId++) {
+            const uint64_t indexBegin = blockId * data.blockSize;
+            const uint64_t indexEnd = std::min(indexBegin + data.blockSize, uint64_t(data.n));
+            const uint64_t bufferBegin = data.blockBegin[blockId];
+            const uint64_t bufferEnd = data.blockBegin[blockId + 1];
+
+            // Count the values for each index in this block.
+            positions.assign(indexEnd - indexBegin, 0);
+            for(uint64_t i=bufferBegin; i!=bufferEnd; i++) {
+                ++positions[uint64_t(buffer[i].first) - indexBegin];
+            }
+
+            // Fill the toc for this block.
+            // The positions become the storage positions for each index.
+            uint64_t position = bufferBegin;
+            for(uint64_t index=indexBegin; index!=indexEnd; index++) {
+                v.toc[index] = Int(position);
+                uint64_t& count = positions[index - indexBegin];
+                const uint64_t indexSize = count;
+                count = position;
+                position += indexSize;
+            }
+            SHASTA_ASSERT(position == bufferEnd);
+
+            // Store the values.
+            for(uint64_t i=bufferBegin; i!=bufferEnd; i++) {
+                const pair<Int, T>& p = buffer[i];
+                v.data[positions[uint64_t(p.first) - indexBegin]++] = p.second;
+            }
+        }
+    }
+}
+
+#endif
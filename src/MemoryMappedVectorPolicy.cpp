@@ -0,0 +1,530 @@
+// Shasta.
+#include "MemoryMappedVectorPolicy.hpp"
+#include "chrono.hpp"
+#include "filesystem.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+using namespace MemoryMapped;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <filesystem>
+#include "fstream.hpp"
+#include "stdexcept.hpp"
+#include <string.h>
+#include "utility.hpp"
+
+// Linux.
+#include <errno.h>
+#include <linux/mman.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+// Process-wide policy, statistics, and prefault queue.
+// The prefault queue is defined last, so it is destroyed first
+// and its worker thread no longer uses vectorStatistics.
+VectorPolicy shasta::MemoryMapped::vectorPolicy;
+VectorStatistics shasta::MemoryMapped::vectorStatistics;
+PrefaultQueue shasta::MemoryMapped::prefaultQueue;
+
+
+
+uint64_t VectorPolicy::growthCapacity(uint64_t newSize, uint64_t objectSize) const
+{
+    SHASTA_ASSERT(objectSize > 0);
+    uint64_t capacity = uint64_t(growthFactor * double(newSize));
+    capacity = max(capacity, newSize + minimumGrowth / objectSize);
+    if(maximumGrowth > 0) {
+        capacity = min(capacity, newSize + max(uint64_t(1), maximumGrowth / objectSize));
+    }
+    return max(capacity, newSize);
+}
+
+
+
+void VectorPolicy::setPrefaultMode(const string& s)
+{
+    if(s == "none") {
+        prefaultMode = PrefaultMode::none;
+    } else if(s == "willneed") {
+        prefaultMode = PrefaultMode::willNeed;
+    } else if(s == "populate") {
+        prefaultMode = PrefaultMode::populateWrite;
+    } else {
+        throw runtime_error("Invalid memory prefault mode " + s +
+            ". Allowed values are none, willneed, populate.");
+    }
+}
+
+
+
+// Return true if the named file is in one of the sharedReadOnlyDirectories.
+bool VectorPolicy::isSharedReadOnly(const string& name) const
+{
+    if(sharedReadOnlyDirectories.empty() or name.empty()) {
+        return false;
+    }
+
+    const size_t slashPosition = name.find_last_of('/');
+    string directoryName;
+    if(slashPosition == string::npos) {
+        directoryName = ".";
+    } else if(slashPosition == 0) {
+        directoryName = "/";
+    } else {
+        directoryName = name.substr(0, slashPosition);
+    }
+    const string absoluteDirectoryName = filesystem::getAbsolutePath(directoryName);
+    return find(sharedReadOnlyDirectories.begin(), sharedReadOnlyDirectories.end(),
+        absoluteDirectoryName) != sharedReadOnlyDirectories.end();
+}
+
+
+
+string VectorPolicy::sharedDataName(const string& name) const
+{
+    if(isSharedReadOnly(name) and not std::filesystem::exists(name)) {
+        return "";
+    } else {
+        return name;
+    }
+}
+
+
+
+// Prefault a range now, in the calling thread.
+// A failure is not an error: the pages will just
+// be faulted in on first use.
+static void prefaultNow(const string& name, void* begin, uint64_t length, int advice)
+{
+    struct rusage usage0;
+    struct rusage usage1;
+    ::getrusage(RUSAGE_THREAD, &usage0);
+    const auto t0 = steady_clock::now();
+    ::madvise(begin, length, advice);
+    const auto t1 = steady_clock::now();
+    ::getrusage(RUSAGE_THREAD, &usage1);
+    const uint64_t pageFaults =
+        uint64_t(usage1.ru_minflt - usage0.ru_minflt) +
+        uint64_t(usage1.ru_majflt - usage0.ru_majflt);
+    vectorStatistics.recordPrefault(name, length, pageFaults, seconds(t1 - t0));
+}
+
+
+
+void shasta::MemoryMapped::prefault(const string& name, void* begin, uint64_t length)
+{
+    const VectorPolicy& policy = vectorPolicy;
+    if(policy.prefaultMode == VectorPolicy::PrefaultMode::none or
+        length == 0 or
+        length < policy.prefaultThreshold) {
+        return;
+    }
+
+    // MADV_POPULATE_WRITE requires Linux 5.14.
+    // If not available, fall back to MADV_WILLNEED.
+    int advice = MADV_WILLNEED;
+#ifdef MADV_POPULATE_WRITE
+    if(policy.prefaultMode == VectorPolicy::PrefaultMode::populateWrite) {
+        advice = MADV_POPULATE_WRITE;
+    }
+#endif
+
+    if(policy.prefaultInBackground) {
+        prefaultQueue.push(name, begin, length, advice);
+    } else {
+        prefaultNow(name, begin, length, advice);
+    }
+}
+
+
+
+bool PrefaultQueue::Request::overlaps(const void* rangeBegin, uint64_t rangeLength) const
+{
+    const char* begin0 = static_cast<const char*>(begin);
+    const char* begin1 = static_cast<const char*>(rangeBegin);
+    return begin0 < begin1 + rangeLength and begin1 < begin0 + length;
+}
+
+
+
+bool PrefaultQueue::push(const string& name, void* begin, uint64_t length, int advice)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(isStopping or requests.size() >= maximumQueueSize) {
+            return false;
+        }
+        Request request;
+        request.name = name;
+        request.begin = begin;
+        request.length = length;
+        request.advice = advice;
+        requests.push_back(request);
+        if(not worker.joinable()) {
+            worker = std::thread(&PrefaultQueue::workerFunction, this);
+        }
+    }
+    condition.notify_all();
+    return true;
+}
+
+
+
+void PrefaultQueue::cancel(const void* begin, uint64_t length)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    requests.erase(
+        std::remove_if(requests.begin(), requests.end(),
+            [begin, length](const Request& request)
+            {
+                return request.overlaps(begin, length);
+            }),
+        requests.end());
+    condition.wait(lock, [this, begin, length]()
+        {
+            return not (isBusy and currentRequest.overlaps(begin, length));
+        });
+}
+
+
+
+void PrefaultQueue::waitForAll()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]()
+        {
+            return requests.empty() and not isBusy;
+        });
+}
+
+
+
+void PrefaultQueue::workerFunction()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        condition.wait(lock, [this]()
+            {
+                return isStopping or not requests.empty();
+            });
+        if(isStopping) {
+            return;
+        }
+
+        // Take the first request and process it without holding the mutex.
+        // While isBusy is set, cancel will not let its range be unmapped.
+        currentRequest = requests.front();
+        requests.pop_front();
+        isBusy = true;
+        lock.unlock();
+        prefaultNow(currentRequest.name, currentRequest.begin,
+            currentRequest.length, currentRequest.advice);
+        lock.lock();
+        isBusy = false;
+        condition.notify_all();
+    }
+}
+
+
+
+PrefaultQueue::~PrefaultQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.clear();
+        isStopping = true;
+    }
+    condition.notify_all();
+    if(worker.joinable()) {
+        worker.join();
+    }
+}
+
+
+
+// Throw an exception after a failed mmap or mremap call.
+static void throwMapError(const string& call)
+{
+    if(errno == ENOMEM) {
+        throw runtime_error("Memory allocation failure "
+            "during " + call + " call for MemoryMapped::Vector.\n"
+            "This assembly requires more memory than available.\n"
+            "Rerun on a larger machine.");
+    } else {
+        throw runtime_error("Error " + to_string(errno)
+            + " during " + call + " call for MemoryMapped::Vector: " + string(::strerror(errno)));
+    }
+}
+
+
+
+// Create an anonymous mapping aligned to 2 MB
+// and advised to use transparent huge pages.
+// The size must be a multiple of 4 KB.
+void* shasta::MemoryMapped::mapAnonymousTransparentHugePages(uint64_t size)
+{
+    const uint64_t hugePageSize = 2ULL * 1024ULL * 1024ULL;
+
+    // Map an additional 2 MB, then unmap the
+    // portions before and after the aligned range.
+    void* pointer = ::mmap(0, size + hugePageSize,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0);
+    if(pointer == reinterpret_cast<void*>(-1LL)) {
+        throwMapError("mmap");
+    }
+    char* begin = static_cast<char*>(pointer);
+    char* alignedBegin = reinterpret_cast<char*>(
+        ((reinterpret_cast<uint64_t>(begin) + hugePageSize - 1ULL) / hugePageSize) * hugePageSize);
+    const uint64_t headSize = uint64_t(alignedBegin - begin);
+    const uint64_t tailSize = hugePageSize - headSize;
+    if(headSize > 0) {
+        ::munmap(begin, headSize);
+    }
+    if(tailSize > 0) {
+        ::munmap(alignedBegin + size, tailSize);
+    }
+
+    // A failure is not an error: the memory will just use 4 KB pages.
+    ::madvise(alignedBegin, size, MADV_HUGEPAGE);
+
+    return alignedBegin;
+}
+
+
+
+// Change the size of a mapping created by mapAnonymousTransparentHugePages.
+// If the mapping cannot grow in place, it is moved
+// to a new address, also aligned to 2 MB.
+// This way the huge pages it already uses are preserved.
+void* shasta::MemoryMapped::remapAnonymousTransparentHugePages(
+    void* pointer,
+    uint64_t oldSize,
+    uint64_t newSize)
+{
+    void* newPointer = ::mremap(pointer, oldSize, newSize, 0);
+    if(newPointer == reinterpret_cast<void*>(-1LL)) {
+
+        // Create a new aligned mapping, then move the old mapping on top of it.
+        void* target = mapAnonymousTransparentHugePages(newSize);
+        newPointer = ::mremap(pointer, oldSize, newSize, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+        if(newPointer == reinterpret_cast<void*>(-1LL)) {
+            const int savedErrno = errno;
+            ::munmap(target, newSize);
+            errno = savedErrno;
+            throwMapError("mremap");
+        }
+    }
+
+    ::madvise(newPointer, newSize, MADV_HUGEPAGE);
+    return newPointer;
+}
+
+
+
+void VectorStatistics::recordRemap(const string& name, uint64_t bytes, double seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Counters& c = counters[name];
+    ++c.remapCount;
+    c.remapBytes += bytes;
+    c.remapSeconds += seconds;
+}
+
+
+
+void VectorStatistics::recordPrefault(
+    const string& name,
+    uint64_t bytes,
+    uint64_t pageFaults,
+    double seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Counters& c = counters[name];
+    ++c.prefaultCount;
+    c.prefaultBytes += bytes;
+    c.prefaultPageFaults += pageFaults;
+    c.prefaultSeconds += seconds;
+}
+
+
+
+void VectorStatistics::write(ostream& s)
+{
+    prefaultQueue.waitForAll();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    vector< pair<string, Counters> > sortedCounters(counters.begin(), counters.end());
+    sort(sortedCounters.begin(), sortedCounters.end(),
+        [](const pair<string, Counters>& x, const pair<string, Counters>& y)
+        {
+            return
+                x.second.remapSeconds + x.second.prefaultSeconds >
+                y.second.remapSeconds + y.second.prefaultSeconds;
+        });
+
+    s << "MemoryMapped::Vector remap and prefault statistics:\n";
+    s << "Name,Remaps,Remapped bytes,Remap seconds,"
+        "Prefaults,Prefaulted bytes,Prefault page faults,Prefault seconds\n";
+    for(const auto& p: sortedCounters) {
+        const Counters& c = p.second;
+        s <<
+            p.first << "," <<
+            c.remapCount << "," <<
+            c.remapBytes << "," <<
+            c.remapSeconds << "," <<
+            c.prefaultCount << "," <<
+            c.prefaultBytes << "," <<
+            c.prefaultPageFaults << "," <<
+            c.prefaultSeconds << "\n";
+    }
+    s << std::flush;
+}
+
+
+
+void VectorStatistics::registerMapping(
+    const string& name,
+    const void* begin,
+    uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Mapping& mapping = mappings[begin];
+    mapping.name = name;
+    mapping.size = size;
+}
+
+
+
+void VectorStatistics::unregisterMapping(const void* begin, bool measureCoverage)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = mappings.find(begin);
+    if(it == mappings.end()) {
+        return;
+    }
+
+    const Mapping& mapping = it->second;
+    if(measureCoverage and mapping.size >= vectorPolicy.hugePageReportThreshold) {
+        vector< pair<const void*, HugePageCoverage> > ranges(1);
+        ranges.front().first = begin;
+        ranges.front().second.name = mapping.name;
+        ranges.front().second.size = mapping.size;
+        measureHugePageCoverage(ranges);
+        freedCoverage.push_back(ranges.front().second);
+    }
+    mappings.erase(it);
+}
+
+
+
+void VectorStatistics::writeTransparentHugePageCoverage(ostream& s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    vector< pair<const void*, HugePageCoverage> > ranges;
+    for(const auto& p: mappings) {
+        const Mapping& mapping = p.second;
+        if(mapping.size >= vectorPolicy.hugePageReportThreshold) {
+            HugePageCoverage coverage;
+            coverage.name = mapping.name;
+            coverage.size = mapping.size;
+            coverage.isMapped = true;
+            ranges.push_back(make_pair(p.first, coverage));
+        }
+    }
+    measureHugePageCoverage(ranges);
+
+    s << "Transparent huge page coverage for large MemoryMapped::Vector objects:\n";
+    s << "Name,Bytes,Resident bytes,Huge page bytes,Huge page coverage,Status\n";
+    for(const HugePageCoverage& coverage: freedCoverage) {
+        writeHugePageCoverage(s, coverage);
+    }
+    for(const auto& p: ranges) {
+        writeHugePageCoverage(s, p.second);
+    }
+    s << std::flush;
+}
+
+
+
+void VectorStatistics::writeHugePageCoverage(ostream& s, const HugePageCoverage& coverage)
+{
+    s <<
+        coverage.name << "," <<
+        coverage.size << "," <<
+        coverage.residentBytes << "," <<
+        coverage.hugePageBytes << ",";
+    if(coverage.residentBytes > 0) {
+        s << double(coverage.hugePageBytes) / double(coverage.residentBytes);
+    }
+    s << "," << (coverage.isMapped ? "Mapped" : "Freed") << "\n";
+}
+
+
+
+// Use /proc/self/smaps to fill in residentBytes and hugePageBytes
+// for a set of address ranges. Each range is normally a single
+// entry in /proc/self/smaps, but the kernel can split it, so we add up
+// the entries that begin inside each range.
+void VectorStatistics::measureHugePageCoverage(
+    vector< pair<const void*, HugePageCoverage> >& ranges)
+{
+    if(ranges.empty()) {
+        return;
+    }
+    sort(ranges.begin(), ranges.end(),
+        [](const pair<const void*, HugePageCoverage>& x, const pair<const void*, HugePageCoverage>& y)
+        {
+            return x.first < y.first;
+        });
+
+    ifstream smaps("/proc/self/smaps");
+    if(not smaps) {
+        return;
+    }
+
+    HugePageCoverage* current = 0;
+    string line;
+    while(getline(smaps, line)) {
+        const size_t spacePosition = line.find(' ');
+        if(spacePosition == string::npos or spacePosition == 0) {
+            continue;
+        }
+
+        if(line[spacePosition - 1] == ':') {
+
+            // This is a field line such as "Rss:  1024 kB".
+            if(current == 0) {
+                continue;
+            }
+            const uint64_t kiloBytes = std::strtoull(line.c_str() + spacePosition, 0, 10);
+            if(line.compare(0, spacePosition, "Rss:") == 0) {
+                current->residentBytes += 1024ULL * kiloBytes;
+            } else if(line.compare(0, spacePosition, "AnonHugePages:") == 0) {
+                current->hugePageBytes += 1024ULL * kiloBytes;
+            }
+
+        } else {
+
+            // This is the first line for a new mapping.
+            // Find the range that contains its beginning address, if any.
+            const uint64_t begin = std::strtoull(line.c_str(), 0, 16);
+            current = 0;
+            auto it = std::upper_bound(ranges.begin(), ranges.end(), begin,
+                [](uint64_t address, const pair<const void*, HugePageCoverage>& range)
+                {
+                    return address < reinterpret_cast<uint64_t>(range.first);
+                });
+            if(it != ranges.begin()) {
+                --it;
+                const uint64_t rangeBegin = reinterpret_cast<uint64_t>(it->first);
+                if(begin < rangeBegin + it->second.size) {
+                    current = &it->second;
+                }
+            }
+        }
+    }
+}
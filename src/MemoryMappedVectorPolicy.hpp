@@ -0,0 +1,251 @@
+#ifndef SHASTA_MEMORY_MAPPED_VECTOR_POLICY_HPP
+#define SHASTA_MEMORY_MAPPED_VECTOR_POLICY_HPP
+
+/*******************************************************************************
+
+Process-wide policies and statistics for MemoryMapped::Vector.
+
+Class VectorPolicy controls:
+
+- How much capacity resize allocates when a vector grows beyond its
+  current capacity (push_back calls resize). The new capacity
+  is growthFactor times the new size, but never grows the vector
+  by less than minimumGrowth bytes or (if not zero) by more than
+  maximumGrowth bytes.
+
+- Prefaulting of newly allocated memory. When createNew, resize,
+  or reserve map at least prefaultThreshold new bytes,
+  the new range can be prefaulted using madvise with MADV_WILLNEED
+  (read-ahead, useful for disk backed files) or MADV_POPULATE_WRITE
+  (allocate all pages at once instead of taking one page fault at a time).
+  If prefaultInBackground is true, this is done by a single worker thread
+  (class PrefaultQueue) so the caller can start using the memory immediately.
+  At most PrefaultQueue::maximumQueueSize requests wait for the worker
+  thread. If the queue is full, a request is dropped, and its pages
+  are faulted in on first use. Before a vector unmaps or remaps its memory,
+  it cancels queued prefaults of that memory and waits
+  for a prefault of that memory that is in progress.
+
+- Use of transparent huge pages for anonymous vectors with 4K page size.
+  If transparentHugePages is true, these vectors are mapped at addresses
+  aligned to 2 MB and madvise(MADV_HUGEPAGE) is used to ask the kernel
+  to back them with 2 MB pages. Unlike MAP_HUGETLB (used for anonymous vectors
+  with 2 MB page size), this does not require huge pages to be reserved
+  in advance, and therefore it does not require root privilege.
+  It only requires /sys/kernel/mm/transparent_hugepage/enabled
+  to be set to always or madvise, which is the default on most systems.
+  The decision is made when a vector is created, so changing
+  transparentHugePages does not affect vectors that already exist.
+  When these vectors grow they are moved (using mremap) to a new address
+  that is also 2 MB aligned, so the huge pages already
+  allocated are preserved. Huge page coverage (the fraction of resident memory
+  backed by 2 MB pages) is not guaranteed, so it is measured from
+  /proc/self/smaps and reported for vectors of at least
+  hugePageReportThreshold bytes, both when they are freed and
+  at the end of an assembly.
+
+- Read-only access to binary data published for sharing between processes
+  (see class SharedAssemblyData). Vectors in one of the
+  sharedReadOnlyDirectories are always opened read-only. If read-write access
+  is requested, they get a private copy-on-write mapping instead,
+  so the published data are never modified. Creating, removing, or renaming
+  a vector in one of these directories throws. Binary data that
+  an attached process builds for itself (for example the Mode 3
+  assembly graph, if it was not published) are anonymous instead:
+  see sharedDataName.
+
+Class VectorStatistics counts, for each vector, the number
+of times it was remapped, the number of bytes involved, and the time spent
+remapping and prefaulting. Vectors are identified by the name of their
+supporting file, without the directory. Anonymous vectors are identified
+by the name passed to createNew (for example by Assembler::createNew),
+or by their object size if no name was given.
+The statistics are written to performance.log at the end of an assembly.
+
+*******************************************************************************/
+
+// Standard library.
+#include <condition_variable>
+#include "cstdint.hpp"
+#include <deque>
+#include "iostream.hpp"
+#include <map>
+#include <mutex>
+#include "string.hpp"
+#include <thread>
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    namespace MemoryMapped {
+        class PrefaultQueue;
+        class VectorPolicy;
+        class VectorStatistics;
+
+        extern VectorPolicy vectorPolicy;
+        extern VectorStatistics vectorStatistics;
+        extern PrefaultQueue prefaultQueue;
+
+        // Prefault a range of newly mapped memory as requested
+        // by vectorPolicy and record the time spent in vectorStatistics.
+        void prefault(const string& name, void* begin, uint64_t length);
+
+        // Create or grow anonymous mappings aligned to 2 MB
+        // and advised to use transparent huge pages.
+        void* mapAnonymousTransparentHugePages(uint64_t size);
+        void* remapAnonymousTransparentHugePages(void* pointer, uint64_t oldSize, uint64_t newSize);
+    }
+}
+
+
+
+class shasta::MemoryMapped::VectorPolicy {
+public:
+
+    // Growth policy used by resize.
+    double growthFactor = 1.5;
+    uint64_t minimumGrowth = 0;
+    uint64_t maximumGrowth = 0;
+
+    // Return the capacity to be requested when resize
+    // needs to grow a vector beyond its current capacity.
+    uint64_t growthCapacity(uint64_t newSize, uint64_t objectSize) const;
+
+    // Prefault policy.
+    enum class PrefaultMode {
+        none,
+        willNeed,
+        populateWrite
+    };
+    PrefaultMode prefaultMode = PrefaultMode::none;
+    uint64_t prefaultThreshold = 256ULL * 1024ULL * 1024ULL;
+    bool prefaultInBackground = true;
+
+    // Set the prefault mode from a string (none, willneed, populate).
+    void setPrefaultMode(const string&);
+
+    // Transparent huge page policy.
+    bool transparentHugePages = false;
+    uint64_t hugePageReportThreshold = 64ULL * 1024ULL * 1024ULL;
+
+    // Shared read-only policy. The directories are stored as absolute paths.
+    vector<string> sharedReadOnlyDirectories;
+    bool isSharedReadOnly(const string& name) const;
+
+    // Return the name to be used for a binary object with the given file name.
+    // This is the name itself, unless it is in one of the
+    // sharedReadOnlyDirectories and does not exist. In that case the object
+    // is being created by an attached process, and an empty name is
+    // returned, so the object is anonymous and private to this process.
+    string sharedDataName(const string& name) const;
+};
+
+
+
+class shasta::MemoryMapped::VectorStatistics {
+public:
+
+    class Counters {
+    public:
+        uint64_t remapCount = 0;
+        uint64_t remapBytes = 0;
+        double remapSeconds = 0.;
+        uint64_t prefaultCount = 0;
+        uint64_t prefaultBytes = 0;
+        uint64_t prefaultPageFaults = 0;
+        double prefaultSeconds = 0.;
+    };
+
+    void recordRemap(const string& name, uint64_t bytes, double seconds);
+    void recordPrefault(const string& name, uint64_t bytes, uint64_t pageFaults, double seconds);
+
+    // Write statistics for all vectors, in order of decreasing
+    // total time. Waits for background prefaults first.
+    void write(ostream&);
+
+    // Keep track of mappings that use transparent huge pages,
+    // so huge page coverage can be reported. When a mapping is unregistered,
+    // its coverage is measured if requested and if it is large enough.
+    void registerMapping(const string& name, const void* begin, uint64_t size);
+    void unregisterMapping(const void* begin, bool measureCoverage);
+
+    // Write transparent huge page coverage for large vectors
+    // freed so far and for those still mapped.
+    void writeTransparentHugePageCoverage(ostream&);
+
+private:
+    std::mutex mutex;
+    std::map<string, Counters> counters;
+
+    class Mapping {
+    public:
+        string name;
+        uint64_t size = 0;
+    };
+    std::map<const void*, Mapping> mappings;
+
+    class HugePageCoverage {
+    public:
+        string name;
+        uint64_t size = 0;
+        uint64_t residentBytes = 0;
+        uint64_t hugePageBytes = 0;
+        bool isMapped = false;
+    };
+    vector<HugePageCoverage> freedCoverage;
+
+    // Use /proc/self/smaps to fill in residentBytes and hugePageBytes
+    // for a set of address ranges. The first member of
+    // each pair is the address where the range begins.
+    static void measureHugePageCoverage(vector< pair<const void*, HugePageCoverage> >&);
+    static void writeHugePageCoverage(ostream&, const HugePageCoverage&);
+};
+
+
+
+// The queue of background prefault requests and the worker thread
+// that processes them. The worker thread is started by the first request.
+class shasta::MemoryMapped::PrefaultQueue {
+public:
+
+    // Maximum number of requests waiting for the worker thread.
+    static const uint64_t maximumQueueSize = 16;
+
+    // Add a request. If the queue is full, the request is dropped
+    // and the function returns false.
+    bool push(const string& name, void* begin, uint64_t length, int advice);
+
+    // Remove queued requests that overlap the given range and wait
+    // for the request in progress, if it overlaps the given range.
+    // This must be called before the range is unmapped or remapped.
+    void cancel(const void* begin, uint64_t length);
+
+    // Wait for all queued requests to complete.
+    void waitForAll();
+
+    // Drops queued requests, waits for the one in progress,
+    // and stops the worker thread.
+    ~PrefaultQueue();
+
+private:
+    class Request {
+    public:
+        string name;
+        void* begin = 0;
+        uint64_t length = 0;
+        int advice = 0;
+        bool overlaps(const void* begin, uint64_t length) const;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Request> requests;
+    Request currentRequest;
+    bool isBusy = false;
+    bool isStopping = false;
+    std::thread worker;
+
+    void workerFunction();
+};
+
+#endif
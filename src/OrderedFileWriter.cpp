@@ -0,0 +1,89 @@
+// Shasta.
+#include "OrderedFileWriter.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "stdexcept.hpp"
+
+// Linux.
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+
+OrderedFileWriter::OrderedFileWriter(const string& fileName) :
+    fileName(fileName)
+{
+    fileDescriptor = ::open(fileName.c_str(),
+        O_CREAT | O_TRUNC | O_WRONLY,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + ": " + ::strerror(errno));
+    }
+}
+
+
+
+OrderedFileWriter::~OrderedFileWriter()
+{
+    if(fileDescriptor != -1) {
+        ::close(fileDescriptor);
+    }
+}
+
+
+
+void OrderedFileWriter::write(uint64_t sequenceNumber, const string& buffer)
+{
+    write(sequenceNumber, buffer.data(), buffer.size());
+}
+
+
+
+void OrderedFileWriter::write(uint64_t sequenceNumber, const char* begin, uint64_t size)
+{
+    // Wait for our turn, then reserve space in the file.
+    uint64_t offset = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]{return wasAborted or nextSequenceNumber == sequenceNumber;});
+        if(wasAborted) {
+            throw runtime_error("Writing to " + fileName + " was aborted.");
+        }
+        offset = nextOffset;
+        nextOffset += size;
+        ++nextSequenceNumber;
+    }
+    condition.notify_all();
+
+    // Write it out. This can overlap with writes done by other threads.
+    while(size > 0) {
+        const ssize_t n = ::pwrite(fileDescriptor, begin, size, off_t(offset));
+        if(n == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+            const string message = "Error writing to " + fileName + ": " + ::strerror(errno);
+            abort();
+            throw runtime_error(message);
+        }
+        begin += n;
+        size -= uint64_t(n);
+        offset += uint64_t(n);
+    }
+}
+
+
+
+void OrderedFileWriter::abort()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wasAborted = true;
+    }
+    condition.notify_all();
+}
@@ -0,0 +1,84 @@
+#ifndef SHASTA_ORDERED_FILE_WRITER_HPP
+#define SHASTA_ORDERED_FILE_WRITER_HPP
+
+/*******************************************************************************
+
+Class OrderedFileWriter allows multiple threads to write
+to the same file, preserving a prescribed ordering.
+
+Each thread formats a chunk of output into its own buffer,
+then calls write with the sequence number of that chunk.
+Sequence numbers must start at 0 and be contiguous.
+The call to write blocks until all chunks with lower
+sequence numbers have been assigned a position in the file.
+This only takes a short critical section, and the
+actual I/O is done outside of it with pwrite,
+so writes by multiple threads can overlap.
+
+When used with MultithreadedObject::getNextBatch,
+which hands out batches in increasing order,
+the sequence number of a batch can be computed as begin/batchSize,
+plus an offset if more than one pass is used to write a file.
+
+If a thread fails before writing its chunk, it must call abort.
+Otherwise threads waiting for that chunk would wait forever.
+After abort, all pending and future calls to write throw.
+
+*******************************************************************************/
+
+// Standard library.
+#include "cstdint.hpp"
+#include <condition_variable>
+#include <mutex>
+#include "string.hpp"
+
+namespace shasta {
+    class OrderedFileWriter;
+}
+
+
+
+class shasta::OrderedFileWriter {
+public:
+
+    // Create the file, truncating it if it exists.
+    OrderedFileWriter(const string& fileName);
+    ~OrderedFileWriter();
+
+    // Write a chunk with a given sequence number.
+    void write(uint64_t sequenceNumber, const string& buffer);
+    void write(uint64_t sequenceNumber, const char* begin, uint64_t size);
+
+    // Wake up all threads waiting in write and make them throw.
+    void abort();
+
+    // The number of chunks written so far.
+    uint64_t getChunkCount() const
+    {
+        return nextSequenceNumber;
+    }
+
+    // The number of bytes written so far.
+    uint64_t getSize() const
+    {
+        return nextOffset;
+    }
+
+    // OrderedFileWriter is not copyable.
+    OrderedFileWriter(const OrderedFileWriter&) = delete;
+    OrderedFileWriter& operator=(const OrderedFileWriter&) = delete;
+
+private:
+    string fileName;
+    int fileDescriptor = -1;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint64_t nextSequenceNumber = 0;
+    uint64_t nextOffset = 0;
+    bool wasAborted = false;
+};
+
+
+
+#endif
@@ -0,0 +1,128 @@
+// Shasta.
+#include "PhaseTimer.hpp"
+#include "performanceLog.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include "fstream.hpp"
+
+// Linux.
+#include <sys/resource.h>
+
+
+
+PhaseTimer::PhaseTimer(bool resetPeakResidentMemoryPerPhase) :
+    peakResidentMemoryIsPerPhase(resetPeakResidentMemoryPerPhase)
+{
+}
+
+
+
+void PhaseTimer::beginPhase(const string& name)
+{
+    endPhase();
+
+    // If requested, reset the peak resident memory,
+    // so we get the peak for this phase only.
+    if(peakResidentMemoryIsPerPhase) {
+        peakResidentMemoryIsPerPhase = resetPeakResidentMemory();
+    }
+
+    phaseIsActive = true;
+    currentName = name;
+    currentBegin = steady_clock::now();
+    currentCpuBegin = getCpuSeconds();
+    performanceLog << timestamp << "Phase " << name << " begins." << endl;
+}
+
+
+
+void PhaseTimer::endPhase()
+{
+    if(not phaseIsActive) {
+        return;
+    }
+
+    Phase phase;
+    phase.name = currentName;
+    phase.elapsedSeconds = seconds(steady_clock::now() - currentBegin);
+    phase.cpuSeconds = getCpuSeconds() - currentCpuBegin;
+    phase.peakResidentMemory = getPeakResidentMemory();
+    phases.push_back(phase);
+    phaseIsActive = false;
+
+    performanceLog << timestamp << "Phase " << phase.name << " ends. Elapsed " <<
+        phase.elapsedSeconds << " s, CPU " << phase.cpuSeconds <<
+        " s, peak resident memory " << phase.peakResidentMemory << " bytes." << endl;
+}
+
+
+
+void PhaseTimer::writeCsv(ostream& csv) const
+{
+    csv << "Phase,Elapsed seconds,CPU seconds,Average CPU utilization,"
+        "Peak resident memory bytes,Peak memory is per phase\n";
+    for(const Phase& phase: phases) {
+        csv << phase.name << "," <<
+            phase.elapsedSeconds << "," <<
+            phase.cpuSeconds << "," <<
+            (phase.elapsedSeconds > 0. ? phase.cpuSeconds / phase.elapsedSeconds : 0.) << "," <<
+            phase.peakResidentMemory << "," <<
+            (peakResidentMemoryIsPerPhase ? "Yes" : "No") << "\n";
+    }
+}
+
+
+
+uint64_t PhaseTimer::peakResidentMemory() const
+{
+    uint64_t peak = 0;
+    for(const Phase& phase: phases) {
+        peak = max(peak, phase.peakResidentMemory);
+    }
+    return peak;
+}
+
+
+
+// Read VmHWM from /proc/self/status.
+uint64_t PhaseTimer::getPeakResidentMemory()
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line)) {
+        if(line.compare(0, 6, "VmHWM:") == 0) {
+            // The value is in kB.
+            return 1024ULL * std::strtoull(line.c_str() + 6, 0, 10);
+        }
+    }
+    return 0;
+}
+
+
+
+// User plus system CPU time of this process, including all threads.
+double PhaseTimer::getCpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return
+        double(usage.ru_utime.tv_sec) + 1.e-6 * double(usage.ru_utime.tv_usec) +
+        double(usage.ru_stime.tv_sec) + 1.e-6 * double(usage.ru_stime.tv_usec);
+}
+
+
+
+// Writing 5 to /proc/self/clear_refs resets VmHWM to the current
+// resident set size (Linux 4.0 and later).
+bool PhaseTimer::resetPeakResidentMemory()
+{
+    ofstream clearRefs("/proc/self/clear_refs");
+    if(not clearRefs) {
+        return false;
+    }
+    clearRefs << "5" << std::flush;
+    return bool(clearRefs);
+}
@@ -0,0 +1,88 @@
+#ifndef SHASTA_PHASE_TIMER_HPP
+#define SHASTA_PHASE_TIMER_HPP
+
+/*******************************************************************************
+
+Class PhaseTimer records elapsed time, CPU time, and peak resident memory
+for each phase of an assembly, so scaling with input size and
+thread count can be measured (see shasta/scripts/RunScalingBenchmark.py).
+
+Phases are consecutive: beginning a phase ends the previous one.
+
+By default, the peak resident memory reported for each phase
+is the peak resident memory of the process (VmHWM) at the end of the phase,
+that is, the peak since the beginning of the process.
+This leaves VmHWM untouched, so the maximum resident set size
+reported by time, wait4, and job schedulers remains correct.
+
+If constructed with resetPeakResidentMemoryPerPhase set to true,
+VmHWM is instead reset at the beginning of each phase by writing 5 to
+/proc/self/clear_refs (Linux only), so the peak memory reported for each phase
+is the peak during that phase only. This invalidates the maximum
+resident set size seen by the parent process, so in that case
+the maximum over all phases should be used instead.
+If the reset is not possible, the behavior is the same as the default.
+
+*******************************************************************************/
+
+// Shasta.
+#include "chrono.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "iostream.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class PhaseTimer;
+}
+
+
+
+class shasta::PhaseTimer {
+public:
+
+    PhaseTimer(bool resetPeakResidentMemoryPerPhase = false);
+
+    // End the current phase, if any, and begin a new one.
+    void beginPhase(const string& name);
+
+    // End the current phase, if any.
+    void endPhase();
+
+    // Write one line per phase in csv format.
+    void writeCsv(ostream&) const;
+
+    // Maximum over all phases of peak resident memory, in bytes.
+    uint64_t peakResidentMemory() const;
+
+    // Get the current peak resident memory (VmHWM) of this process, in bytes.
+    static uint64_t getPeakResidentMemory();
+
+private:
+
+    class Phase {
+    public:
+        string name;
+        double elapsedSeconds = 0.;
+        double cpuSeconds = 0.;
+        uint64_t peakResidentMemory = 0;
+    };
+    vector<Phase> phases;
+
+    // Information about the phase in progress.
+    bool phaseIsActive = false;
+    string currentName;
+    steady_clock::time_point currentBegin;
+    double currentCpuBegin = 0.;
+
+    // True if VmHWM is reset at the beginning of each phase
+    // via /proc/self/clear_refs. Set to false if the reset fails.
+    bool peakResidentMemoryIsPerPhase;
+
+    static double getCpuSeconds();
+    bool resetPeakResidentMemory();
+};
+
+#endif
@@ -59,6 +59,11 @@ PhasingGraph::PhasingGraph(
     bool allowRandomHypothesis) :
     MultithreadedObject<PhasingGraph>(*this)
 {
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    this->threadCount = threadCount;
+
     createVertices(assemblyGraph2);
     createOrientedReadsTable(assemblyGraph2.getReadCount());
     createEdges(
@@ -198,11 +203,43 @@ void PhasingGraph::createEdges(
     createEdgesData.epsilon = epsilon;
     createEdgesData.allowRandomHypothesis = allowRandomHypothesis;
 
-    // Process all vertices in parallel.
-    const uint64_t batchSize = 100;
+    // Process all vertices in parallel to find candidate edges.
+    uint64_t batchSize = 100;
+    createEdgesData.threadEdges.clear();
+    createEdgesData.threadEdges.resize(threadCount);
     setupLoadBalancing(createEdgesData.allVertices.size(), batchSize);
     runThreads(&PhasingGraph::createEdgesThreadFunction, threadCount);
 
+    // Gather the candidate edges and sort them by their vertices,
+    // so the edges are added to the graph in a deterministic order.
+    vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> >& candidateEdges =
+        createEdgesData.candidateEdges;
+    candidateEdges.clear();
+    for(const auto& threadEdges: createEdgesData.threadEdges) {
+        copy(threadEdges.begin(), threadEdges.end(), back_inserter(candidateEdges));
+    }
+    createEdgesData.threadEdges.clear();
+    sort(candidateEdges.begin(), candidateEdges.end(),
+        [](const auto& x, const auto& y)
+        {
+            return make_pair(get<0>(x), get<1>(x)) < make_pair(get<0>(y), get<1>(y));
+        });
+
+    // Run the Bayesian model on all candidate edges, in parallel.
+    batchSize = 1000;
+    setupLoadBalancing(candidateEdges.size(), batchSize);
+    runThreads(&PhasingGraph::runBayesianModelThreadFunction, threadCount);
+
+    // Add the edges with sufficient logP.
+    for(const auto& t: candidateEdges) {
+        const PhasingGraphEdge& edge = get<2>(t);
+        if(edge.logP > minLogP) {
+            add_edge(get<0>(t), get<1>(t), edge, phasingGraph);
+        }
+    }
+    candidateEdges.clear();
+    candidateEdges.shrink_to_fit();
+
     performanceLog << timestamp << "AssemblyGraph2::PhasingGraph::createEdges ends." << endl;
 }
 
@@ -210,8 +247,6 @@ void PhasingGraph::createEdges(
 
 void PhasingGraph::createEdgesThreadFunction(size_t threadId)
 {
-    PhasingGraph& phasingGraph = *this;
-
     const uint64_t minConcordantReadCount = createEdgesData.minConcordantReadCount;
     const uint64_t maxDiscordantReadCount = createEdgesData.maxDiscordantReadCount;
     const double minLogP = createEdgesData.minLogP;
@@ -220,7 +255,8 @@ void PhasingGraph::createEdgesThreadFunction(size_t threadId)
     vector<CreateEdgesData::EdgeData> edgeData;
 
     // Temporary storage of the edges found by this thread.
-    vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> > threadEdges;
+    vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> >& threadEdges =
+        createEdgesData.threadEdges[threadId];
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
@@ -235,20 +271,31 @@ void PhasingGraph::createEdgesThreadFunction(size_t threadId)
                 allowRandomHypothesis);
         }
     }
+}
+
 
-    std::lock_guard<std::mutex> lock(mutex);
-    for(const auto& t: threadEdges) {
-        const vertex_descriptor v0 = get<0>(t);
-        const vertex_descriptor v1 = get<1>(t);
-        const PhasingGraphEdge&  edge = get<2>(t);
-        add_edge(v0, v1, edge, phasingGraph);
+
+void PhasingGraph::runBayesianModelThreadFunction(size_t threadId)
+{
+    const double epsilon = createEdgesData.epsilon;
+    const bool allowRandomHypothesis = createEdgesData.allowRandomHypothesis;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all candidate edges assigned to this batch.
+        for(uint64_t i=begin; i!=end; ++i) {
+            PhasingGraphEdge& edge = get<2>(createEdgesData.candidateEdges[i]);
+            edge.runBayesianModel(epsilon, allowRandomHypothesis);
+        }
     }
 }
 
 
 
-// Create edges between vertex vA and vertices vB with id greater
-// that the id of vA.
+// Find candidate edges between vertex vA and vertices vB with id greater
+// that the id of vA. The Bayesian model is run on them later.
 void PhasingGraph::createEdges(
     PhasingGraph::vertex_descriptor vA,
     uint64_t minConcordantReadCount,
@@ -311,12 +358,7 @@ void PhasingGraph::createEdges(
 
             if( (edge.concordantCount() >= minConcordantReadCount) and
                 (edge.discordantCount() <= maxDiscordantReadCount)) {
-
-                edge.runBayesianModel(epsilon, allowRandomHypothesis);
-
-                if(edge.logP > minLogP) {
-                    threadEdges.push_back(make_tuple(vA, vB, edge));
-                }
+                threadEdges.push_back(make_tuple(vA, vB, edge));
             }
         }
 
@@ -345,47 +387,125 @@ void PhasingGraph::createOrientedReadsTable(uint64_t readCount)
 }
 
 
+// Compute connected components of the PhasingGraph.
+// Components are numbered in order of their lowest vertex,
+// which is the same order in which they are encountered
+// by a loop over vertices.
+void PhasingGraph::computeComponents()
+{
+    PhasingGraph& phasingGraph = *this;
+
+    // Initialize the disjoint sets data structure.
+    const uint64_t n = num_vertices(phasingGraph);
+    vector<uint64_t> rank(n);
+    vector<uint64_t> parent(n);
+    boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
+    for(uint64_t i=0; i<n; i++) {
+        disjointSets.make_set(i);
+    }
+    BGL_FORALL_EDGES(e, phasingGraph, PhasingGraph) {
+        disjointSets.union_set(source(e, phasingGraph), target(e, phasingGraph));
+    }
+
+    // Gather the vertices of each component.
+    components.clear();
+    vector<uint64_t> componentTable(n, std::numeric_limits<uint64_t>::max());
+    BGL_FORALL_VERTICES(v, phasingGraph, PhasingGraph) {
+        const uint64_t root = disjointSets.find_set(v);
+        uint64_t& componentId = componentTable[root];
+        if(componentId == std::numeric_limits<uint64_t>::max()) {
+            componentId = components.size();
+            components.resize(components.size() + 1);
+        }
+        components[componentId].push_back(v);
+    }
+}
+
+
+
 // Find the optimal spanning tree using logFisher as the edge weight.
 // Edges that are part of the optimal spanning tree get their
 // isTreeEdge set.
 void PhasingGraph::computeSpanningTree()
 {
-    PhasingGraph& phasingGraph = *this;
+    computeComponents();
+
+    // Process the connected components in parallel.
+    indexInComponent.resize(num_vertices(*this));
+    const uint64_t batchSize = 10;
+    setupLoadBalancing(components.size(), batchSize);
+    runThreads(&PhasingGraph::computeSpanningTreeThreadFunction, threadCount);
+    indexInComponent.clear();
+    indexInComponent.shrink_to_fit();
+}
 
-    // Create a vector of edges sorted by decreasing logFisher.
-    vector<pair<PhasingGraph::edge_descriptor, double> > edgeTable;
-    BGL_FORALL_EDGES(e, phasingGraph, PhasingGraph) {
-        edgeTable.push_back(make_pair(e, phasingGraph[e].logP));
+
+
+void PhasingGraph::computeSpanningTreeThreadFunction(size_t threadId)
+{
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all connected components assigned to this batch.
+        for(uint64_t componentId=begin; componentId!=end; ++componentId) {
+            computeSpanningTree(components[componentId]);
+        }
     }
-    sort(edgeTable.begin(), edgeTable.end(),
-        OrderPairsBySecondOnlyGreater<PhasingGraph::edge_descriptor, double>());
+}
 
 
-    // Computation of connected components and optimal spanning tree.
 
-    // Initialize the disjoint sets data structure.
-    const uint64_t n = num_vertices(phasingGraph);
+// Compute the optimal spanning tree of a connected component.
+void PhasingGraph::computeSpanningTree(const vector<vertex_descriptor>& component)
+{
+    PhasingGraph& phasingGraph = *this;
+
+    // Create a vector of the edges of this component sorted by decreasing logP.
+    // Ties are broken using the vertices of the edges, so the result
+    // is deterministic.
+    for(uint64_t i=0; i<component.size(); i++) {
+        indexInComponent[component[i]] = i;
+    }
+    vector< tuple<double, vertex_descriptor, vertex_descriptor, edge_descriptor> > edgeTable;
+    for(const vertex_descriptor v0: component) {
+        BGL_FORALL_OUTEDGES(v0, e, phasingGraph, PhasingGraph) {
+            const vertex_descriptor v1 = target(e, phasingGraph);
+            if(v0 < v1) {
+                edgeTable.push_back(make_tuple(-phasingGraph[e].logP, v0, v1, e));
+            }
+        }
+    }
+    sort(edgeTable.begin(), edgeTable.end(),
+        [](const auto& x, const auto& y)
+        {
+            return
+                tie(get<0>(x), get<1>(x), get<2>(x)) <
+                tie(get<0>(y), get<1>(y), get<2>(y));
+        });
+
+    // Initialize the disjoint sets data structure,
+    // using indexes in the component.
+    const uint64_t n = component.size();
     vector<uint64_t> rank(n);
     vector<uint64_t> parent(n);
     boost::disjoint_sets<uint64_t*, uint64_t*> disjointSets(&rank[0], &parent[0]);
-    for(uint32_t i=0; i<n; i++) {
+    for(uint64_t i=0; i<n; i++) {
         disjointSets.make_set(i);
     }
 
     // Process edges in order of decreasing logP.
-    uint64_t treeEdgeCount = 0;
-    for(const auto& p: edgeTable) {
-        const PhasingGraph::edge_descriptor e = p.first;
-        const PhasingGraph::vertex_descriptor v0 = source(e, phasingGraph);
-        const PhasingGraph::vertex_descriptor v1 = target(e, phasingGraph);
-        if(disjointSets.find_set(v0) != disjointSets.find_set(v1)) {
-            disjointSets.union_set(v0, v1);
-            phasingGraph[e].isTreeEdge = true;
-            ++treeEdgeCount;
+    for(const auto& t: edgeTable) {
+        const uint64_t i0 = indexInComponent[get<1>(t)];
+        const uint64_t i1 = indexInComponent[get<2>(t)];
+        PhasingGraphEdge& edge = phasingGraph[get<3>(t)];
+        if(disjointSets.find_set(i0) != disjointSets.find_set(i1)) {
+            disjointSets.union_set(i0, i1);
+            edge.isTreeEdge = true;
+        } else {
+            edge.isTreeEdge = false;
         }
     }
-    // cout << "Found " << treeEdgeCount << " edges of the optimal spanning tree." << endl;
-
 }
 
 
@@ -393,65 +513,88 @@ void PhasingGraph::computeSpanningTree()
 // Phase vertices using the spanning tree.
 void PhasingGraph::phase()
 {
-    PhasingGraph& phasingGraph = *this;
+    // This uses the connected components computed by computeSpanningTree.
+    // Each connected component of the PhasingGraph
+    // is also a connected component of the spanning tree.
+    uint64_t vertexCount = 0;
+    for(const auto& component: components) {
+        vertexCount += component.size();
+    }
+    SHASTA_ASSERT(vertexCount == num_vertices(*this));
 
-    // Loop over start vertices. One iteration for each connected component.
-    uint64_t componentId = 0;
-    BGL_FORALL_VERTICES(vStart, phasingGraph, PhasingGraph) {
-        PhasingGraphVertex& vertexStart = phasingGraph[vStart];
+    // Process the connected components in parallel.
+    const uint64_t batchSize = 10;
+    setupLoadBalancing(components.size(), batchSize);
+    runThreads(&PhasingGraph::phaseThreadFunction, threadCount);
+}
 
-        // If this vertex has already been assigned to a component,
-        // don't use it as a start vertex.
-        if(vertexStart.componentId != PhasingGraphVertex::invalidComponentId) {
-            continue;
+
+
+void PhasingGraph::phaseThreadFunction(size_t threadId)
+{
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all connected components assigned to this batch.
+        for(uint64_t componentId=begin; componentId!=end; ++componentId) {
+            phase(componentId);
         }
+    }
+}
 
 
-        // BFS on the optimal spanning tree, starting at this vertex.
-        std::queue<PhasingGraph::vertex_descriptor> q;
-        q.push(vStart);
-        vertexStart.componentId = componentId;
-        vertexStart.phase = 0;
-        while(not q.empty()) {
-
-            // Dequeue a vertex.
-            const PhasingGraph::vertex_descriptor v0 = q.front();
-            q.pop();
-            PhasingGraphVertex& vertex0 = phasingGraph[v0];
-            SHASTA_ASSERT(vertex0.componentId == componentId);
-            const uint64_t phase0 = vertex0.phase;
-
-            // Loop over tree edges incident to this vertex.
-            BGL_FORALL_OUTEDGES(v0, e, phasingGraph, PhasingGraph) {
-                const PhasingGraphEdge& edge = phasingGraph[e];
-                if(not edge.isTreeEdge) {
-                    continue;
-                }
 
-                // If we already encountered the other vertex, skip.
-                const PhasingGraph::vertex_descriptor v1 = target(e, phasingGraph);
-                PhasingGraphVertex& vertex1 = phasingGraph[v1];
-                if(vertex1.componentId != PhasingGraphVertex::invalidComponentId) {
-                    SHASTA_ASSERT(vertex1.componentId == componentId);
-                    continue;
-                }
+// Phase the vertices of a connected component.
+// This does a BFS on the optimal spanning tree,
+// starting at the lowest numbered vertex of the component.
+void PhasingGraph::phase(uint64_t componentId)
+{
+    PhasingGraph& phasingGraph = *this;
 
-                // Add the other vertex to this component and phase it.
-                q.push(v1);
-                vertex1.componentId = componentId;
+    const PhasingGraph::vertex_descriptor vStart = components[componentId].front();
+    PhasingGraphVertex& vertexStart = phasingGraph[vStart];
+    SHASTA_ASSERT(vertexStart.componentId == PhasingGraphVertex::invalidComponentId);
+
+    std::queue<PhasingGraph::vertex_descriptor> q;
+    q.push(vStart);
+    vertexStart.componentId = componentId;
+    vertexStart.phase = 0;
+    while(not q.empty()) {
+
+        // Dequeue a vertex.
+        const PhasingGraph::vertex_descriptor v0 = q.front();
+        q.pop();
+        PhasingGraphVertex& vertex0 = phasingGraph[v0];
+        SHASTA_ASSERT(vertex0.componentId == componentId);
+        const uint64_t phase0 = vertex0.phase;
+
+        // Loop over tree edges incident to this vertex.
+        BGL_FORALL_OUTEDGES(v0, e, phasingGraph, PhasingGraph) {
+            const PhasingGraphEdge& edge = phasingGraph[e];
+            if(not edge.isTreeEdge) {
+                continue;
+            }
 
-                if(edge.relativePhase == 0) {
-                    vertex1.phase = phase0;
-                } else {
-                    vertex1.phase = 1 - phase0;
-                }
+            // If we already encountered the other vertex, skip.
+            const PhasingGraph::vertex_descriptor v1 = target(e, phasingGraph);
+            PhasingGraphVertex& vertex1 = phasingGraph[v1];
+            if(vertex1.componentId != PhasingGraphVertex::invalidComponentId) {
+                SHASTA_ASSERT(vertex1.componentId == componentId);
+                continue;
             }
-        }
 
-        // Prepare to handle the next connected component.
-        ++componentId;
-    }
+            // Add the other vertex to this component and phase it.
+            q.push(v1);
+            vertex1.componentId = componentId;
 
+            if(edge.relativePhase == 0) {
+                vertex1.phase = phase0;
+            } else {
+                vertex1.phase = 1 - phase0;
+            }
+        }
+    }
 }
 
 
@@ -157,9 +157,12 @@ public:
     // Find the optimal spanning tree using logFisher as the edge weight.
     // Edges that are part of the optimal spanning tree get their
     // isTreeEdge set.
+    // This also computes the connected components, and each
+    // connected component is processed independently, in parallel.
     void computeSpanningTree();
 
     // Phase vertices using the spanning tree.
+    // Each connected component is processed independently, in parallel.
     void phase();
 
     // Store the phasing in the AssemblyGraph2.
@@ -172,6 +175,7 @@ public:
     void writeGraphviz(const string& fileName) const;
 
 private:
+    size_t threadCount;
     void createVertices(const AssemblyGraph2&);
 
     // Edge creation is expensive and runs in parallel.
@@ -183,6 +187,7 @@ private:
         size_t threadCount,
         bool allowRandomHypothesis);
     void createEdgesThreadFunction(size_t threadId);
+    void runBayesianModelThreadFunction(size_t threadId);
     class CreateEdgesData {
     public:
         uint64_t minConcordantReadCount;
@@ -191,6 +196,15 @@ private:
         double epsilon; // For Bayesian model.
         bool allowRandomHypothesis;
         vector<PhasingGraph::vertex_descriptor> allVertices;
+
+        // The candidate edges found by each thread.
+        // These satisfy the requirements on concordant and discordant read counts,
+        // but runBayesianModel has not yet been called for them.
+        vector< vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> > > threadEdges;
+
+        // All candidate edges, sorted by their vertices.
+        // runBayesianModel is called for them in parallel.
+        vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> > candidateEdges;
         class EdgeData {
         public:
             PhasingGraph::vertex_descriptor vB;
@@ -213,6 +227,22 @@ private:
         vector< tuple<vertex_descriptor, vertex_descriptor, PhasingGraphEdge> >& threadEdges,
         bool allowRandomHypothesis);
 
+    // The connected components of the PhasingGraph,
+    // in order of increasing lowest vertex.
+    // The vertices of each component are sorted.
+    // Computed by computeSpanningTree and also used by phase.
+    vector< vector<vertex_descriptor> > components;
+    void computeComponents();
+    void computeSpanningTreeThreadFunction(size_t threadId);
+    void computeSpanningTree(const vector<vertex_descriptor>& component);
+    void phaseThreadFunction(size_t threadId);
+    void phase(uint64_t componentId);
+
+    // Used by computeSpanningTree to map vertices to their
+    // index in their connected component.
+    // Indexed by vertex_descriptor.
+    vector<uint64_t> indexInComponent;
+
     // Get the vertex corresponding to a component, creating it if necessary.
     PhasingGraph::vertex_descriptor getVertex(uint64_t componentId);
 
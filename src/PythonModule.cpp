@@ -1,11 +1,13 @@
 #ifdef SHASTA_PYTHON_API
 
 // Shasta.
+#include "Align4.hpp"
 #include "AssembledSegment.hpp"
 #include "Assembler.hpp"
 #include "AssemblerOptions.hpp"
 #include "AssemblyGraph.hpp"
 #include "Base.hpp"
+#include "BinaryAssemblyGraph.hpp"
 #include "CompactUndirectedGraph.hpp"
 #include "compressAlignment.hpp"
 #include "deduplicate.hpp"
@@ -16,9 +18,11 @@
 #include "mappedCopy.hpp"
 #include "MedianConsensusCaller.hpp"
 #include "MemoryMappedAllocator.hpp"
+#include "mode3.hpp"
 #include "MultithreadedObject.hpp"
 #include "performanceLog.hpp"
 #include "Reads.hpp"
+#include "SharedAssemblyData.hpp"
 #include "ShortBaseSequence.hpp"
 #include "splitRange.hpp"
 #include "SimpleBayesianConsensusCaller.hpp"
@@ -34,6 +38,246 @@ using namespace pybind11;
 
 
 
+// Helper functions used to expose memory mapped data structures
+// of the Assembler to Python as read-only numpy arrays
+// that refer directly to the memory mapped data, without copying.
+// The array keeps the Python Assembler object alive,
+// but the array becomes invalid if the data structure
+// it refers to is closed or recreated.
+namespace shasta {
+    namespace python {
+
+        // Offset in bytes of a member of a class.
+        template<class T, class M> ssize_t memberOffset(const T& t, const M& m)
+        {
+            return reinterpret_cast<const char*>(&m) - reinterpret_cast<const char*>(&t);
+        }
+
+        // Create a structured numpy dtype with the given field names,
+        // formats, and offsets.
+        pybind11::dtype structuredDtype(
+            const vector<string>& names,
+            const vector<string>& formats,
+            const vector<ssize_t>& offsets,
+            size_t itemSize)
+        {
+            SHASTA_ASSERT(formats.size() == names.size());
+            SHASTA_ASSERT(offsets.size() == names.size());
+            pybind11::list namesList;
+            pybind11::list formatsList;
+            pybind11::list offsetsList;
+            for(size_t i=0; i<names.size(); i++) {
+                namesList.append(names[i]);
+                formatsList.append(formats[i]);
+                offsetsList.append(offsets[i]);
+            }
+            return pybind11::dtype(namesList, formatsList, offsetsList, ssize_t(itemSize));
+        }
+
+        // Create a read-only one-dimensional numpy array of n elements of the given dtype
+        // that refers to existing memory kept alive by the base object.
+        pybind11::array readOnlyArray(
+            const pybind11::dtype& t,
+            uint64_t n,
+            const void* p,
+            handle base)
+        {
+            pybind11::array a(t, {ssize_t(n)}, {t.itemsize()}, p, base);
+            a.attr("setflags")(arg("write") = false);
+            return a;
+        }
+
+        template<class T> pybind11::array readOnlyArray(
+            const MemoryMapped::Vector<T>& v,
+            const pybind11::dtype& t,
+            const string& name,
+            handle base)
+        {
+            if(not v.isOpen) {
+                throw runtime_error(name + " is not accessible.");
+            }
+            SHASTA_ASSERT(size_t(t.itemsize()) == sizeof(T));
+            return readOnlyArray(t, v.size(), v.begin(), base);
+        }
+
+        // For a VectorOfVectors, return a tuple containing the table of contents
+        // (size()+1 entries) and the data. The elements of the i-th vector
+        // are data[toc[i]:toc[i+1]].
+        template<class T, class Int> pybind11::tuple readOnlyArrays(
+            const MemoryMapped::VectorOfVectors<T, Int>& v,
+            const pybind11::dtype& tocType,
+            const pybind11::dtype& dataType,
+            const string& name,
+            handle base)
+        {
+            if(not v.isOpen()) {
+                throw runtime_error(name + " is not accessible.");
+            }
+            SHASTA_ASSERT(size_t(tocType.itemsize()) == sizeof(Int));
+            SHASTA_ASSERT(size_t(dataType.itemsize()) == sizeof(T));
+            return pybind11::make_tuple(
+                readOnlyArray(tocType, v.size() + 1, v.tocBegin(), base),
+                readOnlyArray(dataType, v.totalSize(), v.begin(), base));
+        }
+
+        // Dtypes for the Assembler data structures.
+        // Uint24 and Uint40 fields are exposed as little endian byte arrays.
+        // Bit fields are exposed as the byte or word that contains them.
+
+        // CompressedMarker: kmerId, position (3 bytes).
+        pybind11::dtype compressedMarkerDtype()
+        {
+            return structuredDtype(
+                {"kmerId", "position"},
+                {"<u4", "(3,)u1"},
+                {0, ssize_t(sizeof(KmerId))},
+                sizeof(CompressedMarker));
+        }
+
+        // MarkerInterval: orientedReadId, ordinals.
+        pybind11::dtype markerIntervalDtype()
+        {
+            const MarkerInterval x;
+            return structuredDtype(
+                {"orientedReadId", "ordinals"},
+                {"<u4", "(2,)<u4"},
+                {memberOffset(x, x.orientedReadId), memberOffset(x, x.ordinals)},
+                sizeof(MarkerInterval));
+        }
+
+        // ReadGraphEdge: orientedReadIds, flags.
+        // In flags, bits 0-61 are the alignmentId, bit 62 is crossesStrands,
+        // and bit 63 is hasInconsistentAlignment.
+        pybind11::dtype readGraphEdgeDtype()
+        {
+            const ReadGraphEdge x;
+            return structuredDtype(
+                {"orientedReadIds", "flags"},
+                {"(2,)<u4", "<u8"},
+                {memberOffset(x, x.orientedReadIds), ssize_t(sizeof(x.orientedReadIds))},
+                sizeof(ReadGraphEdge));
+        }
+
+        // MarkerGraph::Edge: source and target (5 bytes each), coverage,
+        // flags, isSecondary, flags1.
+        // In flags, bit 0 is wasRemovedByTransitiveReduction, bit 1 wasPruned,
+        // bit 2 isSuperBubbleEdge, bit 3 isLowCoverageCrossEdge, bit 4 wasAssembled.
+        // In flags1, bit 0 is wasRemovedWhileSplittingSecondaryEdges.
+        pybind11::dtype markerGraphEdgeDtype()
+        {
+            const MarkerGraph::Edge x;
+            const ssize_t coverageOffset = memberOffset(x, x.coverage);
+            const ssize_t isSecondaryOffset = memberOffset(x, x.isSecondary);
+            return structuredDtype(
+                {"source", "target", "coverage", "flags", "isSecondary", "flags1"},
+                {"(5,)u1", "(5,)u1", "u1", "u1", "u1", "u1"},
+                {memberOffset(x, x.source), memberOffset(x, x.target),
+                    coverageOffset, coverageOffset + 1,
+                    isSecondaryOffset, isSecondaryOffset + 1},
+                sizeof(MarkerGraph::Edge));
+        }
+
+        // AlignmentInfo fields, used for both AlignmentInfo and AlignmentData.
+        // Each row of orientedReadData contains markerCount, firstOrdinal, lastOrdinal
+        // for one of the two oriented reads.
+        // In flags, bit 0 is isInReadGraph.
+        void appendAlignmentInfoFields(
+            ssize_t infoOffset,
+            vector<string>& names,
+            vector<string>& formats,
+            vector<ssize_t>& offsets)
+        {
+            const AlignmentInfo x;
+            const vector<string> infoNames = {
+                "orientedReadData", "markerCount",
+                "minOrdinalOffset", "maxOrdinalOffset", "averageOrdinalOffset",
+                "maxSkip", "maxDrift", "flags"};
+            const vector<string> infoFormats = {
+                "(2,3)<u4", "<u4",
+                "<i4", "<i4", "<i4",
+                "<u4", "<u4", "u1"};
+            const vector<ssize_t> infoOffsets = {
+                memberOffset(x, x.data), memberOffset(x, x.markerCount),
+                memberOffset(x, x.minOrdinalOffset), memberOffset(x, x.maxOrdinalOffset),
+                memberOffset(x, x.averageOrdinalOffset),
+                memberOffset(x, x.maxSkip), memberOffset(x, x.maxDrift),
+                memberOffset(x, x.maxDrift) + ssize_t(sizeof(x.maxDrift))};
+            names.insert(names.end(), infoNames.begin(), infoNames.end());
+            formats.insert(formats.end(), infoFormats.begin(), infoFormats.end());
+            for(const ssize_t offset: infoOffsets) {
+                offsets.push_back(infoOffset + offset);
+            }
+        }
+
+        pybind11::dtype alignmentInfoDtype()
+        {
+            vector<string> names;
+            vector<string> formats;
+            vector<ssize_t> offsets;
+            appendAlignmentInfoFields(0, names, formats, offsets);
+            return structuredDtype(names, formats, offsets, sizeof(AlignmentInfo));
+        }
+
+        // AlignmentData: readIds, isSameStrand, then the AlignmentInfo fields.
+        pybind11::dtype alignmentDataDtype()
+        {
+            const AlignmentData x;
+            vector<string> names = {"readIds", "isSameStrand"};
+            vector<string> formats = {"(2,)<u4", "?"};
+            vector<ssize_t> offsets = {memberOffset(x, x.readIds), memberOffset(x, x.isSameStrand)};
+            appendAlignmentInfoFields(memberOffset(x, x.info), names, formats, offsets);
+            return structuredDtype(names, formats, offsets, sizeof(AlignmentData));
+        }
+
+        // Little endian 5-byte integer, used for CompressedVertexId.
+        pybind11::dtype uint40Dtype()
+        {
+            return structuredDtype({"value"}, {"(5,)u1"}, {0}, 5);
+        }
+
+
+
+        // Helpers for the batch query functions.
+        using UInt32Array = array_t<uint32_t, pybind11::array::c_style | pybind11::array::forcecast>;
+
+        // Convert an array of shape (n, 2) containing OrientedReadId values
+        // (2*readId+strand) to a vector of oriented read pairs.
+        vector< array<OrientedReadId, 2> > getOrientedReadPairs(const UInt32Array& a)
+        {
+            if(a.ndim() != 2 or a.shape(1) != 2) {
+                throw runtime_error("Expected an array of shape (n, 2) containing oriented read ids.");
+            }
+            const auto r = a.unchecked<2>();
+            vector< array<OrientedReadId, 2> > orientedReadPairs(size_t(a.shape(0)));
+            for(ssize_t i=0; i<a.shape(0); i++) {
+                orientedReadPairs[size_t(i)] = {
+                    OrientedReadId::fromValue(r(i, 0)),
+                    OrientedReadId::fromValue(r(i, 1))};
+            }
+            return orientedReadPairs;
+        }
+
+        // Copy a vector to a new numpy array of the given dtype and shape.
+        template<class T> pybind11::array toArray(
+            const vector<T>& v,
+            const pybind11::dtype& t,
+            const vector<ssize_t>& shape)
+        {
+            pybind11::array a(t, shape);
+            SHASTA_ASSERT(size_t(a.nbytes()) == v.size() * sizeof(T));
+            if(not v.empty()) {
+                std::copy(
+                    reinterpret_cast<const char*>(v.data()),
+                    reinterpret_cast<const char*>(v.data() + v.size()),
+                    static_cast<char*>(a.mutable_data()));
+            }
+            return a;
+        }
+    }
+}
+
+
+
 PYBIND11_MODULE(shasta, shastaModule)
 {
 
@@ -114,6 +358,7 @@ PYBIND11_MODULE(shasta, shastaModule)
         .def_readwrite("maxDiscordantReadCountForBubbleRemoval", &Mode2AssemblyOptions::maxDiscordantReadCountForBubbleRemoval)
         .def_readwrite("minLogPForBubbleRemoval", &Mode2AssemblyOptions::minLogPForBubbleRemoval)
         .def_readwrite("componentSizeThresholdForBubbleRemoval", &Mode2AssemblyOptions::componentSizeThresholdForBubbleRemoval)
+        .def_readwrite("incrementalBubbleRemoval", &Mode2AssemblyOptions::incrementalBubbleRemoval)
         .def_readwrite("minConcordantReadCountForPhasing", &Mode2AssemblyOptions::minConcordantReadCountForPhasing)
         .def_readwrite("maxDiscordantReadCountForPhasing", &Mode2AssemblyOptions::maxDiscordantReadCountForPhasing)
         .def_readwrite("minLogPForPhasing", &Mode2AssemblyOptions::minLogPForPhasing)
@@ -141,6 +386,19 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("readRepresentation") = 1,
             arg("largeDataPageSize") = 2*1024*1024)
 
+        // Lazy access to assembly data.
+        .def("accessAllSoft",
+            &Assembler::accessAllSoft,
+            "Access all available assembly data.")
+        .def("accessAllLazy",
+            &Assembler::accessAllLazy,
+            "Register all available assembly data for access on first use.",
+            arg("warmup") = false)
+        .def("accessLazy",
+            &Assembler::accessLazy,
+            "Access registered assembly data, if not already accessed.",
+            arg("name"))
+
 
 
         // Reads
@@ -357,11 +615,105 @@ PYBIND11_MODULE(shasta, shastaModule)
 
 
 
+        // Batch query functions. They take arrays of oriented read ids
+        // (values 2*readId+strand) and release the GIL while running
+        // multithreaded. Results are returned as numpy arrays.
+        .def("alignOrientedReads4Batch",
+            [](
+                Assembler& assembler,
+                const python::UInt32Array& orientedReadIds,
+                uint64_t deltaX,
+                uint64_t deltaY,
+                uint64_t minEntryCountPerCell,
+                uint64_t maxDistanceFromBoundary,
+                uint64_t minAlignedMarkerCount,
+                double minAlignedFraction,
+                uint64_t maxSkip,
+                uint64_t maxDrift,
+                uint64_t maxTrim,
+                uint64_t maxBand,
+                int64_t matchScore,
+                int64_t mismatchScore,
+                int64_t gapScore,
+                size_t threadCount)
+            {
+                Align4::Options options;
+                options.deltaX = deltaX;
+                options.deltaY = deltaY;
+                options.minEntryCountPerCell = minEntryCountPerCell;
+                options.maxDistanceFromBoundary = maxDistanceFromBoundary;
+                options.minAlignedMarkerCount = minAlignedMarkerCount;
+                options.minAlignedFraction = minAlignedFraction;
+                options.maxSkip = maxSkip;
+                options.maxDrift = maxDrift;
+                options.maxTrim = maxTrim;
+                options.maxBand = maxBand;
+                options.matchScore = matchScore;
+                options.mismatchScore = mismatchScore;
+                options.gapScore = gapScore;
+
+                const vector< std::array<OrientedReadId, 2> > orientedReadPairs =
+                    python::getOrientedReadPairs(orientedReadIds);
+                assembler.checkBatchQueryInput(orientedReadPairs);
+                vector<AlignmentInfo> alignmentInfos;
+                {
+                    gil_scoped_release release;
+                    assembler.alignOrientedReads4Batch(
+                        orientedReadPairs, options, alignmentInfos, threadCount);
+                }
+                return python::toArray(alignmentInfos, python::alignmentInfoDtype(),
+                    {ssize_t(alignmentInfos.size())});
+            },
+            "Align many oriented read pairs, given as an array of shape (n, 2), "
+            "using alignment method 4. Returns an array of AlignmentInfo.",
+            arg("orientedReadIds"),
+            arg("deltaX"),
+            arg("deltaY"),
+            arg("minEntryCountPerCell"),
+            arg("maxDistanceFromBoundary"),
+            arg("minAlignedMarkerCount"),
+            arg("minAlignedFraction"),
+            arg("maxSkip"),
+            arg("maxDrift"),
+            arg("maxTrim"),
+            arg("maxBand"),
+            arg("matchScore"),
+            arg("mismatchScore"),
+            arg("gapScore"),
+            arg("threadCount") = 0)
+        .def("analyzeAlignmentMatrixBatch",
+            [](
+                Assembler& assembler,
+                const python::UInt32Array& orientedReadIds,
+                size_t threadCount)
+            {
+                const vector< std::array<OrientedReadId, 2> > orientedReadPairs =
+                    python::getOrientedReadPairs(orientedReadIds);
+                assembler.checkBatchQueryInput(orientedReadPairs);
+                vector< std::array<uint64_t, 3> > summaries;
+                {
+                    gil_scoped_release release;
+                    assembler.analyzeAlignmentMatrixBatch(
+                        orientedReadPairs, summaries, threadCount);
+                }
+                return python::toArray(summaries, dtype::of<uint64_t>(),
+                    {ssize_t(summaries.size()), 3});
+            },
+            "Alignment matrix summary for many oriented read pairs, "
+            "given as an array of shape (n, 2). Returns an array of shape (n, 3) "
+            "containing the number of histogram cells in x and y "
+            "and the number of active cells.",
+            arg("orientedReadIds"),
+            arg("threadCount") = 0)
+
+
+
         // Undirected read graph
         .def("createReadGraph",
             &Assembler::createReadGraph,
             arg("maxAlignmentCount"),
-            arg("maxTrim"))
+            arg("maxTrim"),
+            arg("threadCount") = 0)
         .def("createReadGraph2",
              &Assembler::createReadGraph2,
             arg("maxAlignmentCount"),
@@ -369,7 +721,8 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("alignedFractionPercentile"),
             arg("maxSkipPercentile"),
             arg("maxDriftPercentile"),
-            arg("maxTrimPercentile"))
+            arg("maxTrimPercentile"),
+            arg("threadCount") = 0)
         .def("createReadGraphUsingPseudoPaths",
              &Assembler::createReadGraphUsingPseudoPaths,
              arg("matchScore"),
@@ -389,13 +742,15 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("maxDistance"),
             arg("threadCount") = 0)
         .def("flagCrossStrandReadGraphEdges2",
-            &Assembler::flagCrossStrandReadGraphEdges2)
+            &Assembler::flagCrossStrandReadGraphEdges2,
+            arg("threadCount") = 0)
         .def("flagChimericReads",
              &Assembler::flagChimericReads,
             arg("maxChimericReadDistance"),
             arg("threadCount") = 0)
         .def("computeReadGraphConnectedComponents",
-            &Assembler::computeReadGraphConnectedComponents)
+            &Assembler::computeReadGraphConnectedComponents,
+            arg("threadCount") = 0)
         .def("writeLocalReadGraphReads",
             &Assembler::writeLocalReadGraphReads,
             arg("readId"),
@@ -410,7 +765,8 @@ PYBIND11_MODULE(shasta, shastaModule)
         .def("analyzeReadGraph",
              &Assembler::analyzeReadGraph)
         .def("readGraphClustering",
-             &Assembler::readGraphClustering)
+             &Assembler::readGraphClustering,
+             arg("threadCount") = 0)
         .def("writeReadGraphEdges",
              &Assembler::writeReadGraphEdges,
              arg("useReadName") = false)
@@ -445,6 +801,42 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("readId"),
             arg("strand"),
             arg("ordinal"))
+        .def("getGlobalMarkerGraphVertexBatch",
+            [](
+                Assembler& assembler,
+                const python::UInt32Array& orientedReadIds,
+                const python::UInt32Array& ordinals,
+                size_t threadCount)
+            {
+                if(orientedReadIds.ndim() != 1 or ordinals.ndim() != 1 or
+                    orientedReadIds.shape(0) != ordinals.shape(0)) {
+                    throw runtime_error("Expected two one-dimensional arrays of the same size.");
+                }
+                const auto r = orientedReadIds.unchecked<1>();
+                const auto o = ordinals.unchecked<1>();
+                vector< pair<OrientedReadId, uint32_t> > markerSpecifications(
+                    size_t(orientedReadIds.shape(0)));
+                for(ssize_t i=0; i<orientedReadIds.shape(0); i++) {
+                    markerSpecifications[size_t(i)] =
+                        make_pair(OrientedReadId::fromValue(r(i)), o(i));
+                }
+                assembler.checkBatchQueryInput(markerSpecifications);
+                vector<MarkerGraph::VertexId> vertexIds;
+                {
+                    gil_scoped_release release;
+                    assembler.getGlobalMarkerGraphVertexBatch(
+                        markerSpecifications, vertexIds, threadCount);
+                }
+                return python::toArray(vertexIds, dtype::of<MarkerGraph::VertexId>(),
+                    {ssize_t(vertexIds.size())});
+            },
+            "Find the marker graph vertices for many markers, each given by "
+            "an oriented read id (2*readId+strand) and an ordinal. "
+            "Batch queries on the same Assembler from several Python threads "
+            "run one at a time.",
+            arg("orientedReadIds"),
+            arg("ordinals"),
+            arg("threadCount") = 0)
         .def("getGlobalMarkerGraphVertexMarkers",
             (
                 vector< std::tuple<ReadId, Strand, uint32_t> > (Assembler::*)
@@ -586,13 +978,26 @@ PYBIND11_MODULE(shasta, shastaModule)
             &Assembler::computeAssemblyStatistics)
         .def("writeGfa1",
             &Assembler::writeGfa1,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
         .def("writeGfa1BothStrands",
             &Assembler::writeGfa1BothStrands,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
+        .def("writeGfa1BothStrandsNoSequence",
+            &Assembler::writeGfa1BothStrandsNoSequence,
+            arg("fileName"),
+            arg("threadCount") = 0)
         .def("writeFasta",
             &Assembler::writeFasta,
-            arg("fileName"))
+            arg("fileName"),
+            arg("threadCount") = 0)
+        .def("testWriteAssemblyGraph",
+            &Assembler::testWriteAssemblyGraph,
+            arg("threadCount") = 0)
+        .def("writeAssemblyGraphBinary",
+            &Assembler::writeAssemblyGraphBinary,
+            arg("fileName") = "Assembly-Graph.bin")
         .def("colorGfaWithTwoReads",
             &Assembler::colorGfaWithTwoReads,
             arg("readId0"),
@@ -631,12 +1036,16 @@ PYBIND11_MODULE(shasta, shastaModule)
         .def("writeOrientedReadsByAssemblyGraphEdge",
             &Assembler::writeOrientedReadsByAssemblyGraphEdge)
         .def("detangle",
-            &Assembler::detangle)
+            &Assembler::detangle,
+            arg("useRounds") = false,
+            arg("threadCount") = 0)
         .def("detangle2",
             &Assembler::detangle2,
             arg("diagonalReadCountMin"),
             arg("offDiagonalReadCountMax"),
-            arg("offDiagonalRatio"))
+            arg("offDiagonalRatio"),
+            arg("useRounds") = false,
+            arg("threadCount") = 0)
         .def("alignPseudoPaths",
             &Assembler::alignPseudoPaths)
         .def("removeAssemblyGraph",
@@ -651,6 +1060,20 @@ PYBIND11_MODULE(shasta, shastaModule)
             arg("mode2Options"),
             arg("threadCount") = 0,
             arg("debug") = false)
+        .def("accessAssemblyGraph2",
+            &Assembler::accessAssemblyGraph2,
+            arg("threadCount") = 0)
+        .def("rephaseAssemblyGraph2",
+            &Assembler::rephaseAssemblyGraph2,
+            arg("pruneLength"),
+            arg("mode2Options"),
+            arg("threadCount") = 0)
+        .def("testWriteAssemblyGraph2",
+            &Assembler::testWriteAssemblyGraph2,
+            arg("threadCount") = 0)
+        .def("testSaveAssemblyGraph2",
+            &Assembler::testSaveAssemblyGraph2,
+            arg("threadCount") = 0)
 
         // Assembly mode 3.
         .def("mode3Assembly",
@@ -680,6 +1103,74 @@ PYBIND11_MODULE(shasta, shastaModule)
 
         .def("test", &Assembler::test)
 
+
+
+        // Read-only numpy views of memory mapped data structures, without copying.
+        // The corresponding access function must be called first.
+        // For vectors of vectors, the return value is a tuple (toc, data),
+        // and the elements of the i-th vector are data[toc[i]:toc[i+1]].
+        // See the dtype functions at the top of this file for the fields.
+        .def("markersArrays",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArrays(assembler.getMarkerTable(),
+                    dtype::of<uint64_t>(), python::compressedMarkerDtype(),
+                    "Markers", self);
+            },
+            "Markers of all oriented reads, indexed by OrientedReadId::getValue().")
+        .def("alignmentDataArray",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArray(assembler.getAlignmentData(),
+                    python::alignmentDataDtype(), "Alignment data", self);
+            })
+        .def("readGraphEdgesArray",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArray(assembler.getReadGraph().edges,
+                    python::readGraphEdgeDtype(), "Read graph edges", self);
+            })
+        .def("readGraphConnectivityArrays",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArrays(assembler.getReadGraph().connectivity,
+                    dtype::of<uint32_t>(), dtype::of<uint32_t>(),
+                    "Read graph connectivity", self);
+            },
+            "Read graph edge ids for each oriented read, indexed by OrientedReadId::getValue().")
+        .def("markerGraphVerticesArrays",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                if(not assembler.markerGraph.verticesPointer) {
+                    throw runtime_error("Marker graph vertices are not accessible.");
+                }
+                return python::readOnlyArrays(assembler.markerGraph.vertices(),
+                    python::uint40Dtype(), dtype::of<MarkerId>(),
+                    "Marker graph vertices", self);
+            },
+            "Marker ids for each marker graph vertex. "
+            "The toc entries are 5-byte little endian integers.")
+        .def("markerGraphEdgesArray",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArray(assembler.markerGraph.edges,
+                    python::markerGraphEdgeDtype(), "Marker graph edges", self);
+            })
+        .def("markerGraphEdgeMarkerIntervalsArrays",
+            [](object self)
+            {
+                const Assembler& assembler = self.cast<const Assembler&>();
+                return python::readOnlyArrays(assembler.markerGraph.edgeMarkerIntervals,
+                    dtype::of<uint64_t>(), python::markerIntervalDtype(),
+                    "Marker graph edge marker intervals", self);
+            })
+
         // Definition of class_Assembler ends here.
     ;
 
@@ -695,6 +1186,81 @@ PYBIND11_MODULE(shasta, shastaModule)
 
 
 
+    // Expose class BinaryAssemblyGraph to Python.
+    // The segment and link tables and the sequence and name sections
+    // are returned as read-only numpy arrays that refer directly
+    // to the memory mapped file, without copying.
+    // See BinaryAssemblyGraph.hpp for a description of the format.
+    PYBIND11_NUMPY_DTYPE(BinaryAssemblyGraphSegment,
+        sequenceBegin, sequenceLength, nameBegin, nameLength, coverage);
+    PYBIND11_NUMPY_DTYPE(BinaryAssemblyGraphLink,
+        segment0, segment1, overlap, reverse0, reverse1, unused);
+    class_<BinaryAssemblyGraph>(shastaModule, "BinaryAssemblyGraph")
+        .def(init<const string&>(), arg("fileName"))
+        .def("segmentCount", &BinaryAssemblyGraph::segmentCount)
+        .def("linkCount", &BinaryAssemblyGraph::linkCount)
+        .def("getName", &BinaryAssemblyGraph::getName, arg("segmentId"))
+        .def("getSequence", &BinaryAssemblyGraph::getSequence, arg("segmentId"))
+        .def("segments",
+            [](object self)
+            {
+                const BinaryAssemblyGraph& graph = self.cast<const BinaryAssemblyGraph&>();
+                array_t<BinaryAssemblyGraphSegment> a(
+                    ssize_t(graph.segmentCount()), graph.segments(), self);
+                a.attr("setflags")(arg("write") = false);
+                return a;
+            })
+        .def("links",
+            [](object self)
+            {
+                const BinaryAssemblyGraph& graph = self.cast<const BinaryAssemblyGraph&>();
+                array_t<BinaryAssemblyGraphLink> a(
+                    ssize_t(graph.linkCount()), graph.links(), self);
+                a.attr("setflags")(arg("write") = false);
+                return a;
+            })
+        .def("sequences",
+            [](object self)
+            {
+                const BinaryAssemblyGraph& graph = self.cast<const BinaryAssemblyGraph&>();
+                array_t<uint8_t> a(
+                    ssize_t(graph.sequenceByteCount()), graph.sequences(), self);
+                a.attr("setflags")(arg("write") = false);
+                return a;
+            })
+        .def("names",
+            [](object self)
+            {
+                const BinaryAssemblyGraph& graph = self.cast<const BinaryAssemblyGraph&>();
+                array_t<uint8_t> a(
+                    ssize_t(graph.nameByteCount()),
+                    reinterpret_cast<const uint8_t*>(graph.names()), self);
+                a.attr("setflags")(arg("write") = false);
+                return a;
+            })
+        ;
+
+
+
+    // Expose class SharedAssemblyData to Python.
+    // Attach before creating the Assembler and keep
+    // the SharedAssemblyData object alive while the Assembler is in use.
+    class_<SharedAssemblyData>(shastaModule, "SharedAssemblyData")
+        .def(init<size_t>(), arg("threadCount") = 0)
+        .def("publish", &SharedAssemblyData::publish,
+            arg("dataDirectoryName"), arg("sharedDirectoryName"))
+        .def("attach", &SharedAssemblyData::attach, arg("sharedDirectoryName"))
+        .def("detach", &SharedAssemblyData::detach)
+        .def("isAttached", &SharedAssemblyData::isAttached)
+        .def("largeDataFileNamePrefix", &SharedAssemblyData::largeDataFileNamePrefix)
+        .def_static("referenceCount", &SharedAssemblyData::referenceCount,
+            arg("sharedDirectoryName"))
+        .def_static("cleanup", &SharedAssemblyData::cleanup,
+            arg("sharedDirectoryName"))
+        ;
+
+
+
     // Expose class CompressedCoverageData to Python.
     class_<CompressedCoverageData>(shastaModule, "CompressedCoverageData")
         .def("getBase", &CompressedCoverageData::getBase)
@@ -722,6 +1288,9 @@ PYBIND11_MODULE(shasta, shastaModule)
     shastaModule.def("testMemoryMappedVector",
         testMemoryMappedVector
         );
+    shastaModule.def("testVectorOfVectorsBuilder",
+        testVectorOfVectorsBuilder
+        );
     shastaModule.def("testBase",
         testBase
         );
@@ -752,6 +1321,12 @@ PYBIND11_MODULE(shasta, shastaModule)
     shastaModule.def("testDeduplicateAndCount",
         testDeduplicateAndCount
         );
+    shastaModule.def("testBinaryAssemblyGraph",
+        testBinaryAssemblyGraph
+        );
+    shastaModule.def("testSegmentReadSketches",
+        mode3::testSegmentReadSketches
+        );
     shastaModule.def("dset64Test",
         dset64Test,
         arg("n"),
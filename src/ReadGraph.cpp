@@ -2,6 +2,7 @@
 #include "ReadGraph.hpp"
 #include "deduplicate.hpp"
 #include "orderPairs.hpp"
+#include "ReadGraphBfs.hpp"
 using namespace shasta;
 
 // Boost libraries.
@@ -177,6 +178,9 @@ void ReadGraph::findNeighbors(
 
 // Find neighbors to specified maximum distance.
 // The neighbors are returned sorted and do not include orientedReadId0.
+// This is used for a single oriented read, so it uses a map
+// instead of a ReadGraphBfs, which would allocate
+// a table with an entry for each oriented read.
 void ReadGraph::findNeighbors(
     OrientedReadId orientedReadId,
     uint64_t maxDistance,
@@ -228,6 +232,21 @@ void ReadGraph::findNeighbors(
 
 
 
+// Same as above, but using a BFS engine provided by the caller.
+// This is more efficient when called for many oriented reads.
+void ReadGraph::findNeighbors(
+    OrientedReadId orientedReadId,
+    uint64_t maxDistance,
+    ReadGraphBfs& bfs,
+    vector<OrientedReadId>& neighbors) const
+{
+    bfs.run(orientedReadId, maxDistance);
+    neighbors.assign(bfs.vertices.begin() + 1, bfs.vertices.end());
+    sort(neighbors.begin(), neighbors.end());
+}
+
+
+
 // Find "bridges" from the read graph.
 // Takes as input a vector<bool> that says, for each alignmentId,
 // whether that alignment is used in the read graph.
@@ -247,6 +266,10 @@ void ReadGraph::findBridges(vector<bool>& keepAlignment, uint64_t maxDistance)
     vector<uint64_t> rank;
     vector<uint64_t> parent;
 
+    // The BFS engine used to find neighbors.
+    // This does not skip cross-strand edges.
+    ReadGraphBfs bfs(*this, false);
+
     // Loop over reads. We only consider vertices corresponding
     // reads on strand 0, then for each edge to be removed
     // also flag its reverse complement.
@@ -258,7 +281,7 @@ void ReadGraph::findBridges(vector<bool>& keepAlignment, uint64_t maxDistance)
         // cout << "Working on " << orientedReadId0 << endl;
 
         // Find neighbors within the specified distance.
-        findNeighbors(orientedReadId0, maxDistance, neighbors);
+        findNeighbors(orientedReadId0, maxDistance, bfs, neighbors);
         const uint64_t n = neighbors.size();
         if(n == 0) {
             continue;
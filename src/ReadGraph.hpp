@@ -28,6 +28,7 @@ but read-only form using MemoryMapped data structures.
 
 namespace shasta {
     class ReadGraph;
+    class ReadGraphBfs;
     class ReadGraphEdge;
 }
 
@@ -113,6 +114,7 @@ public:
 
     void findNeighbors(OrientedReadId, vector<OrientedReadId>&) const;
     void findNeighbors(OrientedReadId, uint64_t maxDistance, vector<OrientedReadId>&) const;
+    void findNeighbors(OrientedReadId, uint64_t maxDistance, ReadGraphBfs&, vector<OrientedReadId>&) const;
 
     // Find "bridges" from the read graph.
     // Takes as input a vector<bool> that says, for each alignmentId,
@@ -0,0 +1,103 @@
+// Shasta.
+#include "ReadGraphBfs.hpp"
+#include "ReadGraph.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+
+
+ReadGraphBfs::ReadGraphBfs(
+    const ReadGraph& readGraph,
+    bool skipCrossStrandEdges) :
+    readGraph(readGraph),
+    skipCrossStrandEdges(skipCrossStrandEdges),
+    vertexTable(readGraph.connectivity.size(), 0)
+{
+}
+
+
+
+bool ReadGraphBfs::run(
+    OrientedReadId startVertex,
+    uint64_t maxDistance,
+    OrientedReadId stopVertex)
+{
+    // Move the base past the entries written by the previous BFS.
+    // This invalidates all of them.
+    // If this BFS could reach values that don't fit in 32 bits,
+    // clear the table and start again.
+    const uint64_t newBase = uint64_t(base) + vertices.size();
+    if(newBase + vertexTable.size() >= notReached) {
+        fill(vertexTable.begin(), vertexTable.end(), 0);
+        base = 1;
+    } else {
+        base = uint32_t(newBase);
+    }
+    vertices.clear();
+    distances.clear();
+    parentEdges.clear();
+
+    reach(startVertex, 0, std::numeric_limits<uint32_t>::max());
+    if(maxDistance == 0) {
+        return false;
+    }
+
+    // The vertices vector is also used as the BFS queue.
+    for(uint64_t head=0; head<vertices.size(); head++) {
+        const OrientedReadId v0 = vertices[head];
+        const uint32_t distance1 = distances[head] + 1;
+
+        for(const uint32_t edgeId: readGraph.connectivity[v0.getValue()]) {
+            const ReadGraphEdge& edge = readGraph.edges[edgeId];
+            if(skipCrossStrandEdges and edge.crossesStrands) {
+                continue;
+            }
+            const OrientedReadId v1 = edge.getOther(v0);
+            if(wasReached(v1)) {
+                continue;
+            }
+            reach(v1, distance1, edgeId);
+            if(v1 == stopVertex) {
+                return true;
+            }
+        }
+
+        // Vertices are reached in order of increasing distance,
+        // so if this one is at maxDistance-1 we are done
+        // when all vertices at that distance have been processed.
+        if(head+1 < vertices.size() and distances[head+1] >= maxDistance) {
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+
+void ReadGraphBfs::reach(OrientedReadId v, uint32_t distance, uint32_t parentEdge)
+{
+    vertexTable[v.getValue()] = base + uint32_t(vertices.size());
+    vertices.push_back(v);
+    distances.push_back(distance);
+    parentEdges.push_back(parentEdge);
+}
+
+
+
+void ReadGraphBfs::getPath(OrientedReadId v, vector<uint32_t>& path) const
+{
+    path.clear();
+    uint32_t i = getLocalIndex(v);
+    SHASTA_ASSERT(i != notReached);
+    while(i != 0) {
+        const uint32_t edgeId = parentEdges[i];
+        path.push_back(edgeId);
+        v = readGraph.edges[edgeId].getOther(v);
+        i = getLocalIndex(v);
+    }
+    reverse(path.begin(), path.end());
+}
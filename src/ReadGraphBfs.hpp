@@ -0,0 +1,108 @@
+#ifndef SHASTA_READ_GRAPH_BFS_HPP
+#define SHASTA_READ_GRAPH_BFS_HPP
+
+/*******************************************************************************
+
+Class ReadGraphBfs does bounded breadth-first searches in the read graph.
+It is used by local read graph analyses that do one BFS
+for each oriented read (flagChimericReads, flagCrossStrandReadGraphEdges1,
+findBridges). Each thread creates its own ReadGraphBfs and reuses it
+for all of its searches.
+
+The only work area proportional to the number of oriented reads
+is vertexTable, which uses 4 bytes per oriented read.
+Each BFS is assigned a base value, and the base of the next BFS
+is the base of the previous one plus the number of vertices it reached.
+When a vertex is reached, its table entry is set to base plus its
+local index in the BFS. So a vertex was reached by the current BFS
+if its entry is at least base, and nothing needs to be cleared
+between searches. The table is only cleared when base
+gets too close to 2^32, that is, after about 2^32 vertices
+have been reached in total.
+
+All other information (vertices reached, their distance from the start vertex,
+and the edge used to reach them) is stored in compact vectors
+indexed by local index, which grow to the size of the
+largest BFS done and are then reused.
+The vector of reached vertices also serves as the BFS queue.
+
+*******************************************************************************/
+
+// Shasta.
+#include "ReadId.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include <limits>
+#include "vector.hpp"
+
+namespace shasta {
+    class ReadGraph;
+    class ReadGraphBfs;
+}
+
+
+
+class shasta::ReadGraphBfs {
+public:
+
+    ReadGraphBfs(
+        const ReadGraph&,
+        bool skipCrossStrandEdges);
+
+    // Do a BFS starting at startVertex and stopping at maxDistance.
+    // If stopVertex is specified, the BFS stops as soon as stopVertex is reached
+    // and the return value is true. Otherwise, the return value is false.
+    bool run(
+        OrientedReadId startVertex,
+        uint64_t maxDistance,
+        OrientedReadId stopVertex = OrientedReadId::invalid());
+
+    // The vertices reached by the last BFS, in the order in which they were reached.
+    // The start vertex is first. Indexed by local index.
+    vector<OrientedReadId> vertices;
+
+    // The distance of each reached vertex from the start vertex.
+    // Indexed by local index.
+    vector<uint32_t> distances;
+
+    // The edge id used to reach each vertex. Indexed by local index.
+    // Not meaningful for the start vertex.
+    vector<uint32_t> parentEdges;
+
+    // Return the local index of a vertex in the last BFS,
+    // or notReached if that vertex was not reached.
+    static const uint32_t notReached = std::numeric_limits<uint32_t>::max();
+    uint32_t getLocalIndex(OrientedReadId v) const
+    {
+        const uint32_t entry = vertexTable[v.getValue()];
+        if(entry >= base) {
+            return entry - base;
+        } else {
+            return notReached;
+        }
+    }
+    bool wasReached(OrientedReadId v) const
+    {
+        return getLocalIndex(v) != notReached;
+    }
+
+    // Construct the edge ids of the path from the start vertex
+    // to a vertex reached by the last BFS.
+    void getPath(OrientedReadId, vector<uint32_t>& path) const;
+
+private:
+    const ReadGraph& readGraph;
+    bool skipCrossStrandEdges;
+
+    // Indexed by OrientedReadId::getValue(). See above for details.
+    // Entries are 0 for vertices never reached since the last clear.
+    vector<uint32_t> vertexTable;
+    uint32_t base = 1;
+
+    void reach(OrientedReadId, uint32_t distance, uint32_t parentEdge);
+};
+
+
+
+#endif
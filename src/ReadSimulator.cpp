@@ -0,0 +1,381 @@
+// Shasta.
+#include "ReadSimulator.hpp"
+#include "chrono.hpp"
+#include "SimpleBayesianConsensusCaller.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <cmath>
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include <thread>
+
+
+
+ReadSimulator::ReadSimulator(const Parameters& parameters, size_t threadCount) :
+    MultithreadedObject<ReadSimulator>(*this),
+    parameters(parameters),
+    threadCount(threadCount)
+{
+    if(threadCount == 0) {
+        this->threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Check the parameters.
+    if(parameters.genomeSize == 0) {
+        throw runtime_error("The simulated genome size must be positive.");
+    }
+    if(parameters.repeatLength == 0) {
+        throw runtime_error("The simulated repeat length must be positive.");
+    }
+    if(parameters.repeatFraction < 0. or parameters.repeatFraction > 1.) {
+        throw runtime_error("The simulated repeat fraction must be between 0 and 1.");
+    }
+    if(parameters.repeatFraction > 0. and parameters.repeatFamilyCount == 0) {
+        throw runtime_error("The number of simulated repeat families must be positive.");
+    }
+    if(parameters.coverage <= 0.) {
+        throw runtime_error("The simulated coverage must be positive.");
+    }
+    if(parameters.readLengthMean <= 0. or parameters.readLengthStandardDeviation < 0.) {
+        throw runtime_error("Invalid simulated read length distribution.");
+    }
+    if(parameters.minReadLength > parameters.genomeSize) {
+        throw runtime_error("The simulated minimum read length cannot exceed the genome size.");
+    }
+    for(const double rate: {parameters.repeatDivergence, parameters.heterozygosity,
+        parameters.substitutionRate, parameters.indelRate}) {
+        if(rate < 0. or rate > 1.) {
+            throw runtime_error("Simulated divergence, heterozygosity, and error rates "
+                "must be between 0 and 1.");
+        }
+    }
+}
+
+
+
+void ReadSimulator::run(const string& outputPrefix)
+{
+    const auto t0 = steady_clock::now();
+    std::mt19937_64 randomSource(parameters.seed);
+
+    cout << timestamp << "Creating a simulated genome of " << parameters.genomeSize <<
+        " bases." << endl;
+    createGenome(randomSource);
+    writeHaplotypes(outputPrefix);
+
+    setupErrorModel();
+
+    createReadInfos(randomSource);
+    uint64_t totalBaseCount = 0;
+    vector<uint64_t> readLengths;
+    for(const ReadInfo& readInfo: readInfos) {
+        totalBaseCount += readInfo.length;
+        readLengths.push_back(readInfo.length);
+    }
+    cout << timestamp << "Generating " << readInfos.size() << " reads with " <<
+        totalBaseCount << " bases before errors, coverage " <<
+        double(totalBaseCount) / double(parameters.genomeSize) <<
+        ", using " << threadCount << " threads." << endl;
+
+    // Read N50, before errors.
+    sort(readLengths.begin(), readLengths.end(), std::greater<uint64_t>());
+    uint64_t n50 = 0;
+    uint64_t cumulativeBaseCount = 0;
+    for(const uint64_t length: readLengths) {
+        cumulativeBaseCount += length;
+        if(2 * cumulativeBaseCount >= totalBaseCount) {
+            n50 = length;
+            break;
+        }
+    }
+    cout << "Read N50 before errors is " << n50 << "." << endl;
+
+    // Generate the reads in chunks, in parallel, and write them out.
+    const string fileName = outputPrefix + "-Reads.fasta";
+    ofstream fasta(fileName);
+    if(not fasta) {
+        throw runtime_error("Error opening " + fileName);
+    }
+    const uint64_t chunkSize = 10000;
+    uint64_t outputBaseCount = 0;
+    for(chunkBegin=0; chunkBegin<readInfos.size(); chunkBegin+=chunkSize) {
+        const uint64_t chunkEnd = min(uint64_t(readInfos.size()), chunkBegin + chunkSize);
+        chunkReads.clear();
+        chunkReads.resize(chunkEnd - chunkBegin);
+        setupLoadBalancing(chunkReads.size(), 10);
+        runThreads(&ReadSimulator::generateReadsThreadFunction, threadCount);
+
+        for(uint64_t readId=chunkBegin; readId<chunkEnd; readId++) {
+            const ReadInfo& readInfo = readInfos[readId];
+            const string& read = chunkReads[readId - chunkBegin];
+            fasta << ">" << readId <<
+                " haplotype=" << readInfo.haplotype <<
+                " start=" << readInfo.begin <<
+                " length=" << readInfo.length <<
+                " strand=" << (readInfo.isReverseComplemented ? '-' : '+') << "\n" <<
+                read << "\n";
+            outputBaseCount += read.size();
+        }
+    }
+    chunkReads.clear();
+    chunkReads.shrink_to_fit();
+
+    const auto t1 = steady_clock::now();
+    cout << timestamp << "Wrote " << readInfos.size() << " reads with " << outputBaseCount <<
+        " bases to " << fileName << " in " << seconds(t1 - t0) << " s." << endl;
+}
+
+
+
+void ReadSimulator::createGenome(std::mt19937_64& randomSource)
+{
+    const char* bases = "ACGT";
+    std::uniform_int_distribution<int> baseDistribution(0, 3);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    const uint64_t repeatLength = parameters.repeatLength;
+
+    // Generate the repeat families.
+    vector<string> repeatFamilies;
+    if(parameters.repeatFraction > 0.) {
+        repeatFamilies.resize(parameters.repeatFamilyCount);
+        for(string& repeatFamily: repeatFamilies) {
+            repeatFamily.resize(repeatLength);
+            for(char& c: repeatFamily) {
+                c = bases[baseDistribution(randomSource)];
+            }
+        }
+    }
+    std::uniform_int_distribution<uint64_t> familyDistribution(
+        0, max(uint64_t(1), uint64_t(repeatFamilies.size())) - 1);
+
+    // Generate the first haplotype, one segment at a time.
+    haplotypes.resize(1);
+    string& haplotype0 = haplotypes.front();
+    haplotype0.reserve(parameters.genomeSize + repeatLength);
+    while(haplotype0.size() < parameters.genomeSize) {
+        if(uniform(randomSource) < parameters.repeatFraction) {
+            string copy = repeatFamilies[familyDistribution(randomSource)];
+            if(uniform(randomSource) < 0.5) {
+                copy = reverseComplement(copy);
+            }
+            for(char& c: copy) {
+                if(uniform(randomSource) < parameters.repeatDivergence) {
+                    c = bases[(Base::fromCharacter(c).value + 1 + baseDistribution(randomSource) % 3) % 4];
+                }
+            }
+            haplotype0 += copy;
+        } else {
+            for(uint64_t i=0; i<repeatLength; i++) {
+                haplotype0.push_back(bases[baseDistribution(randomSource)]);
+            }
+        }
+    }
+    haplotype0.resize(parameters.genomeSize);
+
+    // Generate the second haplotype, if necessary.
+    if(parameters.heterozygosity > 0.) {
+        haplotypes.push_back(haplotype0);
+        for(char& c: haplotypes.back()) {
+            if(uniform(randomSource) < parameters.heterozygosity) {
+                c = bases[(Base::fromCharacter(c).value + 1 + baseDistribution(randomSource) % 3) % 4];
+            }
+        }
+    }
+}
+
+
+
+void ReadSimulator::writeHaplotypes(const string& outputPrefix) const
+{
+    for(uint64_t i=0; i<haplotypes.size(); i++) {
+        const string fileName = outputPrefix + "-Haplotype" + to_string(i) + ".fasta";
+        ofstream fasta(fileName);
+        if(not fasta) {
+            throw runtime_error("Error opening " + fileName);
+        }
+        fasta << ">Haplotype" << i << "\n";
+        const string& haplotype = haplotypes[i];
+        const uint64_t lineLength = 80;
+        for(uint64_t begin=0; begin<haplotype.size(); begin+=lineLength) {
+            fasta.write(haplotype.data() + begin,
+                std::streamsize(min(lineLength, haplotype.size() - begin)));
+            fasta << "\n";
+        }
+        cout << "Wrote " << fileName << endl;
+    }
+}
+
+
+
+void ReadSimulator::setupErrorModel()
+{
+    for(auto& v: repeatCountCumulativeDistribution) {
+        v.clear();
+    }
+    if(parameters.errorModel == "none") {
+        cout << "Repeat count errors will not be simulated." << endl;
+        return;
+    }
+
+    // Also accept the syntax used by --Assembly.consensusCaller.
+    string constructorString = parameters.errorModel;
+    const string prefix = "Bayesian:";
+    if(constructorString.compare(0, prefix.size(), prefix) == 0) {
+        constructorString = constructorString.substr(prefix.size());
+    }
+    const SimpleBayesianConsensusCaller consensusCaller(constructorString);
+
+    vector<double> probabilities;
+    for(uint8_t b=0; b<4; b++) {
+        const Base base = Base::fromInteger(b);
+        auto& baseCumulativeDistribution = repeatCountCumulativeDistribution[b];
+        baseCumulativeDistribution.resize(consensusCaller.getMaxTrueRepeatCount() + 1);
+        for(uint16_t n=1; n<=consensusCaller.getMaxTrueRepeatCount(); n++) {
+            consensusCaller.getObservedRepeatCountDistribution(base, n, probabilities);
+            vector<double>& cumulativeDistribution = baseCumulativeDistribution[n];
+            cumulativeDistribution.resize(probabilities.size());
+            double sum = 0.;
+            for(uint64_t m=0; m<probabilities.size(); m++) {
+                sum += probabilities[m];
+                cumulativeDistribution[m] = sum;
+            }
+            cumulativeDistribution.back() = 1.;
+        }
+    }
+    cout << "Repeat count errors will be simulated using consensus caller configuration " <<
+        constructorString << "." << endl;
+}
+
+
+
+void ReadSimulator::createReadInfos(std::mt19937_64& randomSource)
+{
+    // Log-normal distribution with the requested mean and standard deviation.
+    const double mean = parameters.readLengthMean;
+    const double sd = parameters.readLengthStandardDeviation;
+    const double sigma2 = std::log(1. + (sd * sd) / (mean * mean));
+    std::lognormal_distribution<double> lengthDistribution(
+        std::log(mean) - 0.5 * sigma2, std::sqrt(sigma2));
+    std::uniform_int_distribution<uint64_t> haplotypeDistribution(0, haplotypes.size() - 1);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+
+    const uint64_t genomeSize = parameters.genomeSize;
+    const uint64_t targetBaseCount = uint64_t(parameters.coverage * double(genomeSize));
+    uint64_t baseCount = 0;
+    readInfos.clear();
+    while(baseCount < targetBaseCount) {
+        ReadInfo readInfo;
+        readInfo.length = uint64_t(std::llround(lengthDistribution(randomSource)));
+        readInfo.length = min(genomeSize, max(parameters.minReadLength, readInfo.length));
+        readInfo.haplotype = haplotypeDistribution(randomSource);
+        readInfo.begin = std::uniform_int_distribution<uint64_t>(
+            0, genomeSize - readInfo.length)(randomSource);
+        readInfo.isReverseComplemented = uniform(randomSource) < 0.5;
+        readInfos.push_back(readInfo);
+        baseCount += readInfo.length;
+    }
+}
+
+
+
+void ReadSimulator::generateReadsThreadFunction(size_t)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; ++i) {
+            generateRead(chunkBegin + i, chunkReads[i]);
+        }
+    }
+}
+
+
+
+void ReadSimulator::generateRead(uint64_t readId, string& read) const
+{
+    const char* bases = "ACGT";
+    const ReadInfo& readInfo = readInfos[readId];
+
+    // Each read uses its own random source, so the output
+    // does not depend on the number of threads.
+    std::seed_seq seedSequence{parameters.seed, readId};
+    std::mt19937_64 randomSource(seedSequence);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::uniform_int_distribution<int> baseDistribution(0, 3);
+
+    // The true sequence of the read, on its strand.
+    string trueSequence = haplotypes[readInfo.haplotype].substr(readInfo.begin, readInfo.length);
+    if(readInfo.isReverseComplemented) {
+        trueSequence = reverseComplement(trueSequence);
+    }
+
+    // Repeat count errors, using the error model.
+    string sequence;
+    if(repeatCountCumulativeDistribution.front().empty()) {
+        sequence.swap(trueSequence);
+    } else {
+        sequence.reserve(trueSequence.size() + trueSequence.size() / 10);
+        for(uint64_t runBegin=0; runBegin<trueSequence.size(); ) {
+            const char c = trueSequence[runBegin];
+            uint64_t runEnd = runBegin + 1;
+            while(runEnd < trueSequence.size() and trueSequence[runEnd] == c) {
+                ++runEnd;
+            }
+            const uint64_t trueRepeatCount = runEnd - runBegin;
+
+            // Repeat counts longer than covered by the error model
+            // use the distribution for the longest one, shifted.
+            const auto& baseCumulativeDistribution =
+                repeatCountCumulativeDistribution[Base::fromCharacter(c).value];
+            const uint64_t maxRepeatCount = baseCumulativeDistribution.size() - 1;
+            const uint64_t n = min(trueRepeatCount, maxRepeatCount);
+            const vector<double>& cumulativeDistribution = baseCumulativeDistribution[n];
+            const uint64_t m = uint64_t(
+                upper_bound(cumulativeDistribution.begin(), cumulativeDistribution.end(),
+                uniform(randomSource)) - cumulativeDistribution.begin());
+            const uint64_t observedRepeatCount =
+                min(m, uint64_t(cumulativeDistribution.size() - 1)) + (trueRepeatCount - n);
+
+            sequence.append(observedRepeatCount, c);
+            runBegin = runEnd;
+        }
+    }
+
+    // Substitutions and indels.
+    const double substitutionRate = parameters.substitutionRate;
+    const double halfIndelRate = 0.5 * parameters.indelRate;
+    read.clear();
+    read.reserve(sequence.size() + sequence.size() / 10);
+    for(const char c: sequence) {
+        const double u = uniform(randomSource);
+        if(u < halfIndelRate) {
+            // Insertion before this base.
+            read.push_back(bases[baseDistribution(randomSource)]);
+            read.push_back(c);
+        } else if(u < 2. * halfIndelRate) {
+            // Deletion of this base.
+        } else if(u < 2. * halfIndelRate + substitutionRate) {
+            read.push_back(bases[(Base::fromCharacter(c).value + 1 + baseDistribution(randomSource) % 3) % 4]);
+        } else {
+            read.push_back(c);
+        }
+    }
+}
+
+
+
+string ReadSimulator::reverseComplement(const string& s)
+{
+    string t(s.rbegin(), s.rend());
+    for(char& c: t) {
+        switch(c) {
+        case 'A': c = 'T'; break;
+        case 'C': c = 'G'; break;
+        case 'G': c = 'C'; break;
+        case 'T': c = 'A'; break;
+        }
+    }
+    return t;
+}
@@ -0,0 +1,130 @@
+#ifndef SHASTA_READ_SIMULATOR_HPP
+#define SHASTA_READ_SIMULATOR_HPP
+
+/*******************************************************************************
+
+Class ReadSimulator generates synthetic reads from a random genome,
+to be used as input for assemblies of arbitrary size
+(--command simulateReads). It is used to measure scaling of the assembly
+with input size and thread count (see shasta/scripts/RunScalingBenchmark.py).
+It is not meant to be a realistic simulation of any sequencing technology.
+
+The genome is generated as follows:
+- It consists of consecutive segments of length repeatLength.
+  Each segment is a copy of a randomly chosen repeat family with probability
+  repeatFraction, or a random sequence otherwise.
+  There are repeatFamilyCount repeat families, each a random sequence.
+  Each copy of a repeat family is on a random strand and has substitutions
+  at rate repeatDivergence, so copies are similar but not identical.
+- If heterozygosity is not zero, a second haplotype is generated
+  from the first by adding substitutions at that rate.
+
+Reads are generated with log-normal length distribution until the
+total number of bases reaches coverage times genomeSize.
+Each read comes from a random haplotype, start position, and strand.
+
+Errors are added to the read sequence (on the strand of the read) as follows:
+- If an error model is specified, the read is run-length encoded,
+  and the observed repeat count for each run is sampled from the distribution
+  P(m | n, base read) of the SimpleBayesianConsensusCaller configuration
+  with that name (a built-in configuration name or a configuration file).
+  This is the same error model the consensus caller assumes,
+  so it mostly affects homopolymer lengths. An observed repeat count of zero
+  deletes the run.
+- Then each base is substituted with probability substitutionRate,
+  a random base is inserted before it with probability indelRate/2,
+  and it is deleted with probability indelRate/2.
+
+Given the same seed and options, the output does not depend
+on the number of threads.
+
+Output files, for a given output prefix:
+- prefix-Reads.fasta: the simulated reads. The header line of each read
+  contains its haplotype, start position, length, and strand on the genome.
+- prefix-Haplotype0.fasta, prefix-Haplotype1.fasta: the genome
+  (Haplotype1 is only written if heterozygosity is not zero).
+
+*******************************************************************************/
+
+// Shasta.
+#include "Base.hpp"
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "array.hpp"
+#include "cstdint.hpp"
+#include "fstream.hpp"
+#include <random>
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class ReadSimulator;
+}
+
+
+
+class shasta::ReadSimulator :
+    public MultithreadedObject<ReadSimulator> {
+public:
+
+    class Parameters {
+    public:
+        uint64_t genomeSize = 1000000;
+        double repeatFraction = 0.05;
+        uint64_t repeatLength = 5000;
+        uint64_t repeatFamilyCount = 10;
+        double repeatDivergence = 0.01;
+        double heterozygosity = 0.;
+        double coverage = 30.;
+        double readLengthMean = 20000.;
+        double readLengthStandardDeviation = 10000.;
+        uint64_t minReadLength = 1000;
+        string errorModel = "guppy-3.6.0-a";    // Or "none".
+        double substitutionRate = 0.005;
+        double indelRate = 0.005;
+        uint64_t seed = 231;
+    };
+
+    ReadSimulator(const Parameters&, size_t threadCount = 0);
+
+    // Generate the genome and the reads and write them out.
+    void run(const string& outputPrefix);
+
+private:
+    Parameters parameters;
+    size_t threadCount;
+
+    // The haplotypes of the genome, as characters ACGT.
+    vector<string> haplotypes;
+    void createGenome(std::mt19937_64&);
+    void writeHaplotypes(const string& outputPrefix) const;
+
+    // The cumulative distribution of the observed repeat count,
+    // for each base and true repeat count, from the error model.
+    // Empty if no error model is used.
+    array<vector< vector<double> >, 4> repeatCountCumulativeDistribution;
+    void setupErrorModel();
+
+    // Information needed to generate each read.
+    class ReadInfo {
+    public:
+        uint64_t haplotype;
+        uint64_t begin;
+        uint64_t length;
+        bool isReverseComplemented;
+    };
+    vector<ReadInfo> readInfos;
+    void createReadInfos(std::mt19937_64&);
+
+    // Reads are generated in parallel in chunks and written out
+    // after each chunk.
+    uint64_t chunkBegin;
+    vector<string> chunkReads;
+    void generateReadsThreadFunction(size_t threadId);
+    void generateRead(uint64_t readId, string&) const;
+
+    static string reverseComplement(const string&);
+};
+
+#endif
@@ -0,0 +1,362 @@
+// Shasta.
+#include "SharedAssemblyData.hpp"
+#include "chrono.hpp"
+#include "filesystem.hpp"
+#include "MemoryMappedVectorPolicy.hpp"
+#include "performanceLog.hpp"
+#include "SHASTA_ASSERT.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+#include <filesystem>
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include <string.h>
+
+// Linux.
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+
+SharedAssemblyData::SharedAssemblyData(size_t threadCount) :
+    MultithreadedObject<SharedAssemblyData>(*this),
+    threadCount(threadCount)
+{
+    if(this->threadCount == 0) {
+        this->threadCount = std::thread::hardware_concurrency();
+    }
+}
+
+
+
+SharedAssemblyData::~SharedAssemblyData()
+{
+    if(isAttached()) {
+        detach();
+    }
+}
+
+
+
+string SharedAssemblyData::getDirectoryName(const string& sharedDirectoryName)
+{
+    if(sharedDirectoryName.empty()) {
+        throw runtime_error("No shared directory specified.");
+    }
+    if(sharedDirectoryName.find('/') == string::npos) {
+        return "/dev/shm/shasta-" + sharedDirectoryName;
+    } else {
+        return sharedDirectoryName;
+    }
+}
+
+
+
+void SharedAssemblyData::publish(
+    const string& dataDirectoryName,
+    const string& sharedDirectoryName)
+{
+    const auto t0 = steady_clock::now();
+    const string sharedDirectory = getDirectoryName(sharedDirectoryName);
+    if(std::filesystem::exists(sharedDirectory)) {
+        throw runtime_error(sharedDirectory + " already exists. "
+            "Use --command cleanupSharedData to remove it.");
+    }
+    performanceLog << timestamp << "Publishing " << dataDirectoryName <<
+        " to " << sharedDirectory << endl;
+
+    // Create the shared directory and lock it while we copy the data.
+    filesystem::createDirectory(sharedDirectory);
+    filesystem::createDirectory(sharedDirectory + "/Data");
+    filesystem::createDirectory(sharedDirectory + "/References");
+    const int fileDescriptor = lock(sharedDirectory, true);
+
+    // On hugetlbfs, file sizes must be a multiple of the page size.
+    // We cannot change the file sizes because they are stored
+    // in the MemoryMapped::Vector headers.
+    struct statfs filesystemInformation;
+    if(::statfs(sharedDirectory.c_str(), &filesystemInformation) != 0) {
+        ::close(fileDescriptor);
+        throw runtime_error("Error during statfs for " + sharedDirectory + ": " + ::strerror(errno));
+    }
+    const uint64_t hugetlbfsMagic = 0x958458f6;
+    const bool isHugetlbfs = (uint64_t(filesystemInformation.f_type) == hugetlbfsMagic);
+    const uint64_t sharedPageSize = uint64_t(filesystemInformation.f_bsize);
+
+    // Gather the regular files to be copied and create them.
+    vector<string> fileNames = filesystem::directoryContents(dataDirectoryName);
+    sort(fileNames.begin(), fileNames.end());
+    files.clear();
+    chunks.clear();
+    uint64_t totalSize = 0;
+    for(const string& path: fileNames) {
+        struct stat fileInformation;
+        if(::stat(path.c_str(), &fileInformation) != 0) {
+            ::close(fileDescriptor);
+            throw runtime_error("Error during stat for " + path + ": " + ::strerror(errno));
+        }
+        if(not S_ISREG(fileInformation.st_mode)) {
+            cout << "Skipping " << path << " because it is not a regular file." << endl;
+            continue;
+        }
+
+        FileInfo file;
+        file.sourceName = path;
+        file.targetName = sharedDirectory + "/Data/" + path.substr(path.find_last_of('/') + 1);
+        file.fileSize = uint64_t(fileInformation.st_size);
+        if(isHugetlbfs and (file.fileSize % sharedPageSize) != 0) {
+            ::close(fileDescriptor);
+            throw runtime_error("Size of " + path + " is not a multiple of the page size of " +
+                sharedDirectory + ". Only assemblies created with --memoryBacking 2M "
+                "can be published to a hugetlbfs filesystem.");
+        }
+
+        const int targetFileDescriptor = ::open(file.targetName.c_str(),
+            O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if(targetFileDescriptor == -1) {
+            ::close(fileDescriptor);
+            throw runtime_error("Error creating " + file.targetName + ": " + ::strerror(errno));
+        }
+        if(::ftruncate(targetFileDescriptor, off_t(file.fileSize)) == -1) {
+            ::close(targetFileDescriptor);
+            ::close(fileDescriptor);
+            throw runtime_error("Error during ftruncate for " + file.targetName + ": " +
+                ::strerror(errno) + ". Perhaps " + sharedDirectory + " does not have enough space.");
+        }
+        ::close(targetFileDescriptor);
+
+        const uint64_t fileId = files.size();
+        files.push_back(file);
+        totalSize += file.fileSize;
+        for(uint64_t offset=0; offset<file.fileSize; offset+=chunkSize) {
+            chunks.push_back({fileId, offset, min(chunkSize, file.fileSize - offset)});
+        }
+    }
+
+    // Copy the chunks in parallel.
+    try {
+        setupLoadBalancing(chunks.size(), 1);
+        runThreads(&SharedAssemblyData::publishThreadFunction, threadCount);
+    } catch(...) {
+        ::close(fileDescriptor);
+        throw;
+    }
+
+    // Make the published files read-only, then mark the data as published.
+    for(const FileInfo& file: files) {
+        ::chmod(file.targetName.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+    }
+    const int publishedFileDescriptor = ::open((sharedDirectory + "/Published").c_str(),
+        O_CREAT | O_WRONLY, S_IRUSR | S_IRGRP | S_IROTH);
+    if(publishedFileDescriptor == -1) {
+        ::close(fileDescriptor);
+        throw runtime_error("Error creating " + sharedDirectory + "/Published: " + ::strerror(errno));
+    }
+    ::close(publishedFileDescriptor);
+    ::close(fileDescriptor);
+
+    const auto t1 = steady_clock::now();
+    performanceLog << timestamp << "Published " << files.size() << " files, " <<
+        totalSize << " bytes, in " << seconds(t1 - t0) << " s." << endl;
+    cout << "Published " << files.size() << " files, " << totalSize <<
+        " bytes, to " << sharedDirectory << endl;
+    files.clear();
+    chunks.clear();
+}
+
+
+
+void SharedAssemblyData::publishThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t chunkId=begin; chunkId!=end; chunkId++) {
+            const Chunk& chunk = chunks[chunkId];
+            const FileInfo& file = files[chunk.fileId];
+
+            // Chunk offsets are a multiple of chunkSize, which is a multiple
+            // of the page size, so we can map each chunk independently.
+            const int sourceFileDescriptor = ::open(file.sourceName.c_str(), O_RDONLY);
+            if(sourceFileDescriptor == -1) {
+                throw runtime_error("Error opening " + file.sourceName + ": " + ::strerror(errno));
+            }
+            void* source = ::mmap(0, chunk.size, PROT_READ, MAP_SHARED,
+                sourceFileDescriptor, off_t(chunk.offset));
+            ::close(sourceFileDescriptor);
+            if(source == MAP_FAILED) {
+                throw runtime_error("Error mapping " + file.sourceName + ": " + ::strerror(errno));
+            }
+
+            const int targetFileDescriptor = ::open(file.targetName.c_str(), O_RDWR);
+            if(targetFileDescriptor == -1) {
+                ::munmap(source, chunk.size);
+                throw runtime_error("Error opening " + file.targetName + ": " + ::strerror(errno));
+            }
+            void* target = ::mmap(0, chunk.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                targetFileDescriptor, off_t(chunk.offset));
+            ::close(targetFileDescriptor);
+            if(target == MAP_FAILED) {
+                ::munmap(source, chunk.size);
+                throw runtime_error("Error mapping " + file.targetName + ": " + ::strerror(errno));
+            }
+
+            ::memcpy(target, source, chunk.size);
+            ::munmap(target, chunk.size);
+            ::munmap(source, chunk.size);
+        }
+    }
+}
+
+
+
+void SharedAssemblyData::attach(const string& sharedDirectoryName)
+{
+    SHASTA_ASSERT(not isAttached());
+    const string sharedDirectory = getDirectoryName(sharedDirectoryName);
+    if(not std::filesystem::exists(sharedDirectory + "/Published")) {
+        throw runtime_error(sharedDirectory + " does not contain published assembly data. "
+            "Use --command publishSharedData to create it.");
+    }
+
+    lockFileDescriptor = lock(sharedDirectory, false);
+
+    // Cleanup could have removed the data between the check above
+    // and the time we got the lock. Now that we hold the lock,
+    // the Published file can no longer be removed.
+    if(not std::filesystem::exists(sharedDirectory + "/Published")) {
+        ::close(lockFileDescriptor);
+        lockFileDescriptor = -1;
+        throw runtime_error(sharedDirectory + " was removed while attaching to it.");
+    }
+    directoryName = filesystem::getAbsolutePath(sharedDirectory);
+
+    // Register this process. If this fails (for example because the
+    // shared directory belongs to another user), the reference count
+    // will not include this process, but cleanup is still prevented by the lock.
+    referenceFileName = directoryName + "/References/" + to_string(::getpid());
+    const int fileDescriptor = ::open(referenceFileName.c_str(), O_CREAT | O_WRONLY,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fileDescriptor == -1) {
+        cout << "Unable to register in " << directoryName << "/References: " <<
+            ::strerror(errno) << endl;
+        referenceFileName.clear();
+    } else {
+        ::close(fileDescriptor);
+    }
+
+    MemoryMapped::vectorPolicy.sharedReadOnlyDirectories.push_back(directoryName + "/Data");
+    cout << "Attached to shared assembly data in " << directoryName << ". " <<
+        referenceCount(directoryName) << " processes are attached." << endl;
+}
+
+
+
+void SharedAssemblyData::detach()
+{
+    SHASTA_ASSERT(isAttached());
+
+    if(not referenceFileName.empty()) {
+        ::unlink(referenceFileName.c_str());
+        referenceFileName.clear();
+    }
+
+    vector<string>& sharedReadOnlyDirectories =
+        MemoryMapped::vectorPolicy.sharedReadOnlyDirectories;
+    auto it = find(sharedReadOnlyDirectories.begin(), sharedReadOnlyDirectories.end(),
+        directoryName + "/Data");
+    if(it != sharedReadOnlyDirectories.end()) {
+        sharedReadOnlyDirectories.erase(it);
+    }
+
+    // Closing the file descriptor releases the lock.
+    ::close(lockFileDescriptor);
+    lockFileDescriptor = -1;
+    directoryName.clear();
+}
+
+
+
+string SharedAssemblyData::largeDataFileNamePrefix() const
+{
+    SHASTA_ASSERT(isAttached());
+    return directoryName + "/Data/";
+}
+
+
+
+// Count the References entries of processes that still exist.
+// Entries of processes that no longer exist are removed.
+uint64_t SharedAssemblyData::referenceCount(const string& sharedDirectoryName)
+{
+    const string sharedDirectory = getDirectoryName(sharedDirectoryName);
+    uint64_t count = 0;
+    for(const string& path: filesystem::directoryContents(sharedDirectory + "/References")) {
+        const string name = path.substr(path.find_last_of('/') + 1);
+        const pid_t pid = pid_t(std::stol(name));
+        if(::kill(pid, 0) == 0 or errno == EPERM) {
+            ++count;
+        } else {
+            ::unlink(path.c_str());
+        }
+    }
+    return count;
+}
+
+
+
+void SharedAssemblyData::cleanup(const string& sharedDirectoryName)
+{
+    const string sharedDirectory = getDirectoryName(sharedDirectoryName);
+    if(not std::filesystem::exists(sharedDirectory + "/Lock")) {
+        throw runtime_error(sharedDirectory + " is not a shared assembly data directory.");
+    }
+
+    // This throws if any process is attached.
+    const int fileDescriptor = lock(sharedDirectory, true);
+
+    // Remove the Published file first, so no process can attach
+    // after we release the lock.
+    std::filesystem::remove(sharedDirectory + "/Published");
+    std::filesystem::remove_all(sharedDirectory + "/Data");
+    std::filesystem::remove_all(sharedDirectory + "/References");
+    ::close(fileDescriptor);
+    std::filesystem::remove_all(sharedDirectory);
+    cout << "Removed " << sharedDirectory << endl;
+}
+
+
+
+int SharedAssemblyData::lock(const string& directoryName, bool exclusive)
+{
+    const string lockFileName = directoryName + "/Lock";
+    const int fileDescriptor = ::open(lockFileName.c_str(), O_CREAT | O_RDONLY,
+        S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + lockFileName + ": " + ::strerror(errno));
+    }
+    if(::flock(fileDescriptor, (exclusive ? LOCK_EX : LOCK_SH) | LOCK_NB) == -1) {
+        const int errorNumber = errno;
+        ::close(fileDescriptor);
+        if(errorNumber == EWOULDBLOCK) {
+            if(exclusive) {
+                throw runtime_error(directoryName + " is in use by " +
+                    to_string(referenceCount(directoryName)) + " processes.");
+            } else {
+                throw runtime_error(directoryName + " is being published or removed.");
+            }
+        } else {
+            throw runtime_error("Error locking " + lockFileName + ": " + ::strerror(errorNumber));
+        }
+    }
+    return fileDescriptor;
+}
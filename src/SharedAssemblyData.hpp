@@ -0,0 +1,123 @@
+#ifndef SHASTA_SHARED_ASSEMBLY_DATA_HPP
+#define SHASTA_SHARED_ASSEMBLY_DATA_HPP
+
+/*******************************************************************************
+
+Class SharedAssemblyData allows many processes (--command explore
+or Python scripts) to use the binary data of a single assembly
+without each of them having its own copy in memory.
+
+The binary data are published once, by copying them from the
+Data directory of the assembly to a shared directory which should be on
+a memory based filesystem: a tmpfs filesystem such as /dev/shm
+(shared memory with 4 KB pages), or a hugetlbfs filesystem
+(2 MB pages, requires the assembly to use --memoryBacking 2M).
+Processes that attach to the shared directory map the published files
+read-only with MAP_SHARED, so all of them use the same physical pages.
+While a process is attached, MemoryMapped::Vector never opens the
+published files for write, and refuses to create, remove, or rename files
+in the shared directory (see MemoryMapped::VectorPolicy).
+Binary data that an attached process builds for itself
+(for example the Mode 3 assembly graph, if it was not published)
+are anonymous, so they are private to that process.
+The published data remain available after the publishing process exits,
+until they are removed by cleanup.
+
+A shared directory contains:
+- Data: the published binary data, with read-only file permissions.
+- Published: created after all binary data have been copied.
+  Attach fails if it does not exist.
+- Lock: each attached process holds a shared flock on it.
+  Publish and cleanup hold an exclusive flock, so cleanup
+  fails if any process is attached, even if it terminated abnormally
+  without detaching (flocks are released by the kernel on process exit).
+- References: contains an empty file for each attached process,
+  named using its process id. It is used to report the number
+  of attached processes. Files for processes that no longer
+  exist are ignored and removed.
+
+A shared directory can be specified as a full path or as a name
+that does not contain a slash. A name is interpreted as
+/dev/shm/shasta-name.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MultithreadedObject.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class SharedAssemblyData;
+}
+
+
+
+class shasta::SharedAssemblyData :
+    public MultithreadedObject<SharedAssemblyData> {
+public:
+
+    SharedAssemblyData(size_t threadCount = 0);
+    ~SharedAssemblyData();
+
+    // Publish all regular files in a directory to a new shared directory.
+    void publish(const string& dataDirectoryName, const string& sharedDirectoryName);
+
+    // Attach to or detach from a shared directory.
+    // The destructor detaches if necessary.
+    void attach(const string& sharedDirectoryName);
+    void detach();
+    bool isAttached() const
+    {
+        return lockFileDescriptor != -1;
+    }
+
+    // The largeDataFileNamePrefix to be passed to the Assembler constructor
+    // to use the data in the attached shared directory.
+    string largeDataFileNamePrefix() const;
+
+    // Return the number of processes attached to a shared directory.
+    static uint64_t referenceCount(const string& sharedDirectoryName);
+
+    // Remove a shared directory. Throws if any process is attached to it.
+    static void cleanup(const string& sharedDirectoryName);
+
+    // Return the shared directory corresponding to a name or path.
+    static string getDirectoryName(const string& sharedDirectoryName);
+
+    // Size of the chunks that are copied by each thread during publish.
+    static const uint64_t chunkSize = 64ULL * 1024ULL * 1024ULL;
+
+private:
+    size_t threadCount;
+
+    // The attached shared directory and the file descriptor of its lock.
+    string directoryName;
+    int lockFileDescriptor = -1;
+    string referenceFileName;
+
+    // Data used by publish.
+    class FileInfo {
+    public:
+        string sourceName;
+        string targetName;
+        uint64_t fileSize;
+    };
+    vector<FileInfo> files;
+    class Chunk {
+    public:
+        uint64_t fileId;
+        uint64_t offset;
+        uint64_t size;
+    };
+    vector<Chunk> chunks;
+    void publishThreadFunction(size_t threadId);
+
+    // Open the lock file of a shared directory and lock it, or throw.
+    static int lock(const string& directoryName, bool exclusive);
+};
+
+#endif
@@ -319,6 +319,28 @@ void SimpleBayesianConsensusCaller::printLogLikelihoodVector(vector<double>& log
 }
 
 
+void SimpleBayesianConsensusCaller::getObservedRepeatCountDistribution(
+    Base base,
+    uint16_t trueRepeatCount,
+    vector<double>& probabilities) const
+{
+    SHASTA_ASSERT(trueRepeatCount <= maxOutputRunlength);
+    const vector<double>& logProbabilities = probabilityMatrices[base.value][trueRepeatCount];
+
+    // Convert from log10 and normalize, so the probabilities add up to 1
+    // even if the configuration is not exactly normalized.
+    probabilities.resize(logProbabilities.size());
+    double sum = 0.;
+    for(uint64_t m=0; m<logProbabilities.size(); m++) {
+        probabilities[m] = pow(10., logProbabilities[m]);
+        sum += probabilities[m];
+    }
+    for(double& p: probabilities) {
+        p /= sum;
+    }
+}
+
+
 void SimpleBayesianConsensusCaller::normalizeLikelihoods(vector<double>& x, double xMax) const{
     for (uint32_t i=0; i<x.size(); i++){
         x[i] = x[i]-xMax;
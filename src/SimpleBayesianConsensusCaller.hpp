@@ -68,6 +68,17 @@ public:
 
     static bool isBuiltIn(const string&);
 
+    // Get the probability distribution of the observed repeat count, P(m | n, base read),
+    // for a given true repeat count n, as stored in the configuration.
+    // On return, probabilities[m] is the probability of observing repeat count m.
+    // This is used by the ReadSimulator to generate reads with a matching error model.
+    void getObservedRepeatCountDistribution(
+        Base, uint16_t trueRepeatCount, vector<double>& probabilities) const;
+    uint16_t getMaxTrueRepeatCount() const
+    {
+        return maxOutputRunlength;
+    }
+
     static const std::set<string> builtIns;
 
 private:
@@ -3,10 +3,13 @@
 #include "mode3.hpp"
 #include "findMarkerId.hpp"
 #include "MarkerGraph.hpp"
+#include "MurmurHash2.hpp"
 #include "orderPairs.hpp"
+#include "performanceLog.hpp"
 #include "shastaLapack.hpp"
 #include "ReadFlags.hpp"
 #include "SubsetGraph.hpp"
+#include "timestamp.hpp"
 using namespace shasta;
 using namespace mode3;
 
@@ -19,121 +22,101 @@ using namespace mode3;
 #include <boost/graph/strong_components.hpp>
 
 // Standard library.
-
+#include "chrono.hpp"
 #include <bitset>
 #include <map>
 #include <queue>
+#include <random>
 #include <set>
 #include <unordered_set>
 
 
 
 // Each  linear chain of marker graph edges generates a segment.
-void AssemblyGraph::createSegmentPaths()
+// A marker graph vertex is linear if it has exactly one
+// incoming edge and one outgoing edge.
+// Each chain that is not circular begins with an edge whose source
+// vertex is not linear. These chains are found in parallel.
+// Circular chains (all vertices linear) are rare and are found afterwards
+// by a sequential loop over the edges that were not yet assigned to a chain.
+// Segment ids are then assigned in order of the lowest marker graph
+// edge id in each chain. This is the order in which chains would be
+// found by a sequential loop over all marker graph edges.
+void AssemblyGraph::createSegmentPaths(size_t threadCount)
 {
     const bool debug = false;
+    CreateSegmentPathsData& data = createSegmentPathsData;
 
     createNew(paths, "Mode3-Paths");
     const MarkerGraph::EdgeId edgeCount = markerGraph.edges.size();
-    vector<bool> wasFound(edgeCount, false);
-
-    using MarkerGraphPath = vector<MarkerGraph::EdgeId>;
-    MarkerGraphPath nextEdges;
-    MarkerGraphPath previousEdges;
-    MarkerGraphPath path;
-    MarkerGraphPath reverseComplementedPath;
-
-    // Main loop over all edges of the marker graph.
-    // At each iteration we find a new linear path of edges.
+    data.wasFound.clear();
+    data.wasFound.resize((edgeCount + 63) / 64, 0);
+    data.threadPathEdges.clear();
+    data.threadPathEdges.resize(threadCount + 1);
+    data.threadPathInfos.clear();
+    data.threadPathInfos.resize(threadCount + 1);
+
+    // Find the chains that are not circular.
+    const uint64_t batchSize = 10000;
+    setupLoadBalancing(edgeCount, batchSize);
+    runThreads(&AssemblyGraph::createSegmentPathsThreadFunction1, threadCount);
+
+    // Find the circular chains.
+    vector<MarkerGraphEdgeId>& circularPathEdges = data.threadPathEdges[threadCount];
+    vector<CreateSegmentPathsData::PathInfo>& circularPathInfos = data.threadPathInfos[threadCount];
+    vector<MarkerGraphEdgeId> path;
     for(MarkerGraph::EdgeId startEdgeId=0; startEdgeId<edgeCount; startEdgeId++) {
-
-        // If we already found this edge, skip it.
-        // It is part of a path we already found.
-        if(wasFound[startEdgeId]) {
+        if((data.wasFound[startEdgeId >> 6] >> (startEdgeId & 63)) & 1) {
             continue;
         }
+        MarkerGraphEdgeId minEdgeId;
+        followSegmentPath(startEdgeId, path, minEdgeId);
+        SHASTA_ASSERT(minEdgeId == startEdgeId);
 
-        if(debug) {
-            cout << "Starting a new path at edge " << startEdgeId << endl;
-        }
-
-        // Follow the path forward.
-        nextEdges.clear();
-        MarkerGraph::EdgeId edgeId = startEdgeId;
-        bool isCircular = false;
-        while(true) {
-            const MarkerGraph::Edge edge = markerGraph.edges[edgeId];
-            const MarkerGraph::VertexId v1 = edge.target;
-            const auto outEdges = markerGraph.edgesBySource[v1];
-            if(outEdges.size() != 1) {
-                break;
-            }
-            const auto inEdges = markerGraph.edgesByTarget[v1];
-            if(inEdges.size() != 1) {
-                break;
-            }
-            edgeId = outEdges[0];
-            if(edgeId == startEdgeId) {
-                isCircular = true;
-                break;
-            }
-            nextEdges.push_back(edgeId);
-            SHASTA_ASSERT(not wasFound[edgeId]);
-            if(debug) {
-                cout << "Moving forward: added " << edgeId << endl;
-            }
-        }
+        CreateSegmentPathsData::PathInfo pathInfo;
+        pathInfo.minEdgeId = minEdgeId;
+        pathInfo.threadId = threadCount;
+        pathInfo.begin = circularPathEdges.size();
+        pathInfo.size = path.size();
+        circularPathInfos.push_back(pathInfo);
+        copy(path.begin(), path.end(), back_inserter(circularPathEdges));
 
-        // Follow the path backward.
-        previousEdges.clear();
-        if(!isCircular) {
-            edgeId = startEdgeId;
-            while(true) {
-                const MarkerGraph::Edge edge = markerGraph.edges[edgeId];
-                const MarkerGraph::VertexId v0 = edge.source;
-                const auto outEdges = markerGraph.edgesBySource[v0];
-                if(outEdges.size() != 1) {
-                    break;
-                }
-                const auto inEdges = markerGraph.edgesByTarget[v0];
-                if(inEdges.size() != 1) {
-                    break;
-                }
-                edgeId = inEdges[0];
-                previousEdges.push_back(edgeId);
-                SHASTA_ASSERT(not wasFound[edgeId]);
-                if(debug) {
-                    cout << "Moving backward: added " << edgeId << endl;
-                }
-            }
+        for(const MarkerGraphEdgeId edgeId: path) {
+            data.wasFound[edgeId >> 6] |= (1ULL << (edgeId & 63));
         }
+    }
 
-        // Gather the path.
-        path.clear();
-        copy(previousEdges.rbegin(), previousEdges.rend(), back_inserter(path));
-        path.push_back(startEdgeId);
-        copy(nextEdges.begin(), nextEdges.end(), back_inserter(path));
+    // Check that all edges of the marker graph were found.
+    for(MarkerGraph::EdgeId edgeId=0; edgeId<edgeCount; edgeId++) {
+        SHASTA_ASSERT((data.wasFound[edgeId >> 6] >> (edgeId & 63)) & 1);
+    }
+    data.wasFound.clear();
+    data.wasFound.shrink_to_fit();
 
-        // Mark all the edges in the path as found.
-        for(const MarkerGraph::EdgeId edgeId: path) {
-            if(wasFound[edgeId]) {
-                cout << "Assertion failed at " << edgeId << endl;
-                SHASTA_ASSERT(0);
-            }
-            wasFound[edgeId] = true;
-        }
 
-        // Store this path as a new segment.
-        paths.appendVector();
-        for(const MarkerGraphEdgeId edgeId: path) {
-            paths.append(edgeId);
-        }
-    }
 
+    // Assign segment ids.
+    data.pathInfos.clear();
+    for(const auto& threadPathInfos: data.threadPathInfos) {
+        copy(threadPathInfos.begin(), threadPathInfos.end(), back_inserter(data.pathInfos));
+    }
+    data.threadPathInfos.clear();
+    sort(data.pathInfos.begin(), data.pathInfos.end());
+    const uint64_t segmentCount = data.pathInfos.size();
 
+    // Store the paths.
+    paths.beginPass1(segmentCount);
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        paths.incrementCount(segmentId, data.pathInfos[segmentId].size);
+    }
+    paths.beginPass2();
+    paths.endPass2(false);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::createSegmentPathsThreadFunction2, threadCount);
+    data.threadPathEdges.clear();
+    data.pathInfos.clear();
+    data.pathInfos.shrink_to_fit();
 
-    // Check that all edges of the marker graph were found.
-    SHASTA_ASSERT(find(wasFound.begin(), wasFound.end(), false) == wasFound.end());
 
 
     // Debug output: write the paths.
@@ -152,36 +135,121 @@ void AssemblyGraph::createSegmentPaths()
 
 
 
-// Compute coverage for all segments.
-// It is computed as average marker graph edge coverage
-// over the marker graph edges in the path of each segment.
-void AssemblyGraph::computeSegmentCoverage()
+// Find the chains that are not circular.
+void AssemblyGraph::createSegmentPathsThreadFunction1(size_t threadId)
 {
-    // Initialize segmentCoverage.
-    createNew(segmentCoverage, "Mode3-SegmentCoverage");
-    const uint64_t segmentCount = paths.size();
-    segmentCoverage.resize(segmentCount);
+    CreateSegmentPathsData& data = createSegmentPathsData;
+    uint64_t* wasFound = data.wasFound.data();
+    vector<MarkerGraphEdgeId>& threadPathEdges = data.threadPathEdges[threadId];
+    vector<CreateSegmentPathsData::PathInfo>& threadPathInfos = data.threadPathInfos[threadId];
+    vector<MarkerGraphEdgeId> path;
 
-    // Loop over all segments.
-    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(MarkerGraph::EdgeId startEdgeId=begin; startEdgeId!=end; startEdgeId++) {
 
-        // Access the marker graph path for this segment.
-        const span<MarkerGraphEdgeId> path = paths[segmentId];
+            // If the source vertex of this edge is linear,
+            // this edge is not at the beginning of a chain.
+            if(isLinearMarkerGraphVertex(markerGraph.edges[startEdgeId].source)) {
+                continue;
+            }
 
+            // Follow the chain that starts here.
+            MarkerGraphEdgeId minEdgeId;
+            followSegmentPath(startEdgeId, path, minEdgeId);
 
-        // Loop over this path.
-        uint64_t coverageSum = 0.;
-        for(uint64_t position=0; position<path.size(); position++) {
-            MarkerGraphEdgeId& edgeId = path[position];
+            CreateSegmentPathsData::PathInfo pathInfo;
+            pathInfo.minEdgeId = minEdgeId;
+            pathInfo.threadId = threadId;
+            pathInfo.begin = threadPathEdges.size();
+            pathInfo.size = path.size();
+            threadPathInfos.push_back(pathInfo);
+            copy(path.begin(), path.end(), back_inserter(threadPathEdges));
 
-            // Add the marker intervals on this marker graph edge.
-            const span<const MarkerInterval> markerIntervals = markerGraph.edgeMarkerIntervals[edgeId];
-            coverageSum += markerIntervals.size();
+            // Mark all the edges in the path as found.
+            for(const MarkerGraphEdgeId edgeId: path) {
+                const uint64_t mask = 1ULL << (edgeId & 63);
+                const uint64_t oldWord = __sync_fetch_and_or(wasFound + (edgeId >> 6), mask);
+                if(oldWord & mask) {
+                    cout << "Assertion failed at " << edgeId << endl;
+                    SHASTA_ASSERT(0);
+                }
+            }
         }
+    }
+}
+
+
+
+// Copy the paths to their final location.
+void AssemblyGraph::createSegmentPathsThreadFunction2(size_t threadId)
+{
+    const CreateSegmentPathsData& data = createSegmentPathsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t segmentId=begin; segmentId!=end; segmentId++) {
+            const CreateSegmentPathsData::PathInfo& pathInfo = data.pathInfos[segmentId];
+            const auto pathBegin = data.threadPathEdges[pathInfo.threadId].begin() + pathInfo.begin;
+            copy(pathBegin, pathBegin + pathInfo.size, paths.begin(segmentId));
+        }
+    }
+}
 
-        segmentCoverage[segmentId] = float(coverageSum) / float(path.size());
 
+
+bool AssemblyGraph::isLinearMarkerGraphVertex(MarkerGraphVertexId vertexId) const
+{
+    return
+        (markerGraph.edgesBySource.size(vertexId) == 1) and
+        (markerGraph.edgesByTarget.size(vertexId) == 1);
+}
+
+
+
+// Follow a chain forward, starting at a given edge, until we reach
+// a vertex that is not linear or we get back to the start edge.
+// Also return the lowest edge id in the chain.
+void AssemblyGraph::followSegmentPath(
+    MarkerGraphEdgeId startEdgeId,
+    vector<MarkerGraphEdgeId>& path,
+    MarkerGraphEdgeId& minEdgeId) const
+{
+    path.clear();
+    path.push_back(startEdgeId);
+    minEdgeId = startEdgeId;
+
+    MarkerGraph::EdgeId edgeId = startEdgeId;
+    while(true) {
+        const MarkerGraph::VertexId v1 = markerGraph.edges[edgeId].target;
+        if(not isLinearMarkerGraphVertex(v1)) {
+            break;
+        }
+        edgeId = markerGraph.edgesBySource[v1][0];
+        if(edgeId == startEdgeId) {
+            break;
+        }
+        path.push_back(edgeId);
+        minEdgeId = min(minEdgeId, edgeId);
     }
+}
+
+
+
+// Compute coverage for all segments.
+// It is computed as average marker graph edge coverage
+// over the marker graph edges in the path of each segment.
+void AssemblyGraph::computeSegmentCoverage(size_t threadCount)
+{
+    // Initialize segmentCoverage.
+    createNew(segmentCoverage, "Mode3-SegmentCoverage");
+    const uint64_t segmentCount = paths.size();
+    segmentCoverage.resize(segmentCount);
+
+    // Compute coverage for all segments.
+    const uint64_t batchSize = 1000;
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::computeSegmentCoverageThreadFunction, threadCount);
 
 
     // Write a histogram of segment coverage.
@@ -202,6 +270,34 @@ void AssemblyGraph::computeSegmentCoverage()
 
 
 
+void AssemblyGraph::computeSegmentCoverageThreadFunction(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over all segments assigned to this batch.
+        for(uint64_t segmentId=begin; segmentId!=end; segmentId++) {
+
+            // Access the marker graph path for this segment.
+            const span<MarkerGraphEdgeId> path = paths[segmentId];
+
+            // Loop over this path.
+            uint64_t coverageSum = 0.;
+            for(uint64_t position=0; position<path.size(); position++) {
+                MarkerGraphEdgeId& edgeId = path[position];
+
+                // Add the marker intervals on this marker graph edge.
+                const span<const MarkerInterval> markerIntervals = markerGraph.edgeMarkerIntervals[edgeId];
+                coverageSum += markerIntervals.size();
+            }
+
+            segmentCoverage[segmentId] = float(coverageSum) / float(path.size());
+        }
+    }
+}
+
+
+
 // For each marker graph edge, store in the marker graph edge table
 // the corresponding (segment)
 // and position in the path, if any.
@@ -359,28 +455,24 @@ void AssemblyGraph::sortPseudoPaths(size_t threadId)
 // For each entry, we also store the average offset
 // of the beginning of the oriented read relative
 // to the beginning of the segment, in markers.
-void AssemblyGraph::computeCompressedPseudoPaths()
+void AssemblyGraph::computeCompressedPseudoPaths(size_t threadCount)
 {
     const bool debug = true;
 
     // Initialize the compressed pseudopaths.
     createNew(compressedPseudoPaths, "Mode3-CompressedPseudoPaths");
 
-    // Work vector defined outside the loop to reduce memory allocation overhead.
-    vector<CompressedPseudoPathEntry> compressedPseudoPath;
-
-    // Loop over all oriented reads.
-    for(uint64_t i=0; i<pseudoPaths.size(); i++) {
-
-        // Access the pseudopath for this oriented read.
-        const span<PseudoPathEntry> pseudoPath = pseudoPaths[i];
-
-        // Compute the compressed pseudopath.
-        computeCompressedPseudoPath(pseudoPath, compressedPseudoPath);
-
-        // Store it.
-        compressedPseudoPaths.appendVector(compressedPseudoPath);
-    }
+    // In pass 1 we count the entries of each compressed pseudopath.
+    // In pass 2 we compute them again and store them directly
+    // in their final location.
+    const uint64_t batchSize = 1000;
+    compressedPseudoPaths.beginPass1(pseudoPaths.size());
+    setupLoadBalancing(pseudoPaths.size(), batchSize);
+    runThreads(&AssemblyGraph::computeCompressedPseudoPathsPass1, threadCount);
+    compressedPseudoPaths.beginPass2();
+    compressedPseudoPaths.endPass2(false);
+    setupLoadBalancing(pseudoPaths.size(), batchSize);
+    runThreads(&AssemblyGraph::computeCompressedPseudoPathsPass2, threadCount);
 
 
 
@@ -437,6 +529,52 @@ void AssemblyGraph::computeCompressedPseudoPaths()
 
 
 
+void AssemblyGraph::computeCompressedPseudoPathsPass1(size_t threadId)
+{
+    computeCompressedPseudoPathsPass12(1);
+}
+
+
+
+void AssemblyGraph::computeCompressedPseudoPathsPass2(size_t threadId)
+{
+    computeCompressedPseudoPathsPass12(2);
+}
+
+
+
+void AssemblyGraph::computeCompressedPseudoPathsPass12(uint64_t pass)
+{
+    // Work vector defined outside the loop to reduce memory allocation overhead.
+    vector<CompressedPseudoPathEntry> compressedPseudoPath;
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+
+            // Access the pseudopath for this oriented read.
+            const span<PseudoPathEntry> pseudoPath = pseudoPaths[i];
+
+            // Compute the compressed pseudopath.
+            computeCompressedPseudoPath(pseudoPath, compressedPseudoPath);
+
+            // Store it.
+            if(pass == 1) {
+                compressedPseudoPaths.incrementCount(i, compressedPseudoPath.size());
+            } else {
+                SHASTA_ASSERT(compressedPseudoPaths.size(i) == compressedPseudoPath.size());
+                copy(compressedPseudoPath.begin(), compressedPseudoPath.end(),
+                    compressedPseudoPaths.begin(i));
+            }
+        }
+    }
+}
+
+
+
 void AssemblyGraph::computeCompressedPseudoPath(
     const span<PseudoPathEntry> pseudoPath,
     vector<CompressedPseudoPathEntry>& compressedPseudoPath)
@@ -469,91 +607,224 @@ void AssemblyGraph::computeCompressedPseudoPath(
 
 
 
-void AssemblyGraph::computeSegmentCompressedPseudoPathInfo()
+void AssemblyGraph::computeSegmentCompressedPseudoPathInfo(size_t threadCount)
 {
     const bool debug = true;
 
     const uint64_t segmentCount = paths.size();
-    const uint64_t readCount = compressedPseudoPaths.size()/2;
 
     createNew(segmentCompressedPseudoPathInfo, "Mode3-SegmentCompressedPseudoPathInfo");
 
-    // Pass 1.
+    uint64_t batchSize = 1000;
     segmentCompressedPseudoPathInfo.beginPass1(segmentCount);
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto compressedPseudoPath = compressedPseudoPaths[orientedReadId.getValue()];
+    setupLoadBalancing(compressedPseudoPaths.size(), batchSize);
+    runThreads(&AssemblyGraph::computeSegmentCompressedPseudoPathInfoPass1, threadCount);
+    segmentCompressedPseudoPathInfo.beginPass2();
+    setupLoadBalancing(compressedPseudoPaths.size(), batchSize);
+    runThreads(&AssemblyGraph::computeSegmentCompressedPseudoPathInfoPass2, threadCount);
+    segmentCompressedPseudoPathInfo.endPass2();
 
-            for(uint64_t position=0; position<compressedPseudoPath.size(); position++) {
-                const CompressedPseudoPathEntry& compressedPseudoPathEntry =
-                    compressedPseudoPath[position];
-                const uint64_t segmentId = compressedPseudoPathEntry.segmentId;
-                segmentCompressedPseudoPathInfo.incrementCount(segmentId);
+    // Sort.
+    batchSize = 100;
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::sortSegmentCompressedPseudoPathInfo, threadCount);
+
+
+    if(debug) {
+        ofstream csv("SegmentCompressedPseudoPathInfo.csv");
+        csv << "SegmentId,OrientedReadId,Position in compressed pseudopath\n";
+        for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+            const auto v = segmentCompressedPseudoPathInfo[segmentId];
+            for(const auto& p: v) {
+                csv << segmentId << ",";
+                csv << p.first << ",";
+                csv << p.second << "\n";
             }
         }
     }
+}
+
+
+
+void AssemblyGraph::computeSegmentCompressedPseudoPathInfoPass1(size_t threadId)
+{
+    computeSegmentCompressedPseudoPathInfoPass12(1);
+}
+
+
+
+void AssemblyGraph::computeSegmentCompressedPseudoPathInfoPass2(size_t threadId)
+{
+    computeSegmentCompressedPseudoPathInfoPass12(2);
+}
+
 
-    // Pass 2.
-    segmentCompressedPseudoPathInfo.beginPass2();
-    for(ReadId readId=0; readId<readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto compressedPseudoPath = compressedPseudoPaths[orientedReadId.getValue()];
+
+void AssemblyGraph::computeSegmentCompressedPseudoPathInfoPass12(uint64_t pass)
+{
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+            const OrientedReadId orientedReadId = OrientedReadId::fromValue(ReadId(i));
+            const auto compressedPseudoPath = compressedPseudoPaths[i];
 
             for(uint64_t position=0; position<compressedPseudoPath.size(); position++) {
                 const CompressedPseudoPathEntry& compressedPseudoPathEntry =
                     compressedPseudoPath[position];
                 const uint64_t segmentId = compressedPseudoPathEntry.segmentId;
-                segmentCompressedPseudoPathInfo.store(segmentId, make_pair(orientedReadId, position));
+                if(pass == 1) {
+                    segmentCompressedPseudoPathInfo.incrementCountMultithreaded(segmentId);
+                } else {
+                    segmentCompressedPseudoPathInfo.storeMultithreaded(
+                        segmentId, make_pair(orientedReadId, position));
+                }
             }
         }
     }
-    segmentCompressedPseudoPathInfo.endPass2();
+}
 
-    // Sort.
-    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
-        const auto v = segmentCompressedPseudoPathInfo[segmentId];
-        sort(v.begin(), v.end());
-    }
 
 
-    if(debug) {
-        ofstream csv("SegmentCompressedPseudoPathInfo.csv");
-        csv << "SegmentId,OrientedReadId,Position in compressed pseudopath\n";
-        for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+void AssemblyGraph::sortSegmentCompressedPseudoPathInfo(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over segments assigned to this batch.
+        for(uint64_t segmentId=begin; segmentId!=end; ++segmentId) {
             const auto v = segmentCompressedPseudoPathInfo[segmentId];
-            for(const auto& p: v) {
-                csv << segmentId << ",";
-                csv << p.first << ",";
-                csv << p.second << "\n";
-            }
+            sort(v.begin(), v.end());
         }
     }
 }
 
 
 
-void AssemblyGraph::findTransitions(std::map<SegmentPair, Transitions>& transitionMap)
+// Find pseudopath transitions.
+// Each thread works on its own batches of oriented reads
+// and appends the transitions it finds to its own memory mapped buffer.
+// The transitions are then distributed by segmentId0
+// into transitionsBySegment.
+void AssemblyGraph::findTransitions(size_t threadCount)
 {
-    transitionMap.clear();
+    FindTransitionsData& data = findTransitionsData;
+    data.threadTransitions.clear();
+    data.threadTransitions.resize(threadCount);
+
+    // Each thread stores the transitions it finds in its own buffer.
+    uint64_t batchSize = 1000;
+    setupLoadBalancing(compressedPseudoPaths.size(), batchSize);
+    runThreads(&AssemblyGraph::findTransitionsThreadFunction, threadCount);
+
+    // Find where each thread buffer begins in the concatenation
+    // of all thread buffers.
+    data.threadTransitionsBegin.resize(threadCount + 1);
+    data.threadTransitionsBegin[0] = 0;
+    for(uint64_t threadId=0; threadId<threadCount; threadId++) {
+        data.threadTransitionsBegin[threadId + 1] =
+            data.threadTransitionsBegin[threadId] + data.threadTransitions[threadId]->size();
+    }
+    const uint64_t transitionCount = data.threadTransitionsBegin.back();
+
+    // Distribute the transitions by segmentId0.
+    createNew(transitionsBySegment, "tmp-Mode3-TransitionsBySegment");
+    batchSize = 100000;
+    transitionsBySegment.beginPass1(paths.size());
+    setupLoadBalancing(transitionCount, batchSize);
+    runThreads(&AssemblyGraph::findTransitionsPass1, threadCount);
+    transitionsBySegment.beginPass2();
+    setupLoadBalancing(transitionCount, batchSize);
+    runThreads(&AssemblyGraph::findTransitionsPass2, threadCount);
+    transitionsBySegment.endPass2();
+
+    // Clean up the thread buffers.
+    for(const auto& threadTransitions: data.threadTransitions) {
+        threadTransitions->remove();
+    }
+    data.threadTransitions.clear();
+    data.threadTransitionsBegin.clear();
+}
+
 
-    for(ReadId readId=0; readId<compressedPseudoPaths.size()/2; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto compressedPseudoPath = compressedPseudoPaths[orientedReadId.getValue()];
+
+void AssemblyGraph::findTransitionsThreadFunction(size_t threadId)
+{
+    shared_ptr< MemoryMapped::Vector<TransitionInfo> > threadTransitionsPointer =
+        make_shared< MemoryMapped::Vector<TransitionInfo> >();
+    findTransitionsData.threadTransitions[threadId] = threadTransitionsPointer;
+    MemoryMapped::Vector<TransitionInfo>& threadTransitions = *threadTransitionsPointer;
+    createNew(threadTransitions, "tmp-Mode3-ThreadTransitions-" + to_string(threadId));
+
+    // Loop over all batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t j=begin; j!=end; j++) {
+            const OrientedReadId orientedReadId = OrientedReadId::fromValue(ReadId(j));
+            const auto compressedPseudoPath = compressedPseudoPaths[j];
 
             for(uint64_t i=1; i<compressedPseudoPath.size(); i++) {
                 const auto& previous = compressedPseudoPath[i-1];
                 const auto& current = compressedPseudoPath[i];
                 SHASTA_ASSERT(previous.segmentId != current.segmentId);
 
-                const SegmentPair segmentPair = make_pair(previous.segmentId, current.segmentId);
-                transitionMap[segmentPair].push_back(
-                    make_pair(orientedReadId, Transition({
+                TransitionInfo transitionInfo;
+                transitionInfo.segmentPair = make_pair(previous.segmentId, current.segmentId);
+                transitionInfo.orientedReadId = orientedReadId;
+                transitionInfo.position = uint32_t(i);
+                transitionInfo.transition = Transition({
                     previous.pseudoPathEntries[1],
-                    current.pseudoPathEntries[0]})));
+                    current.pseudoPathEntries[0]});
+                threadTransitions.push_back(transitionInfo);
+            }
+        }
+    }
+}
+
+
+
+void AssemblyGraph::findTransitionsPass1(size_t threadId)
+{
+    findTransitionsPass12(1);
+}
+
+
+
+void AssemblyGraph::findTransitionsPass2(size_t threadId)
+{
+    findTransitionsPass12(2);
+}
+
+
+
+// Batches are ranges of indexes in the concatenation of all thread buffers.
+void AssemblyGraph::findTransitionsPass12(uint64_t pass)
+{
+    const FindTransitionsData& data = findTransitionsData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Find the thread buffer that contains the beginning of this batch.
+        uint64_t threadId = uint64_t(std::upper_bound(
+            data.threadTransitionsBegin.begin(),
+            data.threadTransitionsBegin.end(), begin) - data.threadTransitionsBegin.begin()) - 1;
 
+        for(uint64_t i=begin; i!=end; i++) {
+            while(i >= data.threadTransitionsBegin[threadId + 1]) {
+                ++threadId;
+            }
+            const TransitionInfo& transitionInfo =
+                (*data.threadTransitions[threadId])[i - data.threadTransitionsBegin[threadId]];
+            const uint64_t segmentId0 = transitionInfo.segmentPair.first;
+            if(pass == 1) {
+                transitionsBySegment.incrementCountMultithreaded(segmentId0);
+            } else {
+                transitionsBySegment.storeMultithreaded(segmentId0, transitionInfo);
             }
         }
     }
@@ -561,20 +832,140 @@ void AssemblyGraph::findTransitions(std::map<SegmentPair, Transitions>& transiti
 
 
 
-void AssemblyGraph::createLinks(
-    const std::map<SegmentPair, Transitions>& transitionMap,
-    uint64_t minCoverage)
+// Loop over the links with a given segmentId0.
+// On entry, the transitions for segmentId0 must be sorted.
+// The function object is called with arguments
+// (index of the link among the links with this segmentId0,
+// begin and end of the transitions of the link).
+template<class F> void AssemblyGraph::forEachLinkOfSegment(
+    uint64_t segmentId0,
+    const F& f) const
+{
+    const span<const TransitionInfo> v = transitionsBySegment[segmentId0];
+    uint64_t linkIndex = 0;
+    for(auto it=v.begin(); it!=v.end(); /* Increment later */) {
+        auto streakEnd = it + 1;
+        while(streakEnd != v.end() and streakEnd->segmentPair == it->segmentPair) {
+            ++streakEnd;
+        }
+        const uint64_t coverage = streakEnd - it;
+        if(coverage >= createLinksData.minCoverage) {
+            f(linkIndex++, it, streakEnd);
+        }
+        it = streakEnd;
+    }
+}
+
+
+
+// Create links between pairs of segments with a sufficient number of transitions.
+// Links are created in order of increasing segment pair,
+// and the transitions of each link are in order of increasing
+// OrientedReadId and position in the compressed pseudopath.
+void AssemblyGraph::createLinks(uint64_t minCoverage, size_t threadCount)
 {
+    CreateLinksData& data = createLinksData;
+    data.minCoverage = minCoverage;
+    const uint64_t segmentCount = paths.size();
+    const uint64_t batchSize = 1000;
+
+    // Sort the transitions of each segmentId0 and count its links.
+    data.firstLinkId.clear();
+    data.firstLinkId.resize(segmentCount + 1, 0);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::createLinksThreadFunction1, threadCount);
+
+    // Assign link ids.
+    uint64_t linkCount = 0;
+    for(uint64_t segmentId0=0; segmentId0<segmentCount; segmentId0++) {
+        const uint64_t segmentLinkCount = data.firstLinkId[segmentId0];
+        data.firstLinkId[segmentId0] = linkCount;
+        linkCount += segmentLinkCount;
+    }
+    data.firstLinkId[segmentCount] = linkCount;
+
+    // Store the links and the number of transitions of each link.
     createNew(links, "Mode3-Links");
     createNew(transitions, "Mode3-Transitions");
-    for(const auto& p: transitionMap) {
-        const auto& transitionVector = p.second;
-        const uint64_t coverage = transitionVector.size();
-        if(coverage >= minCoverage) {
-            const uint64_t segmentId0 = p.first.first;
-            const uint64_t segmentId1 = p.first.second;
-            links.push_back(Link(segmentId0, segmentId1, coverage));
-            transitions.appendVector(transitionVector);
+    links.resize(linkCount);
+    transitions.beginPass1(linkCount);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::createLinksThreadFunction2, threadCount);
+
+    // Store the transitions.
+    transitions.beginPass2();
+    transitions.endPass2(false);
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::createLinksThreadFunction3, threadCount);
+
+    transitionsBySegment.remove();
+    data.firstLinkId.clear();
+    data.firstLinkId.shrink_to_fit();
+}
+
+
+
+void AssemblyGraph::createLinksThreadFunction1(size_t threadId)
+{
+    CreateLinksData& data = createLinksData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t segmentId0=begin; segmentId0!=end; segmentId0++) {
+            const span<TransitionInfo> v = transitionsBySegment[segmentId0];
+            sort(v.begin(), v.end());
+
+            uint64_t segmentLinkCount = 0;
+            forEachLinkOfSegment(segmentId0,
+                [&segmentLinkCount](uint64_t, const TransitionInfo*, const TransitionInfo*)
+                {
+                    ++segmentLinkCount;
+                });
+            data.firstLinkId[segmentId0] = segmentLinkCount;
+        }
+    }
+}
+
+
+
+void AssemblyGraph::createLinksThreadFunction2(size_t threadId)
+{
+    const CreateLinksData& data = createLinksData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t segmentId0=begin; segmentId0!=end; segmentId0++) {
+            const uint64_t firstLinkId = data.firstLinkId[segmentId0];
+            forEachLinkOfSegment(segmentId0,
+                [this, firstLinkId](uint64_t i, const TransitionInfo* b, const TransitionInfo* e)
+                {
+                    const uint64_t linkId = firstLinkId + i;
+                    const uint64_t coverage = e - b;
+                    links[linkId] = Link(b->segmentPair.first, b->segmentPair.second, coverage);
+                    transitions.incrementCount(linkId, coverage);
+                });
+        }
+    }
+}
+
+
+
+void AssemblyGraph::createLinksThreadFunction3(size_t threadId)
+{
+    const CreateLinksData& data = createLinksData;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t segmentId0=begin; segmentId0!=end; segmentId0++) {
+            const uint64_t firstLinkId = data.firstLinkId[segmentId0];
+            forEachLinkOfSegment(segmentId0,
+                [this, firstLinkId](uint64_t i, const TransitionInfo* b, const TransitionInfo* e)
+                {
+                    auto it = transitions.begin(firstLinkId + i);
+                    for(const TransitionInfo* t=b; t!=e; ++t, ++it) {
+                        *it = make_pair(t->orientedReadId, t->transition);
+                    }
+                });
         }
     }
 }
@@ -597,28 +988,61 @@ AssemblyGraph::AssemblyGraph(
     // Minimum number of transitions (oriented reads) to create a link.
     const uint64_t minCoverage = 2; // EXPOSE WHEN CODE STABILIZES
 
+    performanceLog << timestamp << "Mode 3 assembly graph creation begins." << endl;
+    const auto tBegin = steady_clock::now();
+
     // Create a segment for each linear chain of marker graph edges.
-    createSegmentPaths();
-    computeSegmentCoverage();
+    auto t0 = steady_clock::now();
+    createSegmentPaths(threadCount);
+    auto t1 = steady_clock::now();
+    performanceLog << timestamp << "createSegmentPaths took " << seconds(t1-t0) << " s." << endl;
+    t0 = t1;
+    computeSegmentCoverage(threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "computeSegmentCoverage took " << seconds(t1-t0) << " s." << endl;
 
     // Keep track of the segment and position each marker graph edge corresponds to.
+    t0 = t1;
     computeMarkerGraphEdgeTable(threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "computeMarkerGraphEdgeTable took " << seconds(t1-t0) << " s." << endl;
 
     // Compute pseudopaths of all oriented reads.
     // We permanently store only the compressed pseudopaths.
+    t0 = t1;
     computePseudoPaths(threadCount);
-    computeCompressedPseudoPaths();
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "computePseudoPaths took " << seconds(t1-t0) << " s." << endl;
+    t0 = t1;
+    computeCompressedPseudoPaths(threadCount);
     pseudoPaths.remove();
-    computeSegmentCompressedPseudoPathInfo();
-
-    // Find pseudopath transitions and store them keyed by the pair of segments.
-    std::map<SegmentPair, Transitions> transitionMap;
-    findTransitions(transitionMap);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "computeCompressedPseudoPaths took " << seconds(t1-t0) << " s." << endl;
+    t0 = t1;
+    computeSegmentCompressedPseudoPathInfo(threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "computeSegmentCompressedPseudoPathInfo took " << seconds(t1-t0) << " s." << endl;
+
+    // Find pseudopath transitions.
+    t0 = t1;
+    findTransitions(threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "findTransitions took " << seconds(t1-t0) << " s." << endl;
 
     // Create a links between pairs of segments with a sufficient number of transitions.
-    createLinks(transitionMap, minCoverage);
+    t0 = t1;
+    createLinks(minCoverage, threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "createLinks took " << seconds(t1-t0) << " s." << endl;
+    t0 = t1;
     createConnectivity();
     flagBackSegments();
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "createConnectivity and flagBackSegments took " <<
+        seconds(t1-t0) << " s." << endl;
+
+    performanceLog << timestamp << "Mode 3 assembly graph creation took " <<
+        seconds(t1-tBegin) << " s." << endl;
 
     cout << "The mode 3 assembly graph has " << paths.size() << " segments and " <<
         links.size() << " links." << endl;
@@ -626,12 +1050,16 @@ AssemblyGraph::AssemblyGraph(
 
 
 
+// If the prefix is in a shared read-only directory
+// (see class SharedAssemblyData), binary objects that were not
+// published are anonymous, so an attached process can create
+// the Mode 3 assembly graph without writing to the shared directory.
 string AssemblyGraph::largeDataName(const string& name) const
 {
     if(largeDataFileNamePrefix.empty()) {
         return "";  // Anonymous;
     } else {
-        return largeDataFileNamePrefix + name;
+        return MemoryMapped::vectorPolicy.sharedDataName(largeDataFileNamePrefix + name);
     }
 }
 
@@ -1072,7 +1500,8 @@ void AssemblyGraph::analyzeSegmentPair(
 
 
 
-// Gather oriented read information for each segment.
+// Gather oriented read information for each segment,
+// then use it to compute the segmentReadSketches.
 void AssemblyGraph::storeSegmentOrientedReadInformation(size_t threadCount)
 {
     const uint64_t segmentCount = paths.size();
@@ -1080,6 +1509,21 @@ void AssemblyGraph::storeSegmentOrientedReadInformation(size_t threadCount)
     const uint64_t batchSize = 10;
     setupLoadBalancing(segmentCount, batchSize);
     runThreads(&AssemblyGraph::storeSegmentOrientedReadInformationThreadFunction, threadCount);
+
+    // The size of the sketches depends on the average number
+    // of oriented reads per segment.
+    uint64_t orientedReadCount = 0;
+    for(const SegmentOrientedReadInformation& info: segmentOrientedReadInformation) {
+        orientedReadCount += info.infos.size();
+    }
+    const uint64_t averageOrientedReadCount =
+        (segmentCount == 0) ? 0 : (orientedReadCount / segmentCount);
+    segmentReadSketches.initialize(segmentCount, averageOrientedReadCount);
+    performanceLog << timestamp << "Segment read sketches use " <<
+        segmentReadSketches.bitCount() << " bits for an average of " <<
+        averageOrientedReadCount << " oriented reads per segment." << endl;
+    setupLoadBalancing(segmentCount, batchSize);
+    runThreads(&AssemblyGraph::storeSegmentReadSketchesThreadFunction, threadCount);
 }
 
 
@@ -1102,17 +1546,269 @@ void AssemblyGraph::storeSegmentOrientedReadInformationThreadFunction(size_t thr
     }
 }
 
+
+
+void AssemblyGraph::storeSegmentReadSketchesThreadFunction(size_t threadId)
+{
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over segments assigned to this batch.
+        for(uint64_t segmentId=begin; segmentId!=end; ++segmentId) {
+            segmentReadSketches.fill(segmentId, segmentOrientedReadInformation[segmentId]);
+        }
+    }
+}
+
+
+
+// The number of bits is the smallest power of 2 that is at least
+// 32 times the average number of oriented reads per segment,
+// so two unrelated segments with an average number of oriented reads
+// share on average less than 1/32 of their reads by chance.
+// It is at least 512 and at most 65536.
+void AssemblyGraph::SegmentReadSketches::initialize(
+    uint64_t segmentCount,
+    uint64_t averageOrientedReadCount)
+{
+    const uint64_t minBitCount = 512;
+    const uint64_t maxBitCount = 65536;
+    uint64_t n = minBitCount;
+    while((n < 32 * averageOrientedReadCount) and (n < maxBitCount)) {
+        n *= 2;
+    }
+    wordCount = n / 64;
+
+    bits.clear();
+    bits.resize(segmentCount * wordCount, 0);
+    collisionCounts.clear();
+    collisionCounts.resize(segmentCount, 0);
+}
+
+
+
+// Fill the sketch of a segment. Different threads can fill
+// the sketches of different segments at the same time.
+void AssemblyGraph::SegmentReadSketches::fill(
+    uint64_t segmentId,
+    const SegmentOrientedReadInformation& info)
+{
+    uint64_t* words = &bits[segmentId * wordCount];
+    std::fill(words, words + wordCount, 0);
+    const uint64_t mask = bitCount() - 1;
+
+    uint32_t collisionCount = 0;
+    for(const auto& orientedReadInfo: info.infos) {
+        const uint32_t value = orientedReadInfo.orientedReadId.getValue();
+        const uint64_t bit = MurmurHash64A(&value, sizeof(value), 231) & mask;
+        uint64_t& word = words[bit >> 6];
+        const uint64_t wordMask = uint64_t(1) << (bit & 63);
+        if(word & wordMask) {
+            ++collisionCount;
+        } else {
+            word |= wordMask;
+        }
+    }
+    collisionCounts[segmentId] = collisionCount;
+}
+
+
+
+uint64_t AssemblyGraph::SegmentReadSketches::commonCountUpperBound(
+    uint64_t segmentId0,
+    uint64_t segmentId1) const
+{
+    const uint64_t* words0 = &bits[segmentId0 * wordCount];
+    const uint64_t* words1 = &bits[segmentId1 * wordCount];
+    uint64_t bound = 0;
+    for(uint64_t i=0; i<wordCount; i++) {
+        bound += __builtin_popcountll(words0[i] & words1[i]);
+    }
+    return bound + min(collisionCounts[segmentId0], collisionCounts[segmentId1]);
+}
+
+
+
+void AssemblyGraph::SegmentReadSketches::clear()
+{
+    wordCount = 0;
+    bits.clear();
+    bits.shrink_to_fit();
+    collisionCounts.clear();
+    collisionCounts.shrink_to_fit();
+}
+
+
+
+// Check on random segments that the segment read sketches never discard
+// a segment pair with at least minCommonReadCount common oriented reads,
+// so addClusterPairs accepts the same pairs (and clusterSegments
+// finds the same clusters) with or without them, and that they
+// discard most of the pairs that have fewer common oriented reads.
+// Segments are in groups of groupSize that share a number of oriented reads
+// between 0 and 12, so there are pairs just above and just below the threshold.
+// For comparison, also report how many pairs would be discarded by
+// 64 buckets of saturated counts, as used before.
+void shasta::mode3::testSegmentReadSketches()
+{
+    const uint64_t segmentCount = 2000;
+    const uint64_t groupSize = 10;
+    const uint32_t orientedReadCount = 200000;
+    const uint64_t minCommonReadCount = 6;  // As in addClusterPairs.
+
+    // Create the oriented reads of each segment.
+    std::mt19937_64 randomGenerator(231);
+    std::uniform_int_distribution<uint32_t> orientedReadDistribution(0, orientedReadCount - 1);
+    std::uniform_int_distribution<uint64_t> ownReadCountDistribution(10, 80);
+    vector< vector<uint32_t> > orientedReadValues(segmentCount);
+    vector<uint32_t> sharedValues;
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        const uint64_t groupId = segmentId / groupSize;
+        if(segmentId % groupSize == 0) {
+            sharedValues.clear();
+            for(uint64_t i=0; i<groupId%13; i++) {
+                sharedValues.push_back(orientedReadDistribution(randomGenerator));
+            }
+        }
+        std::set<uint32_t> values(sharedValues.begin(), sharedValues.end());
+        const uint64_t ownReadCount = ownReadCountDistribution(randomGenerator);
+        for(uint64_t i=0; i<ownReadCount; i++) {
+            values.insert(orientedReadDistribution(randomGenerator));
+        }
+        orientedReadValues[segmentId].assign(values.begin(), values.end());
+    }
+
+    // Fill the sketches.
+    vector<AssemblyGraph::SegmentOrientedReadInformation> infos(segmentCount);
+    uint64_t totalOrientedReadCount = 0;
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        for(const uint32_t value: orientedReadValues[segmentId]) {
+            AssemblyGraph::SegmentOrientedReadInformation::Info info;
+            info.orientedReadId = OrientedReadId::fromValue(value);
+            info.averageOffset = 0;
+            infos[segmentId].infos.push_back(info);
+        }
+        totalOrientedReadCount += infos[segmentId].infos.size();
+    }
+    AssemblyGraph::SegmentReadSketches sketches;
+    sketches.initialize(segmentCount, totalOrientedReadCount / segmentCount);
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        sketches.fill(segmentId, infos[segmentId]);
+    }
+
+    // The old sketches: 64 buckets of counts saturated at 255.
+    const uint64_t oldBucketCount = 64;
+    vector< array<uint8_t, oldBucketCount> > oldSketches(segmentCount);
+    for(uint64_t segmentId=0; segmentId<segmentCount; segmentId++) {
+        array<uint8_t, oldBucketCount>& counts = oldSketches[segmentId];
+        std::fill(counts.begin(), counts.end(), uint8_t(0));
+        for(const uint32_t value: orientedReadValues[segmentId]) {
+            uint8_t& count = counts[MurmurHash64A(&value, sizeof(value), 231) % oldBucketCount];
+            if(count < 255) {
+                ++count;
+            }
+        }
+    }
+
+    // Check all pairs.
+    vector< pair<uint64_t, uint64_t> > acceptedPairs;
+    vector< pair<uint64_t, uint64_t> > acceptedPairsWithSketches;
+    uint64_t rejectedPairCount = 0;
+    uint64_t prunedPairCount = 0;
+    uint64_t oldPrunedPairCount = 0;
+    for(uint64_t segmentId0=0; segmentId0<segmentCount; segmentId0++) {
+        const vector<uint32_t>& values0 = orientedReadValues[segmentId0];
+        for(uint64_t segmentId1=segmentId0+1; segmentId1<segmentCount; segmentId1++) {
+            const vector<uint32_t>& values1 = orientedReadValues[segmentId1];
+
+            // Count the common oriented reads.
+            uint64_t commonCount = 0;
+            auto it0 = values0.begin();
+            auto it1 = values1.begin();
+            while(it0 != values0.end() and it1 != values1.end()) {
+                if(*it0 < *it1) {
+                    ++it0;
+                } else if(*it1 < *it0) {
+                    ++it1;
+                } else {
+                    ++commonCount;
+                    ++it0;
+                    ++it1;
+                }
+            }
+
+            const uint64_t bound = sketches.commonCountUpperBound(segmentId0, segmentId1);
+            SHASTA_ASSERT(bound >= commonCount);
+            const bool isPruned = (bound < minCommonReadCount);
+
+            uint64_t oldBound = 0;
+            for(uint64_t bucket=0; bucket<oldBucketCount; bucket++) {
+                oldBound += min(oldSketches[segmentId0][bucket], oldSketches[segmentId1][bucket]);
+            }
+            SHASTA_ASSERT(oldBound >= commonCount);
+
+            if(commonCount >= minCommonReadCount) {
+                acceptedPairs.push_back(make_pair(segmentId0, segmentId1));
+                if(not isPruned) {
+                    acceptedPairsWithSketches.push_back(make_pair(segmentId0, segmentId1));
+                }
+            } else {
+                ++rejectedPairCount;
+                if(isPruned) {
+                    ++prunedPairCount;
+                }
+                if(oldBound < minCommonReadCount) {
+                    ++oldPrunedPairCount;
+                }
+            }
+        }
+    }
+    SHASTA_ASSERT(acceptedPairs == acceptedPairsWithSketches);
+    SHASTA_ASSERT(not acceptedPairs.empty());
+
+    cout << "testSegmentReadSketches: " << segmentCount << " segments with an average of " <<
+        totalOrientedReadCount / segmentCount << " oriented reads, " <<
+        sketches.bitCount() << " bits per sketch." << endl;
+    cout << acceptedPairs.size() << " segment pairs have at least " << minCommonReadCount <<
+        " common oriented reads and were all kept." << endl;
+    cout << "Of the other " << rejectedPairCount << " segment pairs, " <<
+        prunedPairCount << " were discarded using the sketches, and " <<
+        oldPrunedPairCount << " would have been discarded using 64 buckets." << endl;
+    SHASTA_ASSERT(double(prunedPairCount) >= 0.95 * double(rejectedPairCount));
+    cout << "Success." << endl;
+}
+
+
+
 void AssemblyGraph::clusterSegments(size_t threadCount, uint64_t minClusterSize)
 {
     // Gather oriented read information for all segments.
+    auto t0 = steady_clock::now();
     storeSegmentOrientedReadInformation(threadCount);
+    auto t1 = steady_clock::now();
+    performanceLog << timestamp << "storeSegmentOrientedReadInformation took " <<
+        seconds(t1-t0) << " s." << endl;
 
     // Find the segment pairs.
+    t0 = t1;
     const uint64_t segmentCount = paths.size();
     const uint64_t batchSize = 10;
     setupLoadBalancing(segmentCount, batchSize);
     clusterSegmentsData.threadPairs.resize(threadCount);
+    clusterSegmentsData.consideredPairCount = 0;
+    clusterSegmentsData.prunedPairCount = 0;
+    clusterSegmentsData.acceptedPairCount = 0;
     runThreads(&AssemblyGraph::clusterSegmentsThreadFunction1, threadCount);
+    t1 = steady_clock::now();
+    performanceLog << timestamp << "Finding segment pairs took " << seconds(t1-t0) << " s." << endl;
+    performanceLog << "Segment pairs considered " << clusterSegmentsData.consideredPairCount <<
+        ", pruned using read sketches " << clusterSegmentsData.prunedPairCount <<
+        ", accepted " << clusterSegmentsData.acceptedPairCount << "." << endl;
+    cout << "Considered " << clusterSegmentsData.consideredPairCount << " segment pairs, of which " <<
+        clusterSegmentsData.prunedPairCount << " were pruned using read sketches and " <<
+        clusterSegmentsData.acceptedPairCount << " were accepted." << endl;
 
     // For now, write a dot file with the pairs.
     ofstream dot("SegmentGraph.dot");
@@ -1197,6 +1893,7 @@ void AssemblyGraph::clusterSegments(size_t threadCount, uint64_t minClusterSize)
     clusterSegmentsData.threadPairs.shrink_to_fit();
     segmentOrientedReadInformation.clear();
     segmentOrientedReadInformation.shrink_to_fit();
+    segmentReadSketches.clear();
 }
 
 
@@ -1282,6 +1979,11 @@ void AssemblyGraph::addClusterPairs(size_t threadId, uint64_t startSegmentId)
 
     // std::lock_guard<std::mutex> lock(mutex);    // *********** TAKE OUT
 
+    // Statistics for this segment.
+    uint64_t consideredPairCount = 0;
+    uint64_t prunedPairCount = 0;
+    uint64_t acceptedPairCount = 0;
+
     // Do a BFS and check each pair as we encounter it.
     // The BFS terminates when we found enough pairs.
 
@@ -1325,6 +2027,13 @@ void AssemblyGraph::addClusterPairs(size_t threadId, uint64_t startSegmentId)
                 // cout << "Found " << segmentId1 << endl;
 
                 // Check the pair (startSegmentId, segmentId1).
+                // First use the read sketches to discard it quickly, if possible.
+                ++consideredPairCount;
+                if(segmentReadSketches.commonCountUpperBound(
+                    startSegmentId, segmentId1) < minCommonReadCount) {
+                    ++prunedPairCount;
+                    continue;
+                }
                 SegmentPairInformation info;
                 analyzeSegmentPair(startSegmentId, segmentId1,
                     segmentOrientedReadInformation[startSegmentId],
@@ -1350,7 +2059,13 @@ void AssemblyGraph::addClusterPairs(size_t threadId, uint64_t startSegmentId)
                 break;
             }
         }
+        acceptedPairCount += foundCount;
     }
+
+    // Update the statistics.
+    __sync_fetch_and_add(&clusterSegmentsData.consideredPairCount, consideredPairCount);
+    __sync_fetch_and_add(&clusterSegmentsData.prunedPairCount, prunedPairCount);
+    __sync_fetch_and_add(&clusterSegmentsData.acceptedPairCount, acceptedPairCount);
 }
 #endif
 
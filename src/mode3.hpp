@@ -27,6 +27,8 @@ number of transitions 0->1, we create a link 0->1.
 
 // Standard library.
 #include "array.hpp"
+#include "memory.hpp"
+#include "tuple.hpp"
 #include "unordered_map"
 #include "vector.hpp"
 
@@ -35,6 +37,7 @@ number of transitions 0->1, we create a link 0->1.
 namespace shasta {
     namespace mode3 {
         class AssemblyGraph;
+        void testSegmentReadSketches();
     }
 
     // Some forward declarations of classes in the shasta namespace.
@@ -71,7 +74,7 @@ public:
     string largeDataName(const string&) const;
     template<class T> void createNew(T& t, const string& name)
     {
-        t.createNew(largeDataName(name), largeDataPageSize);
+        t.createNew(largeDataName(name), largeDataPageSize, name);
     }
     template<class T> void accessExistingReadOnly(T& t, const string& name)
     {
@@ -86,11 +89,51 @@ public:
     // The marker graph path corresponding to each segment is stored
     // indexed by segment id.
     MemoryMapped::VectorOfVectors<MarkerGraphEdgeId, uint64_t> paths;
-    void createSegmentPaths();
+    void createSegmentPaths(size_t threadCount);
+    void createSegmentPathsThreadFunction1(size_t threadId);
+    void createSegmentPathsThreadFunction2(size_t threadId);
+    bool isLinearMarkerGraphVertex(MarkerGraphVertexId) const;
+    void followSegmentPath(
+        MarkerGraphEdgeId startEdgeId,
+        vector<MarkerGraphEdgeId>& path,
+        MarkerGraphEdgeId& minEdgeId) const;
+    class CreateSegmentPathsData {
+    public:
+
+        // Bit vector used to flag marker graph edges
+        // that were already assigned to a path.
+        vector<uint64_t> wasFound;
+
+        // The paths found by each thread, stored contiguously.
+        // The last entry is used for circular paths.
+        vector< vector<MarkerGraphEdgeId> > threadPathEdges;
+
+        // Information about a path in threadPathEdges.
+        // Segment ids are assigned in order of increasing minEdgeId,
+        // which gives the same segment ids that
+        // a sequential loop over marker graph edges would.
+        class PathInfo {
+        public:
+            MarkerGraphEdgeId minEdgeId;
+            uint64_t threadId;
+            uint64_t begin;
+            uint64_t size;
+            bool operator<(const PathInfo& that) const
+            {
+                return minEdgeId < that.minEdgeId;
+            }
+        };
+        vector< vector<PathInfo> > threadPathInfos;
+
+        // All the PathInfo's, indexed by segment id.
+        vector<PathInfo> pathInfos;
+    };
+    CreateSegmentPathsData createSegmentPathsData;
 
     // Average marker graph edge coverage for all segments.
     MemoryMapped::Vector<float> segmentCoverage;
-    void computeSegmentCoverage();
+    void computeSegmentCoverage(size_t threadCount);
+    void computeSegmentCoverageThreadFunction(size_t threadId);
 
     // Keep track of the segment and position each marker graph edge corresponds to.
     // For each marker graph edge, store in the marker graph edge table
@@ -154,7 +197,10 @@ public:
     };
     // Indexed by OrientedReadId::getValue().
     MemoryMapped::VectorOfVectors<CompressedPseudoPathEntry, uint64_t> compressedPseudoPaths;
-    void computeCompressedPseudoPaths();
+    void computeCompressedPseudoPaths(size_t threadCount);
+    void computeCompressedPseudoPathsPass1(size_t threadId);
+    void computeCompressedPseudoPathsPass2(size_t threadId);
+    void computeCompressedPseudoPathsPass12(uint64_t pass);
     void computeCompressedPseudoPath(
         const span<PseudoPathEntry> pseudoPath,
         vector<CompressedPseudoPathEntry>& compressedPseudoPath);
@@ -162,7 +208,11 @@ public:
     // Store appearances of segments in compressed pseudopaths.
     // For each segment, store pairs (orientedReadId, position in compressed pseudo path).
     MemoryMapped::VectorOfVectors<pair<OrientedReadId, uint64_t>, uint64_t> segmentCompressedPseudoPathInfo;
-    void computeSegmentCompressedPseudoPathInfo();
+    void computeSegmentCompressedPseudoPathInfo(size_t threadCount);
+    void computeSegmentCompressedPseudoPathInfoPass1(size_t threadId);
+    void computeSegmentCompressedPseudoPathInfoPass2(size_t threadId);
+    void computeSegmentCompressedPseudoPathInfoPass12(uint64_t pass);
+    void sortSegmentCompressedPseudoPathInfo(size_t threadId);
 
 
 
@@ -175,11 +225,45 @@ public:
         Transition() {}
     };
 
-    // Find pseudopath transitions and store them keyed by the pair of segments.
+    // Find pseudopath transitions.
+    // This uses a flat pipeline with no per-segment-pair allocations:
+    // - Each thread appends the transitions it finds, without sorting,
+    //   to its own memory mapped buffer.
+    // - The transitions are then distributed by segmentId0
+    //   (a counting sort on the most significant half of the key)
+    //   into transitionsBySegment, a VectorOfVectors indexed by segmentId0.
+    // - createLinks sorts each of these small buckets
+    //   by segmentId1, OrientedReadId, and position in the compressed pseudopath,
+    //   and groups them in place into links.
     using SegmentPair = pair<uint64_t, uint64_t>;
-    using Transitions = vector< pair<OrientedReadId, Transition> >;
-    std::map<SegmentPair, Transitions> transitionMap;
-    void findTransitions(std::map<SegmentPair, Transitions>& transitionMap);
+    class TransitionInfo {
+    public:
+        SegmentPair segmentPair;
+        OrientedReadId orientedReadId;
+        uint32_t position;  // In the compressed pseudopath.
+        Transition transition;
+        bool operator<(const TransitionInfo& that) const
+        {
+            return
+                tie(segmentPair, orientedReadId, position) <
+                tie(that.segmentPair, that.orientedReadId, that.position);
+        }
+    };
+    MemoryMapped::VectorOfVectors<TransitionInfo, uint64_t> transitionsBySegment;
+    class FindTransitionsData {
+    public:
+        vector< shared_ptr< MemoryMapped::Vector<TransitionInfo> > > threadTransitions;
+
+        // The position of the first transition of each thread buffer
+        // in the concatenation of all thread buffers. Has size threadCount + 1.
+        vector<uint64_t> threadTransitionsBegin;
+    };
+    FindTransitionsData findTransitionsData;
+    void findTransitions(size_t threadCount);
+    void findTransitionsThreadFunction(size_t threadId);
+    void findTransitionsPass1(size_t threadId);
+    void findTransitionsPass2(size_t threadId);
+    void findTransitionsPass12(uint64_t pass);
 
 
 
@@ -197,9 +281,20 @@ public:
             segmentId1(segmentId1) {}
     };
     MemoryMapped::Vector<Link> links;
-    void createLinks(
-        const std::map<SegmentPair, Transitions>& transitionMap,
-        uint64_t minCoverage);
+    void createLinks(uint64_t minCoverage, size_t threadCount);
+    void createLinksThreadFunction1(size_t threadId);
+    void createLinksThreadFunction2(size_t threadId);
+    void createLinksThreadFunction3(size_t threadId);
+    class CreateLinksData {
+    public:
+        uint64_t minCoverage;
+
+        // The first link id for the links with each segmentId0.
+        // Indexed by segmentId0. Has size segmentCount + 1.
+        vector<uint64_t> firstLinkId;
+    };
+    CreateLinksData createLinksData;
+    template<class F> void forEachLinkOfSegment(uint64_t segmentId0, const F&) const;
 
     // The transitions for each link.
     // Indexed by linkId.
@@ -292,6 +387,43 @@ public:
     vector<SegmentOrientedReadInformation> segmentOrientedReadInformation;
     void storeSegmentOrientedReadInformation(size_t threadCount);
     void storeSegmentOrientedReadInformationThreadFunction(size_t threadId);
+    void storeSegmentReadSketchesThreadFunction(size_t threadId);
+
+    // Compact summaries of the oriented reads of each segment,
+    // used to quickly discard segment pairs that cannot have
+    // a sufficient number of common oriented reads.
+    // For each segment, each oriented read is hashed to one of bitCount()
+    // bits, and we also store the number of oriented reads
+    // that hashed to a bit that was already set (collisions).
+    // A common oriented read sets the same bit for both segments,
+    // and two common oriented reads can only share a bit
+    // if they also collide in each of the two segments. Therefore
+    // popcount(bits0 & bits1) + min(collisionCount0, collisionCount1)
+    // is an upper bound on the number of common oriented reads.
+    // The number of bits is a power of 2 and at least 512,
+    // chosen so random overlaps are rare at the average number
+    // of oriented reads per segment.
+    class SegmentReadSketches {
+    public:
+        void initialize(uint64_t segmentCount, uint64_t averageOrientedReadCount);
+        void fill(uint64_t segmentId, const SegmentOrientedReadInformation&);
+        uint64_t commonCountUpperBound(uint64_t segmentId0, uint64_t segmentId1) const;
+        uint64_t bitCount() const
+        {
+            return 64 * wordCount;
+        }
+        void clear();
+    private:
+        uint64_t wordCount = 0;
+
+        // wordCount words for each segment.
+        vector<uint64_t> bits;
+
+        // One for each segment.
+        vector<uint32_t> collisionCounts;
+    };
+    // Stored together with segmentOrientedReadInformation.
+    SegmentReadSketches segmentReadSketches;
 
 
 
@@ -402,6 +534,14 @@ public:
         // The segment pairs found by each thread.
         // In each pair, the lower number segment comes first.
         vector< vector< pair<uint64_t, uint64_t> > > threadPairs;
+
+        // Statistics.
+        // The number of segment pairs considered,
+        // the number discarded using the segmentReadSketches without calling
+        // analyzeSegmentPair, and the number accepted.
+        uint64_t consideredPairCount = 0;
+        uint64_t prunedPairCount = 0;
+        uint64_t acceptedPairCount = 0;
     };
     ClusterSegmentsData clusterSegmentsData;
     void clusterSegmentsThreadFunction1(size_t threadId);
@@ -0,0 +1,335 @@
+// Main program for the Shasta benchmark executable shastaBenchmark.
+// It runs micro-benchmarks of the main computational kernels
+// and writes the results in json format, so performance
+// can be compared across releases on the same hardware.
+// Most benchmarks use as input the binary data of an existing
+// assembly (directory Data in the assembly directory), and the
+// options of that assembly (shasta.conf in the assembly directory).
+// See shasta/benchmarkExecutable/README.md for more information.
+
+// Shasta.
+#include "Assembler.hpp"
+#include "AssemblerOptions.hpp"
+#include "Benchmark.hpp"
+#include "buildId.hpp"
+#include "Coverage.hpp"
+#include "dset64-gccAtomic.hpp"
+#include "filesystem.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MemoryMappedVectorOfVectorsBuilder.hpp"
+#include "platformDependent.hpp"
+#include "Reads.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+// Boost libraries.
+#include <boost/program_options.hpp>
+
+// Standard library.
+#include <filesystem>
+#include "fstream.hpp"
+#include "iostream.hpp"
+#include "stdexcept.hpp"
+#include "string.hpp"
+#include <thread>
+#include "vector.hpp"
+
+// Linux.
+#include <unistd.h>
+
+namespace shasta {
+    namespace benchmark {
+        void main(int argumentCount, const char** arguments);
+        void benchmarkDset64(Benchmark&, uint64_t n);
+        void benchmarkVectorOfVectorsFill(Benchmark&, uint64_t valueCount, size_t threadCount);
+    }
+}
+
+
+
+int main(int argumentCount, const char** arguments)
+{
+    try {
+        shasta::benchmark::main(argumentCount, arguments);
+    } catch(const boost::program_options::error_with_option_name& e) {
+        cout << "Invalid option: " << e.what() << endl;
+        return 1;
+    } catch (const exception& e) {
+        cout << timestamp << e.what() << endl;
+        return 2;
+    }
+    return 0;
+}
+
+
+
+void shasta::benchmark::main(int argumentCount, const char** arguments)
+{
+    using boost::program_options::options_description;
+    using boost::program_options::value;
+    using boost::program_options::variables_map;
+
+    string assemblyDirectory;
+    string outputFileName;
+    uint64_t threadCount;
+    uint64_t repetitionCount;
+    uint64_t sampleCount;
+    uint64_t dset64Size;
+    uint64_t vectorOfVectorsSize;
+    options_description optionsDescription("shastaBenchmark options");
+    optionsDescription.add_options()
+        ("help", "Write a help message.")
+        ("assemblyDirectory",
+        value<string>(&assemblyDirectory)->default_value("ShastaRun"),
+        "Directory of an existing assembly. Its binary data (directory Data) "
+        "and options (shasta.conf) are used as input.")
+        ("output",
+        value<string>(&outputFileName)->default_value("Benchmark.json"),
+        "Name of the json output file.")
+        ("threads",
+        value<uint64_t>(&threadCount)->default_value(0),
+        "Number of threads for multithreaded kernels, or 0 to use all available.")
+        ("repetitions",
+        value<uint64_t>(&repetitionCount)->default_value(3),
+        "Number of times each kernel is run. The minimum time is reported.")
+        ("samples",
+        value<uint64_t>(&sampleCount)->default_value(1000),
+        "Number of alignment candidates, marker graph edges, and "
+        "marker graph vertices used by each kernel.")
+        ("dset64Size",
+        value<uint64_t>(&dset64Size)->default_value(10000000),
+        "Number of items for the dset64 benchmark.")
+        ("vectorOfVectorsSize",
+        value<uint64_t>(&vectorOfVectorsSize)->default_value(10000000),
+        "Number of values for the VectorOfVectors fill benchmarks.")
+        ;
+    variables_map variablesMap;
+    store(parse_command_line(argumentCount, arguments, optionsDescription), variablesMap);
+    notify(variablesMap);
+    if(variablesMap.count("help")) {
+        cout << optionsDescription << endl;
+        return;
+    }
+    if(repetitionCount == 0) {
+        throw runtime_error("--repetitions must be at least 1.");
+    }
+    if(dset64Size == 0) {
+        throw runtime_error("--dset64Size must be at least 1.");
+    }
+    if(vectorOfVectorsSize == 0) {
+        throw runtime_error("--vectorOfVectorsSize must be at least 1.");
+    }
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    cout << buildId() << endl;
+
+    // Open the output file now, before changing to the scratch directory.
+    ofstream json(outputFileName);
+    if(not json) {
+        throw runtime_error("Unable to open " + outputFileName);
+    }
+
+    Benchmark benchmark(repetitionCount);
+    benchmark.context.push_back({"Shasta version", buildId()});
+    benchmark.context.push_back({"Threads", to_string(threadCount)});
+    benchmark.context.push_back({"Repetitions", to_string(repetitionCount)});
+    benchmark.context.push_back({"Samples", to_string(sampleCount)});
+
+    // These benchmarks do not use assembly data.
+    benchmarkDset64(benchmark, dset64Size);
+    benchmarkVectorOfVectorsFill(benchmark, vectorOfVectorsSize, threadCount);
+
+    // Get the options used for the assembly.
+    const string configFileName = assemblyDirectory + "/shasta.conf";
+    vector<const char*> assemblerArguments = {arguments[0]};
+    if(std::filesystem::exists(configFileName)) {
+        assemblerArguments.push_back("--config");
+        assemblerArguments.push_back(configFileName.c_str());
+    } else {
+        cout << configFileName << " not found. Using default options." << endl;
+    }
+    const AssemblerOptions assemblerOptions(
+        int(assemblerArguments.size()), assemblerArguments.data());
+
+    // Run the benchmarks that use assembly data.
+    if(std::filesystem::exists(assemblyDirectory + "/Data/Info")) {
+        const string absoluteAssemblyDirectory = filesystem::getAbsolutePath(assemblyDirectory);
+        benchmark.context.push_back({"Assembly directory", absoluteAssemblyDirectory});
+
+        // Some kernels (for example LowHash0) write csv files
+        // to the current directory. Run them in a scratch directory,
+        // so nothing is written to the assembly directory
+        // or to the current directory.
+        const string currentDirectory = filesystem::getCurrentDirectory();
+        const string scratchDirectory =
+            tmpDirectory() + "shastaBenchmark-" + to_string(::getpid());
+        filesystem::createDirectory(scratchDirectory);
+        filesystem::changeDirectory(scratchDirectory);
+        try {
+            Assembler assembler(absoluteAssemblyDirectory + "/Data/", false, 1, 0);
+            assembler.accessAllSoft();
+            benchmark.context.push_back({"Reads", to_string(assembler.getReads().readCount())});
+            assembler.benchmarkKernels(benchmark, assemblerOptions, sampleCount, threadCount);
+        } catch(...) {
+            filesystem::changeDirectory(currentDirectory);
+            std::filesystem::remove_all(scratchDirectory);
+            throw;
+        }
+        filesystem::changeDirectory(currentDirectory);
+        std::filesystem::remove_all(scratchDirectory);
+    } else {
+        cout << "Binary data for assembly directory " << assemblyDirectory <<
+            " not found. Only benchmarks that don't use assembly data will run." << endl;
+    }
+
+    benchmark.writeJson(json);
+    benchmark.writeSummary(cout);
+    cout << "Benchmark results written to " << outputFileName << endl;
+}
+
+
+
+// Unite random pairs of items, then find the set of each item, sequentially.
+// Uses a simple linear congruential generator
+// so the input is the same on all platforms.
+void shasta::benchmark::benchmarkDset64(Benchmark& benchmark, uint64_t n)
+{
+    using Aint = DisjointSets::Aint;
+    vector<Aint> data(n);
+    vector< pair<uint64_t, uint64_t> > pairs(n);
+    uint64_t x = 1;
+    for(auto& p: pairs) {
+        x = 6364136223846793005ULL * x + 1442695040888963407ULL;
+        p.first = (x >> 11) % n;
+        x = 6364136223846793005ULL * x + 1442695040888963407ULL;
+        p.second = (x >> 11) % n;
+    }
+
+    // Path compression during find changes the data structure,
+    // so each repetition starts again from scratch.
+    benchmark.run("Dset64", "unite and find operations", 2 * n,
+        [&]()
+        {
+            DisjointSets disjointSets(&data.front(), n);
+            uint64_t checksum = 0;
+            for(const auto& p: pairs) {
+                disjointSets.unite(p.first, p.second);
+            }
+            for(uint64_t i=0; i<n; i++) {
+                checksum += disjointSets.find(i);
+            }
+            return checksum;
+        });
+}
+
+
+
+// Fill a VectorOfVectors with the bucket layout used by LowHash0 and LowHash1,
+// once with the two pass construction with atomic counters
+// (incrementCountMultithreaded and storeMultithreaded, used by LowHash
+// before VectorOfVectorsBuilder) and once with VectorOfVectorsBuilder
+// (used by LowHash now). Both kernels compute the same buckets,
+// so they report the same checksum.
+// There are valueCount values of 8 bytes (the size of a LowHash BucketEntry)
+// and a power of 2 number of buckets with a load factor between 1 and 2.
+// As for LowHash features from repeats and high frequency k-mers,
+// one value in 16 goes to one of 64 hot buckets. The rest are spread
+// uniformly by a linear congruential generator, so the input
+// is the same on all platforms.
+void shasta::benchmark::benchmarkVectorOfVectorsFill(
+    Benchmark& benchmark,
+    uint64_t valueCount,
+    size_t threadCount)
+{
+    uint64_t bucketCount = 1;
+    while(2 * bucketCount <= valueCount) {
+        bucketCount *= 2;
+    }
+    const uint64_t mask = bucketCount - 1;
+    const auto getBucketId = [mask](uint64_t i) -> uint64_t
+    {
+        const uint64_t x = 6364136223846793005ULL * i + 1442695040888963407ULL;
+        if(((x >> 60) & 15) == 0) {
+            return ((x >> 32) & 63) * 0x9E3779B97F4A7C15ULL & mask;
+        } else {
+            return (x >> 16) & mask;
+        }
+    };
+
+    // Run a function in threadCount threads, each on a contiguous range of values.
+    const auto runThreads = [valueCount, threadCount](const auto& f)
+    {
+        vector<std::thread> threads;
+        for(size_t threadId=0; threadId<threadCount; threadId++) {
+            const uint64_t begin = (valueCount * threadId) / threadCount;
+            const uint64_t end = (valueCount * (threadId + 1)) / threadCount;
+            threads.push_back(std::thread([&f, threadId, begin, end]() {f(threadId, begin, end);}));
+        }
+        for(std::thread& t: threads) {
+            t.join();
+        }
+    };
+
+    // The checksum only uses bucket sizes, so it does not depend
+    // on the order of values in each bucket, and it is cheap
+    // compared to filling the buckets.
+    // testVectorOfVectorsBuilder checks that the values are the same.
+    const auto checksum = [bucketCount](const MemoryMapped::VectorOfVectors<uint64_t, uint64_t>& v)
+    {
+        uint64_t sum = 0;
+        for(uint64_t bucketId=0; bucketId<bucketCount; bucketId++) {
+            sum += (bucketId + 1) * v.size(bucketId);
+        }
+        return sum;
+    };
+
+    const vector< pair<string, string> > parameters = {
+        {"Threads", to_string(threadCount)},
+        {"Buckets", to_string(bucketCount)}};
+
+    benchmark.run("VectorOfVectorsTwoPass", "values", valueCount,
+        [&]()
+        {
+            MemoryMapped::VectorOfVectors<uint64_t, uint64_t> v;
+            v.createNew("", 4096);
+            v.beginPass1(bucketCount);
+            runThreads([&](size_t, uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; i++) {
+                    v.incrementCountMultithreaded(getBucketId(i));
+                }
+            });
+            v.beginPass2();
+            runThreads([&](size_t, uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; i++) {
+                    v.storeMultithreaded(getBucketId(i), i);
+                }
+            });
+            v.endPass2(false, false);
+            const uint64_t sum = checksum(v);
+            v.remove();
+            return sum;
+        },
+        parameters);
+
+    benchmark.run("VectorOfVectorsBuilder", "values", valueCount,
+        [&]()
+        {
+            MemoryMapped::VectorOfVectors<uint64_t, uint64_t> v;
+            v.createNew("", 4096);
+            MemoryMapped::VectorOfVectorsBuilder<uint64_t, uint64_t> builder(threadCount, "", 4096);
+            runThreads([&](size_t threadId, uint64_t begin, uint64_t end)
+            {
+                for(uint64_t i=begin; i!=end; i++) {
+                    builder.emit(threadId, getBucketId(i), i);
+                }
+            });
+            builder.build(bucketCount, v, threadCount);
+            const uint64_t sum = checksum(v);
+            v.remove();
+            return sum;
+        },
+        parameters);
+}
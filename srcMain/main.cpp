@@ -8,15 +8,20 @@
 #include "Assembler.hpp"
 #include "AssemblerOptions.hpp"
 #include "AssemblyGraph.hpp"
+#include "BinaryDataSnapshot.hpp"
 #include "buildId.hpp"
 #include "ConfigurationTable.hpp"
 #include "Coverage.hpp"
 #include "filesystem.hpp"
+#include "MemoryMappedVectorPolicy.hpp"
 #include "performanceLog.hpp"
+#include "PhaseTimer.hpp"
 #include "Reads.hpp"
 #include "Tee.hpp"
 #include "timestamp.hpp"
 #include "platformDependent.hpp"
+#include "ReadSimulator.hpp"
+#include "SharedAssemblyData.hpp"
 #include "SimpleBayesianConsensusCaller.hpp"
 
 // Standard library.
@@ -35,15 +40,18 @@ namespace shasta {
         void mode0Assembly(
             Assembler&,
             const AssemblerOptions&,
-            uint32_t threadCount);
+            uint32_t threadCount,
+            PhaseTimer&);
         void mode2Assembly(
             Assembler&,
             const AssemblerOptions&,
-            uint32_t threadCount);
+            uint32_t threadCount,
+            PhaseTimer&);
         void mode3Assembly(
             Assembler&,
             const AssemblerOptions&,
-            uint32_t threadCount);
+            uint32_t threadCount,
+            PhaseTimer&);
 
         void setupRunDirectory(
             const string& memoryMode,
@@ -53,12 +61,18 @@ namespace shasta {
             );
 
         void setupHugePages();
+        void checkTransparentHugePages();
         void segmentFaultHandler(int);
 
         // Functions that implement --command keywords
         void assemble(const AssemblerOptions&, int argumentCount, const char** arguments);
         void saveBinaryData(const AssemblerOptions&);
         void cleanupBinaryData(const AssemblerOptions&);
+        void saveBinaryDataSnapshot(const AssemblerOptions&);
+        void restoreBinaryDataSnapshot(const AssemblerOptions&);
+        void publishSharedData(const AssemblerOptions&);
+        void cleanupSharedData(const AssemblerOptions&);
+        void simulateReads(const AssemblerOptions&);
         void createBashCompletionScript(const AssemblerOptions&);
         void listCommands();
         void listConfigurations();
@@ -68,12 +82,17 @@ namespace shasta {
         const std::set<string> commands = {
             "assemble",
             "cleanupBinaryData",
+            "cleanupSharedData",
             "createBashCompletionScript",
             "explore",
             "listCommands",
             "listConfiguration",
             "listConfigurations",
-            "saveBinaryData"};
+            "publishSharedData",
+            "restoreBinaryDataSnapshot",
+            "saveBinaryData",
+            "saveBinaryDataSnapshot",
+            "simulateReads"};
 
     }
 
@@ -159,6 +178,19 @@ void shasta::main::main(int argumentCount, const char** arguments)
         throw runtime_error(message);
     }
 
+    // Set the growth and prefault policy for memory mapped vectors.
+    if(not (assemblerOptions.commandLineOnlyOptions.memoryGrowthFactor > 1.)) {
+        throw runtime_error("Invalid value " +
+            to_string(assemblerOptions.commandLineOnlyOptions.memoryGrowthFactor) +
+            " specified for --memoryGrowthFactor. Must be greater than 1.");
+    }
+    MemoryMapped::vectorPolicy.growthFactor =
+        assemblerOptions.commandLineOnlyOptions.memoryGrowthFactor;
+    MemoryMapped::vectorPolicy.setPrefaultMode(
+        assemblerOptions.commandLineOnlyOptions.memoryPrefault);
+    MemoryMapped::vectorPolicy.prefaultThreshold =
+        assemblerOptions.commandLineOnlyOptions.memoryPrefaultThreshold * 1024ULL * 1024ULL;
+
 
 
     // Execute the requested command.
@@ -171,6 +203,21 @@ void shasta::main::main(int argumentCount, const char** arguments)
     } else if(assemblerOptions.commandLineOnlyOptions.command == "saveBinaryData") {
         saveBinaryData(assemblerOptions);
         return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "saveBinaryDataSnapshot") {
+        saveBinaryDataSnapshot(assemblerOptions);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "restoreBinaryDataSnapshot") {
+        restoreBinaryDataSnapshot(assemblerOptions);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "publishSharedData") {
+        publishSharedData(assemblerOptions);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "cleanupSharedData") {
+        cleanupSharedData(assemblerOptions);
+        return;
+    } else if(assemblerOptions.commandLineOnlyOptions.command == "simulateReads") {
+        simulateReads(assemblerOptions);
+        return;
     } else if(assemblerOptions.commandLineOnlyOptions.command == "explore") {
         explore(assemblerOptions);
         return;
@@ -401,6 +448,10 @@ void shasta::main::assemble(
     // Write out the build id again.
     cout << buildId() << endl;
 
+    MemoryMapped::vectorStatistics.write(performanceLog);
+    if(MemoryMapped::vectorPolicy.transparentHugePages) {
+        MemoryMapped::vectorStatistics.writeTransparentHugePageCoverage(performanceLog);
+    }
     performanceLog << timestamp << "Assembly ends." << endl;
     cout << timestamp << "Assembly ends." << endl;
 }
@@ -442,9 +493,19 @@ void shasta::main::setupRunDirectory(
             setupHugePages();
             pageSize = 2 * 1024 * 1024;
 
+        } else if(memoryBacking == "THP") {
+
+            // Anonymous memory on 4KB pages, aligned to 2MB and
+            // advised to use transparent huge pages.
+            // This does not require root privilege.
+            dataDirectory = "";
+            pageSize = 4096;
+            MemoryMapped::vectorPolicy.transparentHugePages = true;
+            checkTransparentHugePages();
+
         } else {
             throw runtime_error("Invalid value specified for --memoryBacking: " + memoryBacking +
-                "\nValid values are: disk, 4K, 2M.");
+                "\nValid values are: disk, 4K, 2M, THP.");
         }
 
     } else if(memoryMode == "filesystem") {
@@ -495,9 +556,15 @@ void shasta::main::setupRunDirectory(
                     " running command: " + command);
             }
 
+        } else if(memoryBacking == "THP") {
+
+            // This combination is not supported.
+            throw runtime_error("\"--memoryBacking THP\" is only allowed in combination "
+                "with \"--memoryMode anonymous\".");
+
         } else {
             throw runtime_error("Invalid value specified for --memoryBacking: " + memoryBacking +
-                "\nValid values are: disk, 4K, 2M.");
+                "\nValid values are: disk, 4K, 2M, THP.");
         }
 
     } else {
@@ -536,7 +603,14 @@ void shasta::main::assemble(
 
 
 
+    // Elapsed time, CPU time, and peak memory of each phase
+    // are written to PhaseTimes.csv.
+    PhaseTimer phaseTimer(assemblerOptions.commandLineOnlyOptions.resetPeakMemoryPerPhase);
+
+
+
     // Add reads from the specified input files.
+    phaseTimer.beginPhase("LoadReads");
     performanceLog << timestamp << "Begin loading reads from " << inputFileNames.size() << " files." << endl;
     const auto t0 = steady_clock::now();
     for(const string& inputFileName: inputFileNames) {
@@ -591,6 +665,7 @@ void shasta::main::assemble(
 
 
     // Select the k-mers that will be used as markers.
+    phaseTimer.beginPhase("SelectKmers");
     switch(assemblerOptions.kmersOptions.generationMethod) {
     case 0:
         assembler.randomlySelectKmers(
@@ -647,6 +722,7 @@ void shasta::main::assemble(
 
 
     // Find the markers in the reads.
+    phaseTimer.beginPhase("FindMarkers");
     assembler.findMarkers(0);
 
     if(!assemblerOptions.readsOptions.palindromicReads.skipFlagging) {
@@ -666,6 +742,7 @@ void shasta::main::assemble(
 
 
     // Find alignment candidates.
+    phaseTimer.beginPhase("FindAlignmentCandidates");
     if(assemblerOptions.minHashOptions.allPairs) {
         assembler.markAlignmentCandidatesAllPairs();
     } else if(assemblerOptions.minHashOptions.version == 0) {
@@ -707,6 +784,7 @@ void shasta::main::assemble(
 
 
     // Compute alignments.
+    phaseTimer.beginPhase("ComputeAlignments");
     assembler.computeAlignments(
         assemblerOptions.alignOptions,
         threadCount);
@@ -714,10 +792,12 @@ void shasta::main::assemble(
 
 
     // Create the read graph.
+    phaseTimer.beginPhase("ReadGraph");
     if(assemblerOptions.readGraphOptions.creationMethod == 0) {
         assembler.createReadGraph(
             assemblerOptions.readGraphOptions.maxAlignmentCount,
-            assemblerOptions.alignOptions.maxTrim);
+            assemblerOptions.alignOptions.maxTrim,
+            threadCount);
 
         // Actual alignment criteria are as specified in the command line options
         // and/or configuration.
@@ -735,7 +815,8 @@ void shasta::main::assemble(
             assemblerOptions.readGraphOptions.alignedFractionPercentile,
             assemblerOptions.readGraphOptions.maxSkipPercentile,
             assemblerOptions.readGraphOptions.maxDriftPercentile,
-            assemblerOptions.readGraphOptions.maxTrimPercentile);
+            assemblerOptions.readGraphOptions.maxTrimPercentile,
+            threadCount);
     } else {
         throw runtime_error("Invalid value for --ReadGraph.creationMethod.");
     }
@@ -763,7 +844,7 @@ void shasta::main::assemble(
 
     // Strict strand separation.
     if(assemblerOptions.readGraphOptions.strandSeparationMethod == 2) {
-        assembler.flagCrossStrandReadGraphEdges2();
+        assembler.flagCrossStrandReadGraphEdges2(threadCount);
     }
 
     // Compute connected components of the read graph.
@@ -771,7 +852,7 @@ void shasta::main::assemble(
     // For strand separation method 2 this was already done
     // in flagCrossStrandReadGraphEdges2.
     if(assemblerOptions.readGraphOptions.strandSeparationMethod != 2) {
-        assembler.computeReadGraphConnectedComponents();
+        assembler.computeReadGraphConnectedComponents(threadCount);
     }
 
 
@@ -779,13 +860,13 @@ void shasta::main::assemble(
     // Do the rest of the assembly using the selected assembly mode.
     switch(assemblerOptions.assemblyOptions.mode) {
     case 0:
-        mode0Assembly(assembler, assemblerOptions, threadCount);
+        mode0Assembly(assembler, assemblerOptions, threadCount, phaseTimer);
         break;
     case 2:
-        mode2Assembly(assembler, assemblerOptions, threadCount);
+        mode2Assembly(assembler, assemblerOptions, threadCount, phaseTimer);
         break;
     case 3:
-        mode3Assembly(assembler, assemblerOptions, threadCount);
+        mode3Assembly(assembler, assemblerOptions, threadCount, phaseTimer);
         break;
     default:
         throw runtime_error("Invalid value specified for --Assembly.mode. "
@@ -795,6 +876,8 @@ void shasta::main::assemble(
     }
 
 
+    phaseTimer.beginPhase("Summary");
+
     // Store elapsed time for assembly.
     const auto steadyClock1 = std::chrono::steady_clock::now();
     const auto userClock1 = boost::chrono::process_user_cpu_clock::now();
@@ -810,6 +893,8 @@ void shasta::main::assemble(
     assembler.storeAssemblyTime(elapsedTime, averageCpuUtilization);
 
     // Store peak memory usage.
+    // This is peak virtual memory, which is not affected by the reset
+    // of peak resident memory done by the PhaseTimer with --resetPeakMemoryPerPhase.
     uint64_t peakMemoryUsage = getPeakMemoryUsage();
     assembler.storePeakMemoryUsage(peakMemoryUsage);
 
@@ -838,6 +923,11 @@ void shasta::main::assemble(
     performanceLog << "Peak Memory usage: " << peakMemoryUsage << " bytes = " <<
         int(std::round(double(peakMemoryUsage) / (1024. * 1024. * 1024.)) ) << " GiB" << endl;
 
+    phaseTimer.endPhase();
+    ofstream phaseTimesCsv("PhaseTimes.csv");
+    phaseTimer.writeCsv(phaseTimesCsv);
+    performanceLog << "Peak resident memory: " << phaseTimer.peakResidentMemory() << " bytes." << endl;
+
 }
 
 
@@ -845,11 +935,13 @@ void shasta::main::assemble(
 void shasta::main::mode0Assembly(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
-    uint32_t threadCount)
+    uint32_t threadCount,
+    PhaseTimer& phaseTimer)
 {
 
     // Iterative assembly, if requested (experimental).
     if(assemblerOptions.assemblyOptions.iterative) {
+        phaseTimer.beginPhase("IterativeAssembly");
         for(uint64_t iteration=0;
             iteration<assemblerOptions.assemblyOptions.iterativeIterationCount;
             iteration++) {
@@ -910,6 +1002,7 @@ void shasta::main::mode0Assembly(
     // Create marker graph vertices.
     // This uses a disjoint sets data structure to merge markers
     // that are aligned based on an alignment present in the read graph.
+    phaseTimer.beginPhase("MarkerGraph");
     assembler.createMarkerGraphVertices(
         assemblerOptions.markerGraphOptions.minCoverage,
         assemblerOptions.markerGraphOptions.maxCoverage,
@@ -965,6 +1058,7 @@ void shasta::main::mode0Assembly(
     assembler.simplifyMarkerGraph(assemblerOptions.markerGraphOptions.simplifyMaxLengthVector, false);
 
     // Create the assembly graph.
+    phaseTimer.beginPhase("AssemblyGraph");
     assembler.createAssemblyGraphEdges();
     assembler.createAssemblyGraphVertices();
 
@@ -985,12 +1079,16 @@ void shasta::main::mode0Assembly(
 
     // Detangle, if requested.
     if(assemblerOptions.assemblyOptions.detangleMethod == 1) {
-        assembler.detangle();
+        assembler.detangle(
+            assemblerOptions.assemblyOptions.detangleInRounds,
+            threadCount);
     } else if(assemblerOptions.assemblyOptions.detangleMethod == 2) {
         assembler.detangle2(
             assemblerOptions.assemblyOptions.detangleDiagonalReadCountMin,
             assemblerOptions.assemblyOptions.detangleOffDiagonalReadCountMax,
-            assemblerOptions.assemblyOptions.detangleOffDiagonalRatio
+            assemblerOptions.assemblyOptions.detangleOffDiagonalRatio,
+            assemblerOptions.assemblyOptions.detangleInRounds,
+            threadCount
             );
     }
 
@@ -1005,6 +1103,7 @@ void shasta::main::mode0Assembly(
     }
 
     // Compute optimal repeat counts for each vertex of the marker graph.
+    phaseTimer.beginPhase("Consensus");
     if(assemblerOptions.readsOptions.representation == 1) {
         assembler.assembleMarkerGraphVertices(threadCount);
     }
@@ -1029,11 +1128,15 @@ void shasta::main::mode0Assembly(
         threadCount,
         assemblerOptions.assemblyOptions.storeCoverageDataCsvLengthThreshold);
     // assembler.findAssemblyGraphBubbles();
+
+    // Write the assembly.
+    phaseTimer.beginPhase("Output");
     assembler.computeAssemblyStatistics();
-    assembler.writeGfa1("Assembly.gfa");
-    assembler.writeGfa1BothStrands("Assembly-BothStrands.gfa");
-    assembler.writeGfa1BothStrandsNoSequence("Assembly-BothStrands-NoSequence.gfa");
-    assembler.writeFasta("Assembly.fasta");
+    assembler.writeGfa1("Assembly.gfa", threadCount);
+    assembler.writeGfa1BothStrands("Assembly-BothStrands.gfa", threadCount);
+    assembler.writeGfa1BothStrandsNoSequence("Assembly-BothStrands-NoSequence.gfa", threadCount);
+    assembler.writeFasta("Assembly.fasta", threadCount);
+    assembler.writeAssemblyGraphBinary("Assembly-Graph.bin");
 
     // If requested, write out the oriented reads that were used to assemble
     // each assembled segment.
@@ -1049,9 +1152,11 @@ void shasta::main::mode0Assembly(
 void shasta::main::mode2Assembly(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
-    uint32_t threadCount)
+    uint32_t threadCount,
+    PhaseTimer& phaseTimer)
 {
     // Create marker graph vertices.
+    phaseTimer.beginPhase("MarkerGraph");
     assembler.createMarkerGraphVertices(
         assemblerOptions.markerGraphOptions.minCoverage,
         assemblerOptions.markerGraphOptions.maxCoverage,
@@ -1086,6 +1191,7 @@ void shasta::main::mode2Assembly(
     assembler.computeMarkerGraphCoverageHistogram();
 
     // Compute optimal repeat counts for each vertex of the marker graph.
+    phaseTimer.beginPhase("Consensus");
     if(assemblerOptions.readsOptions.representation == 1) {
         assembler.assembleMarkerGraphVertices(threadCount);
     }
@@ -1100,6 +1206,7 @@ void shasta::main::mode2Assembly(
         );
 
     // Create the mode 2 assembly graph.
+    phaseTimer.beginPhase("AssemblyGraph2");
     assembler.createAssemblyGraph2(
         assemblerOptions.assemblyOptions.pruneLength,
         assemblerOptions.assemblyOptions.mode2Options,
@@ -1116,9 +1223,11 @@ void shasta::main::mode2Assembly(
 void shasta::main::mode3Assembly(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
-    uint32_t threadCount)
+    uint32_t threadCount,
+    PhaseTimer& phaseTimer)
 {
     // Create marker graph vertices.
+    phaseTimer.beginPhase("MarkerGraph");
     assembler.createMarkerGraphVertices(
         assemblerOptions.markerGraphOptions.minCoverage,
         assemblerOptions.markerGraphOptions.maxCoverage,
@@ -1146,6 +1255,7 @@ void shasta::main::mode3Assembly(
     assembler.computeMarkerGraphCoverageHistogram();
 
     // Compute optimal repeat counts for each vertex of the marker graph.
+    phaseTimer.beginPhase("Consensus");
     if(assemblerOptions.readsOptions.representation == 1) {
         assembler.assembleMarkerGraphVertices(threadCount);
     }
@@ -1160,6 +1270,7 @@ void shasta::main::mode3Assembly(
         );
 
     // Run mode 3 assembly.
+    phaseTimer.beginPhase("Mode3Assembly");
     assembler.mode3Assembly(
         threadCount);
 
@@ -1216,6 +1327,35 @@ void shasta::main::setupHugePages()
 
 
 
+// Check that transparent huge pages are enabled,
+// which is required for --memoryBacking THP to be effective.
+// This does not require root privilege and does not change
+// system settings. If transparent huge pages are not available,
+// the assembly still runs but with 4K pages.
+void shasta::main::checkTransparentHugePages()
+{
+    const string fileName = "/sys/kernel/mm/transparent_hugepage/enabled";
+    ifstream file(fileName);
+    string setting;
+    getline(file, setting);
+    if(not file) {
+        cout << "Could not read " << fileName << ".\n"
+            "Transparent huge pages may not be available." << endl;
+        return;
+    }
+
+    // The setting in effect is enclosed in square brackets,
+    // for example "always [madvise] never".
+    if(setting.find("[never]") != string::npos) {
+        cout << "Transparent huge pages are disabled on this system (" << fileName <<
+            " is set to \"" << setting << "\").\n"
+            "The assembly will use 4K pages." << endl;
+    }
+    performanceLog << "Transparent huge pages setting: " << setting << endl;
+}
+
+
+
 // Implementation of --command saveBinaryData.
 // This copies Data to DataOnDisk.
 void shasta::main::saveBinaryData(
@@ -1284,6 +1424,187 @@ void shasta::main::cleanupBinaryData(
 
 }
 
+
+
+// Implementation of --command saveBinaryDataSnapshot.
+// This saves the contents of Data to a compressed snapshot file
+// DataSnapshot in the assembly directory.
+// See class BinaryDataSnapshot for more information.
+void shasta::main::saveBinaryDataSnapshot(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "saveBinaryDataSnapshot");
+
+    // Locate the Data directory.
+    const string dataDirectory =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/Data";
+    if(!std::filesystem::exists(dataDirectory)) {
+        throw runtime_error(dataDirectory + " does not exist, nothing done.");
+    }
+
+    // Check that the snapshot does not exist.
+    const string snapshotFileName =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/DataSnapshot";
+    if(std::filesystem::exists(snapshotFileName)) {
+        throw runtime_error(snapshotFileName + " already exists, nothing done.");
+    }
+
+    // Get the page size of the binary data, which is stored in the snapshot.
+    uint64_t pageSize = 0;
+    {
+        MemoryMapped::Object<AssemblerInfo> assemblerInfo;
+        assemblerInfo.accessExistingReadOnly(dataDirectory + "/Info");
+        pageSize = assemblerInfo->largeDataPageSize;
+    }
+
+    openPerformanceLog(assemblerOptions.commandLineOnlyOptions.assemblyDirectory +
+        "/performance-saveBinaryDataSnapshot.log");
+    BinaryDataSnapshot snapshot(assemblerOptions.commandLineOnlyOptions.threadCount);
+    snapshot.save(dataDirectory, snapshotFileName, pageSize);
+    cout << "Binary data snapshot successfully saved." << endl;
+}
+
+
+
+// Implementation of --command restoreBinaryDataSnapshot.
+// This recreates the Data directory, as specified by
+// --memoryMode filesystem and --memoryBacking, and restores
+// into it the contents of DataSnapshot.
+// The page size implied by --memoryBacking must be the same
+// as the page size of the binary data that were saved.
+void shasta::main::restoreBinaryDataSnapshot(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "restoreBinaryDataSnapshot");
+
+    if(assemblerOptions.commandLineOnlyOptions.memoryMode != "filesystem") {
+        throw runtime_error("--command restoreBinaryDataSnapshot requires "
+            "--memoryMode filesystem.");
+    }
+
+    // Check that the snapshot exists and that Data does not.
+    const string snapshotFileName =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/DataSnapshot";
+    if(!std::filesystem::exists(snapshotFileName)) {
+        throw runtime_error(snapshotFileName + " does not exist, nothing done.");
+    }
+    const string dataDirectory =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/Data";
+    if(std::filesystem::exists(dataDirectory) or std::filesystem::is_symlink(dataDirectory)) {
+        throw runtime_error(dataDirectory + " already exists, nothing done. "
+            "Use --command cleanupBinaryData to remove it.");
+    }
+
+    // Check the page size before creating the Data directory.
+    // This uses the same page sizes as setupRunDirectory.
+    const uint64_t snapshotPageSize = BinaryDataSnapshot::getPageSize(snapshotFileName);
+    const uint64_t requiredPageSize =
+        (assemblerOptions.commandLineOnlyOptions.memoryBacking == "2M") ? (2 * 1024 * 1024) : 4096;
+    if(snapshotPageSize != requiredPageSize) {
+        throw runtime_error(snapshotFileName + " contains binary data with page size " +
+            to_string(snapshotPageSize) + " which cannot be restored with --memoryBacking " +
+            assemblerOptions.commandLineOnlyOptions.memoryBacking + ". Use " +
+            ((snapshotPageSize == 2 * 1024 * 1024) ? "--memoryBacking 2M." :
+            "--memoryBacking disk or 4K.") + " Nothing done.");
+    }
+
+    // Set up the Data directory as required by the memoryMode and memoryBacking options.
+    filesystem::changeDirectory(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
+    openPerformanceLog("performance-restoreBinaryDataSnapshot.log");
+    size_t pageSize = 0;
+    string dataDirectoryPrefix;
+    setupRunDirectory(
+        assemblerOptions.commandLineOnlyOptions.memoryMode,
+        assemblerOptions.commandLineOnlyOptions.memoryBacking,
+        pageSize,
+        dataDirectoryPrefix);
+
+    BinaryDataSnapshot snapshot(assemblerOptions.commandLineOnlyOptions.threadCount);
+    snapshot.restore("DataSnapshot", "Data", pageSize);
+    cout << "Binary data snapshot successfully restored." << endl;
+}
+
+
+
+// Implementation of --command publishSharedData.
+// This copies the contents of Data to the shared directory
+// specified by --sharedDataDirectory, so any number of
+// --command explore processes (or Python scripts) can use them
+// without each having its own copy in memory.
+// See class SharedAssemblyData for more information.
+void shasta::main::publishSharedData(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "publishSharedData");
+
+    if(assemblerOptions.commandLineOnlyOptions.sharedDataDirectory.empty()) {
+        throw runtime_error("--command publishSharedData requires --sharedDataDirectory.");
+    }
+    const string dataDirectory =
+        assemblerOptions.commandLineOnlyOptions.assemblyDirectory + "/Data";
+    if(!std::filesystem::exists(dataDirectory)) {
+        throw runtime_error(dataDirectory + " does not exist, nothing done.");
+    }
+
+    openPerformanceLog(assemblerOptions.commandLineOnlyOptions.assemblyDirectory +
+        "/performance-publishSharedData.log");
+    SharedAssemblyData sharedAssemblyData(assemblerOptions.commandLineOnlyOptions.threadCount);
+    sharedAssemblyData.publish(dataDirectory,
+        assemblerOptions.commandLineOnlyOptions.sharedDataDirectory);
+    cout << "Use --command explore --sharedDataDirectory " <<
+        assemblerOptions.commandLineOnlyOptions.sharedDataDirectory <<
+        " to use the shared data, and --command cleanupSharedData to remove them "
+        "when no longer needed." << endl;
+}
+
+
+
+// Implementation of --command cleanupSharedData.
+// This removes a shared directory created by --command publishSharedData,
+// if no process is using it.
+void shasta::main::cleanupSharedData(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "cleanupSharedData");
+
+    if(assemblerOptions.commandLineOnlyOptions.sharedDataDirectory.empty()) {
+        throw runtime_error("--command cleanupSharedData requires --sharedDataDirectory.");
+    }
+    SharedAssemblyData::cleanup(assemblerOptions.commandLineOnlyOptions.sharedDataDirectory);
+}
+
+
+
+// Implementation of --command simulateReads.
+// This generates synthetic reads from a random genome,
+// to be used as input for assemblies of arbitrary size.
+// See class ReadSimulator for more information.
+void shasta::main::simulateReads(
+    const AssemblerOptions& assemblerOptions)
+{
+    SHASTA_ASSERT(assemblerOptions.commandLineOnlyOptions.command == "simulateReads");
+    const CommandLineOnlyOptions& options = assemblerOptions.commandLineOnlyOptions;
+
+    ReadSimulator::Parameters parameters;
+    parameters.genomeSize = options.simulateGenomeSize;
+    parameters.repeatFraction = options.simulateRepeatFraction;
+    parameters.repeatLength = options.simulateRepeatLength;
+    parameters.repeatFamilyCount = options.simulateRepeatFamilyCount;
+    parameters.repeatDivergence = options.simulateRepeatDivergence;
+    parameters.heterozygosity = options.simulateHeterozygosity;
+    parameters.coverage = options.simulateCoverage;
+    parameters.readLengthMean = options.simulateReadLengthMean;
+    parameters.readLengthStandardDeviation = options.simulateReadLengthStandardDeviation;
+    parameters.minReadLength = options.simulateMinReadLength;
+    parameters.errorModel = options.simulateErrorModel;
+    parameters.substitutionRate = options.simulateSubstitutionRate;
+    parameters.indelRate = options.simulateIndelRate;
+    parameters.seed = options.simulateSeed;
+
+    ReadSimulator readSimulator(parameters, options.threadCount);
+    readSimulator.run(options.simulateOutputPrefix);
+}
+
 // Implementation of --command explore.
 void shasta::main::explore(
     const AssemblerOptions& assemblerOptions)
@@ -1301,11 +1622,20 @@ void shasta::main::explore(
         alignmentsPafFileAbsolutePath = filesystem::getAbsolutePath(assemblerOptions.commandLineOnlyOptions.alignmentsPafFile);
     }
 
+    // If a shared directory was specified, attach to it
+    // before we switch to the assembly directory.
+    SharedAssemblyData sharedAssemblyData;
+    string largeDataFileNamePrefix = "Data/";
+    if(not assemblerOptions.commandLineOnlyOptions.sharedDataDirectory.empty()) {
+        sharedAssemblyData.attach(assemblerOptions.commandLineOnlyOptions.sharedDataDirectory);
+        largeDataFileNamePrefix = sharedAssemblyData.largeDataFileNamePrefix();
+    }
+
     // Go to the assembly directory.
     filesystem::changeDirectory(assemblerOptions.commandLineOnlyOptions.assemblyDirectory);
     
     // Check that we have the binary data. 
-    if(!std::filesystem::exists("Data")) {
+    if(not sharedAssemblyData.isAttached() and !std::filesystem::exists("Data")) {
         throw runtime_error("Binary directory \"Data\" not available "
         " in assembly directory " + 
         assemblerOptions.commandLineOnlyOptions.assemblyDirectory +
@@ -1318,10 +1648,11 @@ void shasta::main::explore(
     }
     
     // Create the Assembler.
-    Assembler assembler("Data/", false, 1, 0);
+    Assembler assembler(largeDataFileNamePrefix, false, 1, 0);
     
-    // Access all available binary data.
-    assembler.accessAllSoft();
+    // Register all available binary data.
+    // Each binary object is only accessed when first needed.
+    assembler.accessAllLazy(assemblerOptions.commandLineOnlyOptions.exploreWarmup);
     
     // Set up the consensus caller.
     cout << "Setting up consensus caller " <<